@@ -0,0 +1,112 @@
+
+//===================================================================================//
+/*
+  Filename: Dual_Bus_Server.ino [ESP32]
+  Description: This example demonstrates how to run two Modbus RTU Servers on two
+  different types of serial ports at the same time. The first server uses an RS-485
+  port with a DE pin (RS485Class). The second server uses a raw hardware serial port
+  (HardwareSerial) with an RS-485 module that has automatic data-direction control.
+  Both servers share the same Holding Register layout.
+
+  You can use the `Holding_Register_Client.ino` sketch on the Client side to test the
+  servers. Use the address 0x01 for the first bus and 0x02 for the second bus.
+
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Library Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  Last Modified: +05:30 08:10:25 PM 16-10-2026, Friday
+ */
+//===================================================================================//
+
+#include <CSE_ArduinoRS485.h>
+#include <CSE_ModbusRTU.h>
+
+//===================================================================================//
+
+// You can define the serial port pins here.
+#define   PIN_RS485_RX        16
+#define   PIN_RS485_TX        17
+#define   PIN_RS485_DE        4
+
+#define   PIN_SERIAL2_RX      25
+#define   PIN_SERIAL2_TX      26
+
+#define   PORT_RS485          Serial1 // The hardware serial port for the RS-485 interface
+#define   PORT_SERIAL2        Serial2 // The hardware serial port for the second bus
+
+//===================================================================================//
+
+// Declare the RS485 interface here with a hardware serial port.
+RS485Class RS485 (PORT_RS485, PIN_RS485_DE, -1, PIN_RS485_TX); // (Serial Port, DE, RE, TX)
+
+// Create the transports. The port type is a template parameter, so the port is
+// accessed directly in the receive loop of each node.
+CSE_ModbusRTU_Port <RS485Class> rs485Transport (&RS485);
+CSE_ModbusRTU_StreamPort <HardwareSerial> serialTransport (&PORT_SERIAL2);
+
+// Create a Modbus RTU node instance for each bus.
+CSE_ModbusRTU modbusRTU1 (rs485Transport, 0x01, "modbusRTU-0x01"); // (Transport, Device Address, Device Name)
+CSE_ModbusRTU modbusRTU2 (serialTransport, 0x02, "modbusRTU-0x02"); // (Transport, Device Address, Device Name)
+
+// Create a Modbus RTU server instance for each node.
+CSE_ModbusRTU_Server modbusRTUServer1 (modbusRTU1, "modbusRTUServer1"); // (CSE_ModbusRTU, Server Name)
+CSE_ModbusRTU_Server modbusRTUServer2 (modbusRTU2, "modbusRTUServer2"); // (CSE_ModbusRTU, Server Name)
+
+//===================================================================================//
+/**
+ * @brief Configures nine Holding Registers starting at address 0x00 on a server, and
+ * sets the value of the first four.
+ * 
+ * @param server The server to configure.
+ */
+void configureServer (CSE_ModbusRTU_Server& server) {
+  server.begin();
+  server.setNonBlocking (true);
+  server.configureHoldingRegisters (0x00, 9);
+
+  server.writeHoldingRegister (0x00, 0x1234);
+  server.writeHoldingRegister (0x01, 0x4321);
+  server.writeHoldingRegister (0x02, 0xFF00);
+  server.writeHoldingRegister (0x03, 0x00FF);
+}
+
+//===================================================================================//
+
+void setup() {
+  // Initialize the default serial port for debug messages.
+  Serial.begin (115200);
+  delay (1000);
+  Serial.println ("CSE_ModbusRTU - Dual Bus Server");
+
+  // Initialize the serial ports manually.
+  // This particualr begin() call is specific to ESP32-Arduino.
+  // If you are using a different controller, change the begin() call accordingly.
+  PORT_RS485.begin (9600, SERIAL_8N1, PIN_RS485_RX, PIN_RS485_TX);
+  PORT_SERIAL2.begin (9600, SERIAL_8N1, PIN_SERIAL2_RX, PIN_SERIAL2_TX);
+
+  // Initialize the RS485 interface. If you are initializing the RS485 interface
+  // manually, then the parameter can be empty.
+  RS485.begin();
+
+  // Initialize the Modbus RTU servers. The non-blocking mode is used, so that one server
+  // does not wait for a frame while the other bus is active.
+  configureServer (modbusRTUServer1);
+  configureServer (modbusRTUServer2);
+
+  // Enable/Disable the debug messages here.
+  // CSE_ModbusRTU_Debug:: enableDebugMessages();
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+}
+
+//===================================================================================//
+
+void loop() {
+  // Poll both buses for Modbus RTU requests.
+  modbusRTUServer1.poll();
+  modbusRTUServer2.poll();
+}
+
+//===================================================================================//
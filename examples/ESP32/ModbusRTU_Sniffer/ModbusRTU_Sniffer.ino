@@ -0,0 +1,145 @@
+
+//===================================================================================//
+/*
+  Filename: ModbusRTU_Sniffer.ino [ESP32]
+  Description: This example demonstrates how to monitor a Modbus RTU bus without taking
+  part in the communication. All the frames on the bus are captured, paired as requests
+  and responses, and printed with their timestamps and round-trip times. The RS-485
+  driver is never enabled.
+
+  The received bytes are pushed to a ring buffer from the receive callback of the
+  serial port, so that the frame timing is taken from the arrival time of each byte.
+  
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Library Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  Last Modified: +05:30 06:02:51 PM 16-10-2026, Friday
+ */
+//===================================================================================//
+
+#include <CSE_ArduinoRS485.h>
+#include <CSE_ModbusRTU.h>
+
+//===================================================================================//
+
+// You can define the serial port pins here.
+#define   PIN_RS485_RX        16
+#define   PIN_RS485_TX        17
+
+#define   PORT_RS485          Serial2 // The hardware serial port for the RS-485 interface
+#define   BAUDRATE_RS485      115200  // The baud rate of the bus
+
+//===================================================================================//
+
+// Declare the RS485 interface here with a hardware serial port.
+RS485Class RS485 (PORT_RS485, -1, -1, PIN_RS485_TX); // (Serial Port, DE, RE, TX)
+
+// Create a Modbus RTU node instance with the RS485 interface.
+// The device address is not used by the sniffer.
+CSE_ModbusRTU modbusRTU (&RS485, 0x00, "modbusRTU-Sniffer"); // (RS-485 Port, Device Address, Device Name)
+
+// Create a Modbus RTU sniffer instance with the Modbus RTU node.
+CSE_ModbusRTU_Sniffer modbusRTUSniffer (modbusRTU, "modbusRTUSniffer"); // (CSE_ModbusRTU, Sniffer Name)
+
+// The received bytes are saved here with their arrival times.
+CSE_ModbusRTU_RingBuffer rxBuffer;
+
+//===================================================================================//
+/**
+ * @brief Called by the ESP32 serial driver when bytes are received.
+ * 
+ */
+void onModbusReceive() {
+  while (PORT_RS485.available()) {
+    rxBuffer.push (PORT_RS485.read(), micros());
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Called by the sniffer for every captured frame.
+ * 
+ * @param frame The captured frame.
+ */
+void onFrame (CSE_ModbusRTU_Sniffer::frame_t& frame) {
+  Serial.print (frame.endTime);
+  Serial.print (" us #");
+  Serial.print (frame.sequence);
+
+  if (frame.status < 0) {
+    Serial.println (frame.status == MODBUS_RTU_RECEIVE_FRAMING_ERROR ? " Framing error" : " CRC error");
+    return;
+  }
+
+  switch (frame.adu.getType()) {
+    case CSE_ModbusRTU_ADU::aduType_t:: REQUEST:
+      Serial.print (" Request  ");
+      break;
+    case CSE_ModbusRTU_ADU::aduType_t:: RESPONSE:
+      Serial.print (" Response ");
+      break;
+    case CSE_ModbusRTU_ADU::aduType_t:: EXCEPTION:
+      Serial.print (" Exception");
+      break;
+    default:
+      Serial.print (" Unknown  ");
+      break;
+  }
+
+  Serial.print (" Address: ");
+  Serial.print (frame.adu.getDeviceAddress());
+  Serial.print (" FC: 0x");
+  Serial.print (frame.adu.getFunctionCode(), HEX);
+  Serial.print (" Length: ");
+  Serial.print (frame.status);
+
+  if (frame.roundTripTime > 0) {
+    Serial.print (" RTT: ");
+    Serial.print (frame.roundTripTime);
+    Serial.print (" us");
+  }
+
+  Serial.println();
+}
+
+//===================================================================================//
+void setup() {
+  // Initialize the default serial port for debug messages.
+  Serial.begin (921600);
+  delay (1000);
+  Serial.println ("CSE_ModbusRTU - Sniffer");
+
+  // Initialize the RS485 port manually.
+  // This particualr begin() call is specific to ESP32-Arduino.
+  PORT_RS485.begin (BAUDRATE_RS485, SERIAL_8N1, PIN_RS485_RX, PIN_RS485_TX);
+
+  // Call the receive callback for every byte, so that the timestamps are accurate.
+  PORT_RS485.setRxFIFOFull (1);
+  PORT_RS485.onReceive (onModbusReceive);
+
+  RS485.begin();
+
+  // Set the frame timing for the bus. The port uses 8N1.
+  modbusRTU.setBaudRate (BAUDRATE_RS485);
+  modbusRTU.setCharacterBits (10);
+  modbusRTU.setReceiveBuffer (&rxBuffer);
+
+  // Start listening. DE is deasserted and never asserted again.
+  modbusRTUSniffer.setCallback (onFrame);
+  modbusRTUSniffer.begin();
+
+  // The debug messages would slow down the capture.
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+}
+
+//===================================================================================//
+
+void loop() {
+  // Capture the frames. This does not block.
+  modbusRTUSniffer.poll();
+}
+
+//===================================================================================//
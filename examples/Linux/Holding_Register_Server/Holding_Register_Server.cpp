@@ -0,0 +1,88 @@
+
+//===================================================================================//
+/*
+  Filename: Holding_Register_Server.cpp [Linux]
+  Description: This example demonstrates how to run a Modbus RTU Server with Holding
+  Registers on a Linux or macOS computer, using a USB-RS485 adapter. You can use the
+  `Holding_Register_Client.ino` sketch on the Client side to test the server.
+
+  This is not an Arduino sketch. Compile it from the root folder of the library with:
+
+    g++ -std=gnu++11 -O2 -Isrc examples/Linux/Holding_Register_Server/Holding_Register_Server.cpp src/CSE_ModbusRTU*.cpp -o Holding_Register_Server
+
+  Then run it with the path of the serial device:
+
+    ./Holding_Register_Server /dev/ttyUSB0
+
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Library Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  Last Modified: +05:30 06:40:00 PM 16-10-2026, Friday
+ */
+//===================================================================================//
+
+#include <CSE_ModbusRTU.h>
+#include <stdio.h>
+
+//===================================================================================//
+
+#define   BAUDRATE_RS485      9600
+
+//===================================================================================//
+
+int main (int argc, char* argv[]) {
+  const char* device = (argc > 1) ? argv [1] : "/dev/ttyUSB0";
+
+  // Most USB-RS485 adapters switch the direction automatically. If your adapter uses
+  // the RTS line for DE, use MODBUS_RTU_POSIX_DE_RTS instead.
+  CSE_ModbusRTU_PosixSerial RS485 (device, BAUDRATE_RS485, "8N1", MODBUS_RTU_POSIX_DE_NONE);
+
+  // Create a Modbus RTU node instance with the serial port.
+  CSE_ModbusRTU modbusRTU (&RS485, 0x01, "modbusRTU-0x01"); // (Serial Port, Device Address, Device Name)
+
+  // Create a Modbus RTU server instance with the Modbus RTU node.
+  CSE_ModbusRTU_Server modbusRTUServer (modbusRTU, "modbusRTUServer"); // (CSE_ModbusRTU, Server Name)
+
+  printf ("CSE_ModbusRTU - Holding Register Server [Linux]\n");
+
+  if (!RS485.begin()) {
+    perror (device);
+    return 1;
+  }
+
+  // USB adapters deliver the received bytes in packets, with gaps that can be longer
+  // than the inter-character timeout. Only the inter-frame delay is used to find the
+  // end of a frame then.
+  modbusRTU.setBaudRate (BAUDRATE_RS485);
+  modbusRTU.setInterCharTimeout (0);
+
+  // Initialize the Modbus RTU server.
+  modbusRTUServer.begin();
+  modbusRTUServer.setNonBlocking (true);
+
+  // Configure nine Holding Registers starting at address 0x00.
+  modbusRTUServer.configureHoldingRegisters (0x00, 9);
+
+  // Set the value of the first four Holding Registers.
+  modbusRTUServer.writeHoldingRegister (0x00, 0x1234);
+  modbusRTUServer.writeHoldingRegister (0x01, 0x4321);
+  modbusRTUServer.writeHoldingRegister (0x02, 0xFF00);
+  modbusRTUServer.writeHoldingRegister (0x03, 0x00FF);
+
+  // Enable/Disable the debug messages here.
+  CSE_ModbusRTU_Debug:: enableDebugMessages();
+  // CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  while (true) {
+    // Poll for Modbus RTU requests.
+    modbusRTUServer.poll();
+    delayMicroseconds (200);
+  }
+
+  return 0;
+}
+
+//===================================================================================//
@@ -25,6 +25,7 @@ bool CSE_ModbusRTU_Debug:: debugEnabled = false;
  * 
  */
 CSE_ModbusRTU_ADU::CSE_ModbusRTU_ADU() {
+  resetLength();
   clear();
 }
 
@@ -41,6 +42,11 @@ CSE_ModbusRTU_ADU::CSE_ModbusRTU_ADU() {
  */
 bool CSE_ModbusRTU_ADU:: resetLength() {
   aduLength = 0;
+
+  // Start a new running CRC
+  crcValue = MODBUS_RTU_CRC_INIT;
+  crcLength = 0;
+
   return true;
 }
 
@@ -52,9 +58,9 @@ bool CSE_ModbusRTU_ADU:: resetLength() {
  * ADU buffer. If you change the aduLength manually, you will end up with a corrupted ADU
  * buffer
  * 
- * @return uint8_t - The current aduLength.
+ * @return uint16_t - The current aduLength.
  */
-uint8_t CSE_ModbusRTU_ADU:: getLength() {
+uint16_t CSE_ModbusRTU_ADU:: getLength() {
   return aduLength;
 }
 
@@ -66,7 +72,14 @@ uint8_t CSE_ModbusRTU_ADU:: getLength() {
  * @return false - Operation failed.
  */
 bool CSE_ModbusRTU_ADU:: clear() {
-  return clear (0, MODBUS_RTU_ADU_LENGTH_MAX);
+  // The full buffer length does not fit in the uint8_t length parameter of clear().
+  for (uint16_t i = 0; i < MODBUS_RTU_ADU_LENGTH_MAX; i++) {
+    aduBuffer [i] = 0x00;
+  }
+
+  invalidateCRC (0);
+
+  return true;
 }
 
 //======================================================================================//
@@ -99,10 +112,12 @@ bool CSE_ModbusRTU_ADU:: clear (uint8_t index, uint8_t length) {
     return false;
   }
 
-  for (uint8_t i = index; i < (index + length); i++) {
+  for (uint16_t i = index; i < (index + length); i++) {
     aduBuffer [i] = 0x00;
   }
 
+  invalidateCRC (index);
+
   return true;
 }
 
@@ -111,6 +126,9 @@ bool CSE_ModbusRTU_ADU:: clear (uint8_t index, uint8_t length) {
  * @brief Add a single byte to the ADU buffer. The new byte is written at the end of the
  * buffer indicated by aduLength. The aduLength is incremented by 1.
  * 
+ * The running CRC is also updated with the new byte, if it is up to date. This is what
+ * allows the CRC of a received frame to be checked without reading the buffer again.
+ * 
  * @param byte The byte to add.
  * @return true - Operation successful.
  * @return false - Operation failed.
@@ -120,6 +138,12 @@ bool CSE_ModbusRTU_ADU:: add (uint8_t byte) {
     return false;
   }
 
+  // Update the running CRC only if it already covers all the previous bytes.
+  if (crcLength == aduLength) {
+    crcValue = CSE_ModbusRTU_CRC:: update (crcValue, byte);
+    crcLength++;
+  }
+
   aduBuffer [aduLength++] = byte;
 
   return true;
@@ -175,31 +199,58 @@ bool CSE_ModbusRTU_ADU:: add (uint16_t word) {
  * the buffer indicated by aduLength. The aduLength is incremented by the length of
  * the word array times 2.
  * 
+ * The words are converted to the big-endian byte order directly into the ADU buffer in
+ * one pass with CSE_ModbusRTU_Codec, after a single bounds check.
+ * 
  * @param buffer A 16-bit data buffer to add.
  * @param length The number of 16-bit data words to add (not the number of bytes)
  * @return true - Operation successful.
  * @return false - Operation failed.
  */
-bool CSE_ModbusRTU_ADU:: add (uint16_t* buffer, uint8_t length) {
+bool CSE_ModbusRTU_ADU:: add (const uint16_t* buffer, uint8_t length) {
   if ((aduLength + (length * 2)) > MODBUS_RTU_ADU_LENGTH_MAX) {
     return false;
   }
 
-  // Split the words and add them to the buffer
-  for (uint8_t i = 0; i < length; i++) {
-    aduBuffer [aduLength++] = (uint8_t) (buffer [i] >> 8);
-    aduBuffer [aduLength++] = (uint8_t) (buffer [i] & 0xFF);
-  }
+  // The Hi byte of each word is added first
+  CSE_ModbusRTU_Codec:: encode (aduBuffer + aduLength, buffer, length);
+  aduLength += length * 2;
 
   return true;
 }
 
+//======================================================================================//
+/**
+ * @brief Reserves a number of bytes at the end of the ADU buffer, and returns a pointer
+ * to them. The aduLength is incremented by the length, and the caller writes the bytes
+ * in place. This avoids building the data in a separate array and copying it with add().
+ * The bytes must be written before the CRC is set.
+ * 
+ * @param length The number of bytes to reserve.
+ * @return uint8_t* - Pointer to the first reserved byte; NULL if the bytes don't fit.
+ */
+uint8_t* CSE_ModbusRTU_ADU:: reserve (uint8_t length) {
+  if ((aduLength + length) > MODBUS_RTU_ADU_LENGTH_MAX) {
+    return NULL;
+  }
+
+  uint8_t* span = aduBuffer + aduLength;
+  aduLength += length;
+
+  return span;
+}
+
 //======================================================================================//
 /**
  * @brief Calculates the CRC of the ADU and compares it to the CRC in the ADU. If the ADU
  * length is less than 3, that means that the device address, function code, and data are
  * not set yet. In this case, we can't calculate the CRC and the function returns `false`.
  * 
+ * The CRC-16/MODBUS of a frame including its own CRC bytes (low byte first) is always
+ * zero. So the check is done by bringing the running CRC up to the full ADU length and
+ * comparing it with zero. If the ADU was filled with `add (uint8_t)`, the running CRC is
+ * already up to date and the check takes constant time.
+ * 
  * @return true - If the CRCs match.
  * @return false - If the CRCs do not match.
  */
@@ -212,13 +263,16 @@ bool CSE_ModbusRTU_ADU:: checkCRC() {
   }
 
   // To check CRC, it must have been already set.
-  uint16_t crc = calculateCRC (true);
-
-  if ((aduBuffer [aduLength - 2] == (uint8_t) (crc & 0xFF)) && (aduBuffer [aduLength - 1] == (uint8_t) (crc >> 8))) {
+  // If the running CRC already covers the whole buffer (after setCRC() or receiving),
+  // no bytes are read here.
+  if (updateCRC (aduLength) == 0x0000) {
     // DEBUG_PRINTLN (F("checkCRC(): CRCs match."));
     return true;
   }
   else {
+    // Only used for printing the expected value
+    uint16_t crc = CSE_ModbusRTU_CRC:: calculate (aduBuffer, aduLength - MODBUS_RTU_CRC_LENGTH);
+
     DEBUG_PRINT (F("checkCRC(): Error - CRCs do not match. Found: 0x"));
     DEBUG_PRINT (aduBuffer [aduLength - 2], HEX);
     DEBUG_PRINT (aduBuffer [aduLength - 1], HEX);
@@ -233,6 +287,7 @@ bool CSE_ModbusRTU_ADU:: checkCRC() {
  * @brief Calculates the CRC of the ADU contents and returns it. If the aduLength is
  * not sufficient to calculate the CRC then 0x00 is returned. The CRC can be calculated
  * for the entire ADU buffer, or exclude the last two bytes if the CRC is already set.
+ * Only the bytes not yet covered by the running CRC are processed.
  * 
  * @param isCRCSet If true, the CRC is already set and should not be included in the
  * CRC calculation. If false, the CRC is not set and use the entire ADU bufer for CRC
@@ -246,9 +301,7 @@ uint16_t CSE_ModbusRTU_ADU:: calculateCRC (bool isCRCSet) {
     return 0x0000;
   }
 
-  uint16_t crc = 0xFFFF;
-
-  uint8_t length = 0;
+  uint16_t length = 0;
 
   if (isCRCSet) {
     // If the CRC is already set, then we don't want to include it in the CRC calculation.
@@ -258,20 +311,43 @@ uint16_t CSE_ModbusRTU_ADU:: calculateCRC (bool isCRCSet) {
     length = aduLength;
   }
 
-  for (uint8_t i = 0; i < length; i++) {
-    crc ^= aduBuffer [i];
+  return updateCRC (length);
+}
 
-    for (uint8_t j = 0; j < 8; j++) {
-      if ((crc & 0x0001) == 0x0001) {
-        crc >>= 1;
-        crc ^= 0xA001;
-      } else {
-        crc >>= 1;
-      }
-    }
+//======================================================================================//
+/**
+ * @brief Brings the running CRC up to the specified length and returns it. Bytes that
+ * are already covered are not processed again. If the running CRC already covers more
+ * bytes than the specified length, it is restarted from the beginning of the buffer.
+ * 
+ * @param length The number of bytes the CRC should cover.
+ * @return uint16_t - The CRC of the first `length` bytes.
+ */
+uint16_t CSE_ModbusRTU_ADU:: updateCRC (uint16_t length) {
+  if (crcLength > length) {
+    crcValue = MODBUS_RTU_CRC_INIT;
+    crcLength = 0;
   }
 
-  return crc;
+  // The CRC engine is selected at compile time. See CSE_ModbusRTU_CRC.h.
+  crcValue = CSE_ModbusRTU_CRC:: calculate (aduBuffer + crcLength, length - crcLength, crcValue);
+  crcLength = length;
+
+  return crcValue;
+}
+
+//======================================================================================//
+/**
+ * @brief Discards the running CRC if the byte at the specified index is covered by it.
+ * This must be called whenever a byte that was already added is changed.
+ * 
+ * @param index The index of the byte being changed.
+ */
+void CSE_ModbusRTU_ADU:: invalidateCRC (uint16_t index) {
+  if (index < crcLength) {
+    crcValue = MODBUS_RTU_CRC_INIT;
+    crcLength = 0;
+  }
 }
 
 //======================================================================================//
@@ -312,6 +388,7 @@ bool CSE_ModbusRTU_ADU:: setType (int type) {
  */
 bool CSE_ModbusRTU_ADU:: setDeviceAddress (uint8_t address) {
   aduBuffer [MODBUS_RTU_ADU_ADDRESS_INDEX] = address;
+  invalidateCRC (MODBUS_RTU_ADU_ADDRESS_INDEX);
 
   // If the ADU length is already greater than 2, we don't need to increment the length further.
   // For example when we have already set the function code, we don't need to increment the length
@@ -340,6 +417,7 @@ bool CSE_ModbusRTU_ADU:: setFunctionCode (uint8_t functionCode) {
   }
 
   aduBuffer [MODBUS_RTU_ADU_FUNCTION_CODE_INDEX] = functionCode;
+  invalidateCRC (MODBUS_RTU_ADU_FUNCTION_CODE_INDEX);
 
   // If the ADU length is already greater than 2, we don't need to increment the length further.
   if (aduLength < 2) {
@@ -371,6 +449,7 @@ bool CSE_ModbusRTU_ADU:: setExceptionCode (uint8_t exceptionCode) {
   }
 
   aduBuffer [MODBUS_RTU_ADU_EXCEPTION_CODE_INDEX] = exceptionCode;
+  invalidateCRC (MODBUS_RTU_ADU_EXCEPTION_CODE_INDEX);
   aduLength++;  // Length should now be 3
   return true;
 }
@@ -393,6 +472,7 @@ bool CSE_ModbusRTU_ADU:: setException() {
   // Converting a function code to an exception is done simply by setting he MSB to 1.
   if (aduBuffer [MODBUS_RTU_ADU_FUNCTION_CODE_INDEX] < 0x80) { // Check if the function code is not already an exception
     aduBuffer [MODBUS_RTU_ADU_FUNCTION_CODE_INDEX] += 0x80; // Set the function code as an exception
+    invalidateCRC (MODBUS_RTU_ADU_FUNCTION_CODE_INDEX);
     return true;
   }
 
@@ -428,6 +508,7 @@ bool CSE_ModbusRTU_ADU:: setData (uint8_t* buffer, uint8_t length) {
 
   // Start writing from after the function code field.
   aduLength = MODBUS_RTU_ADU_DATA_INDEX;
+  invalidateCRC (MODBUS_RTU_ADU_DATA_INDEX);
 
   for (uint8_t i = 0; i < length; i++) {
     aduBuffer [aduLength++] = buffer [i];
@@ -457,8 +538,9 @@ uint16_t CSE_ModbusRTU_ADU:: setCRC() {
   uint16_t crc = calculateCRC (false);  // Use the entire buffer data.
 
   // CRC is written with Lo byte first, unlike the data field.
-  aduBuffer [aduLength++] = (uint8_t) (crc & 0xFF); // Low byte
-  aduBuffer [aduLength++] = (uint8_t) (crc >> 8); // High byte
+  // Adding them also updates the running CRC, which makes a later checkCRC() fast.
+  add ((uint8_t) (crc & 0xFF)); // Low byte
+  add ((uint8_t) (crc >> 8)); // High byte
 
   DEBUG_PRINT (F("setCRC(): CRC is 0x"));
   DEBUG_PRINTLN (crc, HEX);
@@ -561,6 +643,97 @@ uint8_t CSE_ModbusRTU_ADU:: getDataLength() {
   return (aduLength - MODBUS_RTU_ADU_DATA_INDEX - MODBUS_RTU_CRC_LENGTH); // aduLength - 4
 }
 
+//======================================================================================//
+/**
+ * @brief Predicts the full length of the ADU from the bytes received so far, using the
+ * function code and the byte count field. The layout depends on the ADU type. REQUEST
+ * ADUs are treated as requests and RESPONSE or EXCEPTION ADUs as responses. This allows
+ * a receiver to know when a frame is complete without waiting for the inter-frame delay.
+ * 
+ * Response lengths:
+ * - Exception: 5 bytes
+ * - FC 0x01 to 0x04: 5 + byte count
+ * - FC 0x05, 0x06, 0x0F and 0x10: 8 bytes
+ * 
+ * Request lengths:
+ * - FC 0x01 to 0x06: 8 bytes
+ * - FC 0x0F and 0x10: 9 + byte count
+ * 
+ * @return uint16_t - The expected ADU length. 0 if the length can not be predicted yet
+ * or if the function code is not supported.
+ */
+uint16_t CSE_ModbusRTU_ADU:: getExpectedLength() {
+  // The function code is needed for any prediction.
+  if (aduLength < 2) {
+    return 0;
+  }
+
+  uint8_t functionCode = aduBuffer [MODBUS_RTU_ADU_FUNCTION_CODE_INDEX];
+
+  if ((aduType == aduType_t:: RESPONSE) || (aduType == aduType_t:: EXCEPTION)) {
+    if (functionCode >= 0x80) {
+      return 5; // Address + function code + exception code + CRC
+    }
+
+    switch (functionCode) {
+      case MODBUS_FC_READ_COILS:
+      case MODBUS_FC_READ_DISCRETE_INPUTS:
+      case MODBUS_FC_READ_HOLDING_REGISTERS:
+      case MODBUS_FC_READ_INPUT_REGISTERS:
+        // The byte count comes right after the function code.
+        if (aduLength < 3) {
+          return 0;
+        }
+        return 5 + aduBuffer [MODBUS_RTU_ADU_DATA_INDEX];
+
+      case MODBUS_FC_WRITE_SINGLE_COIL:
+      case MODBUS_FC_WRITE_SINGLE_REGISTER:
+      case MODBUS_FC_WRITE_MULTIPLE_COILS:
+      case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        return 8; // Address + function code + 2 words + CRC
+
+      default:
+        return 0;
+    }
+  }
+  else if (aduType == aduType_t:: REQUEST) {
+    switch (functionCode) {
+      case MODBUS_FC_READ_COILS:
+      case MODBUS_FC_READ_DISCRETE_INPUTS:
+      case MODBUS_FC_READ_HOLDING_REGISTERS:
+      case MODBUS_FC_READ_INPUT_REGISTERS:
+      case MODBUS_FC_WRITE_SINGLE_COIL:
+      case MODBUS_FC_WRITE_SINGLE_REGISTER:
+        return 8; // Address + function code + 2 words + CRC
+
+      case MODBUS_FC_WRITE_MULTIPLE_COILS:
+      case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        // The byte count comes after the starting address and quantity.
+        if (aduLength < 7) {
+          return 0;
+        }
+        return 9 + aduBuffer [MODBUS_RTU_ADU_DATA_INDEX + 4];
+
+      default:
+        return 0;
+    }
+  }
+
+  return 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns a pointer to the ADU buffer. The number of valid bytes is given by
+ * getLength(). The buffer must not be modified through this pointer, because the
+ * running CRC would not be updated.
+ * 
+ * @return const uint8_t* - Pointer to the first byte of the ADU.
+ */
+const uint8_t* CSE_ModbusRTU_ADU:: getBuffer() {
+  return aduBuffer;
+}
+
 //======================================================================================//
 /**
  * @brief Returns a single byte from the ADU. The index should be within the aduLength.
@@ -603,6 +776,28 @@ uint16_t CSE_ModbusRTU_ADU:: getWord (uint8_t index) {
   }
 }
 
+//======================================================================================//
+/**
+ * @brief Copies a number of consecutive 16-bit words from the ADU buffer. The range is
+ * checked once, and the words are converted from the big-endian byte order in one pass
+ * with CSE_ModbusRTU_Codec. The index indicates the position of the Hi byte of the
+ * first word.
+ * 
+ * @param index The starting index of the first word.
+ * @param buffer The array to save the words. Must have space for count words.
+ * @param count The number of words.
+ * @return true - The words were copied.
+ * @return false - The range is not within the aduLength. Nothing is copied.
+ */
+bool CSE_ModbusRTU_ADU:: getWords (uint8_t index, uint16_t* buffer, uint8_t count) {
+  if ((index + (count * 2)) > aduLength) {
+    return false;
+  }
+
+  CSE_ModbusRTU_Codec:: decode (buffer, aduBuffer + index, count);
+  return true;
+}
+
 //======================================================================================//
 /**
  * @brief Returns the current type of the ADU. The ADU type is converted to an integer.
@@ -622,7 +817,7 @@ void CSE_ModbusRTU_ADU:: print() {
   // Print the ADU as a hex string
   DEBUG_PRINT ("ADU: ");
 
-  for (uint8_t i = 0; i < aduLength; i++) {
+  for (uint16_t i = 0; i < aduLength; i++) {
     if (aduBuffer [i] < 0x10) {
       DEBUG_PRINT ("0x0");
     }
@@ -637,21 +832,60 @@ void CSE_ModbusRTU_ADU:: print() {
   DEBUG_PRINTLN();
 }
 
+//======================================================================================//
+/**
+ * @brief Instantiate a new CSE_ModbusRTU object with a transport. The transport is an
+ * adapter like CSE_ModbusRTU_Port or CSE_ModbusRTU_StreamPort that wraps the serial
+ * port. The type of the port is a template parameter of the adapter, so the port
+ * functions are called directly in the receive loop.
+ * 
+ * @param transport The transport to read/write data.
+ * @param deviceAddress The 8-bit device address.
+ * @param name The name of the Modbus RTU object.
+ * @return CSE_ModbusRTU:: 
+ */
+CSE_ModbusRTU:: CSE_ModbusRTU (CSE_ModbusRTU_Transport& transport, uint8_t deviceAddress, String name) {
+  this->transport = &transport;
+  this->serialPort = NULL;
+  this->deviceAddress = deviceAddress;
+  this->name = name;
+
+  frameInProgress = false;
+  framingError = false;
+  frameStartTime = 0;
+  lastByteTime = 0;
+  idleTime = 0;
+  receiveBuffer = NULL;
+
+  responseDelay = 0;
+  deLeadTime = 0;
+  frameEndTime = 0;
+  turnaroundPending = false;
+  lastTurnaroundTime = 0;
+  txStartTime = 0;
+  txTime = 0;
+  txEndTime = 0;
+  txPending = false;
+
+  characterBits = MODBUS_RTU_CHARACTER_BITS;
+  setBaudRate (MODBUS_RTU_DEFAULT_BAUDRATE);
+}
+
 //======================================================================================//
 /**
  * @brief Instantiate a new CSE_ModbusRTU object. The device address is the host
  * address. Serial port can be hardware or software serial port if you are using the
- * CSE_ArduinoRS485 library.
+ * CSE_ArduinoRS485 library. The port is wrapped in an internal CSE_ModbusRTU_Port of
+ * the type MODBUS_RTU_SERIAL_PORT_OBJECT.
  * 
  * @param serialPort The serial port to read/write data.
  * @param deviceAddress The 8-bit device address.
  * @param name The name of the Modbus RTU object.
  * @return CSE_ModbusRTU:: 
  */
-CSE_ModbusRTU:: CSE_ModbusRTU (serialPort_t serialPort, uint8_t deviceAddress, String name) {
+CSE_ModbusRTU:: CSE_ModbusRTU (serialPort_t serialPort, uint8_t deviceAddress, String name) : CSE_ModbusRTU (defaultTransport, deviceAddress, name) {
   this->serialPort = serialPort;
-  this->deviceAddress = deviceAddress;
-  this->name = name;
+  defaultTransport.setPort (serialPort);
 }
 
 //======================================================================================//
@@ -713,10 +947,10 @@ bool CSE_ModbusRTU:: setClient (CSE_ModbusRTU_Client& client) {
  */
 int CSE_ModbusRTU:: enableReceive (bool toDeassertDE) {
   if (toDeassertDE) {
-    serialPort->deassertDE();
+    transport->deassertDE();
   }
   
-  if (serialPort->assertRE()) { // Check if the pin is present and asserted
+  if (transport->assertRE()) { // Check if the pin is present and asserted
     return 0; // Assertion success
   }
 
@@ -734,7 +968,7 @@ int CSE_ModbusRTU:: enableReceive (bool toDeassertDE) {
  * @return int - 0 if the operation was successful; -1 otherwise.
  */
 int CSE_ModbusRTU:: disableReceive() {
-  if (serialPort->deassertRE()) { // Check if the pin is present and deasserted
+  if (transport->deassertRE()) { // Check if the pin is present and deasserted
     return 0; // Deassertion success
   }
 
@@ -750,15 +984,33 @@ int CSE_ModbusRTU:: disableReceive() {
  * if you want to. Since the sending operation has higher precedence than receiving,
  * sending is not affected by the device being in receive mode.
  * 
- * The aduLength is reset to 0 before reading the serial port. The function will check
- * the CRC of the received ADU and return the length of the ADU if the CRC is valid.
- * The address of the ADU is not checked. It has to be checked by the server or client.
+ * The aduLength is reset to 0 before reading the serial port. Frames are delimited by
+ * the Modbus RTU timing. The function waits up to `timeout` milliseconds for the first
+ * byte of a frame. Once a frame has started, it is complete as soon as the line has been
+ * silent for t3.5 (see setBaudRate()). The function does not wait for the rest of the
+ * timeout after that. If the line is silent for longer than t1.5 between two bytes of
+ * the same frame, the frame is rejected as a framing error.
+ * 
+ * If `completeOnLength` is true, the frame length is predicted from the function code
+ * and the byte count field (see CSE_ModbusRTU_ADU::getExpectedLength()). The function
+ * returns as soon as that many bytes with a valid CRC have been received, without
+ * waiting for t3.5. The ADU type must be set before calling the function for this.
+ * 
+ * The function will check the CRC of the received ADU and return the length of the ADU
+ * if the CRC is valid. The address of the ADU is not checked. It has to be checked by
+ * the server or client.
+ * 
+ * This is the blocking version of receiveFrame().
  * 
  * @param adu The ADU object to save the incoming data.
- * @return int - The ADU length, or -1 if the operation fails.
+ * @param timeout The time to wait for the start of a frame in milliseconds.
+ * @param completeOnLength If true, return as soon as the predicted length is received.
+ * @return int - The ADU length, MODBUS_RTU_RECEIVE_FRAMING_ERROR (-2) if the frame timing
+ * or length is invalid, or MODBUS_RTU_RECEIVE_ERROR (-1) if the operation fails.
  */
-int CSE_ModbusRTU:: receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout) {
+int CSE_ModbusRTU:: receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout, bool completeOnLength) {
   adu.resetLength(); // Reset the ADU length
+  frameInProgress = false; // Discard any partially received frame
   // DEBUG_PRINT (F("receive(): Checking Modbus port.."));
   
   // Put the serial port (RS485) in receive mode.
@@ -767,15 +1019,137 @@ int CSE_ModbusRTU:: receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout) {
 
   uint32_t startTime = millis();
 
-  while ((millis() - startTime) < timeout) {
-    // Read all the bytes from the serial port
-    while ((serialPort->available() > 0) && (adu.getLength() < MODBUS_RTU_ADU_LENGTH_MAX)) {
-      adu.add ((uint8_t) serialPort->read()); // Read the first byte
+  while (true) {
+    int result = receiveFrame (adu, completeOnLength);
+
+    if (result != 0) {
+      return result;
+    }
+
+    if ((millis() - startTime) >= timeout) {
+      if (!frameInProgress) {
+        return MODBUS_RTU_RECEIVE_ERROR; // No frame received
+      }
+
+      // A line that never goes silent for t3.5 should not block forever.
+      if (framingError) {
+        frameInProgress = false;
+        return completeFrame (adu);
+      }
     }
   }
+}
+
+//======================================================================================//
+/**
+ * @brief Reads the bytes currently available on the serial port, or in the receive buffer
+ * if one is set, into the ADU and returns immediately. This is the non-blocking version of receive(). Call it
+ * repeatedly with the same ADU object to receive a frame. The ADU is reset when the
+ * first byte of a new frame arrives. The frame timing and the CRC are checked the same
+ * way as in receive(). Receive mode is not enabled by this function. You should call
+ * enableReceive() once before you start polling.
+ * 
+ * @param adu The ADU object to save the incoming data.
+ * @param completeOnLength If true, the frame is complete as soon as the predicted length
+ * is received.
+ * @return int - The ADU length if a valid frame is complete, 0 if no frame is complete
+ * yet, MODBUS_RTU_RECEIVE_FRAMING_ERROR (-2) if the frame timing or length is invalid, or
+ * MODBUS_RTU_RECEIVE_ERROR (-1) if the CRC is invalid.
+ */
+int CSE_ModbusRTU:: receiveFrame (CSE_ModbusRTU_ADU& adu, bool completeOnLength) {
+  return transport->receiveFrame (*this, adu, completeOnLength);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns true if a frame has started but is not complete yet.
+ * 
+ * @return true - A frame is being received.
+ * @return false - The receiver is idle.
+ */
+bool CSE_ModbusRTU:: isReceiving() {
+  return frameInProgress;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the arrival time of the first byte of the last frame, or of the frame
+ * being received. The time is the value of micros() when the byte was read, or the
+ * timestamp from the receive buffer.
+ * 
+ * @return uint32_t - The arrival time in microseconds.
+ */
+uint32_t CSE_ModbusRTU:: getFrameStartTime() {
+  return frameStartTime;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the arrival time of the last byte of the last frame, or of the latest
+ * byte of the frame being received.
+ * 
+ * @return uint32_t - The arrival time in microseconds.
+ */
+uint32_t CSE_ModbusRTU:: getFrameEndTime() {
+  return lastByteTime;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of received bytes that are waiting to be read. The receive
+ * buffer is checked if one is set. Otherwise the serial port is checked.
+ * 
+ * @return int - Number of bytes available.
+ */
+int CSE_ModbusRTU:: available() {
+  if (receiveBuffer != NULL) {
+    return receiveBuffer->available();
+  }
+
+  return transport->available();
+}
+
+//======================================================================================//
+/**
+ * @brief Sets a ring buffer as the source of received bytes. The buffer has to be filled
+ * by a UART receive interrupt or a receive callback, by calling
+ * CSE_ModbusRTU_RingBuffer::push() with each byte and its arrival time from micros().
+ * The serial port is then no longer read by the library. The arrival times are used for
+ * the t1.5 and t3.5 checks, so the frame timing does not depend on how often the
+ * library is polled. Pass NULL to read from the serial port again.
+ * 
+ * @param buffer A pointer to the ring buffer, or NULL.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU:: setReceiveBuffer (CSE_ModbusRTU_RingBuffer* buffer) {
+  receiveBuffer = buffer;
+  frameInProgress = false; // Discard any partially received frame
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the ring buffer set with setReceiveBuffer().
+ * 
+ * @return CSE_ModbusRTU_RingBuffer* - The receive buffer, or NULL if the serial port is
+ * read directly.
+ */
+CSE_ModbusRTU_RingBuffer* CSE_ModbusRTU:: getReceiveBuffer() {
+  return receiveBuffer;
+}
 
+//======================================================================================//
+/**
+ * @brief Validates a frame that has just been completed by receiveFrame().
+ * 
+ * @param adu The received ADU.
+ * @return int - The ADU length if the frame is valid, MODBUS_RTU_RECEIVE_FRAMING_ERROR
+ * if a framing error was found, or MODBUS_RTU_RECEIVE_ERROR if the CRC is invalid.
+ */
+int CSE_ModbusRTU:: completeFrame (CSE_ModbusRTU_ADU& adu) {
   // Print the ADU
-  if (adu.getLength() > 0) {
+  if (CSE_ModbusRTU_Debug::debugEnabled && (adu.getLength() > 0)) {
     DEBUG_PRINT (F("receive(): Received ADU:"));
     for (int i = 0; i < adu.getLength(); i++) {
       DEBUG_PRINT (" ");
@@ -791,9 +1165,21 @@ int CSE_ModbusRTU:: receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout) {
     DEBUG_PRINTLN();
   }
 
+  if (framingError) {
+    DEBUG_PRINTLN (F("receive(): Framing error"));
+    return MODBUS_RTU_RECEIVE_FRAMING_ERROR;
+  }
+
   // Now check if the ADU is valid. We can do this by simply checking the CRC of the ADU.
   if (adu.getLength() > 0) {
     if (adu.checkCRC()) { // Check the CRC of the ADU
+      // Save the end of a request for the turnaround timing of the reply. The responses
+      // received by a client are not replied to, so they do not delay its next request.
+      if (adu.getType() == CSE_ModbusRTU_ADU::aduType_t:: REQUEST) {
+        frameEndTime = lastByteTime;
+        turnaroundPending = true;
+      }
+
       DEBUG_PRINTLN (F("receive(): ADU CRC passed"));
       return (int) adu.getLength(); // Return the length of the ADU
     }
@@ -802,7 +1188,7 @@ int CSE_ModbusRTU:: receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout) {
     }
   }
   
-  return -1;
+  return MODBUS_RTU_RECEIVE_ERROR;
 }
 
 //======================================================================================//
@@ -811,38 +1197,99 @@ int CSE_ModbusRTU:: receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout) {
  * before sending it. Returns the ADU length if the operation was successful. Otherwise
  * it will return -1.
  * 
+ * For frames built with setCRC(), the running CRC of the ADU already covers the whole
+ * frame, so the check does not read the buffer again. The frame is written to the port
+ * with a single write() call.
+ * 
+ * This is the blocking version of sendFrame(). It returns after the last stop bit has
+ * left the port and DE is released.
+ * 
  * @param adu The ADU to send.
  * @return int - ADU length, or -1 if the operation fails.
  */
 int CSE_ModbusRTU:: send (CSE_ModbusRTU_ADU& adu) {
+  int length = sendFrame (adu);
+
+  if (length < 0) {
+    return -1;
+  }
+
+  transport->flush();
+
+  // Some cores return from flush() when the TX FIFO is empty, while the last character
+  // is still in the shift register. The frame can not leave the port faster than the
+  // baud rate allows, so DE is held until that time has passed as well.
+  while (isSending()) {
+    // Busy wait for the last stop bit
+  }
+
+  return length; // Return the length of the ADU
+}
+
+//======================================================================================//
+/**
+ * @brief Starts sending the specified ADU and returns without waiting for the frame to
+ * leave the port. This is the non-blocking version of send(). DE is asserted, and the
+ * frame is handed to the port with a single write() call. Call isSending() until it
+ * returns false, to release DE at the end of the frame. No other frame can be sent or
+ * received until then.
+ * 
+ * @param adu The ADU to send.
+ * @return int - ADU length, or -1 if the CRC is invalid or a frame is still being sent.
+ */
+int CSE_ModbusRTU:: sendFrame (CSE_ModbusRTU_ADU& adu) {
+  if (txPending) {
+    return -1;
+  }
+
   // Check if the ADU is valid
   if (adu.checkCRC()) {
-    DEBUG_PRINT (F("send(): Sending ADU:"));
+    const uint8_t* buffer = adu.getBuffer();
+    uint16_t length = adu.getLength();
 
-    // Print the ADU
-    for (int i = 0; i < adu.getLength(); i++) {
-      DEBUG_PRINT (" ");
-      if (adu.getByte (i) < 0x10) {
-        DEBUG_PRINT (F("0x0"));
-      }
-      else {
-        DEBUG_PRINT (F("0x"));
+    // Print the ADU. The loop is skipped entirely when debug messages are disabled.
+    if (CSE_ModbusRTU_Debug::debugEnabled) {
+      DEBUG_PRINT (F("send(): Sending ADU:"));
+
+      for (uint16_t i = 0; i < length; i++) {
+        DEBUG_PRINT (" ");
+        if (buffer [i] < 0x10) {
+          DEBUG_PRINT (F("0x0"));
+        }
+        else {
+          DEBUG_PRINT (F("0x"));
+        }
+        DEBUG_PRINT (buffer [i], HEX);
       }
-      DEBUG_PRINT (adu.getByte (i), HEX);
+
+      DEBUG_PRINTLN();
     }
 
-    DEBUG_PRINTLN();
+    // Wait for t3.5 of silence on the line, and for the minimum response delay counted
+    // from the end of the received frame. Callers that must not wait check
+    // isReadyToSend() first.
+    while (!isReadyToSend()) {
+      yield();  // The delay is usually a few milliseconds. Other tasks can run meanwhile.
+    }
 
-    // Send the ADU
-    serialPort->beginTransmission();
-    
-    for (uint8_t i = 0; i < adu.getLength(); i++) {
-      serialPort->write (adu.getByte (i));
+    // Assert DE. The port waits for the DE lead time set with setDELeadTime().
+    transport->beginTransmission();
+
+    txStartTime = micros();
+
+    if (turnaroundPending) {
+      lastTurnaroundTime = txStartTime - frameEndTime;
+      turnaroundPending = false;
     }
 
-    serialPort->endTransmission();
+    // Send the ADU. The whole frame is handed to the port in a single call.
+    transport->write (buffer, length);
+
+    // The time the frame needs on the line
+    txTime = ((uint32_t) length * characterBits * 1000000UL) / baudRate;
+    txPending = true;
 
-    return adu.getLength(); // Return the length of the ADU
+    return length;
   }
 
   DEBUG_PRINTLN (F("send(): CRC checking failed!"));
@@ -853,67 +1300,460 @@ int CSE_ModbusRTU:: send (CSE_ModbusRTU_ADU& adu) {
 
 //======================================================================================//
 /**
- * @brief Instantiates a new Modbus server object. You must send a parent Modbus RTU
- * object and a name for the server. The name is used for debugging purposes.
+ * @brief Checks if a frame can be sent now, without waiting in sendFrame(). A frame can
+ * only start after the line has been silent for t3.5, since the last byte received and
+ * since the end of the last frame sent. A reply to a request also has to wait for the
+ * response delay set with setResponseDelay(), counted from the end of the request.
  * 
- * @param rtu Parent Modbus RTU object.
- * @param name Name of the server.
- * @return CSE_ModbusRTU_Server:: 
+ * @return true - A frame can be sent now.
+ * @return false - A frame is still being sent, or one of the delays has not passed.
  */
-CSE_ModbusRTU_Server:: CSE_ModbusRTU_Server (CSE_ModbusRTU& rtu, String name) {
-  this->rtu = &rtu;
-  this->name = name;
+bool CSE_ModbusRTU:: isReadyToSend() {
+  if (txPending) {
+    return false;
+  }
 
-  // Set the default request and response ADU types
-  request.setType (CSE_ModbusRTU_ADU::aduType_t:: REQUEST);
-  response.setType (CSE_ModbusRTU_ADU::aduType_t:: RESPONSE);
+  uint32_t now = micros();
+
+  if (((now - lastByteTime) < interFrameDelay) || ((now - txEndTime) < interFrameDelay)) {
+    return false;
+  }
 
+  if (turnaroundPending && ((now - frameEndTime) < responseDelay)) {
+    return false;
+  }
 
-  // Reserve memory for the data arrays. This is not necessary but it will prevent
-  // memory fragmentation.
-  coils.reserve (MODBUS_RTU_COIL_COUNT_MAX);
-  discreteInputs.reserve (MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX);
-  holdingRegisters.reserve (MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX);
-  inputRegisters.reserve (MODBUS_RTU_INPUT_REGISTER_COUNT_MAX);
+  return true;
 }
 
 //======================================================================================//
 /**
- * @brief Returns the name of the server.
+ * @brief Checks if a frame started with sendFrame() is still being sent. When the time
+ * the frame needs on the line has passed, the port is flushed, DE is released, and the
+ * function returns false.
  * 
- * @return String - Name of the server.
+ * @return true - The frame is still being sent.
+ * @return false - No frame is being sent.
  */
-String CSE_ModbusRTU_Server:: getName() {
-  return name;
+bool CSE_ModbusRTU:: isSending() {
+  if (!txPending) {
+    return false;
+  }
+
+  if ((micros() - txStartTime) < txTime) {
+    return true;
+  }
+
+  transport->flush();
+  transport->endTransmission(); // Release DE. The post-delay of the port is set to 0.
+  txEndTime = micros();
+  txPending = false;
+
+  return false;
 }
 
 //======================================================================================//
 /**
- * @brief Does nothing for now.
+ * @brief Sets the baud rate used for calculating the Modbus RTU frame timing. This
+ * does not change the baud rate of the serial port. You should call this with the same
+ * baud rate you used to initialize the serial port. The inter-character timeout (t1.5)
+ * and the inter-frame delay (t3.5) are calculated from the time to send one character
+ * (11 bits by default, see setCharacterBits()). Above 19200 baud, the fixed values of
+ * 750 us and 1750 us recommended by the Modbus specification are used. Any previous
+ * override of the timing is discarded.
  * 
- * @return true 
- * @return false 
+ * @param baudRate The baud rate of the serial port.
+ * @return true - Operation successful.
+ * @return false - Invalid baud rate.
  */
-bool CSE_ModbusRTU_Server:: begin() {
+bool CSE_ModbusRTU:: setBaudRate (uint32_t baudRate) {
+  if (baudRate == 0) {
+    return false;
+  }
+
+  this->baudRate = baudRate;
+
+  if (baudRate > MODBUS_RTU_FIXED_TIMING_BAUDRATE) {
+    interCharTimeout = MODBUS_RTU_FIXED_INTER_CHAR_TIMEOUT;
+    interFrameDelay = MODBUS_RTU_FIXED_INTER_FRAME_DELAY;
+  }
+  else {
+    // 1.5 and 3.5 character times in microseconds.
+    interCharTimeout = (uint32_t) ((characterBits * 1500000UL) / baudRate);
+    interFrameDelay = (uint32_t) ((characterBits * 3500000UL) / baudRate);
+  }
+
   return true;
 }
 
 //======================================================================================//
 /**
- * @brief This function is used to poll the server for new requests. When a request is
- * received, it is disassembled into the request ADU and checked for validity. This
- * function takes care of checking what type of request it is and then send a response
- * back to the client. The response is assembled into the response ADU. Finally, the
+ * @brief Returns the baud rate used for calculating the frame timing.
+ * 
+ * @return uint32_t - The baud rate.
+ */
+uint32_t CSE_ModbusRTU:: getBaudRate() {
+  return baudRate;
+}
+
+//======================================================================================//
+/**
+ * @brief Overrides the inter-character timeout (t1.5) calculated by setBaudRate().
+ * Setting the timeout to 0 disables the check. This is useful for serial ports that
+ * deliver the received bytes in bursts, such as ports with large hardware FIFOs or USB
+ * serial adapters. Otherwise, the bursts can be mistaken for gaps inside a frame.
+ * 
+ * @param timeout The inter-character timeout in microseconds. 0 to disable.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU:: setInterCharTimeout (uint32_t timeout) {
+  interCharTimeout = timeout;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the inter-character timeout (t1.5) in microseconds.
+ * 
+ * @return uint32_t - t1.5 in microseconds. 0 if the check is disabled.
+ */
+uint32_t CSE_ModbusRTU:: getInterCharTimeout() {
+  return interCharTimeout;
+}
+
+//======================================================================================//
+/**
+ * @brief Overrides the inter-frame delay (t3.5) calculated by setBaudRate(). A frame
+ * is considered complete when the line has been silent for this long. If your serial
+ * port delivers the received bytes with a delay longer than t3.5, you should increase
+ * this value so that a frame is not split into two.
+ * 
+ * @param delayTime The inter-frame delay in microseconds. Must be greater than 0.
+ * @return true - Operation successful.
+ * @return false - Invalid delay.
+ */
+bool CSE_ModbusRTU:: setInterFrameDelay (uint32_t delayTime) {
+  if (delayTime == 0) {
+    return false;
+  }
+
+  interFrameDelay = delayTime;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the inter-frame delay (t3.5) in microseconds.
+ * 
+ * @return uint32_t - t3.5 in microseconds.
+ */
+uint32_t CSE_ModbusRTU:: getInterFrameDelay() {
+  return interFrameDelay;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the number of bits per character on the line, including the start, parity
+ * and stop bits. The Modbus specification requires 11 bits (8E1 or 8N2), which is the
+ * default. Set it to 10 if your port uses 8N1. The t1.5 and t3.5 timing and the
+ * transmission time used for releasing DE are recalculated. Any previous override of
+ * the timing is discarded.
+ * 
+ * @param bits The number of bits per character (7 to 12).
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU:: setCharacterBits (uint8_t bits) {
+  if ((bits < 7) || (bits > 12)) {
+    return false;
+  }
+
+  characterBits = bits;
+  return setBaudRate (baudRate);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bits per character.
+ * 
+ * @return uint8_t - The number of bits per character.
+ */
+uint8_t CSE_ModbusRTU:: getCharacterBits() {
+  return characterBits;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the minimum time between the end of a received request and the start of
+ * the reply. This is for clients that need time to switch their transceiver back to
+ * receive mode. If the reply is ready earlier, send() waits. The default is 0, which
+ * means the reply is sent as soon as it is ready. Only the replies of a server are
+ * delayed. The requests of a client are not delayed after the previous response.
+ * 
+ * @param delayTime The minimum response delay in microseconds.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU:: setResponseDelay (uint32_t delayTime) {
+  responseDelay = delayTime;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the minimum response delay.
+ * 
+ * @return uint32_t - The minimum response delay in microseconds.
+ */
+uint32_t CSE_ModbusRTU:: getResponseDelay() {
+  return responseDelay;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the time between asserting DE and sending the first byte. This gives the
+ * transceiver time to enable its driver. The value is set as the pre-delay of the serial
+ * port. The post-delay of the port is set to 0, because send() releases DE as soon as
+ * the last stop bit has been sent.
+ * 
+ * @param leadTime The DE lead time in microseconds.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU:: setDELeadTime (uint32_t leadTime) {
+  deLeadTime = leadTime;
+  transport->setDelays ((int) leadTime, 0);
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the DE lead time.
+ * 
+ * @return uint32_t - The DE lead time in microseconds.
+ */
+uint32_t CSE_ModbusRTU:: getDELeadTime() {
+  return deLeadTime;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the turnaround time of the last reply. This is the time from the end of
+ * the last valid received request to the moment the first byte of the reply was
+ * written, after the response delay and the DE lead time. It is measured by send() when a
+ * frame is sent after receiving a request, so it is only measured by a server.
+ * 
+ * @return uint32_t - The turnaround time in microseconds, or 0 if nothing was measured yet.
+ */
+uint32_t CSE_ModbusRTU:: getLastTurnaroundTime() {
+  return lastTurnaroundTime;
+}
+
+//======================================================================================//
+/**
+ * @brief Instantiates a new Modbus server object. You must send a parent Modbus RTU
+ * object and a name for the server. The name is used for debugging purposes.
+ * 
+ * @param rtu Parent Modbus RTU object.
+ * @param name Name of the server.
+ * @return CSE_ModbusRTU_Server:: 
+ */
+CSE_ModbusRTU_Server:: CSE_ModbusRTU_Server (CSE_ModbusRTU& rtu, String name) {
+  this->rtu = &rtu;
+  this->name = name;
+
+  nonBlocking = false;
+  pendingFrame = NULL;
+  state = serverState_t:: IDLE;
+  providerCount = 0;
+  writeCallback = NULL;
+  writeContext = NULL;
+
+  // Set the default request and response ADU types
+  request.setType (CSE_ModbusRTU_ADU::aduType_t:: REQUEST);
+  response.setType (CSE_ModbusRTU_ADU::aduType_t:: RESPONSE);
+
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the name of the server.
+ * 
+ * @return String - Name of the server.
+ */
+String CSE_ModbusRTU_Server:: getName() {
+  return name;
+}
+
+//======================================================================================//
+/**
+ * @brief Does nothing for now.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool CSE_ModbusRTU_Server:: begin() {
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief This function is used to poll the server for new requests. When a request is
+ * received, it is disassembled into the request ADU and checked for validity. This
+ * function takes care of checking what type of request it is and then send a response
+ * back to the client. The response is assembled into the response ADU. Finally, the
  * type of request received is returned.
  * 
- * @return int - Function code, or -1 if the operation fails.
+ * In the default blocking mode, the function waits for a request for up to 100 ms.
+ * In the non-blocking mode (see setNonBlocking()), the function only reads the bytes
+ * that are already available and returns immediately. A request is processed in the
+ * same call in which its frame is completed. The response is started in that call if
+ * the response delay has passed, or by a later call. The state stays TRANSMITTING until
+ * a later call finds that the response has left the port. Call the function as often as
+ * possible from your loop. The state of the server can be checked with getState().
+ * 
+ * @return int - Function code if a request was handled, or -1 if no request was handled.
  */
 int CSE_ModbusRTU_Server:: poll() {
-  // First received a new ADU from the client
-  if (receive() < 0) {
+  if (!nonBlocking) {
+    // First received a new ADU from the client
+    if (receive() < 0) {
+      return -1;
+    }
+
+    int result = processRequest();
+    state = serverState_t:: IDLE;
+    return result;
+  }
+
+  // Non-blocking mode. A response being sent has to leave the port first.
+  if (state == serverState_t:: TRANSMITTING) {
+    // Until the response is sent there is nothing else to do. So the CPU is given to the
+    // other tasks, like the ports do when no byte is available.
+    if (transmit()) {
+      yield();
+    }
+
+    return -1;
+  }
+
+  if (state == serverState_t:: IDLE) {
+    // Nothing is pending. Return as quickly as possible.
+    if (rtu->available() <= 0) {
+      return -1;
+    }
+
+    state = serverState_t:: RECEIVING;
+  }
+
+  int result = rtu->receiveFrame (request);
+
+  if (result == 0) {
+    // The frame is not complete yet
+    state = rtu->isReceiving() ? serverState_t:: RECEIVING : serverState_t:: IDLE;
+    return -1;
+  }
+
+  if (result < 0) {
+    // The frame was invalid. Wait for the next one.
+    state = serverState_t:: IDLE;
     return -1;
   }
 
+  state = serverState_t:: FRAME_COMPLETE;
+
+  result = processRequest(); // Changes the state to DISPATCHING, and to TRANSMITTING if there is a response
+
+  if (state != serverState_t:: TRANSMITTING) {
+    state = serverState_t:: IDLE;
+  }
+
+  return result;
+}
+
+//======================================================================================//
+/**
+ * @brief Starts or finishes sending the response in the non-blocking mode. The frame is
+ * started when the response delay has passed. The state goes back to IDLE when the frame
+ * has left the port.
+ * 
+ * @return true - The response is still waiting or being sent.
+ * @return false - The response has been sent, or could not be sent.
+ */
+bool CSE_ModbusRTU_Server:: transmit() {
+  if (pendingFrame != NULL) {
+    if (!rtu->isReadyToSend()) {
+      return true;
+    }
+
+    CSE_ModbusRTU_ADU* adu = pendingFrame;
+    pendingFrame = NULL;
+
+    if (rtu->sendFrame (*adu) < 0) {
+      state = serverState_t:: IDLE;
+      return false;
+    }
+  }
+
+  if (rtu->isSending()) {
+    return true;
+  }
+
+  state = serverState_t:: IDLE;
+  return false;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the polling mode of the server. In the non-blocking mode, poll() never
+ * waits for data. It only advances the frame state machine with the bytes that are
+ * already available. Receive mode is enabled when switching to non-blocking mode. A
+ * response that is being sent is finished first, and a response that is still waiting
+ * for the response delay is dropped.
+ * 
+ * @param nonBlocking true for non-blocking mode, false for the default blocking mode.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU_Server:: setNonBlocking (bool nonBlocking) {
+  // A response that was started is finished, and one that was not started is dropped
+  pendingFrame = NULL;
+
+  while (rtu->isSending()) {
+    // Busy wait for the last stop bit
+  }
+
+  this->nonBlocking = nonBlocking;
+  state = serverState_t:: IDLE;
+
+  if (nonBlocking) {
+    rtu->enableReceive(); // receiveFrame() does not enable receive mode by itself.
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the current state of the server frame state machine. The state is only
+ * advanced in the non-blocking mode.
+ * 
+ * @return int - The server state. See `serverState_t`.
+ */
+int CSE_ModbusRTU_Server:: getState() {
+  return state;
+}
+
+//======================================================================================//
+/**
+ * @brief Processes the request in the request ADU and sends the response to the client.
+ * 
+ * @return int - Function code, or -1 if the operation fails.
+ */
+int CSE_ModbusRTU_Server:: processRequest() {
+  state = serverState_t:: DISPATCHING;
+
   // Now check if the address of the request matches the address of the server
   if (request.getDeviceAddress() != rtu->deviceAddress) {
     DEBUG_PRINTLN (F("poll(): Server addresses does not match."));
@@ -932,7 +1772,7 @@ int CSE_ModbusRTU_Server:: poll() {
     case MODBUS_FC_READ_COILS: {
       // Check if the coil count is valid (the maximum in a request is 0x07D0) or
       // if all of the coils in the range are present in the server.
-      if ((request.getQuantity() > 0x07D0) || (!isCoilPresent (request.getStartingAddress(), request.getQuantity()))) {
+      if ((request.getQuantity() > 0x07D0) || (!coils.isPresent (request.getStartingAddress(), request.getQuantity()))) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -969,21 +1809,9 @@ int CSE_ModbusRTU_Server:: poll() {
 
       response.add (byteCount); // Set the byte count of the response
 
-      // Now we need to pack the coil states into the response ADU
-      uint8_t coilData [byteCount] = {0}; // Create an array to store the coil data
-
-      for (int i = request.getStartingAddress(), j = 0; i < (request.getStartingAddress() + request.getQuantity()); i++) {
-        if (coils [i].value == 0) {
-          coilData [j / 8] &= ~(1U << (j % 8)); // Clear the bit
-        }
-        else {
-          coilData [j / 8] |= (1U << (j % 8)); // Set the bit
-        }
-        j++;
-      }
-
-      // Now we need to copy the coil data into the response ADU
-      response.add (coilData, byteCount); // Add the coil data to the response ADU
+      // Now we need to pack the coil states into the response ADU. The coils are stored
+      // packed in the same order, so they are copied directly into the reserved bytes.
+      coils.read (request.getStartingAddress(), request.getQuantity(), response.reserve (byteCount));
       response.setCRC(); // Set the CRC of the response
       send(); // Send the response
       return MODBUS_FC_READ_COILS; // Return the function code
@@ -995,7 +1823,7 @@ int CSE_ModbusRTU_Server:: poll() {
     case MODBUS_FC_READ_DISCRETE_INPUTS: {
       // Check if the discrete input count is valid (the maximum in a request is 0x07D0) or
       // if all of the discrete inputs in the range are present in the server.
-      if ((request.getQuantity() > 0x07D0) || (!isDiscreteInputPresent (request.getStartingAddress(), request.getQuantity()))) {
+      if ((request.getQuantity() > 0x07D0) || (!discreteInputs.isPresent (request.getStartingAddress(), request.getQuantity()))) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1033,21 +1861,10 @@ int CSE_ModbusRTU_Server:: poll() {
 
       response.add (byteCount); // Set the byte count of the response
 
-      // Now we need to pack the discrete input states into the response ADU
-      uint8_t discreteInputData [byteCount] = {0}; // Create an array to store the discrete input data
-
-      for (int i = request.getStartingAddress(), j = 0; i < (request.getStartingAddress() + request.getQuantity()); i++) {
-        if (discreteInputs [i].value == 0) {
-          discreteInputData [j / 8] &= ~(1U << (j % 8)); // Clear the bit
-        }
-        else {
-          discreteInputData [j / 8] |= (1U << (j % 8)); // Set the bit
-        }
-        j++;
-      }
-
-      // Now we need to copy the discrete input data into the response ADU
-      response.add (discreteInputData, byteCount); // Add the discrete input data to the response ADU
+      // Now we need to pack the discrete input states into the response ADU. The discrete
+      // inputs are stored packed in the same order, so they are copied directly into the
+      // reserved bytes.
+      discreteInputs.read (request.getStartingAddress(), request.getQuantity(), response.reserve (byteCount));
       response.setCRC(); // Set the CRC of the response
       send(); // Send the response
       return MODBUS_FC_READ_DISCRETE_INPUTS; // Return the function code
@@ -1056,9 +1873,12 @@ int CSE_ModbusRTU_Server:: poll() {
     //---------------------------------------------------------------------------------//
 
     case MODBUS_FC_READ_HOLDING_REGISTERS: {
+      // Find the holding registers of the range. They are contiguous in a single block of the map.
+      uint16_t* values = holdingRegisters.find (request.getStartingAddress(), request.getQuantity());
+
       // Check if the holding register count is valid (the maximum in a request is 0x007D) or
       // if all of the holding registers in the range are present in the server.
-      if ((request.getQuantity() > 0x007D) || (!isHoldingRegisterPresent (request.getStartingAddress(), request.getQuantity()))) {
+      if ((request.getQuantity() > 0x007D) || (values == NULL)) {
         // Then process an exception
         DEBUG_PRINTLN (F("poll(): Invalid request to read holding registers."));
         DEBUG_PRINTLN (F("poll(): ERROR - Exception: Illegal data value."));
@@ -1085,32 +1905,24 @@ int CSE_ModbusRTU_Server:: poll() {
       response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
       response.setFunctionCode (MODBUS_FC_READ_HOLDING_REGISTERS); // Set the function code of the response
 
-      uint16_t registerCount = request.getQuantity(); // Get the number of registers needed
-      uint8_t byteCount = registerCount * 2; // Get the number of bytes needed
+      uint8_t registerCount = request.getQuantity(); // Get the number of registers needed (1-125)
 
-      // Create an array to store the register data.
-      // Since the register data is 16-bit, we need double the number of bytes.
-      uint8_t registerData [byteCount] = {0};
-
-      // Read the register data from the holding registers and write them to the array
-      for (int i = request.getStartingAddress(), j = 0; i < (request.getStartingAddress() + request.getQuantity()); i++) {
-        for (int k = 0; k < holdingRegisters.size(); k++) {
-          if (holdingRegisters [k].address == i) {
-            registerData [j] = holdingRegisters [k].value >> 8; // Get the high byte
-            registerData [j + 1] = holdingRegisters [k].value & 0xFF; // Get the low byte
-            j += 2;
-            DEBUG_PRINT ("Address: 0x");
-            DEBUG_PRINT (i, HEX);
-            DEBUG_PRINT (", Value: 0x");
-            DEBUG_PRINTLN (holdingRegisters [k].value, HEX);
-          }
-        }
-      }
+      // Let the providers of the range compute their values first
+      callProviders (MODBUS_FC_READ_HOLDING_REGISTERS, request.getStartingAddress(), registerCount, values);
+      uint8_t byteCount = registerCount * 2; // Get the number of bytes needed
 
       response.add (byteCount); // Set the byte count of the response
-      
-      // Now we need to copy the register data into the response ADU
-      response.add (registerData, byteCount); // Add the register data to the response ADU
+      uint8_t* data = response.reserve (byteCount); // Reserve space for the register data
+
+      // Now we can convert the register values directly into the response ADU. If another
+      // thread writes the registers during the copy, the copy is done again.
+      uint32_t sequence;
+
+      do {
+        sequence = holdingRegisterLock.beginRead();
+        CSE_ModbusRTU_Codec:: encode (data, values, registerCount);
+      } while (!holdingRegisterLock.endRead (sequence));
+
       response.setCRC(); // Set the CRC of the response
       send(); // Send the response
       return MODBUS_FC_READ_HOLDING_REGISTERS; // Return the function code
@@ -1120,9 +1932,12 @@ int CSE_ModbusRTU_Server:: poll() {
     //---------------------------------------------------------------------------------//
 
     case MODBUS_FC_READ_INPUT_REGISTERS: {
+      // Find the input registers of the range. They are contiguous in a single block of the map.
+      uint16_t* values = inputRegisters.find (request.getStartingAddress(), request.getQuantity());
+
       // Check if the input register count is valid (the maximum in a request is 0x007D) or
       // if all of the input registers in the range are present in the server.
-      if ((request.getQuantity() > 0x007D) || (!isInputRegisterPresent (request.getStartingAddress(), request.getQuantity()))) {
+      if ((request.getQuantity() > 0x007D) || (values == NULL)) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1147,32 +1962,23 @@ int CSE_ModbusRTU_Server:: poll() {
       response.setFunctionCode (MODBUS_FC_READ_INPUT_REGISTERS); // Set the function code of the response
 
       uint8_t registerCount = request.getQuantity(); // Get the number of registers needed (1-125)
-      uint8_t byteCount = registerCount * 2; // Get the number of bytes needed
 
-      // Create an array to store the register data.
-      // Since the register data is 16-bit, we need double the number of bytes.
-      uint8_t inputRegisterData [byteCount] = {0};
-
-      // Read the register data from the input registers and write them to the array
-      for (int i = request.getStartingAddress(), j = 0; i < (request.getStartingAddress() + request.getQuantity()); i++) {
-        for (int k = 0; k < inputRegisters.size(); k++) {
-          if (inputRegisters [k].address == i) {
-            inputRegisterData [j] = inputRegisters [k].value >> 8; // Get the high byte
-            inputRegisterData [j + 1] = inputRegisters [k].value & 0xFF; // Get the low byte
-            j += 2;
-
-            DEBUG_PRINT ("Address: 0x");
-            DEBUG_PRINT (i, HEX);
-            DEBUG_PRINT (", Value: 0x");
-            DEBUG_PRINTLN (inputRegisters [k].value, HEX);
-          }
-        }
-      }
+      // Let the providers of the range compute their values first
+      callProviders (MODBUS_FC_READ_INPUT_REGISTERS, request.getStartingAddress(), registerCount, values);
+      uint8_t byteCount = registerCount * 2; // Get the number of bytes needed
 
       response.add (byteCount); // Set the byte count of the response
+      uint8_t* data = response.reserve (byteCount); // Reserve space for the input register data
+
+      // Now we can convert the input register values directly into the response ADU. If
+      // another thread writes the registers during the copy, the copy is done again.
+      uint32_t sequence;
+
+      do {
+        sequence = inputRegisterLock.beginRead();
+        CSE_ModbusRTU_Codec:: encode (data, values, registerCount);
+      } while (!inputRegisterLock.endRead (sequence));
 
-      // Now we need to copy the input register data into the response ADU
-      response.add (inputRegisterData, byteCount); // Add the input register data to the response ADU
       response.setCRC(); // Set the CRC of the response
       send(); // Send the response
       return MODBUS_FC_READ_INPUT_REGISTERS; // Return the function code
@@ -1182,8 +1988,8 @@ int CSE_ModbusRTU_Server:: poll() {
     //---------------------------------------------------------------------------------//
 
     case MODBUS_FC_WRITE_SINGLE_COIL: {
-      // Check if the coil is present in the server
-      if (!isCoilPresent (request.getStartingAddress())) {
+      // Check if the coil is present in the server, and is not read-only
+      if (!coils.isWritable (request.getStartingAddress())) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1211,9 +2017,11 @@ int CSE_ModbusRTU_Server:: poll() {
         writeCoil (request.getStartingAddress(), 0x01); // Write the coil to the server
       }
 
-      // For successful coil writes, the response ADU is the same as the request ADU
-      response = request; // Copy the request ADU to the response ADU
-      send(); // Send the response
+      markChanged (changedCoils, request.getStartingAddress(), 1); // Mark the coil as changed
+
+      // For successful coil writes, the response is the same as the request. The request
+      // ADU is sent back as it is, without copying it to the response ADU.
+      send (request); // Echo the request
       return MODBUS_FC_WRITE_SINGLE_COIL; // Return the function code
       break;
     }
@@ -1221,8 +2029,8 @@ int CSE_ModbusRTU_Server:: poll() {
     //---------------------------------------------------------------------------------//
 
     case MODBUS_FC_WRITE_SINGLE_REGISTER: {
-      // Check if the holding register is present in the server
-      if (!isHoldingRegisterPresent (request.getStartingAddress())) {
+      // Check if the holding register is present in the server, and is not read-only
+      if (!holdingRegisters.isWritable (request.getStartingAddress())) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1240,10 +2048,15 @@ int CSE_ModbusRTU_Server:: poll() {
       // If the holding register is present in the server, we can proceed with writing the holding register specified.
       // The holding register value will be after the starting address in the request ADU.
       writeHoldingRegister (request.getStartingAddress(), request.getWord (MODBUS_RTU_ADU_DATA_INDEX + 2)); // Write the holding register to the server
+      markChanged (changedHoldingRegisters, request.getStartingAddress(), 1); // Mark the holding register as changed
 
-      // For successful holding register writes, the response ADU is the same as the request ADU
-      response = request; // Copy the request ADU to the response ADU
-      send(); // Send the response
+      if (writeCallback != NULL) {
+        writeCallback (request.getStartingAddress(), 1, writeContext);
+      }
+
+      // For successful holding register writes, the response is the same as the request.
+      // The request ADU is sent back as it is, without copying it to the response ADU.
+      send (request); // Echo the request
       return MODBUS_FC_WRITE_SINGLE_REGISTER; // Return the function code
       break;
     }
@@ -1251,9 +2064,9 @@ int CSE_ModbusRTU_Server:: poll() {
     //---------------------------------------------------------------------------------//
 
     case MODBUS_FC_WRITE_MULTIPLE_COILS: {
-      // Check if the coils are present in the server,
+      // Check if the coils are present in the server and are not read-only,
       // and the requested register count. The maximum register count is 0x07B0 (1968).
-      if ((request.getQuantity() > 0x07B0) || (!isCoilPresent (request.getStartingAddress(), request.getQuantity()))) {
+      if ((request.getQuantity() > 0x07B0) || (!coils.isWritable (request.getStartingAddress(), request.getQuantity()))) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1270,25 +2083,26 @@ int CSE_ModbusRTU_Server:: poll() {
       DEBUG_PRINT (F(" to 0x"));
       DEBUG_PRINTLN (request.getStartingAddress() + request.getQuantity() - 1, HEX);
 
-      // The coil data will come packed as bits in the data field of the ADU.
-      // So we need to extract each coil data and write them to the server.
-
-      // Create an array with the sepcified number of coil registers.
-      // Coil register count is not the same as the byte count.
-      uint8_t coilData [request.getQuantity()] = {0}; //
+      // The byte count must match the quantity, and the data must be inside the request.
+      // Otherwise the bytes left in the buffer by an earlier frame would be written.
       uint8_t byteCount = request.getByte (MODBUS_RTU_ADU_DATA_INDEX + 4); // Get the byte count
 
-      // Now we need to copy the coil data from the request ADU
-      for (int i = 0, j = 0; i < byteCount; i++) {
-        for (int k = 0; ((k < 8) && (j < request.getQuantity())); k++) {
-          coilData [j] = (request.getByte (MODBUS_RTU_ADU_DATA_INDEX + 5 + i) >> k) & 0x01;
-          j++;
-        }
+      if ((byteCount != ((request.getQuantity() + 7) / 8)) || ((MODBUS_RTU_ADU_DATA_INDEX + 5 + byteCount + MODBUS_RTU_CRC_LENGTH) > request.getLength())) {
+        response.resetLength(); // Reset the response length
+        response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
+        response.setFunctionCode (MODBUS_FC_WRITE_MULTIPLE_COILS); // Set the function code of the response
+        response.setException(); // Set the exception bit of the function code
+        response.setExceptionCode (MODBUS_EX_ILLEGAL_DATA_VALUE); // Set the exception code
+        response.setCRC(); // Set the CRC of the response
+        send(); // Send the response
+        return MODBUS_FC_WRITE_MULTIPLE_COILS + 0x80; // Return exception function code
       }
 
-      for (int i = 0; i < request.getQuantity(); i++) {
-        writeCoil (request.getStartingAddress() + i, coilData [i]); // Write the coil to the server
-      }
+      // The coil data will come packed as bits in the data field of the ADU, after the
+      // byte count. The coils are stored packed in the same order, so the bits are copied
+      // to the server a byte at a time.
+      coils.write (request.getStartingAddress(), request.getQuantity(), request.getBuffer() + MODBUS_RTU_ADU_DATA_INDEX + 5);
+      markChanged (changedCoils, request.getStartingAddress(), request.getQuantity()); // Mark the coils as changed
 
       response.resetLength(); // Reset the response length
       response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1304,9 +2118,12 @@ int CSE_ModbusRTU_Server:: poll() {
     //---------------------------------------------------------------------------------//
 
     case MODBUS_FC_WRITE_MULTIPLE_REGISTERS: {
-      // Check if the holding registers are present in the server,
+      // Find the holding registers of the range. They are contiguous in a single block of the map.
+      uint16_t* values = holdingRegisters.find (request.getStartingAddress(), request.getQuantity());
+
+      // Check if the holding registers are present in the server and are not read-only,
       // and the requested register count. The maximum register count is 0x007B (123).
-      if ((request.getQuantity() > 0x007B) || (!isHoldingRegisterPresent (request.getStartingAddress(), request.getQuantity()))) {
+      if ((request.getQuantity() > 0x007B) || (values == NULL) || !holdingRegisters.isWritable (request.getStartingAddress(), request.getQuantity())) {
         // Then process an exception
         response.resetLength(); // Reset the response length
         response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
@@ -1324,21 +2141,29 @@ int CSE_ModbusRTU_Server:: poll() {
       DEBUG_PRINTLN (request.getStartingAddress() + request.getQuantity() - 1, HEX);
 
       // The holding register data will come packed as 16-bit words in the data field of the ADU.
-      // So we need to extract each holding register data and write them to the server.
-
-      // Create an array with the sepcified number of holding registers.
-      // Holding register count is not the same as the word count.
-      uint16_t holdingRegisterData [request.getQuantity()] = {0}; //
+      // The byte count must match the quantity, and the data must be inside the request.
       uint8_t byteCount = request.getByte (MODBUS_RTU_ADU_DATA_INDEX + 4); // Get the byte count
+      uint8_t registerCount = request.getQuantity();
 
-      // Now we need to copy the holding register data from the request ADU
-      for (int i = 0, j = 0; i < byteCount; i += 2) {
-        holdingRegisterData [j] = request.getWord (MODBUS_RTU_ADU_DATA_INDEX + 5 + i);
-        j++;
-      }
-
-      for (int i = 0; i < request.getQuantity(); i++) {
-        writeHoldingRegister (request.getStartingAddress() + i, holdingRegisterData [i]); // Write the holding register to the server
+      if ((byteCount != (registerCount * 2)) || ((MODBUS_RTU_ADU_DATA_INDEX + 5 + byteCount + MODBUS_RTU_CRC_LENGTH) > request.getLength())) {
+        response.resetLength(); // Reset the response length
+        response.setDeviceAddress (rtu->deviceAddress); // Set the address of the response
+        response.setFunctionCode (MODBUS_FC_WRITE_MULTIPLE_REGISTERS); // Set the function code of the response
+        response.setException(); // Set the exception bit of the function code
+        response.setExceptionCode (MODBUS_EX_ILLEGAL_DATA_VALUE); // Set the exception code
+        response.setCRC(); // Set the CRC of the response
+        send(); // Send the response
+        return MODBUS_FC_WRITE_MULTIPLE_REGISTERS + 0x80; // Return exception function code
+      }
+
+      // Now we can convert the holding register data from the request ADU directly into the holding registers
+      holdingRegisterLock.beginWrite();
+      request.getWords (MODBUS_RTU_ADU_DATA_INDEX + 5, values, registerCount);
+      holdingRegisterLock.endWrite();
+      markChanged (changedHoldingRegisters, request.getStartingAddress(), registerCount); // Mark the holding registers as changed
+
+      if (writeCallback != NULL) {
+        writeCallback (request.getStartingAddress(), registerCount, writeContext);
       }
 
       response.resetLength(); // Reset the response length
@@ -1394,38 +2219,79 @@ int CSE_ModbusRTU_Server:: receive() {
  */
 int CSE_ModbusRTU_Server:: send() {
   // A server will use the response ADU to send responses to the client.
-  return rtu->send (response);
+  return send (response);
 }
 
 //======================================================================================//
 /**
- * @brief Configures the coil data array by adding new data to the coils vector.
- * The maximum coil count is limited to MODBUS_RTU_COIL_COUNT_MAX which you can change
- * if required. You can create a contiguous set of coils by specifying the starting
- * address and the quantity of coils to be created. If you want coils of different
- * and non-contiguous addresses, you can call this function multiple times. This library
- * treats individual data as unique and independent; not as part of a contiguous set.
- * So two adjacent coils in the data array can have non-contiguous addresses.
+ * @brief Sends any ADU to the client. The server uses this to echo the request ADU of
+ * the write single coil and write single register requests, instead of copying it to
+ * the response ADU.
+ * 
+ * In the non-blocking mode, the function does not wait. The state is changed to
+ * TRANSMITTING, and poll() sends the ADU when the response delay has passed. The ADU
+ * must not be changed until the state is IDLE again.
+ * 
+ * @param adu The ADU to send. The CRC must be set.
+ * @return int - ADU length, or -1 if the operation fails.
+ */
+int CSE_ModbusRTU_Server:: send (CSE_ModbusRTU_ADU& adu) {
+  if (nonBlocking) {
+    if ((state == serverState_t:: TRANSMITTING) || !adu.checkCRC()) {
+      return -1;
+    }
+
+    pendingFrame = &adu;
+    state = serverState_t:: TRANSMITTING;
+    transmit(); // Start now if the response delay has passed
+
+    return (int) adu.getLength();
+  }
+
+  serverState_t previousState = state;
+  state = serverState_t:: TRANSMITTING;
+
+  int result = rtu->send (adu);
+
+  state = previousState;
+  return result;
+}
+
+//======================================================================================//
+/**
+ * @brief Configures the coil data array by adding a contiguous range of coils. The
+ * maximum coil count is limited to MODBUS_RTU_COIL_COUNT_MAX which you can change
+ * if required. If you want coils of different and non-contiguous addresses, you can
+ * call this function multiple times. The coils are stored in blocks of contiguous
+ * addresses (see CSE_ModbusRTU_RegisterMap). A range that starts right after, or ends
+ * right before, an existing range is joined with it, so a request can read or write
+ * across both. The new coils are set to 0x00.
+ *
+ * The coils take memory only for the configured addresses, and the whole address space
+ * can be used. Since the quantity is 16-bit, all the 65536 addresses need two calls. The
+ * memory can be taken from an arena instead of the heap with coils.setArena().
  * 
  * @param startAddress The starting address of the coil (16-bit)
  * @param quantity The number of coils to create (16-bit)
  * @return true - Operation successful
- * @return false - Operation failed
+ * @return false - Operation failed. The count is exceeded, the range overlaps existing coils, or there is no memory for the coils or their change flags. Then nothing is added.
  */
 bool CSE_ModbusRTU_Server:: configureCoils (uint16_t startAddress, uint16_t quantity) {
-  // First check if the current coil count doesn't exceed the maximum coil count
-  if (coils.size() == MODBUS_RTU_COIL_COUNT_MAX) {
+  // Check if the input coil count won't exceed the maximum coil count
+  if ((coils.size() + quantity) > MODBUS_RTU_COIL_COUNT_MAX) {
     return false;
   }
 
-  // Now check if the input coil count won't exceed the maximum coil count
-  if ((coils.size() + quantity) > MODBUS_RTU_COIL_COUNT_MAX) {
+  // Now we can add the new coils, and their change flags
+  if (!coils.add (startAddress, quantity)) {
     return false;
   }
 
-  // Now we can add a new coil
-  for (uint16_t i = 0; i < quantity; i++) {
-    coils.push_back (modbus_bit_t (startAddress + i, 0x00));
+  // Without the change flags, the writes to the range could not be reported. So the
+  // range is removed again.
+  if (!changedCoils.add (startAddress, quantity)) {
+    coils.remove (startAddress, quantity);
+    return false;
   }
 
   return true;
@@ -1433,105 +2299,79 @@ bool CSE_ModbusRTU_Server:: configureCoils (uint16_t startAddress, uint16_t quan
 
 //======================================================================================//
 /**
- * @brief Configures the discrete input data array by adding new data to the discrete
- * inputs vector. The maximum discrete input count is limited to MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX
- * which you can change if required. You can create a contiguous set of discrete inputs
- * by specifying the starting address and the quantity of discrete inputs to be created.
- * If you want discrete inputs of different and non-contiguous addresses, you can call
- * this function multiple times. This library treats individual data as unique and
- * independent; not as part of a contiguous set. So two adjacent discrete inputs in the
- * data array can have non-contiguous addresses.
+ * @brief Configures the discrete input data array by adding a contiguous range of
+ * discrete inputs. The maximum discrete input count is limited to
+ * MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX which you can change if required. If you want
+ * discrete inputs of different and non-contiguous addresses, you can call this function
+ * multiple times. Adjacent ranges are joined as with configureCoils().
  * 
  * @param startAddress The starting address of the discrete input (16-bit)
  * @param quantity The number of discrete inputs to create (16-bit)
  * @return true - Operation successful
- * @return false - Operation failed
+ * @return false - Operation failed. The count is exceeded, or the range overlaps existing discrete inputs.
  */
 bool CSE_ModbusRTU_Server:: configureDiscreteInputs (uint16_t startAddress, uint16_t quantity) {
-  // First check if the current discrete input count doesn't exceed the maximum discrete input count
-  if (discreteInputs.size() == MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX) {
-    return false;
-  }
-
-  // Now check if the input discrete input count won't exceed the maximum discrete input count
+  // Check if the input discrete input count won't exceed the maximum discrete input count
   if ((discreteInputs.size() + quantity) > MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX) {
     return false;
   }
 
-  // Now we can add a new discrete input
-  for (uint16_t i = 0; i < quantity; i++) {
-    modbus_bit_t* newCoil = new modbus_bit_t (startAddress + i, 0x00);
-    discreteInputs.push_back (*newCoil);
-  }
-
-  return true;
+  // Now we can add the new discrete inputs
+  return discreteInputs.add (startAddress, quantity);
 }
 
 //======================================================================================//
 /**
- * @brief Configures the input register data array by adding new data to the input
- * registers vector. The maximum input register count is limited to MODBUS_RTU_INPUT_REGISTER_COUNT_MAX
- * which you can change if required. You can create a contiguous set of input registers
- * by specifying the starting address and the quantity of input registers to be created.
- * If you want input registers of different and non-contiguous addresses, you can call
- * this function multiple times. This library treats individual data as unique and
- * independent; not as part of a contiguous set. So two adjacent input registers in the
- * data array can have non-contiguous addresses.
+ * @brief Configures the input register data array by adding a contiguous range of
+ * input registers. The maximum input register count is limited to
+ * MODBUS_RTU_INPUT_REGISTER_COUNT_MAX which you can change if required. If you want
+ * input registers of different and non-contiguous addresses, you can call this function
+ * multiple times. Adjacent ranges are joined as with configureCoils().
  * 
  * @param startAddress The starting address of the input register (16-bit)
  * @param quantity The number of input registers to create (16-bit)
  * @return true - Operation successful
- * @return false - Operation failed
+ * @return false - Operation failed. The count is exceeded, or the range overlaps existing input registers.
  */
 bool CSE_ModbusRTU_Server:: configureInputRegisters (uint16_t startAddress, uint16_t quantity) {
-  // First check if the current input register count doesn't exceed the maximum input register count
-  if (inputRegisters.size() == MODBUS_RTU_INPUT_REGISTER_COUNT_MAX) {
-    return false;
-  }
-
-  // Now check if the input input register count won't exceed the maximum input register count
+  // Check if the input input register count won't exceed the maximum input register count
   if ((inputRegisters.size() + quantity) > MODBUS_RTU_INPUT_REGISTER_COUNT_MAX) {
     return false;
   }
 
-  // Now we can add a new input register
-  for (uint16_t i = 0; i < quantity; i++) {
-    inputRegisters.push_back (modbus_register_t (startAddress + i, 0x0000));
-  }
-
-  return true;
+  // Now we can add the new input registers
+  return inputRegisters.add (startAddress, quantity);
 }
 
 //======================================================================================//
 /**
- * @brief Configures the holding register data array by adding new data to the holding
- * registers vector. The maximum holding register count is limited to MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX
- * which you can change if required. You can create a contiguous set of holding registers
- * by specifying the starting address and the quantity of holding registers to be created.
- * If you want holding registers of different and non-contiguous addresses, you can call
- * this function multiple times. This library treats individual data as unique and
- * independent; not as part of a contiguous set. So two adjacent holding registers in the
- * data array can have non-contiguous addresses.
+ * @brief Configures the holding register data array by adding a contiguous range of
+ * holding registers. The maximum holding register count is limited to
+ * MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX which you can change if required. If you want
+ * holding registers of different and non-contiguous addresses, you can call this
+ * function multiple times. Adjacent ranges are joined as with configureCoils().
  * 
  * @param startAddress The starting address of the holding register (16-bit)
  * @param quantity The number of holding registers to create (16-bit)
  * @return true - Operation successful
- * @return false - Operation failed
+ * @return false - Operation failed. The count is exceeded, the range overlaps existing holding registers, or there is no memory for the registers or their change flags. Then nothing is added.
  */
 bool CSE_ModbusRTU_Server:: configureHoldingRegisters (uint16_t startAddress, uint16_t quantity) {
-  // First check if the current holding register count doesn't exceed the maximum holding register count
-  if (holdingRegisters.size() == MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX) {
+  // Check if the input holding register count won't exceed the maximum holding register count
+  if ((holdingRegisters.size() + quantity) > MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX) {
     return false;
   }
 
-  // Now check if the input holding register count won't exceed the maximum holding register count
-  if ((holdingRegisters.size() + quantity) > MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX) {
+  // Now we can add the new holding registers, and their change flags
+  if (!holdingRegisters.add (startAddress, quantity)) {
     return false;
   }
 
-  // Now we can add a new holding register
-  for (uint16_t i = 0; i < quantity; i++) {
-    holdingRegisters.push_back (modbus_register_t (startAddress + i, 0x0000));
+  // Without the change flags, the writes to the range could not be reported. So the
+  // range is removed again.
+  if (!changedHoldingRegisters.add (startAddress, quantity)) {
+    holdingRegisters.remove (startAddress, quantity);
+    return false;
   }
 
   return true;
@@ -1539,29 +2379,20 @@ bool CSE_ModbusRTU_Server:: configureHoldingRegisters (uint16_t startAddress, ui
 
 //======================================================================================//
 /**
- * @brief Reads a single coil from the coil data array. The address is checked for validity
- * by comparing it with the coil addresses in the coil data array. If the address is valid,
- * the coil value is returned. If the address is invalid, -1 is returned.
+ * @brief Reads a single coil from the coil data array. If the address is valid, the coil
+ * value is returned. If the address is invalid, -1 is returned.
  * 
  * @param address - The 16-bit address of the coil.
  * @return int - Coil value; -1 if address is invalid.
  */
 int CSE_ModbusRTU_Server:: readCoil (uint16_t address) {
-  // First check if the coil exists
-  for (uint16_t i = 0; i < coils.size(); i++) {
-    if (coils [i].address == address) {
-      return coils [i].value;
-    }
-  }
-
-  return -1;
+  return coils.getBit (address);
 }
 
 //======================================================================================//
 /**
- * @brief Writes a single coil register on the server. The address is checked for validity
- * by comparing it with the coil addresses in the coil data array. If the address is valid,
- * the coil value is updated and 1 is returned. If the address is invalid, -1 is returned.
+ * @brief Writes a single coil register on the server. If the address is valid, the coil
+ * value is updated and 1 is returned. If the address is invalid, -1 is returned.
  * The coil value can be 0x00 or 0x01. Any other value is invalid.
  * 
  * This function does not send anything to the client. This function is only used to update
@@ -1572,27 +2403,14 @@ int CSE_ModbusRTU_Server:: readCoil (uint16_t address) {
  * @return int - 1 if successful; -1 if failed.
  */
 int CSE_ModbusRTU_Server:: writeCoil (uint16_t address, uint8_t value) {
-  if ((value != 0x00) && (value != 0x01)) {
-    return -1;
-  }
-
-  // First check if the coil exists
-  for (uint16_t i = 0; i < coils.size(); i++) {
-    if (coils [i].address == address) {
-      coils [i].value = value;
-      return 1;
-    }
-  }
-
-  return -1;
+  return writeCoil (address, value, 1);
 }
 
 //======================================================================================//
 /**
- * @brief Writes a contiguous series of coil registers on the server. Individual addresses
- * are checked for validity by comparing them with the coil addresses in the coil data array.
- * If any of the addresses are invalid, the function stops writing the values and returns 
- * -1. If all the addresses are valid, the coil values are updated and 1 is returned.
+ * @brief Writes a contiguous series of coil registers on the server with the same value.
+ * If any of the addresses is not present, nothing is written and -1 is returned. If all
+ * the addresses are valid, the coil values are updated and 1 is returned.
  * The coil value can be 0x00 or 0x01. Any other value is invalid.
  * 
  * @param address The 16-bit starting address of the coils.
@@ -1605,51 +2423,30 @@ int CSE_ModbusRTU_Server:: writeCoil (uint16_t address, uint8_t value, uint16_t
     return -1;
   }
 
-  // Check if the coil addresses go out of bounds
-  if ((address + count) > (coils [coils.size() - 1].address + 1)) {
+  if (!coils.setBit (address, value, count)) {
     return -1;
   }
 
-  int result = 1; // Assume success
-
-  // Write the specified coils
-  for (uint16_t i = 0; i < count; i++) {
-    if (writeCoil (address + i, value) == -1) { // Check if any of the writes fail
-      result = -1;  // If so, set the result to failure
-    }
-  }
-
-  return result;
+  return 1;
 }
 
 //======================================================================================//
 /**
- * @brief Checks if a single coil with address is present in the server. The coil
- * addresses don't have to be contiguous. But ideally it should be.
+ * @brief Checks if a single coil with address is present in the server.
  * 
  * @param address The coil address to check.
  * @return true - Coil is present in the data array.
  * @return false - Coil is not found.
  */
 bool CSE_ModbusRTU_Server:: isCoilPresent (uint16_t address) {
-  // Check if the coil exists
-  for (uint16_t i = 0; i < coils.size(); i++) {
-    if (coils [i].address == address) {
-      return true;
-    }
-  }
-
-  return false;
+  return coils.isPresent (address);
 }
 
 //======================================================================================//
 /**
  * @brief Checks if a range of coils is present. If any of the coils is not present
- * in the server, the function returns false. The coil addresses don't have to be
- * contiguous. But ideally it should be. For example, it is possile to have coils with
- * addresses 0x01, 0x03, 0x04, 0x07, etc. These are not contigous addresses. So we
- * need to compare each of the coils specified in the range with the coils present
- * in the server.
+ * in the server, the function returns false. The range can cover coils configured with
+ * separate calls to configureCoils(), as long as there is no gap between them.
  * 
  * @param address The 16-bit starting address of the coils.
  * @param count The number of coils to check.
@@ -1657,14 +2454,7 @@ bool CSE_ModbusRTU_Server:: isCoilPresent (uint16_t address) {
  * @return false - One or more coils are not present in the server.
  */
 bool CSE_ModbusRTU_Server:: isCoilPresent (uint16_t address, uint16_t count) {
-  // Check if each of the coils exist
-  for (uint16_t i = 0; i < count; i++) {
-    if (!isCoilPresent (address + i)) { // If any of the coils don't exist, return false
-      return false;
-    }
-  }
-
-  return true;
+  return coils.isPresent (address, count);
 }
 
 //======================================================================================//
@@ -1676,16 +2466,7 @@ bool CSE_ModbusRTU_Server:: isCoilPresent (uint16_t address, uint16_t count) {
  * @return int - 0x00 if OFF; 0x01 if ON; -1 if failed.
  */
 int CSE_ModbusRTU_Server:: readDiscreteInput (uint16_t address) {
-  // First check if the discrete input exists
-  for (uint16_t i = 0; i < discreteInputs.size(); i++) {
-    if (discreteInputs [i].address == address) {
-      if ((discreteInputs [i].value == 0x00) || (discreteInputs [i].value == 0x01)) {
-        return discreteInputs [i].value;
-      }
-    }
-  }
-
-  return -1;
+  return discreteInputs.getBit (address);
 }
 
 //======================================================================================//
@@ -1698,28 +2479,15 @@ int CSE_ModbusRTU_Server:: readDiscreteInput (uint16_t address) {
  * @return int - 1 if successful; -1 if failed.
  */
 int CSE_ModbusRTU_Server:: writeDiscreteInput (uint16_t address, uint8_t value) {
-  if ((value != 0x00) && (value != 0x01)) {
-    return -1;
-  }
-
-  // First check if the discrete input exists
-  for (uint16_t i = 0; i < discreteInputs.size(); i++) {
-    if (discreteInputs [i].address == address) {
-      discreteInputs [i].value = value;
-      return 1;
-    }
-  }
-
-  return -1;
+  return writeDiscreteInput (address, value, 1);
 }
 
 //======================================================================================//
 /**
- * @brief Writes a contiguous series of discrete input registers on the server. Individual
- * addresses are checked for validity by comparing them with the discrete input addresses
- * in the discrete input data array. If any of the addresses are invalid, the function
- * stops writing the values and returns -1. If all the addresses are valid, the discrete
- * input values are updated and 1 is returned.
+ * @brief Writes a contiguous series of discrete input registers on the server with the
+ * same value. If any of the addresses is not present, nothing is written and -1 is
+ * returned. If all the addresses are valid, the discrete input values are updated and
+ * 1 is returned.
  * 
  * @param address The 16-bit starting address of the discrete input registers.
  * @param value 0x00 for OFF, and 0x01 for ON.
@@ -1731,21 +2499,11 @@ int CSE_ModbusRTU_Server:: writeDiscreteInput (uint16_t address, uint8_t value,
     return -1;
   }
 
-  // Check if the discrete input addresses go out of bounds
-  if ((address + count) > (discreteInputs [discreteInputs.size() - 1].address + 1)) {
+  if (!discreteInputs.setBit (address, value, count)) {
     return -1;
   }
 
-  int result = 1; // Assume success
-
-  // Write the specified discrete inputs
-  for (uint16_t i = 0; i < count; i++) {
-    if (writeDiscreteInput (address + i, value) == -1) { // Check if any of the writes fail
-      result = -1; // If so, set the result to failure
-    }
-  }
-
-  return result;
+  return 1;
 }
 
 //======================================================================================//
@@ -1757,14 +2515,7 @@ int CSE_ModbusRTU_Server:: writeDiscreteInput (uint16_t address, uint8_t value,
  * @return false - Discrete input is not found in the server.
  */
 bool CSE_ModbusRTU_Server:: isDiscreteInputPresent (uint16_t address) {
-  // Check if the discrete input exists
-  for (uint16_t i = 0; i < discreteInputs.size(); i++) {
-    if (discreteInputs [i].address == address) {
-      return true;
-    }
-  }
-
-  return false;
+  return discreteInputs.isPresent (address);
 }
 
 //======================================================================================//
@@ -1778,14 +2529,7 @@ bool CSE_ModbusRTU_Server:: isDiscreteInputPresent (uint16_t address) {
  * @return false - One or more discrete inputs are not present in the server.
  */
 bool CSE_ModbusRTU_Server:: isDiscreteInputPresent (uint16_t address, uint16_t count) {
-  // Check if each of the discrete inputs exist
-  for (uint16_t i = 0; i < count; i++) {
-    if (!isDiscreteInputPresent (address + i)) { // If any of the discrete inputs don't exist, return false
-      return false;
-    }
-  }
-
-  return true;
+  return discreteInputs.isPresent (address, count);
 }
 
 //======================================================================================//
@@ -1797,14 +2541,13 @@ bool CSE_ModbusRTU_Server:: isDiscreteInputPresent (uint16_t address, uint16_t c
  * @return int - The value of the input register; -1 if failed.
  */
 int CSE_ModbusRTU_Server:: readInputRegister (uint16_t address) {
-  // First check if the input register exists
-  for (uint16_t i = 0; i < inputRegisters.size(); i++) {
-    if (inputRegisters [i].address == address) {
-      return inputRegisters [i].value;
-    }
+  uint16_t* value = inputRegisters.find (address);
+
+  if (value == NULL) {
+    return -1;
   }
 
-  return -1;
+  return *value;
 }
 
 //======================================================================================//
@@ -1817,24 +2560,15 @@ int CSE_ModbusRTU_Server:: readInputRegister (uint16_t address) {
  * @return int - 1 if successful; -1 if failed.
  */
 int CSE_ModbusRTU_Server:: writeInputRegister (uint16_t address, uint16_t value) {
-  // First check if the input register exists
-  for (uint16_t i = 0; i < inputRegisters.size(); i++) {
-    if (inputRegisters [i].address == address) {
-      inputRegisters [i].value = value;
-      return 1;
-    }
-  }
-
-  return -1;
+  return writeInputRegister (address, value, 1);
 }
 
 //======================================================================================//
 /**
- * @brief Writes a contiguous series of input registers on the server. Individual
- * addresses are checked for validity by comparing them with the input register addresses
- * in the input register data array. If any of the addresses are invalid, the function
- * stops writing the values and returns -1. If all the addresses are valid, the input
- * register values are updated and 1 is returned.
+ * @brief Writes a contiguous series of input registers on the server with the same
+ * value. If any of the addresses is not present, nothing is written and -1 is returned.
+ * If all the addresses are valid, the input register values are updated and 1 is
+ * returned.
  * 
  * @param address The 16-bit starting address of the input registers.
  * @param value The 16-bit value to write to the input registers.
@@ -1842,172 +2576,484 @@ int CSE_ModbusRTU_Server:: writeInputRegister (uint16_t address, uint16_t value)
  * @return int - 1 if successful; -1 if failed.
  */
 int CSE_ModbusRTU_Server:: writeInputRegister (uint16_t address, uint16_t value, uint16_t count) {
-  // Check if the input register addresses go out of bounds
-  if ((address + count) > (inputRegisters [inputRegisters.size() - 1].address + 1)) {
+  uint16_t* values = inputRegisters.find (address, count);
+
+  if (values == NULL) {
+    return -1;
+  }
+
+  inputRegisterLock.beginWrite();
+
+  for (uint16_t i = 0; i < count; i++) {
+    values [i] = value;
+  }
+
+  inputRegisterLock.endWrite();
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a contiguous series of input registers on the server from an array. The
+ * values are written under the input register lock, so a request never reads only some
+ * of them. Use this to update values that span more than one register, such as a 32-bit
+ * float, from another thread or core. If any of the addresses is not present, nothing
+ * is written and -1 is returned.
+ * 
+ * @param address The 16-bit starting address of the input registers.
+ * @param count The number of input registers to write.
+ * @param registerValues The values to write.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: writeInputRegister (uint16_t address, uint16_t count, const uint16_t* registerValues) {
+  uint16_t* values = inputRegisters.find (address, count);
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  inputRegisterLock.beginWrite();
+  memcpy (values, registerValues, count * 2);
+  inputRegisterLock.endWrite();
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a contiguous series of input registers on the server to an array. The
+ * values are a consistent snapshot, even if another thread writes them during the read.
+ * If any of the addresses is not present, nothing is read and -1 is returned.
+ * 
+ * @param address The 16-bit starting address of the input registers.
+ * @param count The number of input registers to read.
+ * @param registerValues The values are saved here.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: readInputRegister (uint16_t address, uint16_t count, uint16_t* registerValues) {
+  uint16_t* values = inputRegisters.find (address, count);
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  uint32_t sequence;
+
+  do {
+    sequence = inputRegisterLock.beginRead();
+    memcpy (registerValues, values, count * 2);
+  } while (!inputRegisterLock.endRead (sequence));
+
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if a single input register with address is present in the server.
+ * 
+ * @param address The 16-bit address of the input register to check.
+ * @return true - Input register is present in the server.
+ * @return false - Input register is not found in the server.
+ */
+bool CSE_ModbusRTU_Server:: isInputRegisterPresent (uint16_t address) {
+  return inputRegisters.isPresent (address);
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if a range of input registers is present. If any of the input registers
+ * is not present in the server, the function returns false.
+ * 
+ * @param address The 16-bit starting address of the input registers.
+ * @param count The number of input registers to check.
+ * @return true - All input registers are present in the server.
+ * @return false - One or more input registers are not present in the server.
+ */
+bool CSE_ModbusRTU_Server:: isInputRegisterPresent (uint16_t address, uint16_t count) {
+  return inputRegisters.isPresent (address, count);
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a single holding register on the server. The address is checked for
+ * validity.
+ * 
+ * @param address The 16-bit address of the holding register.
+ * @return int - The value of the holding register; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: readHoldingRegister (uint16_t address) {
+  uint16_t* value = holdingRegisters.find (address);
+
+  if (value == NULL) {
+    return -1;
+  }
+
+  return *value;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a single holding register on the server. The address is checked for
+ * validity.
+ * 
+ * @param address The 16-bit address of the holding register.
+ * @param value The 16-bit value to write to the holding register.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: writeHoldingRegister (uint16_t address, uint16_t value) {
+  return writeHoldingRegister (address, value, 1);
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a contiguous series of holding registers on the server with the same
+ * value. If any of the addresses is not present, nothing is written and -1 is returned.
+ * If all the addresses are valid, the holding register values are updated and 1 is
+ * returned.
+ * 
+ * @param address The 16-bit starting address of the holding registers.
+ * @param value The 16-bit value to write to the holding registers.
+ * @param count The number of holding registers to write.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: writeHoldingRegister (uint16_t address, uint16_t value, uint16_t count) {
+  uint16_t* values = holdingRegisters.find (address, count);
+
+  if (values == NULL) {
+    return -1;
+  }
+
+  holdingRegisterLock.beginWrite();
+
+  for (uint16_t i = 0; i < count; i++) {
+    values [i] = value;
+  }
+
+  holdingRegisterLock.endWrite();
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a contiguous series of holding registers on the server from an array. The
+ * values are written under the holding register lock, so a request never reads only some
+ * of them. Use this to update values that span more than one register, such as a 32-bit
+ * float, from another thread or core. If any of the addresses is not present, nothing
+ * is written and -1 is returned.
+ * 
+ * @param address The 16-bit starting address of the holding registers.
+ * @param count The number of holding registers to write.
+ * @param registerValues The values to write.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: writeHoldingRegister (uint16_t address, uint16_t count, const uint16_t* registerValues) {
+  uint16_t* values = holdingRegisters.find (address, count);
+
+  if ((values == NULL) || (registerValues == NULL)) {
     return -1;
   }
 
-  int result = 1; // Assume success
+  holdingRegisterLock.beginWrite();
+  memcpy (values, registerValues, count * 2);
+  holdingRegisterLock.endWrite();
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a contiguous series of holding registers on the server to an array. The
+ * values are a consistent snapshot, even if another thread writes them during the read.
+ * If any of the addresses is not present, nothing is read and -1 is returned.
+ * 
+ * @param address The 16-bit starting address of the holding registers.
+ * @param count The number of holding registers to read.
+ * @param registerValues The values are saved here.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Server:: readHoldingRegister (uint16_t address, uint16_t count, uint16_t* registerValues) {
+  uint16_t* values = holdingRegisters.find (address, count);
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  uint32_t sequence;
+
+  do {
+    sequence = holdingRegisterLock.beginRead();
+    memcpy (registerValues, values, count * 2);
+  } while (!holdingRegisterLock.endRead (sequence));
+
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if a single holding register with address is present in the server.
+ * 
+ * @param address The 16-bit address of the holding register to check.
+ * @return true - Holding register is present in the server.
+ * @return false - Holding register is not found in the server.
+ */
+bool CSE_ModbusRTU_Server:: isHoldingRegisterPresent (uint16_t address) {
+  return holdingRegisters.isPresent (address);
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if a range of holding registers is present. If any of the holding registers
+ * is not present in the server, the function returns false.
+ * 
+ * @param address The 16-bit starting address of the holding registers.
+ * @param count The number of holding registers to check.
+ * @return true - All holding registers are present in the server.
+ * @return false - One or more holding registers are not present in the server.
+ */
+bool CSE_ModbusRTU_Server:: isHoldingRegisterPresent (uint16_t address, uint16_t count) {
+  return holdingRegisters.isPresent (address, count);
+}
+
+//======================================================================================//
+/**
+ * @brief Adds a register provider. The range must be configured, and must not overlap
+ * another provider of the same table.
+ * 
+ * @param functionCode The read function code of the table.
+ * @param address The first address of the range.
+ * @param count The number of registers.
+ * @param function The function that computes the values.
+ * @param context Passed to the function.
+ * @return true - The provider was added.
+ * @return false - The range is not configured or overlaps another provider, or there is no space.
+ */
+bool CSE_ModbusRTU_Server:: addProvider (uint8_t functionCode, uint16_t address, uint16_t count, registerProvider_t function, void* context) {
+  if ((function == NULL) || (providerCount >= MODBUS_RTU_PROVIDER_COUNT_MAX)) {
+    return false;
+  }
+
+  // The whole range must be configured
+  if (functionCode == MODBUS_FC_READ_INPUT_REGISTERS) {
+    if (!inputRegisters.isPresent (address, count)) {
+      return false;
+    }
+  }
+  else if (!holdingRegisters.isPresent (address, count)) {
+    return false;
+  }
+
+  uint32_t end = (uint32_t) address + count; // One past the last address
+
+  for (uint8_t i = 0; i < providerCount; i++) {
+    if ((providers [i].functionCode == functionCode) && (providers [i].address < end) && (((uint32_t) providers [i].address + providers [i].count) > address)) {
+      return false;
+    }
+  }
+
+  provider_t& provider = providers [providerCount++];
+  provider.functionCode = functionCode;
+  provider.address = address;
+  provider.count = count;
+  provider.function = function;
+  provider.context = context;
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Calls the providers of the registers a request reads. Each provider whose
+ * range overlaps the request is called once, with the overlapping part. The provider
+ * writes to a copy of the values without holding the lock of the table, so it can call
+ * writeInputRegister() or writeHoldingRegister(), and a slow provider does not keep the
+ * other threads waiting. The copy is written to the map under the lock afterwards.
+ * 
+ * @param functionCode The read function code of the table.
+ * @param address The first address of the request.
+ * @param count The number of registers of the request.
+ * @param values The values of the request in the register map.
+ */
+void CSE_ModbusRTU_Server:: callProviders (uint8_t functionCode, uint16_t address, uint16_t count, uint16_t* values) {
+  uint32_t end = (uint32_t) address + count; // One past the last address
+
+  for (uint8_t i = 0; i < providerCount; i++) {
+    provider_t& provider = providers [i];
+
+    if (provider.functionCode != functionCode) {
+      continue;
+    }
 
-  // Write the specified input registers
-  for (uint16_t i = 0; i < count; i++) {
-    if (writeInputRegister (address + i, value) == -1) { // Check if any of the writes fail
-      result = -1; // If so, set the result to failure
+    uint32_t providerEnd = (uint32_t) provider.address + provider.count;
+    uint32_t first = (provider.address > address) ? provider.address : address;
+    uint32_t last = (providerEnd < end) ? providerEnd : end; // One past the last address
+
+    if (first < last) {
+      CSE_ModbusRTU_SeqLock& lock = (functionCode == MODBUS_FC_READ_INPUT_REGISTERS) ? inputRegisterLock : holdingRegisterLock;
+      uint16_t* target = values + (first - address);
+      uint16_t length = last - first;
+      uint16_t scratch [0x007D]; // A request reads at most 125 registers
+      uint32_t sequence;
+
+      // Start from the current values, so that the provider can leave some of them as they are
+      do {
+        sequence = lock.beginRead();
+        memcpy (scratch, target, length * sizeof (uint16_t));
+      } while (!lock.endRead (sequence));
+
+      provider.function ((uint16_t) first, length, scratch, provider.context);
+
+      lock.beginWrite();
+      memcpy (target, scratch, length * sizeof (uint16_t));
+      lock.endWrite();
     }
   }
-
-  return result;
 }
 
 //======================================================================================//
 /**
- * @brief Checks if a single input register with address is present in the server.
+ * @brief Sets a function that computes the values of a range of input registers. The
+ * function is called only when a request reads any input register of the range, once
+ * per request, before the response is built. So the values don't have to be kept up to
+ * date with writeInputRegister(). The range must be configured, and must not overlap
+ * another input register provider. Up to MODBUS_RTU_PROVIDER_COUNT_MAX providers can be
+ * added for all the tables.
  * 
- * @param address The 16-bit address of the input register to check.
- * @return true - Input register is present in the server.
- * @return false - Input register is not found in the server.
+ * @param address The first address of the range.
+ * @param count The number of input registers.
+ * @param provider The function that computes the values.
+ * @param context Passed to the function. Optional.
+ * @return true - The provider was added.
+ * @return false - The range is not configured or overlaps another provider, or there is no space.
  */
-bool CSE_ModbusRTU_Server:: isInputRegisterPresent (uint16_t address) {
-  // Check if the input register exists
-  for (uint16_t i = 0; i < inputRegisters.size(); i++) {
-    if (inputRegisters [i].address == address) {
-      return true;
-    }
-  }
-
-  return false;
+bool CSE_ModbusRTU_Server:: addInputRegisterProvider (uint16_t address, uint16_t count, registerProvider_t provider, void* context) {
+  return addProvider (MODBUS_FC_READ_INPUT_REGISTERS, address, count, provider, context);
 }
 
 //======================================================================================//
 /**
- * @brief Checks if a range of input registers is present. If any of the input registers
- * is not present in the server, the function returns false.
+ * @brief Sets a function that computes the values of a range of holding registers when
+ * a request reads them. Works the same way as addInputRegisterProvider(). Write
+ * requests don't call the function.
  * 
- * @param address The 16-bit starting address of the input registers.
- * @param count The number of input registers to check.
- * @return true - All input registers are present in the server.
- * @return false - One or more input registers are not present in the server.
+ * @param address The first address of the range.
+ * @param count The number of holding registers.
+ * @param provider The function that computes the values.
+ * @param context Passed to the function. Optional.
+ * @return true - The provider was added.
+ * @return false - The range is not configured or overlaps another provider, or there is no space.
  */
-bool CSE_ModbusRTU_Server:: isInputRegisterPresent (uint16_t address, uint16_t count) {
-  // Check if each of the input registers exist
-  for (uint16_t i = 0; i < count; i++) {
-    if (!isInputRegisterPresent (address + i)) { // If any of the input registers don't exist, return false
-      return false;
-    }
-  }
-
-  return true;
+bool CSE_ModbusRTU_Server:: addHoldingRegisterProvider (uint16_t address, uint16_t count, registerProvider_t provider, void* context) {
+  return addProvider (MODBUS_FC_READ_HOLDING_REGISTERS, address, count, provider, context);
 }
 
 //======================================================================================//
 /**
- * @brief Reads a single holding register on the server. The address is checked for
- * validity.
+ * @brief Removes all the register providers. The values computed last stay in the
+ * register maps.
  * 
- * @param address The 16-bit address of the holding register.
- * @return int - The value of the holding register; -1 if failed.
  */
-int CSE_ModbusRTU_Server:: readHoldingRegister (uint16_t address) {
-  // First check if the holding register exists
-  for (uint16_t i = 0; i < holdingRegisters.size(); i++) {
-    if (holdingRegisters [i].address == address) {
-      return holdingRegisters [i].value;
-    }
-  }
-
-  return -1;
+void CSE_ModbusRTU_Server:: clearProviders() {
+  providerCount = 0;
 }
 
 //======================================================================================//
 /**
- * @brief Writes a single holding register on the server. The address is checked for
- * validity.
+ * @brief Sets a function to be called after the client writes holding registers with
+ * the write single register or write multiple registers requests. It is called once per
+ * request, after the values are written and before the response is sent, so it must
+ * return quickly. The writes of the server itself are not reported. Only one function
+ * can be set. CSE_ModbusRTU_Journal uses it to find the registers to save.
  * 
- * @param address The 16-bit address of the holding register.
- * @param value The 16-bit value to write to the holding register.
- * @return int - 1 if successful; -1 if failed.
+ * @param callback The function. NULL to remove it.
+ * @param context Passed to the function.
  */
-int CSE_ModbusRTU_Server:: writeHoldingRegister (uint16_t address, uint16_t value) {
-  // First check if the holding register exists
-  for (uint16_t i = 0; i < holdingRegisters.size(); i++) {
-    if (holdingRegisters [i].address == address) {
-      holdingRegisters [i].value = value;
-      return 1;
-    }
-  }
-
-  return -1;
+void CSE_ModbusRTU_Server:: setWriteCallback (writeCallback_t callback, void* context) {
+  writeCallback = callback;
+  writeContext = context;
 }
 
 //======================================================================================//
 /**
- * @brief Writes a contiguous series of holding registers on the server. Individual
- * addresses are checked for validity by comparing them with the holding register
- * addresses in the holding register data array. If any of the addresses are invalid,
- * the function stops writing the values and returns -1. If all the addresses are valid,
- * the holding register values are updated and 1 is returned.
+ * @brief Sets the change flags of a range of coils or holding registers. The flags are
+ * set under the change lock, so that a readChanges() from another thread can not clear
+ * them before they are seen.
  * 
- * @param address The 16-bit starting address of the holding registers.
- * @param value The 16-bit value to write to the holding registers.
- * @param count The number of holding registers to write.
- * @return int - 1 if successful; -1 if failed.
+ * @param changes changedCoils or changedHoldingRegisters.
+ * @param address The first address of the range.
+ * @param count The number of addresses.
  */
-int CSE_ModbusRTU_Server:: writeHoldingRegister (uint16_t address, uint16_t value, uint16_t count) {
-  // Check if the holding register addresses go out of bounds
-  if ((address + count) > (holdingRegisters [holdingRegisters.size() - 1].address + 1)) {
-    return -1;
-  }
+void CSE_ModbusRTU_Server:: markChanged (CSE_ModbusRTU_BitMap& changes, uint16_t address, uint16_t count) {
+  changeLock.beginWrite();
+  changes.setBit (address, 1, count);
+  changeLock.endWrite();
+}
 
-  int result = 1; // Assume success
+//======================================================================================//
+/**
+ * @brief Finds and clears the first range of change flags, under the change lock. The
+ * flags are cleared before any new write can set them again, so no write is lost.
+ * 
+ * @param changes changedCoils or changedHoldingRegisters.
+ * @param address The first address of the range is saved here.
+ * @param count The number of addresses in the range is saved here.
+ * @return true - A range was found and cleared.
+ * @return false - No flags were set.
+ */
+bool CSE_ModbusRTU_Server:: readChanges (CSE_ModbusRTU_BitMap& changes, uint16_t& address, uint16_t& count) {
+  changeLock.beginWrite();
+  bool found = changes.findSet (address, count);
 
-  // Write the specified holding registers
-  for (uint16_t i = 0; i < count; i++) {
-    if (writeHoldingRegister (address + i, value) == -1) { // Check if any of the writes fail
-      result = -1; // If so, set the result to failure
-    }
+  if (found) {
+    changes.setBit (address, 0, count);
   }
 
-  return result;
+  changeLock.endWrite();
+  return found;
 }
 
 //======================================================================================//
 /**
- * @brief Checks if a single holding register with address is present in the server.
+ * @brief Reads and clears the first range of coils changed by the client. The coils
+ * written with the write single coil and write multiple coils requests are marked as
+ * changed, even if the value is the same. The writes of the server itself with
+ * writeCoil() are not marked. Call this until it returns false to get all the changed
+ * ranges. The range is found and cleared under the same lock that the server holds to
+ * mark the changes, so this can be called from another thread or core without losing
+ * a write. If there is no register lock (MODBUS_RTU_REGISTER_LOCK_NONE), call this
+ * from the same thread as poll().
  * 
- * @param address The 16-bit address of the holding register to check.
- * @return true - Holding register is present in the server.
- * @return false - Holding register is not found in the server.
+ * @param address The first address of the range is saved here.
+ * @param count The number of coils in the range is saved here.
+ * @return true - A range was found and cleared.
+ * @return false - No coils were changed.
  */
-bool CSE_ModbusRTU_Server:: isHoldingRegisterPresent (uint16_t address) {
-  // Check if the holding register exists
-  for (uint16_t i = 0; i < holdingRegisters.size(); i++) {
-    if (holdingRegisters [i].address == address) {
-      return true;
-    }
-  }
-
-  return false;
+bool CSE_ModbusRTU_Server:: readChangedCoils (uint16_t& address, uint16_t& count) {
+  return readChanges (changedCoils, address, count);
 }
 
 //======================================================================================//
 /**
- * @brief Checks if a range of holding registers is present. If any of the holding registers
- * is not present in the server, the function returns false.
+ * @brief Reads and clears the first range of holding registers changed by the client.
+ * Works the same way as readChangedCoils(), for the write single register and write
+ * multiple registers requests.
  * 
- * @param address The 16-bit starting address of the holding registers.
- * @param count The number of holding registers to check.
- * @return true - All holding registers are present in the server.
- * @return false - One or more holding registers are not present in the server.
+ * @param address The first address of the range is saved here.
+ * @param count The number of holding registers in the range is saved here.
+ * @return true - A range was found and cleared.
+ * @return false - No holding registers were changed.
  */
-bool CSE_ModbusRTU_Server:: isHoldingRegisterPresent (uint16_t address, uint16_t count) {
-  // Check if each of the holding registers exist
-  for (uint16_t i = 0; i < count; i++) {
-    if (!isHoldingRegisterPresent (address + i)) { // If any of the holding registers don't exist, return false
-      return false;
-    }
-  }
+bool CSE_ModbusRTU_Server:: readChangedHoldingRegisters (uint16_t& address, uint16_t& count) {
+  return readChanges (changedHoldingRegisters, address, count);
+}
 
-  return true;
+//======================================================================================//
+/**
+ * @brief Clears the change flags of all the coils and holding registers.
+ * 
+ */
+void CSE_ModbusRTU_Server:: clearChanges() {
+  changeLock.beginWrite();
+  changedCoils.setAll (0);
+  changedHoldingRegisters.setAll (0);
+  changeLock.endWrite();
 }
 
 //======================================================================================//
@@ -2022,6 +3068,10 @@ bool CSE_ModbusRTU_Server:: isHoldingRegisterPresent (uint16_t address, uint16_t
 CSE_ModbusRTU_Client:: CSE_ModbusRTU_Client (CSE_ModbusRTU& rtu, String name) {
   this->rtu = &rtu;
   this->name = name;
+
+  // Set the default request and response ADU types
+  request.setType (CSE_ModbusRTU_ADU::aduType_t:: REQUEST);
+  response.setType (CSE_ModbusRTU_ADU::aduType_t:: RESPONSE);
 }
 
 //======================================================================================//
@@ -2065,10 +3115,17 @@ bool CSE_ModbusRTU_Client:: begin() {
  * Receive mode will be enabled during reading the response.
  * Receive mode is disabled after receiving the response, or if the timeout is reached.
  * 
+ * The length of the response is predicted from the function code and the byte count,
+ * and the function returns as soon as the complete response with a valid CRC has been
+ * received. It does not wait for the timeout or the inter-frame delay.
+ * 
  * @return int - ADU length if successful; -1 if failed.
  */
 int CSE_ModbusRTU_Client:: receive() {
-  int result = rtu->receive (response, receiveTimeout);
+  // The response type may have been changed to EXCEPTION by the previous transaction.
+  response.setType (CSE_ModbusRTU_ADU::aduType_t:: RESPONSE);
+
+  int result = rtu->receive (response, receiveTimeout, true);
   rtu->disableReceive(); // Disable receiving after receiving the response
   return result;
 }
@@ -2083,6 +3140,49 @@ int CSE_ModbusRTU_Client:: send() {
   return rtu->send (request);
 }
 
+//======================================================================================//
+/**
+ * @brief Sends the request ADU as it is, and receives the response. Use this for
+ * function codes that have no dedicated function, or to forward requests built
+ * elsewhere. The request must be complete, including the device address and the CRC.
+ * The response is checked for the device address and the function code of the request.
+ * No response is expected for broadcast requests (device address 0x00).
+ * 
+ * @return int - Function code if successful; Exception code if exception; -1 if failed.
+ */
+int CSE_ModbusRTU_Client:: transfer() {
+  uint8_t deviceAddress = request.getDeviceAddress();
+  uint8_t functionCode = request.getFunctionCode();
+
+  if (send() < 0) {
+    return -1;
+  }
+
+  // A broadcast request has no response
+  if (deviceAddress == 0x00) {
+    return functionCode;
+  }
+
+  if (receive() < 0) {
+    return -1;
+  }
+
+  if (response.getDeviceAddress() != deviceAddress) {
+    return -1;
+  }
+
+  if (response.getFunctionCode() == functionCode) {
+    response.setType (CSE_ModbusRTU_ADU::aduType_t::RESPONSE);
+    return functionCode;
+  }
+  else if (response.getFunctionCode() == (functionCode | 0x80)) { // If the server responded with an exception
+    response.setType (CSE_ModbusRTU_ADU::aduType_t::EXCEPTION);
+    return response.getExceptionCode();
+  }
+
+  return -1;
+}
+
 //======================================================================================//
 /**
  * @brief Read a single coil from the server. This function form the request message, sends
@@ -2401,9 +3501,10 @@ int CSE_ModbusRTU_Client:: readInputRegister (uint16_t address, uint8_t count, u
   if (response.getFunctionCode() == MODBUS_FC_READ_INPUT_REGISTERS) {
     response.setType (CSE_ModbusRTU_ADU::aduType_t::RESPONSE);
 
-    // Now we need to unpack the input registers from the response ADU
-    for (uint8_t i = 0; i < count; i++) {
-      *(inputRegisters + i) = response.getWord ((MODBUS_RTU_ADU_DATA_INDEX + 1) + (i * 2));  // Get each input register data word from the response ADU
+    // Now we need to unpack the input registers from the response ADU in one pass.
+    // If the response is too short, the registers are not changed.
+    if (!response.getWords (MODBUS_RTU_ADU_DATA_INDEX + 1, inputRegisters, count)) {
+      return -1;
     }
 
     // Finally return the function code
@@ -2457,9 +3558,10 @@ int CSE_ModbusRTU_Client:: readHoldingRegister (uint16_t address, uint8_t count,
   if (response.getFunctionCode() == MODBUS_FC_READ_HOLDING_REGISTERS) {
     response.setType (CSE_ModbusRTU_ADU::aduType_t::RESPONSE);
 
-    // Now we need to unpack the holding registers from the response ADU
-    for (uint8_t i = 0; i < count; i++) {
-      *(holdingRegisters + i) = response.getWord ((MODBUS_RTU_ADU_DATA_INDEX + 1) + (i * 2));  // Get each holding register data word from the response ADU
+    // Now we need to unpack the holding registers from the response ADU in one pass.
+    // If the response is too short, the registers are not changed.
+    if (!response.getWords (MODBUS_RTU_ADU_DATA_INDEX + 1, holdingRegisters, count)) {
+      return -1;
     }
 
     // Finally return the function code
@@ -2541,9 +3643,10 @@ int CSE_ModbusRTU_Client:: writeHoldingRegister (uint16_t address, uint16_t coun
   request.add ((uint16_t) count);  // Set the 16-bit quantity of holding registers to write
   request.add ((uint8_t) (count * 2));  // Set the byte count
 
-  // Write the requested number of register values to the request ADU
-  for (int i = 0; i < count; i++) {
-    request.add (*(registerValues + i));
+  // Write the requested number of register values to the request ADU in one pass.
+  // The maximum in a request is 0x007B (123), which also fits the ADU.
+  if ((count > 0x007B) || !request.add (registerValues, (uint8_t) count)) {
+    return -1;
   }
 
   request.setCRC(); // Set the CRC
@@ -2582,4 +3685,266 @@ int CSE_ModbusRTU_Client:: writeHoldingRegister (uint16_t address, uint16_t coun
 }
 
 //======================================================================================//
+/**
+ * @brief Constructor for the CSE_ModbusRTU_Sniffer class.
+ * 
+ * @param rtu The parent CSE_ModbusRTU object.
+ * @param name The name of the sniffer.
+ */
+CSE_ModbusRTU_Sniffer:: CSE_ModbusRTU_Sniffer (CSE_ModbusRTU& rtu, String name) {
+  this->rtu = &rtu;
+  this->name = name;
+
+  queueHead = 0;
+  queueCount = 0;
+  callback = NULL;
+
+  requestPending = false;
+  requestAddress = 0;
+  requestFunctionCode = 0;
+  requestSequence = 0;
+  requestStartTime = 0;
+  requestEndTime = 0;
+
+  responseTimeout = MODBUS_RTU_SNIFFER_RESPONSE_TIMEOUT;
+
+  frameCount = 0;
+  errorCount = 0;
+  droppedFrameCount = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Puts the serial port in listen-only mode. DE is deasserted and RE is asserted.
+ * The sniffer never asserts DE after this. Without a receive buffer, the bytes are timed
+ * when poll() reads them, so back-to-back frames are only split if poll() runs within
+ * t1.5 of every byte. Set a receive buffer with CSE_ModbusRTU::setReceiveBuffer() for
+ * busy buses.
+ * 
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU_Sniffer:: begin() {
+  rtu->enableReceive (true);
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Captures the frames on the bus. This function never blocks. It reads the bytes
+ * that are already available and completes all frames that have ended. Call it as often
+ * as possible. For continuous traffic at high baud rates, use a receive buffer (see
+ * CSE_ModbusRTU::setReceiveBuffer()), so that the frame timing is taken from the arrival
+ * times of the bytes.
+ * 
+ * @return int - The number of frames captured in this call.
+ */
+int CSE_ModbusRTU_Sniffer:: poll() {
+  int frames = 0;
+
+  while (true) {
+    int result = rtu->receiveFrame (frame.adu);
+
+    if (result == 0) {
+      break;  // No more complete frames
+    }
+
+    frame.status = result;
+    frame.sequence = frameCount++;
+    frame.startTime = rtu->getFrameStartTime();
+    frame.endTime = rtu->getFrameEndTime();
+    frame.roundTripTime = 0;
+    frame.requestSequence = 0;
+
+    if (result < 0) {
+      errorCount++;
+      frame.adu.setType (CSE_ModbusRTU_ADU::aduType_t:: NONE);
+    }
+    else {
+      classifyFrame();
+    }
+
+    deliverFrame();
+    frames++;
+  }
+
+  return frames;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the type of a valid frame. A frame is a response if it comes from the
+ * address of the pending request, has the same function code, arrives within the
+ * response timeout, and has the length of a response. Otherwise it is a request if it
+ * has the length of a request. Frames with unknown function codes are classified by the
+ * address and function code only.
+ * 
+ */
+void CSE_ModbusRTU_Sniffer:: classifyFrame() {
+  CSE_ModbusRTU_ADU& adu = frame.adu;
+  uint16_t length = adu.getLength();
+  uint8_t functionCode = adu.getFunctionCode();
+
+  if (requestPending && ((frame.startTime - requestEndTime) > (responseTimeout * 1000UL))) {
+    requestPending = false; // The request was not answered
+  }
+
+  if (requestPending && (adu.getDeviceAddress() == requestAddress) && ((functionCode & 0x7F) == requestFunctionCode)) {
+    adu.setType (CSE_ModbusRTU_ADU::aduType_t:: RESPONSE);
+    uint16_t expectedLength = adu.getExpectedLength();
+
+    if ((expectedLength == 0) || (expectedLength == length)) {
+      if (functionCode >= 0x80) {
+        adu.setType (CSE_ModbusRTU_ADU::aduType_t:: EXCEPTION);
+      }
+
+      frame.roundTripTime = frame.endTime - requestStartTime;
+      frame.requestSequence = requestSequence;
+      requestPending = false;
+      return;
+    }
+  }
+
+  adu.setType (CSE_ModbusRTU_ADU::aduType_t:: REQUEST);
+  uint16_t expectedLength = adu.getExpectedLength();
+
+  if ((functionCode >= 0x80) || ((expectedLength != 0) && (expectedLength != length))) {
+    adu.setType (CSE_ModbusRTU_ADU::aduType_t:: NONE); // Not a request we can recognize
+    return;
+  }
+
+  // Broadcast requests (address 0) are not answered.
+  requestPending = (adu.getDeviceAddress() != 0);
+  requestAddress = adu.getDeviceAddress();
+  requestFunctionCode = functionCode;
+  requestSequence = frame.sequence;
+  requestStartTime = frame.startTime;
+  requestEndTime = frame.endTime;
+}
+
+//======================================================================================//
+/**
+ * @brief Passes the captured frame to the callback function if one is set. Otherwise
+ * the frame is copied to the queue. If the queue is full, the frame is dropped.
+ * 
+ */
+void CSE_ModbusRTU_Sniffer:: deliverFrame() {
+  if (callback != NULL) {
+    callback (frame);
+    return;
+  }
+
+  if (queueCount >= MODBUS_RTU_SNIFFER_QUEUE_SIZE) {
+    droppedFrameCount++;
+    return;
+  }
+
+  queue [queueHead] = frame;
+  queueHead = (queueHead + 1) % MODBUS_RTU_SNIFFER_QUEUE_SIZE;
+  queueCount++;
+}
 
+//======================================================================================//
+/**
+ * @brief Returns the name of the sniffer.
+ * 
+ * @return String - Name of the sniffer.
+ */
+String CSE_ModbusRTU_Sniffer:: getName() {
+  return name;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets a function that is called with every captured frame. The frames are then
+ * not queued. The function is called from poll(). Pass NULL to use the queue again.
+ * 
+ * @param callback The callback function, or NULL.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU_Sniffer:: setCallback (frameCallback_t callback) {
+  this->callback = callback;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the time a request waits for its response. A frame that arrives later is
+ * not paired with the request.
+ * 
+ * @param timeout The response timeout in milliseconds.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU_Sniffer:: setResponseTimeout (uint32_t timeout) {
+  if (timeout == 0) {
+    return false;
+  }
+
+  responseTimeout = timeout;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of frames in the queue.
+ * 
+ * @return int - Number of frames available to read.
+ */
+int CSE_ModbusRTU_Sniffer:: available() {
+  return queueCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads the oldest frame from the queue and removes it.
+ * 
+ * @param frame The frame is copied here.
+ * @return true - A frame was read.
+ * @return false - The queue is empty.
+ */
+bool CSE_ModbusRTU_Sniffer:: readFrame (frame_t& frame) {
+  if (queueCount == 0) {
+    return false;
+  }
+
+  uint8_t tail = (queueHead + MODBUS_RTU_SNIFFER_QUEUE_SIZE - queueCount) % MODBUS_RTU_SNIFFER_QUEUE_SIZE;
+  frame = queue [tail];
+  queueCount--;
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of frames captured since the sniffer was created. This
+ * includes frames with errors.
+ * 
+ * @return uint32_t - Number of frames.
+ */
+uint32_t CSE_ModbusRTU_Sniffer:: getFrameCount() {
+  return frameCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of frames with CRC or framing errors.
+ * 
+ * @return uint32_t - Number of frames with errors.
+ */
+uint32_t CSE_ModbusRTU_Sniffer:: getErrorCount() {
+  return errorCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of frames dropped because the queue was full.
+ * 
+ * @return uint32_t - Number of frames dropped.
+ */
+uint32_t CSE_ModbusRTU_Sniffer:: getDroppedFrameCount() {
+  return droppedFrameCount;
+}
+
+//======================================================================================//
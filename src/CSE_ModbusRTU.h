@@ -22,12 +22,31 @@
   #include <vector>
 #endif
 
-// You can define the type of serial port to use for the Modbus RTU node here.
-#define   MODBUS_RTU_SERIAL_PORT_OBJECT   RS485Class
+#include "CSE_ModbusRTU_CRC.h"
+#include "CSE_ModbusRTU_Codec.h"
+#include "CSE_ModbusRTU_RingBuffer.h"
+#include "CSE_ModbusRTU_RegisterMap.h"
+#include "CSE_ModbusRTU_StaticMap.h"
+#include "CSE_ModbusRTU_SeqLock.h"
+
+// You can define the type of serial port to use for the Modbus RTU node here. On hosts
+// without the Arduino core (Linux, macOS), the CSE_ModbusRTU_HostSerial interface is
+// used, which is implemented by CSE_ModbusRTU_PosixSerial and CSE_ModbusRTU_LoopbackPort.
+#ifndef MODBUS_RTU_SERIAL_PORT_OBJECT
+  #if defined(ARDUINO)
+    #define   MODBUS_RTU_SERIAL_PORT_OBJECT   RS485Class
+  #else
+    #define   MODBUS_RTU_SERIAL_PORT_OBJECT   CSE_ModbusRTU_HostSerial
+  #endif
+#endif
 
-// Make a library selection based on the type of serial port selected.
-#if (MODBUS_RTU_SERIAL_PORT_OBJECT == RS485Class)
+// Make a library selection based on the platform.
+#if defined(ARDUINO)
   #include <CSE_ArduinoRS485.h>
+#else
+  #include "CSE_ModbusRTU_Host.h"
+  #include "CSE_ModbusRTU_PosixSerial.h"
+  #include "CSE_ModbusRTU_Loopback.h"
 #endif
 
 //======================================================================================//
@@ -42,10 +61,58 @@
 #define   MODBUS_RTU_ADU_EXCEPTION_CODE_INDEX           2U
 #define   MODBUS_RTU_ADU_DATA_LENGTH_MAX                252U  // Doesn't include the function code
 #define   MODBUS_RTU_ADU_DATA_INDEX                     2U
-#define   MODBUS_RTU_COIL_COUNT_MAX                     100U
-#define   MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX           100U
-#define   MODBUS_RTU_INPUT_REGISTER_COUNT_MAX           100U
-#define   MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX         100U
+
+// Server data tables
+// The maximum number of addresses in each table of a server. By default a table can
+// cover the whole address space. Only the configured addresses take memory.
+#ifndef MODBUS_RTU_COIL_COUNT_MAX
+  #define MODBUS_RTU_COIL_COUNT_MAX                     65536UL
+#endif
+
+#ifndef MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX
+  #define MODBUS_RTU_DISCRETE_INPUT_COUNT_MAX           65536UL
+#endif
+
+#ifndef MODBUS_RTU_INPUT_REGISTER_COUNT_MAX
+  #define MODBUS_RTU_INPUT_REGISTER_COUNT_MAX           65536UL
+#endif
+
+#ifndef MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX
+  #define MODBUS_RTU_HOLDING_REGISTER_COUNT_MAX         65536UL
+#endif
+
+// The maximum number of register providers of a server. See addInputRegisterProvider().
+#ifndef MODBUS_RTU_PROVIDER_COUNT_MAX
+  #if defined(ARDUINO_ARCH_AVR)
+    #define MODBUS_RTU_PROVIDER_COUNT_MAX               4U
+  #else
+    #define MODBUS_RTU_PROVIDER_COUNT_MAX               16U
+  #endif
+#endif
+
+// Modbus RTU timing
+#define   MODBUS_RTU_DEFAULT_BAUDRATE                   9600U // Used until setBaudRate() is called
+#define   MODBUS_RTU_CHARACTER_BITS                     11U   // Start + 8 data + parity/stop + stop. Default of setCharacterBits().
+#define   MODBUS_RTU_FIXED_TIMING_BAUDRATE              19200U  // Above this, fixed timings are used
+#define   MODBUS_RTU_FIXED_INTER_CHAR_TIMEOUT           750U  // t1.5 in microseconds above 19200 baud
+#define   MODBUS_RTU_FIXED_INTER_FRAME_DELAY            1750U // t3.5 in microseconds above 19200 baud
+
+// Error codes returned by CSE_ModbusRTU::receive()
+#define   MODBUS_RTU_RECEIVE_ERROR                      (-1)  // Timeout, CRC error or empty frame
+#define   MODBUS_RTU_RECEIVE_FRAMING_ERROR              (-2)  // Silence longer than t1.5 inside a frame, or frame too long
+
+// Sniffer
+// The number of frames the sniffer can queue until they are read with readFrame().
+// Each queued frame takes about 280 bytes of RAM.
+#ifndef MODBUS_RTU_SNIFFER_QUEUE_SIZE
+  #if defined(ARDUINO_ARCH_AVR)
+    #define MODBUS_RTU_SNIFFER_QUEUE_SIZE               1U
+  #else
+    #define MODBUS_RTU_SNIFFER_QUEUE_SIZE               8U
+  #endif
+#endif
+
+#define   MODBUS_RTU_SNIFFER_RESPONSE_TIMEOUT           1000U // Time a request waits for its response in milliseconds
 
 // Modbus function codes
 #define   MODBUS_FC_READ_COILS                          0x01U
@@ -81,7 +148,11 @@
 #define   ENABLE_DEBUG             1
 
 // Change the serial port used for debug messages here.
-#define   MODBUS_DEBUG_SERIAL      Serial
+#if defined(ARDUINO)
+  #define   MODBUS_DEBUG_SERIAL      Serial
+#else
+  #define   MODBUS_DEBUG_SERIAL      modbusHostSerial
+#endif
 
 #ifdef ENABLE_DEBUG
   #define DEBUG_PRINT_HELPER(condition, ...) \
@@ -115,6 +186,8 @@ class CSE_ModbusRTU_ADU;
 class CSE_ModbusRTU;
 class CSE_ModbusRTU_Server;
 class CSE_ModbusRTU_Client;
+class CSE_ModbusRTU_Sniffer;
+class CSE_ModbusRTU_Gateway;
 class CSE_ModbusRTU_Debug;
 
 //======================================================================================//
@@ -141,6 +214,8 @@ class CSE_ModbusRTU_Debug {
     friend class CSE_ModbusRTU;
     friend class CSE_ModbusRTU_Server;
     friend class CSE_ModbusRTU_Client;
+    friend class CSE_ModbusRTU_Sniffer;
+    friend class CSE_ModbusRTU_Gateway;
 
   private:
     // Variable to track debug state
@@ -155,7 +230,15 @@ class CSE_ModbusRTU_Debug {
 class CSE_ModbusRTU_ADU {
   private:
     uint8_t aduBuffer [MODBUS_RTU_ADU_LENGTH_MAX];  // The ADU buffer for transmitting
-    uint8_t aduLength;  // The number of valid bytes in the receive ADU buffer
+    uint16_t aduLength;  // The number of valid bytes in the receive ADU buffer
+
+    // A running CRC is maintained while the ADU is filled byte by byte.
+    // crcValue is the CRC of the first crcLength bytes of the buffer.
+    uint16_t crcValue;  // The running CRC
+    uint16_t crcLength; // The number of bytes covered by the running CRC
+
+    uint16_t updateCRC (uint16_t length); // Bring the running CRC up to the specified length
+    void invalidateCRC (uint16_t index); // Discard the running CRC if the byte at index is changed
 
   public:
     enum aduType_t {
@@ -168,7 +251,7 @@ class CSE_ModbusRTU_ADU {
     CSE_ModbusRTU_ADU();
 
     bool resetLength(); // Reset the ADU length to 0
-    uint8_t getLength(); // Get the ADU length
+    uint16_t getLength(); // Get the ADU length
 
     bool clear(); // Clear the ADU buffer by setting all bytes to 0x00
     bool clear (uint8_t index); // Clear a byte in the ADU buffer by setting it to 0x00
@@ -177,7 +260,8 @@ class CSE_ModbusRTU_ADU {
     bool add (uint8_t byte); // Add a byte to the ADU buffer
     bool add (uint8_t* buffer, uint8_t length); // Add a buffer of bytes to the ADU buffer
     bool add (uint16_t word); // Add a word to the ADU buffer
-    bool add (uint16_t* buffer, uint8_t length); // Add a buffer of words to the ADU buffer
+    bool add (const uint16_t* buffer, uint8_t length); // Add a buffer of words to the ADU buffer
+    uint8_t* reserve (uint8_t length); // Reserve bytes at the end of the ADU buffer to be written in place
 
     bool checkCRC(); // Check the CRC of the ADU buffer
     uint16_t calculateCRC (bool isCRCSet = false); // Calculate the CRC of the ADU
@@ -197,14 +281,104 @@ class CSE_ModbusRTU_ADU {
     uint16_t getQuantity(); // Get the quantity (register count) of the ADU
     uint16_t getCRC(); // Get the CRC of the ADU
     uint8_t getDataLength(); // Get the data length of the ADU
+    uint16_t getExpectedLength(); // Predict the full ADU length from the received header
     int getType(); // Get the type of the ADU
 
+    const uint8_t* getBuffer(); // Get a pointer to the ADU buffer
     uint8_t getByte (uint8_t index); // Get a byte from the ADU buffer
     uint16_t getWord (uint8_t index); // Get a word from the ADU buffer
+    bool getWords (uint8_t index, uint16_t* buffer, uint8_t count); // Get consecutive words from the ADU buffer
 
     void print(); // Print the ADU buffer to the serial port
 };
 
+//======================================================================================//
+/**
+ * @brief The interface between CSE_ModbusRTU and a serial port. The functions here are
+ * called once per frame, not once per byte. The bytes are read by receiveFrame(), which
+ * is implemented by the adapter templates below with the exact type of the port. So the
+ * available() and read() calls of the port are resolved at compile time, and can be
+ * inlined into the receive loop.
+ * 
+ * You normally don't implement this class yourself. Use CSE_ModbusRTU_Port for ports
+ * with RS-485 direction control (RS485Class, CSE_ModbusRTU_HostSerial), or
+ * CSE_ModbusRTU_StreamPort for raw serial ports (HardwareSerial, SoftwareSerial).
+ * 
+ */
+class CSE_ModbusRTU_Transport {
+  protected:
+    ~CSE_ModbusRTU_Transport() {}
+
+  public:
+    virtual int available() = 0;  // Number of bytes that can be read
+    virtual int receiveFrame (CSE_ModbusRTU& rtu, CSE_ModbusRTU_ADU& adu, bool completeOnLength) = 0; // Read the available bytes into a frame
+    virtual size_t write (const uint8_t* buffer, size_t size) = 0;  // Write a buffer
+    virtual void flush() = 0; // Wait until all the written bytes are sent
+
+    virtual void beginTransmission() {} // Enable the driver before writing
+    virtual void endTransmission() {} // Disable the driver after writing
+    virtual bool assertDE() { return false; }
+    virtual bool deassertDE() { return false; }
+    virtual bool assertRE() { return false; }
+    virtual bool deassertRE() { return false; }
+    virtual void setDelays (int preDelay, int postDelay) { (void) preDelay; (void) postDelay; }
+};
+
+//======================================================================================//
+/**
+ * @brief The common part of the transport adapters. Holds a pointer to a port of the
+ * type port_t. The port must have available(), read(), write (buffer, size) and flush().
+ * 
+ */
+template <typename port_t> class CSE_ModbusRTU_PortBase : public CSE_ModbusRTU_Transport {
+  protected:
+    port_t* port;
+
+  public:
+    CSE_ModbusRTU_PortBase (port_t* port = NULL) : port (port) {}
+
+    void setPort (port_t* port) { this->port = port; }
+    port_t* getPort() { return port; }
+
+    int available() { return port->available(); }
+    int receiveFrame (CSE_ModbusRTU& rtu, CSE_ModbusRTU_ADU& adu, bool completeOnLength); // Defined after CSE_ModbusRTU
+    size_t write (const uint8_t* buffer, size_t size) { return port->write (buffer, size); }
+    void flush() { port->flush(); }
+};
+
+//======================================================================================//
+/**
+ * @brief Transport adapter for RS-485 ports with direction control, like RS485Class of
+ * CSE_ArduinoRS485, or the CSE_ModbusRTU_HostSerial backends. The port must also have
+ * beginTransmission(), endTransmission(), assertDE(), deassertDE(), assertRE(),
+ * deassertRE() and setDelays().
+ * 
+ */
+template <typename port_t> class CSE_ModbusRTU_Port : public CSE_ModbusRTU_PortBase <port_t> {
+  public:
+    CSE_ModbusRTU_Port (port_t* port = NULL) : CSE_ModbusRTU_PortBase <port_t> (port) {}
+
+    void beginTransmission() { this->port->beginTransmission(); }
+    void endTransmission() { this->port->endTransmission(); }
+    bool assertDE() { return this->port->assertDE(); }
+    bool deassertDE() { return this->port->deassertDE(); }
+    bool assertRE() { return this->port->assertRE(); }
+    bool deassertRE() { return this->port->deassertRE(); }
+    void setDelays (int preDelay, int postDelay) { this->port->setDelays (preDelay, postDelay); }
+};
+
+//======================================================================================//
+/**
+ * @brief Transport adapter for raw serial ports without direction control, like
+ * HardwareSerial or SoftwareSerial. Use it with transceivers that switch the direction
+ * automatically, or with RS-232 and TTL links.
+ * 
+ */
+template <typename port_t> class CSE_ModbusRTU_StreamPort : public CSE_ModbusRTU_PortBase <port_t> {
+  public:
+    CSE_ModbusRTU_StreamPort (port_t* port = NULL) : CSE_ModbusRTU_PortBase <port_t> (port) {}
+};
+
 //======================================================================================//
 /**
  * @brief Generic Modbus RTU class. Implements common functions and data structures
@@ -221,15 +395,76 @@ class CSE_ModbusRTU {
 
     String name; // The name of the Modbus RTU object
 
+    uint32_t baudRate; // The baud rate of the serial port. Used for calculating the frame timing.
+    uint32_t interCharTimeout; // t1.5 in microseconds. 0 disables the check.
+    uint32_t interFrameDelay; // t3.5 in microseconds
+    uint8_t characterBits; // Bits per character on the line, including start, parity and stop bits
+
+    // Turnaround policy
+    uint32_t responseDelay; // Minimum time from the end of a received frame to the start of the reply in microseconds
+    uint32_t deLeadTime; // Time from asserting DE to the first byte in microseconds
+    uint32_t frameEndTime; // The time the last valid request ended in microseconds
+    bool turnaroundPending; // A valid request was received and no frame was sent after it
+    uint32_t lastTurnaroundTime; // Measured turnaround of the last reply in microseconds
+    uint32_t txStartTime; // The time the frame being sent was written to the port in microseconds
+    uint32_t txTime; // The time the frame being sent needs on the line in microseconds
+    uint32_t txEndTime; // The time the last frame sent left the port in microseconds
+    bool txPending; // A frame was started with sendFrame() and DE is not released yet
+
+    // State of the frame receiver
+    bool frameInProgress; // A frame has started but is not complete yet
+    bool framingError; // The current frame has a framing error
+    uint32_t frameStartTime; // The time the first byte of the current frame was read in microseconds
+    uint32_t lastByteTime; // The time the last byte was read in microseconds
+    uint32_t idleTime; // The time the port was last found empty after the last byte in microseconds
+
+    CSE_ModbusRTU_RingBuffer* receiveBuffer; // Optional buffer filled by an interrupt or callback
+
+    CSE_ModbusRTU_Transport* transport; // The transport used for all port access
+    CSE_ModbusRTU_Port <MODBUS_RTU_SERIAL_PORT_OBJECT> defaultTransport; // Wraps the port given to the legacy constructor
+
+    int completeFrame (CSE_ModbusRTU_ADU& adu); // Validate a completed frame
+
+    template <typename port_t> friend class CSE_ModbusRTU_PortBase;
+    template <typename port_t> bool readByte (port_t& port, uint8_t& byte, uint32_t& timestamp); // Read a byte from the receive buffer or the serial port
+    template <typename port_t> int receiveFrameFrom (port_t& port, CSE_ModbusRTU_ADU& adu, bool completeOnLength); // The receive loop for a port type
+
   public:
     int enableReceive (bool deassertDE = false); // Enable receiving Modbus RTU packets. Asserts RE. DE is optional.
     int disableReceive(); // Disable receiving Modbus RTU packets. De-asserts RE. DE is not affected.
-    int receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout = 100);  // Receive a custom Modbus RTU packet
+    int receive (CSE_ModbusRTU_ADU& adu, uint32_t timeout = 100, bool completeOnLength = false);  // Receive a custom Modbus RTU packet
+    int receiveFrame (CSE_ModbusRTU_ADU& adu, bool completeOnLength = false); // Receive without blocking
+    bool isReceiving(); // Check if a frame is being received
+    uint32_t getFrameStartTime(); // Get the arrival time of the first byte of the last frame
+    uint32_t getFrameEndTime(); // Get the arrival time of the last byte of the last frame
+    int available(); // Number of received bytes waiting to be read
+    bool setReceiveBuffer (CSE_ModbusRTU_RingBuffer* buffer); // Receive from a ring buffer instead of the serial port
+    CSE_ModbusRTU_RingBuffer* getReceiveBuffer(); // Get the ring buffer in use
     int send (CSE_ModbusRTU_ADU& adu); // Send a custom Modbus RTU packet
+    int sendFrame (CSE_ModbusRTU_ADU& adu); // Start sending without blocking
+    bool isSending(); // Check if a frame is being sent. Releases DE at the end of the frame.
+    bool isReadyToSend(); // Check if sendFrame() can send without waiting
+
+    bool setBaudRate (uint32_t baudRate); // Set the baud rate and calculate t1.5 and t3.5
+    uint32_t getBaudRate(); // Get the baud rate used for timing
+    bool setInterCharTimeout (uint32_t timeout); // Override t1.5 in microseconds
+    uint32_t getInterCharTimeout(); // Get t1.5 in microseconds
+    bool setInterFrameDelay (uint32_t delayTime); // Override t3.5 in microseconds
+    uint32_t getInterFrameDelay(); // Get t3.5 in microseconds
+    bool setCharacterBits (uint8_t bits); // Set the number of bits per character and recalculate the timing
+    uint8_t getCharacterBits(); // Get the number of bits per character
+
+    bool setResponseDelay (uint32_t delayTime); // Set the minimum time before replying to a frame in microseconds
+    uint32_t getResponseDelay(); // Get the minimum response delay in microseconds
+    bool setDELeadTime (uint32_t leadTime); // Set the time from asserting DE to the first byte in microseconds
+    uint32_t getDELeadTime(); // Get the DE lead time in microseconds
+    uint32_t getLastTurnaroundTime(); // Get the measured turnaround of the last reply in microseconds
 
     /**
-     * @brief This typedef defines the serial port object used for Modbus RTU communication.
-     * It can be any object that implements the following methods:
+     * @brief This typedef defines the serial port object used by the legacy constructor.
+     * To use any other port type, create a CSE_ModbusRTU_Port or CSE_ModbusRTU_StreamPort
+     * for it and use the transport constructor instead. The default type can be any
+     * object that implements the following methods:
      * - begin (baudrate)
      * - available ()
      * - read ()
@@ -258,42 +493,124 @@ class CSE_ModbusRTU {
     CSE_ModbusRTU_Client* client; // Pointer to the client object connected to this RTU
 
     CSE_ModbusRTU (serialPort_t serialPort, uint8_t deviceAddress, String name);
+    CSE_ModbusRTU (CSE_ModbusRTU_Transport& transport, uint8_t deviceAddress, String name);
     String getName();
 };
 
 //======================================================================================//
 /**
- * @brief A custom type for storing Modbus RTU bits. It can be used for coils and
- * discrete inputs.
+ * @brief Reads the next received byte and its arrival time. The byte is taken from the
+ * receive buffer if one is set. Otherwise it is read from the serial port and the
+ * current time is used as the arrival time.
  * 
+ * @param port The serial port.
+ * @param byte The byte is saved here.
+ * @param timestamp The arrival time in microseconds is saved here.
+ * @return true - A byte was read.
+ * @return false - No byte is available.
  */
-class modbus_bit_t {
-  public:
-    uint16_t address;
-    uint8_t value;
+template <typename port_t> inline bool CSE_ModbusRTU:: readByte (port_t& port, uint8_t& byte, uint32_t& timestamp) {
+  if (receiveBuffer != NULL) {
+    return receiveBuffer->pop (byte, timestamp);
+  }
 
-    modbus_bit_t (uint16_t address, uint8_t value) {
-      this->address = address;
-      this->value = value;
-    }
-};
+  if (port.available() <= 0) {
+    return false;
+  }
+
+  byte = (uint8_t) port.read();
+  timestamp = micros();
+  return true;
+}
 
 //======================================================================================//
 /**
- * @brief A custom type for storing Modbus RTU registers. It can be used for holding
- * registers and input registers.
+ * @brief The receive loop of receiveFrame(). It is a template on the type of the port,
+ * so that the port functions are called without going through a pointer to a base
+ * class.
  * 
+ * @param port The serial port.
+ * @param adu The ADU object to save the incoming data.
+ * @param completeOnLength If true, the frame is complete as soon as the predicted length
+ * is received.
+ * @return int - See receiveFrame().
  */
-class modbus_register_t {
-  public:
-    uint16_t address;
-    uint16_t value;
+template <typename port_t> int CSE_ModbusRTU:: receiveFrameFrom (port_t& port, CSE_ModbusRTU_ADU& adu, bool completeOnLength) {
+  uint8_t byte;
+  uint32_t byteTime;
+
+  while (true) {
+    // The timestamps from a receive buffer are the exact arrival times. So a gap of t3.5
+    // ends the frame even if bytes of the next frame are already in the buffer.
+    if ((receiveBuffer != NULL) && frameInProgress) {
+      if (receiveBuffer->peek (byte, byteTime) && ((byteTime - lastByteTime) >= interFrameDelay)) {
+        frameInProgress = false;
+        return completeFrame (adu);
+      }
+    }
+
+    if (!readByte (port, byte, byteTime)) {
+      if (receiveBuffer == NULL) {
+        idleTime = micros();
+      }
 
-    modbus_register_t (uint16_t address, uint16_t value) {
-      this->address = address;
-      this->value = value;
+      break;
     }
-};
+
+    if (!frameInProgress) {
+      // This is the first byte of a new frame.
+      adu.resetLength();
+      frameInProgress = true;
+      framingError = false;
+      frameStartTime = byteTime;
+    }
+    else if ((interCharTimeout > 0) && ((((receiveBuffer != NULL) ? byteTime : idleTime) - lastByteTime) > interCharTimeout)) {
+      // A silence longer than t1.5 between two bytes of a frame is not allowed. Without a
+      // receive buffer, a byte is only known to have arrived after the port was last
+      // found empty. So the silence is measured up to that time, and a slow loop between
+      // two calls does not make a correctly timed frame a framing error.
+      framingError = true;
+    }
+
+    // Keep reading until the end of the frame even if the buffer is full.
+    if (!adu.add (byte)) {
+      framingError = true;
+    }
+
+    lastByteTime = byteTime;
+    idleTime = byteTime;
+
+    // Return early if the predicted length is reached and the CRC is valid.
+    // The running CRC of the ADU makes the CRC check here take constant time.
+    if (completeOnLength && !framingError && (adu.getLength() == adu.getExpectedLength()) && adu.checkCRC()) {
+      frameInProgress = false;
+      return completeFrame (adu);
+    }
+  }
+
+  // The frame is complete when the line has been silent for t3.5. The time is taken
+  // before checking the port again. If the task was suspended after the last read, the
+  // bytes that arrived in the meantime belong to this frame and are read on the next call.
+  if (frameInProgress) {
+    uint32_t now = micros();
+
+    if (((now - lastByteTime) >= interFrameDelay) && (((receiveBuffer != NULL) ? receiveBuffer->available() : port.available()) <= 0)) {
+      frameInProgress = false;
+      return completeFrame (adu);
+    }
+  }
+
+  return 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads the available bytes of the port into a frame.
+ * 
+ */
+template <typename port_t> int CSE_ModbusRTU_PortBase <port_t>:: receiveFrame (CSE_ModbusRTU& rtu, CSE_ModbusRTU_ADU& adu, bool completeOnLength) {
+  return rtu.receiveFrameFrom (*port, adu, completeOnLength);
+}
 
 //======================================================================================//
 /**
@@ -303,16 +620,77 @@ class modbus_register_t {
  * 
  */
 class CSE_ModbusRTU_Server {
+  public:
+    // A function that computes the values of a range of registers. It is called when a
+    // request reads any register of the range, once per request. The address and count
+    // are the part of the range that is read. values points to a copy of their current
+    // values, which is written to the register map after the function returns. The
+    // function is called without holding the lock of the table, so it can call
+    // writeInputRegister() or writeHoldingRegister(), but those values are replaced by
+    // the copy.
+    typedef void (*registerProvider_t) (uint16_t address, uint16_t count, uint16_t* values, void* context);
+
+    // A function that is called after the client writes a range of holding registers.
+    // It is called in the response path, so it must return quickly.
+    typedef void (*writeCallback_t) (uint16_t address, uint16_t count, void* context);
+
   private:
+    // A range of registers whose values are computed only when they are read
+    struct provider_t {
+      uint8_t functionCode; // The read function code of the table
+      uint16_t address; // The first address of the range
+      uint16_t count; // The number of registers
+      registerProvider_t function; // The function that computes the values
+      void* context; // Passed to the function
+    };
+
     String name;  // The name of the server
     CSE_ModbusRTU* rtu; // The parent RTU object
 
+    bool nonBlocking; // If true, poll() does not wait for data
+    CSE_ModbusRTU_ADU* pendingFrame; // The response waiting for the response delay in the non-blocking mode, or NULL
+
+    provider_t providers [MODBUS_RTU_PROVIDER_COUNT_MAX]; // The register providers
+    uint8_t providerCount; // The number of register providers
+
+    writeCallback_t writeCallback; // Called after the client writes holding registers
+    void* writeContext; // Passed to the write callback
+
+    CSE_ModbusRTU_SeqLock changeLock; // Serializes the writers of the change flags
+
+    int processRequest(); // Process the request ADU and send the response
+    bool transmit(); // Start or finish sending the response in the non-blocking mode
+    bool addProvider (uint8_t functionCode, uint16_t address, uint16_t count, registerProvider_t function, void* context); // Add a register provider
+    void callProviders (uint8_t functionCode, uint16_t address, uint16_t count, uint16_t* values); // Call the providers of a range
+    void markChanged (CSE_ModbusRTU_BitMap& changes, uint16_t address, uint16_t count); // Set the change flags of a range
+    bool readChanges (CSE_ModbusRTU_BitMap& changes, uint16_t& address, uint16_t& count); // Find and clear the first changed range
+
   public:
-    // The following vectors store the Modbus data.
-    std::vector <modbus_bit_t> coils;
-    std::vector <modbus_bit_t> discreteInputs;
-    std::vector <modbus_register_t> holdingRegisters;
-    std::vector <modbus_register_t> inputRegisters;
+    // The states of the server frame state machine used in the non-blocking mode
+    enum serverState_t {
+      IDLE,           // Waiting for the first byte of a request
+      RECEIVING,      // Receiving a request frame
+      FRAME_COMPLETE, // A valid request frame has been received
+      DISPATCHING,    // Processing the request
+      TRANSMITTING    // Sending the response
+    } state;  // The current state
+
+    // The following maps store the Modbus data. See CSE_ModbusRTU_RegisterMap.
+    CSE_ModbusRTU_BitMap coils;
+    CSE_ModbusRTU_BitMap discreteInputs;
+    CSE_ModbusRTU_RegisterMap <uint16_t> holdingRegisters;
+    CSE_ModbusRTU_RegisterMap <uint16_t> inputRegisters;
+
+    // The coils and holding registers written by the client. One bit per address, with
+    // the same ranges as the data maps. See readChangedCoils().
+    CSE_ModbusRTU_BitMap changedCoils;
+    CSE_ModbusRTU_BitMap changedHoldingRegisters;
+
+    // Sequence locks of the register tables. The read requests copy a consistent snapshot
+    // of the registers, even if another thread or core writes them with the functions of
+    // the server. See CSE_ModbusRTU_SeqLock.
+    CSE_ModbusRTU_SeqLock inputRegisterLock;
+    CSE_ModbusRTU_SeqLock holdingRegisterLock;
 
     // There are two ADUs, one for request and one for response.
     // request ADUs are sent by the client.
@@ -326,8 +704,11 @@ class CSE_ModbusRTU_Server {
 
     bool begin(); // Does nothing for now.
     int poll(); // Listen for incoming requests from the client and process them
+    bool setNonBlocking (bool nonBlocking); // Set the polling mode
+    int getState(); // Get the state of the frame state machine
     int receive(); // Receive a request from the client
     int send(); // Send a response to the client
+    int send (CSE_ModbusRTU_ADU& adu); // Send any ADU to the client
 
     // The following functions are used to configure and read Modbus data.
     bool configureCoils (uint16_t startAddress, uint16_t count); // Create and add new coils to the server
@@ -350,14 +731,29 @@ class CSE_ModbusRTU_Server {
     int readInputRegister (uint16_t address); // Read a single input register from the server itself
     int writeInputRegister (uint16_t address, uint16_t value); // Write a single input register to the server itself
     int writeInputRegister (uint16_t address, uint16_t value, uint16_t count); // Write multiple input registers to the server itself
+    int writeInputRegister (uint16_t address, uint16_t count, const uint16_t* registerValues); // Write input registers from an array, as one update
+    int readInputRegister (uint16_t address, uint16_t count, uint16_t* registerValues); // Read a consistent snapshot of input registers
     bool isInputRegisterPresent (uint16_t address); // Check if an input register is present in the server
     bool isInputRegisterPresent (uint16_t address, uint16_t count); // Check if multiple input registers are present in the server
 
     int readHoldingRegister (uint16_t address); // Read a single holding register from the server itself
     int writeHoldingRegister (uint16_t address, uint16_t value); // Write a single holding register to the server itself
     int writeHoldingRegister (uint16_t address, uint16_t value, uint16_t count); // Write multiple holding registers to the server itself
+    int writeHoldingRegister (uint16_t address, uint16_t count, const uint16_t* registerValues); // Write holding registers from an array, as one update
+    int readHoldingRegister (uint16_t address, uint16_t count, uint16_t* registerValues); // Read a consistent snapshot of holding registers
     bool isHoldingRegisterPresent (uint16_t address); // Check if a holding register is present in the server
     bool isHoldingRegisterPresent (uint16_t address, uint16_t count); // Check if multiple holding registers are present in the server
+
+    // The following functions set functions that compute register values only when a request reads them.
+    bool addInputRegisterProvider (uint16_t address, uint16_t count, registerProvider_t provider, void* context = NULL); // Compute input registers on read
+    bool addHoldingRegisterProvider (uint16_t address, uint16_t count, registerProvider_t provider, void* context = NULL); // Compute holding registers on read
+    void clearProviders(); // Remove all the register providers
+    void setWriteCallback (writeCallback_t callback, void* context = NULL); // Call a function after the client writes holding registers
+
+    // The following functions return the data written by the client.
+    bool readChangedCoils (uint16_t& address, uint16_t& count); // Read and clear the first range of changed coils
+    bool readChangedHoldingRegisters (uint16_t& address, uint16_t& count); // Read and clear the first range of changed holding registers
+    void clearChanges(); // Clear all the change flags
 };
 
 //======================================================================================//
@@ -382,6 +778,7 @@ class CSE_ModbusRTU_Client {
     bool begin();
     int receive(); // Receive a response from the server
     int send(); // Send a request to the server
+    int transfer(); // Send the request ADU and receive the response
 
     bool setServerAddress (uint8_t remoteAddress); // Set the address of the server (0x00 to 0xFF)
     String getName(); // Returns the name of the server
@@ -399,6 +796,81 @@ class CSE_ModbusRTU_Client {
     int writeHoldingRegister (uint16_t address, uint16_t count, uint16_t* registerValues); // Write multiple holding registers to the server
 };
 
+//======================================================================================//
+/**
+ * @brief Implements a listen-only Modbus RTU node. The sniffer splits all the traffic
+ * on the bus into frames using the inter-frame timing, checks their CRC, and pairs the
+ * requests with their responses. The frames are delivered with their timestamps to a
+ * callback function, or queued until they are read with readFrame(). The sniffer never
+ * asserts DE. The device address of the parent CSE_ModbusRTU object is not used.
+ * 
+ */
+class CSE_ModbusRTU_Sniffer {
+  public:
+    /**
+     * @brief A frame captured by the sniffer. The type of the ADU is set to REQUEST,
+     * RESPONSE or EXCEPTION if the frame could be classified, or NONE otherwise.
+     * 
+     */
+    struct frame_t {
+      CSE_ModbusRTU_ADU adu; // The frame
+      int status; // The length of the frame, or a MODBUS_RTU_RECEIVE_* error code
+      uint32_t sequence; // The sequence number of the frame, starting from 0
+      uint32_t startTime; // The arrival time of the first byte in microseconds
+      uint32_t endTime; // The arrival time of the last byte in microseconds
+      uint32_t roundTripTime; // For responses, the time from the first byte of the request to the last byte of the response in microseconds. 0 otherwise.
+      uint32_t requestSequence; // For responses, the sequence number of the request
+    };
+
+    typedef void (*frameCallback_t) (frame_t& frame); // The type of the frame callback
+
+  private:
+    String name;  // The name of the sniffer
+    CSE_ModbusRTU* rtu; // The parent RTU object
+
+    frame_t frame; // The frame being received
+
+    frame_t queue [MODBUS_RTU_SNIFFER_QUEUE_SIZE]; // Frames waiting to be read
+    uint8_t queueHead; // The next entry to write
+    uint8_t queueCount; // The number of frames in the queue
+
+    frameCallback_t callback; // If set, frames are passed to this function instead of the queue
+
+    // The last request that has not received a response yet
+    bool requestPending;
+    uint8_t requestAddress;
+    uint8_t requestFunctionCode;
+    uint32_t requestSequence;
+    uint32_t requestStartTime;
+    uint32_t requestEndTime;
+
+    uint32_t responseTimeout; // Time a request waits for its response in milliseconds
+
+    uint32_t frameCount; // The number of frames captured
+    uint32_t errorCount; // The number of frames with CRC or framing errors
+    uint32_t droppedFrameCount; // The number of frames dropped because the queue was full
+
+    void classifyFrame(); // Set the type of the frame and pair it with the request
+    void deliverFrame(); // Pass the frame to the callback or the queue
+
+  public:
+    CSE_ModbusRTU_Sniffer (CSE_ModbusRTU& rtu, String name);
+
+    bool begin(); // Put the port in listen-only mode
+    int poll(); // Capture the frames on the bus
+    String getName(); // Returns the name of the sniffer
+
+    bool setCallback (frameCallback_t callback); // Set a function to receive the frames
+    bool setResponseTimeout (uint32_t timeout); // Set the time a request waits for its response in milliseconds
+
+    int available(); // Number of frames in the queue
+    bool readFrame (frame_t& frame); // Read the oldest frame from the queue
+
+    uint32_t getFrameCount(); // Number of frames captured
+    uint32_t getErrorCount(); // Number of frames with errors
+    uint32_t getDroppedFrameCount(); // Number of frames dropped because the queue was full
+};
+
 #endif
 
 //======================================================================================//
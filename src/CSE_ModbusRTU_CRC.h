@@ -0,0 +1,112 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_CRC.h
+  Description: CRC-16/MODBUS engines for the CSE_ModbusRTU library.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_CRC_H
+#define CSE_MODBUSRTU_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The lookup tables are placed in the program memory on targets that have a separate
+// flash address space. On other targets a const array is already placed in flash.
+#if defined(ARDUINO_ARCH_AVR)
+  #include <avr/pgmspace.h>
+  #define MODBUS_RTU_CRC_TABLE_ATTR         PROGMEM
+  #define MODBUS_RTU_CRC_TABLE_READ(addr)   pgm_read_word (addr)
+#elif defined(ARDUINO_ARCH_ESP8266)
+  #include <pgmspace.h>
+  #define MODBUS_RTU_CRC_TABLE_ATTR         PROGMEM
+  #define MODBUS_RTU_CRC_TABLE_READ(addr)   pgm_read_word (addr)
+#else
+  #define MODBUS_RTU_CRC_TABLE_ATTR
+  #define MODBUS_RTU_CRC_TABLE_READ(addr)   (*(addr))
+#endif
+
+//======================================================================================//
+
+// Available CRC engines
+#define   MODBUS_RTU_CRC_ENGINE_BITWISE                 0U  // 8 shift/xor iterations per byte. No tables.
+#define   MODBUS_RTU_CRC_ENGINE_TABLE                   1U  // One 256-entry table lookup per byte (512 bytes).
+#define   MODBUS_RTU_CRC_ENGINE_SLICING_4               2U  // Four bytes per step (2 KB of tables).
+#define   MODBUS_RTU_CRC_ENGINE_SLICING_8               3U  // Eight bytes per step (4 KB of tables).
+
+// You can select the CRC engine used by the library here, or by defining
+// MODBUS_RTU_CRC_ENGINE in your build flags. The table engine is the default on
+// microcontrollers. Slicing engines are meant for 32/64-bit hosts with data caches.
+#ifndef MODBUS_RTU_CRC_ENGINE
+  #if defined(ARDUINO)
+    #define MODBUS_RTU_CRC_ENGINE       MODBUS_RTU_CRC_ENGINE_TABLE
+  #else
+    #define MODBUS_RTU_CRC_ENGINE       MODBUS_RTU_CRC_ENGINE_SLICING_8
+  #endif
+#endif
+
+#define   MODBUS_RTU_CRC_INIT                           0xFFFFU // Initial value of CRC-16/MODBUS
+
+//======================================================================================//
+
+extern const uint16_t modbusCRCTable [256] MODBUS_RTU_CRC_TABLE_ATTR;
+extern const uint16_t modbusCRCSlicingTable [8][256];
+
+//======================================================================================//
+/**
+ * @brief Implements the CRC-16/MODBUS checksum (reflected polynomial 0xA001, initial
+ * value 0xFFFF). All engines produce the same result and can be chained by passing the
+ * CRC of the previous block as the initial value. The `calculate()` function uses the
+ * engine selected by MODBUS_RTU_CRC_ENGINE. The individual engines are always available
+ * for testing and benchmarking.
+ *
+ */
+class CSE_ModbusRTU_CRC {
+  public:
+    static uint16_t calculate (const uint8_t* buffer, size_t length, uint16_t crc = MODBUS_RTU_CRC_INIT); // Calculate with the selected engine
+
+    static uint16_t calculateBitwise (const uint8_t* buffer, size_t length, uint16_t crc = MODBUS_RTU_CRC_INIT); // Bit-by-bit engine
+    static uint16_t calculateTable (const uint8_t* buffer, size_t length, uint16_t crc = MODBUS_RTU_CRC_INIT); // 256-entry table engine
+    static uint16_t calculateSlicing4 (const uint8_t* buffer, size_t length, uint16_t crc = MODBUS_RTU_CRC_INIT); // Slicing-by-4 engine
+    static uint16_t calculateSlicing8 (const uint8_t* buffer, size_t length, uint16_t crc = MODBUS_RTU_CRC_INIT); // Slicing-by-8 engine
+
+    static const char* getEngineName(); // Returns the name of the selected engine
+
+    /**
+     * @brief Updates a running CRC with a single byte. The bitwise engine is used when
+     * it is the selected engine. Otherwise the 256-entry table is used.
+     *
+     * @param crc The current CRC value.
+     * @param byte The next byte.
+     * @return uint16_t - The updated CRC value.
+     */
+    static inline uint16_t update (uint16_t crc, uint8_t byte) {
+      #if (MODBUS_RTU_CRC_ENGINE == MODBUS_RTU_CRC_ENGINE_BITWISE)
+        crc ^= byte;
+
+        for (uint8_t j = 0; j < 8; j++) {
+          if ((crc & 0x0001) == 0x0001) {
+            crc >>= 1;
+            crc ^= 0xA001;
+          } else {
+            crc >>= 1;
+          }
+        }
+
+        return crc;
+      #else
+        return (crc >> 8) ^ MODBUS_RTU_CRC_TABLE_READ (&modbusCRCTable [(crc ^ byte) & 0xFF]);
+      #endif
+    }
+};
+
+#endif
+
+//======================================================================================//
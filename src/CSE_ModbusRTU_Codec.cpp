@@ -0,0 +1,243 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Codec.cpp
+  Description: Bulk conversion of 16-bit register values to and from the big-endian
+  byte order of Modbus frames.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#include "CSE_ModbusRTU_Codec.h"
+#include <string.h>
+
+#if defined(MODBUS_RTU_CODEC_SIMD_AVAILABLE)
+  #if defined(__SSE2__)
+    #include <emmintrin.h>
+  #else
+    #include <arm_neon.h>
+  #endif
+#endif
+
+// On a big-endian host the registers are already stored in the byte order of the frame.
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  #define MODBUS_RTU_CODEC_BIG_ENDIAN_HOST
+#endif
+
+//======================================================================================//
+/**
+ * @brief Swaps the two bytes of each 16-bit pair, two pairs at a time. The 32-bit words
+ * are loaded and stored with memcpy(), which the compiler turns into single loads and
+ * stores where unaligned access is allowed. Swapping the bytes of each pair gives the
+ * same result in either byte order of the host.
+ *
+ * @param target The target bytes.
+ * @param source The source bytes.
+ * @param count The number of pairs.
+ */
+static void swapPairs (uint8_t* target, const uint8_t* source, size_t count) {
+  size_t i = 0;
+
+  for (; (i + 2) <= count; i += 2) {
+    uint32_t word;
+    memcpy (&word, source + (i * 2), 4);
+    word = ((word & 0x00FF00FFUL) << 8) | ((word >> 8) & 0x00FF00FFUL);
+    memcpy (target + (i * 2), &word, 4);
+  }
+
+  // The last pair of an odd count
+  if (i < count) {
+    uint8_t high = source [(i * 2) + 1];
+    target [(i * 2) + 1] = source [i * 2];
+    target [i * 2] = high;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Swaps the two bytes of each 16-bit pair, eight pairs at a time with SSE2 or
+ * NEON. The rest is done by swapPairs().
+ *
+ * @param target The target bytes.
+ * @param source The source bytes.
+ * @param count The number of pairs.
+ */
+static void swapPairsSIMD (uint8_t* target, const uint8_t* source, size_t count) {
+  size_t i = 0;
+
+  #if defined(MODBUS_RTU_CODEC_SIMD_AVAILABLE)
+    for (; (i + 8) <= count; i += 8) {
+      #if defined(__SSE2__)
+        __m128i pairs = _mm_loadu_si128 ((const __m128i*) (source + (i * 2)));
+        pairs = _mm_or_si128 (_mm_slli_epi16 (pairs, 8), _mm_srli_epi16 (pairs, 8));
+        _mm_storeu_si128 ((__m128i*) (target + (i * 2)), pairs);
+      #else
+        vst1q_u8 (target + (i * 2), vrev16q_u8 (vld1q_u8 (source + (i * 2))));
+      #endif
+    }
+  #endif
+
+  swapPairs (target + (i * 2), source + (i * 2), count - i);
+}
+
+//======================================================================================//
+/**
+ * @brief Converts registers to big-endian bytes with the selected engine.
+ *
+ * @param target The target bytes. Must have space for count * 2 bytes.
+ * @param source The registers.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: encode (uint8_t* target, const uint16_t* source, size_t count) {
+  #if (MODBUS_RTU_CODEC_ENGINE == MODBUS_RTU_CODEC_ENGINE_BYTEWISE)
+    encodeBytewise (target, source, count);
+  #elif (MODBUS_RTU_CODEC_ENGINE == MODBUS_RTU_CODEC_ENGINE_SIMD)
+    encodeSIMD (target, source, count);
+  #else
+    encodeWordwise (target, source, count);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Converts big-endian bytes to registers with the selected engine.
+ *
+ * @param target The registers.
+ * @param source The source bytes. count * 2 bytes are read.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: decode (uint16_t* target, const uint8_t* source, size_t count) {
+  #if (MODBUS_RTU_CODEC_ENGINE == MODBUS_RTU_CODEC_ENGINE_BYTEWISE)
+    decodeBytewise (target, source, count);
+  #elif (MODBUS_RTU_CODEC_ENGINE == MODBUS_RTU_CODEC_ENGINE_SIMD)
+    decodeSIMD (target, source, count);
+  #else
+    decodeWordwise (target, source, count);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Converts registers to big-endian bytes, one register per step. The high byte
+ * is written first.
+ *
+ * @param target The target bytes. Must have space for count * 2 bytes.
+ * @param source The registers.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: encodeBytewise (uint8_t* target, const uint16_t* source, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    *target++ = (uint8_t) (source [i] >> 8);
+    *target++ = (uint8_t) (source [i] & 0xFF);
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Converts big-endian bytes to registers, one register per step.
+ *
+ * @param target The registers.
+ * @param source The source bytes. count * 2 bytes are read.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: decodeBytewise (uint16_t* target, const uint8_t* source, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    target [i] = (uint16_t) ((source [0] << 8) | source [1]);
+    source += 2;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Converts registers to big-endian bytes, two registers per step in a 32-bit
+ * word.
+ *
+ * @param target The target bytes. Must have space for count * 2 bytes.
+ * @param source The registers.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: encodeWordwise (uint8_t* target, const uint16_t* source, size_t count) {
+  #if defined(MODBUS_RTU_CODEC_BIG_ENDIAN_HOST)
+    memcpy (target, source, count * 2);
+  #else
+    swapPairs (target, (const uint8_t*) source, count);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Converts big-endian bytes to registers, two registers per step in a 32-bit
+ * word.
+ *
+ * @param target The registers.
+ * @param source The source bytes. count * 2 bytes are read.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: decodeWordwise (uint16_t* target, const uint8_t* source, size_t count) {
+  #if defined(MODBUS_RTU_CODEC_BIG_ENDIAN_HOST)
+    memcpy (target, source, count * 2);
+  #else
+    swapPairs ((uint8_t*) target, source, count);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Converts registers to big-endian bytes, eight registers per step with SSE2 or
+ * NEON. Same as encodeWordwise() if neither is available.
+ *
+ * @param target The target bytes. Must have space for count * 2 bytes.
+ * @param source The registers.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: encodeSIMD (uint8_t* target, const uint16_t* source, size_t count) {
+  #if defined(MODBUS_RTU_CODEC_BIG_ENDIAN_HOST)
+    memcpy (target, source, count * 2);
+  #else
+    swapPairsSIMD (target, (const uint8_t*) source, count);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Converts big-endian bytes to registers, eight registers per step with SSE2 or
+ * NEON. Same as decodeWordwise() if neither is available.
+ *
+ * @param target The registers.
+ * @param source The source bytes. count * 2 bytes are read.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Codec:: decodeSIMD (uint16_t* target, const uint8_t* source, size_t count) {
+  #if defined(MODBUS_RTU_CODEC_BIG_ENDIAN_HOST)
+    memcpy (target, source, count * 2);
+  #else
+    swapPairsSIMD ((uint8_t*) target, source, count);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the name of the engine selected by MODBUS_RTU_CODEC_ENGINE.
+ *
+ * @return const char* - Engine name.
+ */
+const char* CSE_ModbusRTU_Codec:: getEngineName() {
+  #if (MODBUS_RTU_CODEC_ENGINE == MODBUS_RTU_CODEC_ENGINE_BYTEWISE)
+    return "bytewise";
+  #elif (MODBUS_RTU_CODEC_ENGINE == MODBUS_RTU_CODEC_ENGINE_SIMD) && defined(MODBUS_RTU_CODEC_SIMD_AVAILABLE)
+    #if defined(__SSE2__)
+      return "SIMD (SSE2)";
+    #else
+      return "SIMD (NEON)";
+    #endif
+  #else
+    return "wordwise";
+  #endif
+}
+
+//======================================================================================//
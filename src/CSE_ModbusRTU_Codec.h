@@ -0,0 +1,74 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Codec.h
+  Description: Bulk conversion of 16-bit register values to and from the big-endian
+  byte order of Modbus frames.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_CODEC_H
+#define CSE_MODBUSRTU_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//======================================================================================//
+
+// Available codec engines
+#define   MODBUS_RTU_CODEC_ENGINE_BYTEWISE              0U  // One register per step, with shifts.
+#define   MODBUS_RTU_CODEC_ENGINE_WORDWISE              1U  // Two registers per step in a 32-bit word.
+#define   MODBUS_RTU_CODEC_ENGINE_SIMD                  2U  // Eight registers per step with SSE2 or NEON.
+
+// The SIMD engine is only available on hosts with SSE2 (all x86-64) or NEON (AArch64 and
+// most ARMv7 Linux systems). On other targets it falls back to the word-wise engine.
+#if !defined(ARDUINO) && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+  #define MODBUS_RTU_CODEC_SIMD_AVAILABLE
+#endif
+
+// You can select the codec engine used by the library here, or by defining
+// MODBUS_RTU_CODEC_ENGINE in your build flags. 8-bit AVR has no 32-bit registers, so it
+// uses the byte-wise engine.
+#ifndef MODBUS_RTU_CODEC_ENGINE
+  #if defined(MODBUS_RTU_CODEC_SIMD_AVAILABLE)
+    #define MODBUS_RTU_CODEC_ENGINE     MODBUS_RTU_CODEC_ENGINE_SIMD
+  #elif defined(ARDUINO_ARCH_AVR)
+    #define MODBUS_RTU_CODEC_ENGINE     MODBUS_RTU_CODEC_ENGINE_BYTEWISE
+  #else
+    #define MODBUS_RTU_CODEC_ENGINE     MODBUS_RTU_CODEC_ENGINE_WORDWISE
+  #endif
+#endif
+
+//======================================================================================//
+/**
+ * @brief Converts dense arrays of 16-bit register values to and from the big-endian
+ * byte order of the data field of a Modbus ADU, in one pass. The byte arrays do not have
+ * to be aligned. The `encode()` and `decode()` functions use the engine selected by
+ * MODBUS_RTU_CODEC_ENGINE. The individual engines are always available for testing and
+ * benchmarking. All engines produce the same result.
+ *
+ */
+class CSE_ModbusRTU_Codec {
+  public:
+    static void encode (uint8_t* target, const uint16_t* source, size_t count); // Registers to big-endian bytes
+    static void decode (uint16_t* target, const uint8_t* source, size_t count); // Big-endian bytes to registers
+
+    static void encodeBytewise (uint8_t* target, const uint16_t* source, size_t count); // One register per step
+    static void decodeBytewise (uint16_t* target, const uint8_t* source, size_t count);
+    static void encodeWordwise (uint8_t* target, const uint16_t* source, size_t count); // Two registers per step
+    static void decodeWordwise (uint16_t* target, const uint8_t* source, size_t count);
+    static void encodeSIMD (uint8_t* target, const uint16_t* source, size_t count); // Eight registers per step
+    static void decodeSIMD (uint16_t* target, const uint8_t* source, size_t count);
+
+    static const char* getEngineName(); // Returns the name of the selected engine
+};
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,705 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Gateway.cpp
+  Description: Modbus TCP to RTU gateway for Linux and macOS hosts. Accepts Modbus TCP
+  connections and forwards the requests to the serial buses of a CSE_ModbusRTU_Master.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Gateway.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#if !defined(MSG_NOSIGNAL)
+  #define MSG_NOSIGNAL    0 // macOS uses SO_NOSIGPIPE instead
+#endif
+
+//======================================================================================//
+/**
+ * @brief Sets a file descriptor to the non-blocking mode.
+ *
+ * @param fd The file descriptor.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+static bool setNonBlocking (int fd) {
+  int flags = fcntl (fd, F_GETFL, 0);
+  return (flags >= 0) && (fcntl (fd, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+//======================================================================================//
+/**
+ * @brief Constructor. The master must have its buses and routes set, and be started
+ * before the gateway is polled.
+ *
+ * @param master The master that runs the serial buses.
+ * @param name The name of the gateway.
+ */
+CSE_ModbusRTU_Gateway:: CSE_ModbusRTU_Gateway (CSE_ModbusRTU_Master& master, String name) {
+  this->master = &master;
+  this->name = name;
+  listenSocket = -1;
+  wakePipe [0] = -1;
+  wakePipe [1] = -1;
+  port = 0;
+  queueDepth = MODBUS_RTU_GATEWAY_QUEUE_DEPTH;
+  completedCount = 0;
+  requestCount = 0;
+  rejectedCount = 0;
+  queueDelayTotal = 0;
+  queueDelayMax = 0;
+
+  for (uint8_t i = 0; i < MODBUS_RTU_GATEWAY_CONNECTION_MAX; i++) {
+    connections [i].fd = -1;
+    connections [i].generation = 0;
+    connections [i].rxLength = 0;
+  }
+
+  for (uint8_t i = 0; i < MODBUS_RTU_GATEWAY_REQUEST_MAX; i++) {
+    requests [i].gateway = this;
+    requests [i].used = false;
+  }
+
+  for (uint8_t i = 0; i < MODBUS_RTU_MASTER_BUS_COUNT_MAX; i++) {
+    pendingCount [i] = 0;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Destructor. Closes the connections and waits for the requests in progress.
+ *
+ */
+CSE_ModbusRTU_Gateway:: ~CSE_ModbusRTU_Gateway() {
+  end();
+}
+
+//======================================================================================//
+/**
+ * @brief Starts listening for Modbus TCP clients.
+ *
+ * @param port The TCP port. 0 selects a free port. See getPort().
+ * @param address The IPv4 address of the interface to listen on. "0.0.0.0" listens on
+ * all the interfaces, and "127.0.0.1" only on the local host.
+ * @return true - Operation successful.
+ * @return false - The address is invalid, or the socket could not be opened.
+ */
+bool CSE_ModbusRTU_Gateway:: begin (uint16_t port, const char* address) {
+  if (listenSocket >= 0) {
+    return false;
+  }
+
+  struct sockaddr_in socketAddress;
+  memset (&socketAddress, 0, sizeof (socketAddress));
+  socketAddress.sin_family = AF_INET;
+  socketAddress.sin_port = htons (port);
+
+  if (inet_pton (AF_INET, address, &socketAddress.sin_addr) != 1) {
+    DEBUG_PRINTLN (F("CSE_ModbusRTU_Gateway: Invalid address."));
+    return false;
+  }
+
+  listenSocket = socket (AF_INET, SOCK_STREAM, 0);
+
+  if (listenSocket < 0) {
+    return false;
+  }
+
+  int enable = 1;
+  setsockopt (listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (enable));
+
+  if ((bind (listenSocket, (struct sockaddr*) &socketAddress, sizeof (socketAddress)) != 0) ||
+    (listen (listenSocket, MODBUS_RTU_GATEWAY_CONNECTION_MAX) != 0) || !setNonBlocking (listenSocket) ||
+    (pipe (wakePipe) != 0)) {
+    DEBUG_PRINT (F("CSE_ModbusRTU_Gateway: Failed to listen on port "));
+    DEBUG_PRINTLN (port);
+    end();
+    return false;
+  }
+
+  setNonBlocking (wakePipe [0]);
+  setNonBlocking (wakePipe [1]);
+
+  // Read back the port, in case a free port was selected
+  socklen_t addressLength = sizeof (socketAddress);
+  getsockname (listenSocket, (struct sockaddr*) &socketAddress, &addressLength);
+  this->port = ntohs (socketAddress.sin_port);
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Stops listening and closes all the connections. Waits until the requests in
+ * progress are complete, because they are owned by the gateway. Their responses are
+ * discarded.
+ *
+ */
+void CSE_ModbusRTU_Gateway:: end() {
+  for (uint8_t i = 0; i < MODBUS_RTU_GATEWAY_CONNECTION_MAX; i++) {
+    closeConnection (i);
+  }
+
+  while (getPendingCount() > 0) {
+    if (master->poll() < 0) {
+      yield();  // The bus threads complete the requests
+    }
+
+    sendCompleted();
+  }
+
+  if (listenSocket >= 0) {
+    close (listenSocket);
+    listenSocket = -1;
+  }
+
+  for (uint8_t i = 0; i < 2; i++) {
+    if (wakePipe [i] >= 0) {
+      close (wakePipe [i]);
+      wakePipe [i] = -1;
+    }
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Handles the sockets. New clients are accepted, the received requests are
+ * forwarded to the buses, and the responses of the completed requests are sent. If the
+ * master runs in the polled mode, it is polled too.
+ *
+ * @param timeout The time to wait for a socket or a completed request in milliseconds.
+ * Must be 0 if the master runs in the polled mode.
+ * @return int - The number of responses sent; -1 if the gateway is not started.
+ */
+int CSE_ModbusRTU_Gateway:: poll (int timeout) {
+  if (listenSocket < 0) {
+    return -1;
+  }
+
+  master->poll();
+
+  // The listening socket, the wake pipe, and the connections
+  struct pollfd descriptors [MODBUS_RTU_GATEWAY_CONNECTION_MAX + 2];
+  uint8_t indexes [MODBUS_RTU_GATEWAY_CONNECTION_MAX];
+  nfds_t count = 0;
+
+  descriptors [count++] = { listenSocket, POLLIN, 0 };
+  descriptors [count++] = { wakePipe [0], POLLIN, 0 };
+
+  for (uint8_t i = 0; i < MODBUS_RTU_GATEWAY_CONNECTION_MAX; i++) {
+    if (connections [i].fd >= 0) {
+      indexes [count - 2] = i;
+      descriptors [count++] = { connections [i].fd, POLLIN, 0 };
+    }
+  }
+
+  if (::poll (descriptors, count, timeout) > 0) {
+    if (descriptors [1].revents & POLLIN) {
+      uint8_t buffer [64];
+
+      while (read (wakePipe [0], buffer, sizeof (buffer)) > 0) {
+        // Drain the pipe. The completed requests are in completedList.
+      }
+    }
+
+    for (nfds_t i = 2; i < count; i++) {
+      if (descriptors [i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        readConnection (indexes [i - 2]);
+      }
+    }
+
+    if (descriptors [0].revents & POLLIN) {
+      acceptConnections();
+    }
+  }
+
+  return sendCompleted();
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the name of the gateway.
+ *
+ * @return String - The name of the gateway.
+ */
+String CSE_ModbusRTU_Gateway:: getName() {
+  return name;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the TCP port the gateway listens on. If begin() was called with port
+ * 0, this is the port selected by the OS.
+ *
+ * @return uint16_t - The TCP port; 0 if the gateway is not started.
+ */
+uint16_t CSE_ModbusRTU_Gateway:: getPort() {
+  return port;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the maximum number of requests in progress for one bus. Requests above
+ * this are answered with the exception Server Device Busy (0x06). This bounds the time
+ * a request can wait for a busy bus, to the queue depth times the transaction time.
+ *
+ * @param depth The queue depth. 1 to MODBUS_RTU_GATEWAY_REQUEST_MAX.
+ * @return true - Operation successful.
+ * @return false - The depth is out of range.
+ */
+bool CSE_ModbusRTU_Gateway:: setQueueDepth (uint8_t depth) {
+  if ((depth == 0) || (depth > MODBUS_RTU_GATEWAY_REQUEST_MAX)) {
+    return false;
+  }
+
+  queueDepth = depth;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the maximum number of requests in progress for one bus.
+ *
+ * @return uint8_t - The queue depth.
+ */
+uint8_t CSE_ModbusRTU_Gateway:: getQueueDepth() {
+  return queueDepth;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of connected TCP clients.
+ *
+ * @return uint8_t - The number of connections.
+ */
+uint8_t CSE_ModbusRTU_Gateway:: getConnectionCount() {
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < MODBUS_RTU_GATEWAY_CONNECTION_MAX; i++) {
+    if (connections [i].fd >= 0) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of requests forwarded to the buses and completed.
+ *
+ * @return uint32_t - The number of requests.
+ */
+uint32_t CSE_ModbusRTU_Gateway:: getRequestCount() {
+  return requestCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of requests answered with Server Device Busy, because the
+ * queue of their bus was full.
+ *
+ * @return uint32_t - The number of requests.
+ */
+uint32_t CSE_ModbusRTU_Gateway:: getRejectedCount() {
+  return rejectedCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the average time the completed requests waited for their bus, from
+ * being received to being sent on the bus.
+ *
+ * @return uint32_t - The average queueing delay in microseconds.
+ */
+uint32_t CSE_ModbusRTU_Gateway:: getQueueDelayAverage() {
+  return (requestCount > 0) ? (uint32_t) (queueDelayTotal / requestCount) : 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the longest time a completed request waited for its bus.
+ *
+ * @return uint32_t - The longest queueing delay in microseconds.
+ */
+uint32_t CSE_ModbusRTU_Gateway:: getQueueDelayMax() {
+  return queueDelayMax;
+}
+
+//======================================================================================//
+/**
+ * @brief Called by the master when a request is complete. This runs on the thread of
+ * the bus. The request is added to the completed list, and poll() is woken up.
+ *
+ * @param job The completed job.
+ * @param context The request_t the job belongs to.
+ */
+void CSE_ModbusRTU_Gateway:: jobComplete (CSE_ModbusRTU_Master::job_t& job, void* context) {
+  (void) job;
+
+  request_t* request = (request_t*) context;
+  CSE_ModbusRTU_Gateway* gateway = request->gateway;
+
+  {
+    std::lock_guard <std::mutex> guard (gateway->completedLock);
+    gateway->completedList [gateway->completedCount++] = (uint8_t) (request - gateway->requests);
+  }
+
+  uint8_t byte = 0;
+
+  if (write (gateway->wakePipe [1], &byte, 1) < 0) {
+    // The pipe is full, so poll() is already woken up
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Accepts the waiting TCP clients. If all the connection slots are in use, the
+ * new client is closed.
+ *
+ */
+void CSE_ModbusRTU_Gateway:: acceptConnections() {
+  while (true) {
+    int fd = accept (listenSocket, NULL, NULL);
+
+    if (fd < 0) {
+      return;
+    }
+
+    uint8_t index = 0;
+
+    while ((index < MODBUS_RTU_GATEWAY_CONNECTION_MAX) && (connections [index].fd >= 0)) {
+      index++;
+    }
+
+    if ((index == MODBUS_RTU_GATEWAY_CONNECTION_MAX) || !setNonBlocking (fd)) {
+      DEBUG_PRINTLN (F("CSE_ModbusRTU_Gateway: Connection refused."));
+      close (fd);
+      continue;
+    }
+
+    // The responses are small, and must not wait for more data
+    int enable = 1;
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+
+#if defined(SO_NOSIGPIPE)
+    setsockopt (fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof (enable));
+#endif
+
+    connections [index].fd = fd;
+    connections [index].rxLength = 0;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Closes a TCP client. The requests of the client still in progress are
+ * completed, but their responses are discarded.
+ *
+ * @param index The index of the connection.
+ */
+void CSE_ModbusRTU_Gateway:: closeConnection (uint8_t index) {
+  connection_t& connection = connections [index];
+
+  if (connection.fd >= 0) {
+    close (connection.fd);
+    connection.fd = -1;
+    connection.generation++;
+    connection.rxLength = 0;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Reads the available bytes of a TCP client, and forwards the complete requests
+ * to the buses. A client that sends an invalid MBAP header is closed.
+ *
+ * @param index The index of the connection.
+ * @return true - The connection is open.
+ * @return false - The connection was closed.
+ */
+bool CSE_ModbusRTU_Gateway:: readConnection (uint8_t index) {
+  connection_t& connection = connections [index];
+
+  while (connection.fd >= 0) {
+    ssize_t count = recv (connection.fd, connection.rxBuffer + connection.rxLength, MODBUS_TCP_FRAME_LENGTH_MAX - connection.rxLength, 0);
+
+    if (count == 0) {
+      closeConnection (index);  // Closed by the client
+      return false;
+    }
+    else if (count < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+        return true;
+      }
+
+      closeConnection (index);
+      return false;
+    }
+
+    connection.rxLength += (size_t) count;
+
+    // Handle all the complete requests in the buffer
+    while (connection.rxLength >= MODBUS_TCP_MBAP_LENGTH) {
+      uint16_t protocolId = (connection.rxBuffer [2] << 8) | connection.rxBuffer [3];
+      uint16_t length = (connection.rxBuffer [4] << 8) | connection.rxBuffer [5]; // Unit ID + PDU
+
+      if ((protocolId != 0) || (length < 2) || (length > (MODBUS_TCP_FRAME_LENGTH_MAX - 6))) {
+        DEBUG_PRINTLN (F("CSE_ModbusRTU_Gateway: Invalid MBAP header."));
+        closeConnection (index);
+        return false;
+      }
+
+      size_t frameLength = 6 + length;
+
+      if (connection.rxLength < frameLength) {
+        break;
+      }
+
+      handleRequest (index, connection.rxBuffer, frameLength);
+
+      if (connection.fd < 0) {
+        return false; // Closed while sending an exception
+      }
+
+      connection.rxLength -= frameLength;
+      memmove (connection.rxBuffer, connection.rxBuffer + frameLength, connection.rxLength);
+    }
+  }
+
+  return false;
+}
+
+//======================================================================================//
+/**
+ * @brief Translates a Modbus TCP request to an RTU ADU and queues it to the bus of its
+ * unit ID. If the request can not be queued, an exception response is sent at once,
+ * unless the request is a broadcast.
+ *
+ * @param index The index of the connection.
+ * @param frame The MBAP header and the PDU.
+ * @param length The length of the frame.
+ */
+void CSE_ModbusRTU_Gateway:: handleRequest (uint8_t index, const uint8_t* frame, size_t length) {
+  uint16_t transactionId = (frame [0] << 8) | frame [1];
+  uint8_t unitId = frame [6];
+  uint8_t functionCode = frame [7];
+  uint8_t bus = master->getRoute (unitId);
+
+  if ((bus == MODBUS_RTU_MASTER_BUS_NONE) || (bus >= master->getBusCount())) {
+    sendException (index, transactionId, unitId, functionCode, MODBUS_EX_GATEWAY_PATH_UNAVAILABLE);
+    return;
+  }
+
+  // Find a free request slot
+  uint8_t slot = 0;
+
+  while ((slot < MODBUS_RTU_GATEWAY_REQUEST_MAX) && requests [slot].used) {
+    slot++;
+  }
+
+  if ((slot == MODBUS_RTU_GATEWAY_REQUEST_MAX) || (pendingCount [bus] >= queueDepth)) {
+    rejectedCount++;
+    sendException (index, transactionId, unitId, functionCode, MODBUS_EX_SERVER_DEVICE_BUSY);
+    return;
+  }
+
+  request_t& request = requests [slot];
+  CSE_ModbusRTU_Master::job_t& job = request.job;
+
+  // The RTU ADU is the unit ID and the PDU, followed by the CRC
+  job.bus = bus;
+  job.request.resetLength();
+  job.request.add (unitId);
+  job.request.add ((uint8_t*) (frame + MODBUS_TCP_MBAP_LENGTH), (uint8_t) (length - MODBUS_TCP_MBAP_LENGTH));
+  job.request.setCRC();
+  job.callback = jobComplete;
+  job.context = &request;
+
+  request.connection = index;
+  request.generation = connections [index].generation;
+  request.transactionId = transactionId;
+  request.bus = bus;
+  request.used = true;
+  pendingCount [bus]++;
+
+  if (!master->submit (job)) {
+    request.used = false;
+    pendingCount [bus]--;
+    sendException (index, transactionId, unitId, functionCode, MODBUS_EX_GATEWAY_PATH_UNAVAILABLE);
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Sends the responses of the completed requests, and frees their slots. The
+ * response is discarded if the connection of the request was closed. Broadcast
+ * requests are not answered.
+ *
+ * @return int - The number of responses sent.
+ */
+int CSE_ModbusRTU_Gateway:: sendCompleted() {
+  uint8_t list [MODBUS_RTU_GATEWAY_REQUEST_MAX];
+  uint8_t count;
+
+  {
+    std::lock_guard <std::mutex> guard (completedLock);
+    count = completedCount;
+    memcpy (list, completedList, count);
+    completedCount = 0;
+  }
+
+  int sent = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    request_t& request = requests [list [i]];
+    CSE_ModbusRTU_Master::job_t& job = request.job;
+    uint32_t queueDelay = job.startTime - job.submitTime;
+
+    requestCount++;
+    queueDelayTotal += queueDelay;
+
+    if (queueDelay > queueDelayMax) {
+      queueDelayMax = queueDelay;
+    }
+
+    pendingCount [request.bus]--;
+
+    uint8_t unitId = job.request.getDeviceAddress();
+
+    if ((connections [request.connection].fd >= 0) && (connections [request.connection].generation == request.generation) && (unitId != 0x00)) {
+      if ((job.result < 0) || (job.response.getLength() < 4)) {
+        sendException (request.connection, request.transactionId, unitId, job.request.getFunctionCode(), MODBUS_EX_GATEWAY_TARGET_NO_RESPONSE);
+      }
+      else {
+        // The MBAP header, followed by the response ADU without the CRC
+        uint8_t frame [MODBUS_TCP_FRAME_LENGTH_MAX];
+        uint16_t length = job.response.getLength() - 2;  // Unit ID + PDU
+
+        frame [0] = request.transactionId >> 8;
+        frame [1] = request.transactionId & 0xFF;
+        frame [2] = 0;
+        frame [3] = 0;
+        frame [4] = length >> 8;
+        frame [5] = length & 0xFF;
+        memcpy (frame + 6, job.response.getBuffer(), length);
+
+        writeFrame (request.connection, frame, 6 + length);
+      }
+
+      sent++;
+    }
+
+    request.used = false;
+  }
+
+  return sent;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a frame to a TCP client. Waits up to a second if the socket buffer is
+ * full. The client is closed if the write fails.
+ *
+ * @param index The index of the connection.
+ * @param frame The frame to write.
+ * @param length The length of the frame.
+ * @return true - Operation successful.
+ * @return false - The write failed.
+ */
+bool CSE_ModbusRTU_Gateway:: writeFrame (uint8_t index, const uint8_t* frame, size_t length) {
+  int fd = connections [index].fd;
+  size_t written = 0;
+
+  while ((fd >= 0) && (written < length)) {
+    ssize_t count = send (fd, frame + written, length - written, MSG_NOSIGNAL);
+
+    if (count > 0) {
+      written += (size_t) count;
+    }
+    else if ((count < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+      break;  // Write error
+    }
+    else {
+      struct pollfd descriptor = { fd, POLLOUT, 0 };
+
+      if (::poll (&descriptor, 1, 1000) <= 0) {
+        break;  // Timeout
+      }
+    }
+  }
+
+  if (written < length) {
+    closeConnection (index);
+    return false;
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sends an exception response to a TCP client. Broadcast requests, with the unit
+ * ID 0x00, are never answered, so nothing is sent for them.
+ *
+ * @param index The index of the connection.
+ * @param transactionId The transaction ID of the request.
+ * @param unitId The unit ID of the request.
+ * @param functionCode The function code of the request.
+ * @param exceptionCode The exception code.
+ * @return true - Operation successful, or the request was a broadcast.
+ * @return false - The write failed.
+ */
+bool CSE_ModbusRTU_Gateway:: sendException (uint8_t index, uint16_t transactionId, uint8_t unitId, uint8_t functionCode, uint8_t exceptionCode) {
+  if (unitId == 0x00) {
+    return true;
+  }
+
+  uint8_t frame [] = {
+    (uint8_t) (transactionId >> 8), (uint8_t) (transactionId & 0xFF),
+    0x00, 0x00, // Protocol ID
+    0x00, 0x03, // Length
+    unitId, (uint8_t) (functionCode | 0x80), exceptionCode
+  };
+
+  return writeFrame (index, frame, sizeof (frame));
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of requests in progress, including the completed requests
+ * not handled by sendCompleted() yet.
+ *
+ * @return uint8_t - The number of requests.
+ */
+uint8_t CSE_ModbusRTU_Gateway:: getPendingCount() {
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < MODBUS_RTU_GATEWAY_REQUEST_MAX; i++) {
+    if (requests [i].used) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+#endif
+
+//======================================================================================//
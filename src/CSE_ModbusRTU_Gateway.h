@@ -0,0 +1,141 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Gateway.h
+  Description: Modbus TCP to RTU gateway for Linux and macOS hosts. Accepts Modbus TCP
+  connections and forwards the requests to the serial buses of a CSE_ModbusRTU_Master.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_GATEWAY_H
+#define CSE_MODBUSRTU_GATEWAY_H
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Master.h"
+#include <mutex>
+
+//======================================================================================//
+
+// The maximum number of TCP clients connected at the same time
+#ifndef MODBUS_RTU_GATEWAY_CONNECTION_MAX
+  #define MODBUS_RTU_GATEWAY_CONNECTION_MAX     8U
+#endif
+
+// The maximum number of requests in progress, over all the connections and buses
+#ifndef MODBUS_RTU_GATEWAY_REQUEST_MAX
+  #define MODBUS_RTU_GATEWAY_REQUEST_MAX        32U
+#endif
+
+// The default number of requests that can wait for one bus. See setQueueDepth().
+#ifndef MODBUS_RTU_GATEWAY_QUEUE_DEPTH
+  #define MODBUS_RTU_GATEWAY_QUEUE_DEPTH        8U
+#endif
+
+#define   MODBUS_TCP_DEFAULT_PORT               502U
+#define   MODBUS_TCP_MBAP_LENGTH                7U  // Transaction ID, protocol ID, length and unit ID
+#define   MODBUS_TCP_FRAME_LENGTH_MAX           260U  // MBAP header + 253 bytes of PDU
+
+//======================================================================================//
+/**
+ * @brief A Modbus TCP to RTU gateway. Listens on a TCP port for Modbus TCP clients.
+ * Each request is translated to an RTU ADU, with the unit ID of the MBAP header as the
+ * device address, and is queued to the bus the unit ID is routed to in the master (see
+ * CSE_ModbusRTU_Master::setRoute()). Many TCP clients can have many requests in progress
+ * at the same time. The requests of one bus are sent one after another. The responses
+ * are sent back to the connection the request came from, with the transaction ID of the
+ * request, in the order they are received from the buses.
+ *
+ * The number of requests waiting for a bus is limited by the queue depth. Requests
+ * above that are answered with the exception Server Device Busy (0x06). Requests for a
+ * unit ID with no route are answered with Gateway Path Unavailable (0x0A), and requests
+ * with no response from the bus with Gateway Target Device Failed to Respond (0x0B).
+ * Requests to the unit ID 0x00 are broadcast and not answered.
+ *
+ * All the sockets are handled by poll(). The master can run in either of its modes.
+ * With the polled mode, poll() also runs the master, and must be called with a timeout
+ * of 0.
+ *
+ */
+class CSE_ModbusRTU_Gateway {
+  private:
+    // A TCP client
+    struct connection_t {
+      int fd; // The socket, or -1 if the slot is free
+      uint32_t generation;  // Incremented when the socket is closed
+      uint8_t rxBuffer [MODBUS_TCP_FRAME_LENGTH_MAX]; // Received bytes of the next request
+      size_t rxLength;  // Number of bytes in rxBuffer
+    };
+
+    // A request in progress
+    struct request_t {
+      CSE_ModbusRTU_Master::job_t job;  // The RTU request and response
+      CSE_ModbusRTU_Gateway* gateway; // The owner of the request
+      uint8_t connection; // The index of the connection the request came from
+      uint32_t generation;  // The generation of the connection when the request came
+      uint16_t transactionId; // The transaction ID of the MBAP header
+      uint8_t bus;  // The bus the request is queued to
+      bool used;  // The slot is in use
+    };
+
+    String name; // The name of the gateway
+    CSE_ModbusRTU_Master* master; // Runs the buses
+    int listenSocket; // The listening socket, or -1
+    int wakePipe [2]; // Written by the bus threads when a request is complete
+    uint16_t port;  // The TCP port
+
+    connection_t connections [MODBUS_RTU_GATEWAY_CONNECTION_MAX];
+    request_t requests [MODBUS_RTU_GATEWAY_REQUEST_MAX];
+    uint8_t queueDepth; // Maximum requests waiting for one bus
+    uint8_t pendingCount [MODBUS_RTU_MASTER_BUS_COUNT_MAX]; // Requests waiting for each bus
+
+    std::mutex completedLock; // Protects the completed list
+    uint8_t completedList [MODBUS_RTU_GATEWAY_REQUEST_MAX]; // Indexes of the completed requests
+    uint8_t completedCount; // Number of entries in completedList
+
+    uint32_t requestCount;  // Number of requests forwarded to the buses
+    uint32_t rejectedCount; // Number of requests answered with Server Device Busy
+    uint64_t queueDelayTotal; // Sum of the queueing delays in microseconds
+    uint32_t queueDelayMax; // Longest queueing delay in microseconds
+
+    static void jobComplete (CSE_ModbusRTU_Master::job_t& job, void* context); // Called by the master
+    void acceptConnections(); // Accept the waiting TCP clients
+    void closeConnection (uint8_t index); // Close a TCP client
+    bool readConnection (uint8_t index); // Read and handle the requests of a TCP client
+    void handleRequest (uint8_t index, const uint8_t* frame, size_t length); // Forward a request to a bus
+    int sendCompleted(); // Send the responses of the completed requests
+    bool writeFrame (uint8_t index, const uint8_t* frame, size_t length); // Write a frame to a TCP client
+    bool sendException (uint8_t index, uint16_t transactionId, uint8_t unitId, uint8_t functionCode, uint8_t exceptionCode);
+    uint8_t getPendingCount(); // Number of requests in progress
+
+  public:
+    CSE_ModbusRTU_Gateway (CSE_ModbusRTU_Master& master, String name);
+    ~CSE_ModbusRTU_Gateway();
+
+    bool begin (uint16_t port = MODBUS_TCP_DEFAULT_PORT, const char* address = "0.0.0.0"); // Start listening
+    void end(); // Close all the connections
+    int poll (int timeout = 0); // Handle the connections and the completed requests
+    String getName(); // Returns the name of the gateway
+
+    uint16_t getPort(); // Get the TCP port
+    bool setQueueDepth (uint8_t depth); // Set the maximum number of requests waiting for one bus
+    uint8_t getQueueDepth(); // Get the queue depth
+    uint8_t getConnectionCount(); // Number of connected TCP clients
+
+    uint32_t getRequestCount(); // Number of requests forwarded to the buses
+    uint32_t getRejectedCount(); // Number of requests rejected because a queue was full
+    uint32_t getQueueDelayAverage(); // Average time the requests waited for a bus in microseconds
+    uint32_t getQueueDelayMax(); // Longest time a request waited for a bus in microseconds
+};
+
+#endif
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,191 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Host.cpp
+  Description: Compatibility layer for building the CSE_ModbusRTU library on hosts
+  without the Arduino core, such as Linux and macOS.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Host.h"
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+
+CSE_ModbusRTU_HostPrint modbusHostSerial;
+
+//======================================================================================//
+/**
+ * @brief Returns the time of the monotonic clock in microseconds.
+ *
+ * @return uint64_t
+ */
+static uint64_t monotonicMicros() {
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return ((uint64_t) now.tv_sec * 1000000ULL) + ((uint64_t) now.tv_nsec / 1000ULL);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the time of the first call in microseconds. This is taken as the time
+ * the program started. A function-local static is used, so that it is also valid when
+ * called from the constructors of other global objects.
+ *
+ * @return uint64_t
+ */
+static uint64_t getStartMicros() {
+  static const uint64_t startMicros = monotonicMicros();
+  return startMicros;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of milliseconds since the program started. Wraps around
+ * after about 49 days, like on Arduino.
+ *
+ * @return uint32_t
+ */
+uint32_t millis() {
+  return (uint32_t) ((monotonicMicros() - getStartMicros()) / 1000ULL);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of microseconds since the program started. Wraps around
+ * after about 71 minutes, like on Arduino.
+ *
+ * @return uint32_t
+ */
+uint32_t micros() {
+  return (uint32_t) (monotonicMicros() - getStartMicros());
+}
+
+//======================================================================================//
+/**
+ * @brief Sleeps for the specified number of milliseconds.
+ *
+ * @param ms
+ */
+void delay (uint32_t ms) {
+  struct timespec duration;
+  duration.tv_sec = ms / 1000;
+  duration.tv_nsec = (long) (ms % 1000) * 1000000L;
+  nanosleep (&duration, NULL);
+}
+
+//======================================================================================//
+/**
+ * @brief Waits for the specified number of microseconds. Short delays are busy waits,
+ * because the sleep functions of the OS are not accurate at that scale.
+ *
+ * @param us
+ */
+void delayMicroseconds (uint32_t us) {
+  if (us >= 1000) {
+    struct timespec duration;
+    duration.tv_sec = us / 1000000;
+    duration.tv_nsec = (long) (us % 1000000) * 1000L;
+    nanosleep (&duration, NULL);
+    return;
+  }
+
+  uint64_t endTime = monotonicMicros() + us;
+
+  while (monotonicMicros() < endTime) {
+    // Busy wait
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Gives the CPU to other threads.
+ *
+ */
+void yield() {
+  sched_yield();
+}
+
+//======================================================================================//
+/**
+ * @brief Prints an unsigned number in the specified base, without leading zeros.
+ *
+ * @param value
+ * @param base 2 to 16.
+ */
+void CSE_ModbusRTU_HostPrint:: printNumber (unsigned long value, int base) {
+  char buffer [8 * sizeof (unsigned long) + 1];
+  char* p = &buffer [sizeof (buffer) - 1];
+  *p = '\0';
+
+  if ((base < 2) || (base > 16)) {
+    base = DEC;
+  }
+
+  do {
+    unsigned long digit = value % base;
+    *--p = (char) ((digit < 10) ? ('0' + digit) : ('A' + digit - 10));
+    value /= base;
+  } while (value > 0);
+
+  fputs (p, stdout);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (const char* text) {
+  fputs (text, stdout);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (const String& text) {
+  fputs (text.c_str(), stdout);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (char c) {
+  fputc (c, stdout);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (unsigned char value, int base) {
+  printNumber (value, base);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (int value, int base) {
+  print ((long) value, base);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (unsigned int value, int base) {
+  printNumber (value, base);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (long value, int base) {
+  // Like Arduino, negative numbers only have a sign in base 10.
+  if ((value < 0) && (base == DEC)) {
+    fputc ('-', stdout);
+    printNumber ((unsigned long) (-(value + 1)) + 1, base);
+    return;
+  }
+
+  printNumber ((unsigned long) value, base);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (unsigned long value, int base) {
+  printNumber (value, base);
+}
+
+void CSE_ModbusRTU_HostPrint:: print (double value) {
+  printf ("%.2f", value);
+}
+
+void CSE_ModbusRTU_HostPrint:: println() {
+  fputs ("\r\n", stdout);
+}
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,118 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Host.h
+  Description: Compatibility layer for building the CSE_ModbusRTU library on hosts
+  without the Arduino core, such as Linux and macOS.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_HOST_H
+#define CSE_MODBUSRTU_HOST_H
+
+#if !defined(ARDUINO)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+//======================================================================================//
+// The parts of the Arduino API used by the library.
+
+#define   DEC           10
+#define   HEX           16
+#define   F(string_literal)   (string_literal)
+
+typedef std::string String;
+
+uint32_t millis(); // Milliseconds since the program started
+uint32_t micros(); // Microseconds since the program started
+void delay (uint32_t ms);
+void delayMicroseconds (uint32_t us);
+void yield();
+
+//======================================================================================//
+/**
+ * @brief A minimal replacement for the Arduino Print class. Used for the debug messages
+ * of the library. The messages are written to the standard output.
+ *
+ */
+class CSE_ModbusRTU_HostPrint {
+  private:
+    void printNumber (unsigned long value, int base);
+
+  public:
+    void print (const char* text);
+    void print (const String& text);
+    void print (char c);
+    void print (unsigned char value, int base = DEC);
+    void print (int value, int base = DEC);
+    void print (unsigned int value, int base = DEC);
+    void print (long value, int base = DEC);
+    void print (unsigned long value, int base = DEC);
+    void print (double value);
+
+    void println();
+
+    template <typename T> void println (T value) {
+      print (value);
+      println();
+    }
+
+    template <typename T> void println (T value, int base) {
+      print (value, base);
+      println();
+    }
+};
+
+extern CSE_ModbusRTU_HostPrint modbusHostSerial; // The default debug port on hosts
+
+//======================================================================================//
+/**
+ * @brief The serial port interface used by CSE_ModbusRTU on hosts. It has the same
+ * functions the library uses from the RS485Class of CSE_ArduinoRS485. A backend such as
+ * CSE_ModbusRTU_PosixSerial implements it. The DE/RE functions return false when the
+ * pins are not controlled by the backend.
+ *
+ */
+class CSE_ModbusRTU_HostSerial {
+  protected:
+    int preDelay; // Time from asserting DE to the first byte in microseconds
+    int postDelay;  // Time from the last byte to deasserting DE in microseconds
+
+  public:
+    CSE_ModbusRTU_HostSerial() : preDelay (0), postDelay (0) {}
+    virtual ~CSE_ModbusRTU_HostSerial() {}
+
+    virtual int available() = 0;  // Number of bytes that can be read
+    virtual int read() = 0; // Read a byte, or -1 if none is available
+    virtual int peek() = 0; // Read a byte without removing it, or -1 if none is available
+    virtual size_t write (uint8_t byte) = 0;  // Write a byte
+    virtual size_t write (const uint8_t* buffer, size_t size) = 0;  // Write a buffer
+    virtual void flush() = 0; // Wait until all the written bytes are sent
+
+    virtual void beginTransmission() {} // Enable the driver before writing
+    virtual void endTransmission() {} // Disable the driver after writing
+
+    virtual bool assertDE() { return false; }
+    virtual bool deassertDE() { return false; }
+    virtual bool assertRE() { return false; }
+    virtual bool deassertRE() { return false; }
+
+    virtual void setDelays (int preDelay, int postDelay) {
+      this->preDelay = preDelay;
+      this->postDelay = postDelay;
+    }
+};
+
+#endif
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,1018 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Journal.cpp
+  Description: Saves the holding registers written by the client to a journal in flash,
+  EEPROM or a file, and restores them when the server starts.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#include "CSE_ModbusRTU_Journal.h"
+#include <string.h>
+
+#if !defined(ARDUINO)
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/stat.h>
+#endif
+
+//======================================================================================//
+/**
+ * @brief Stores a 16-bit value in little-endian order.
+ *
+ * @param buffer The buffer.
+ * @param value The value.
+ */
+static void putWord (uint8_t* buffer, uint16_t value) {
+  buffer [0] = (uint8_t) (value & 0xFF);
+  buffer [1] = (uint8_t) (value >> 8);
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a 16-bit value in little-endian order.
+ *
+ * @param buffer The buffer.
+ * @return uint16_t - The value.
+ */
+static uint16_t getWord (const uint8_t* buffer) {
+  return (uint16_t) (buffer [0] | (buffer [1] << 8));
+}
+
+//======================================================================================//
+/**
+ * @brief Constructor.
+ *
+ * @param memory The array. It must have pageSize * pageCount bytes.
+ * @param pageSize The number of bytes in a page.
+ * @param pageCount The number of pages.
+ */
+CSE_ModbusRTU_MemoryJournalStorage:: CSE_ModbusRTU_MemoryJournalStorage (uint8_t* memory, uint32_t pageSize, uint16_t pageCount) {
+  this->memory = memory;
+  this->pageSize = pageSize;
+  this->pageCount = pageCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes in a page.
+ *
+ * @return uint32_t
+ */
+uint32_t CSE_ModbusRTU_MemoryJournalStorage:: getPageSize() {
+  return pageSize;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of pages.
+ *
+ * @return uint16_t
+ */
+uint16_t CSE_ModbusRTU_MemoryJournalStorage:: getPageCount() {
+  return pageCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads bytes from the array.
+ *
+ * @param offset The offset of the first byte.
+ * @param data The bytes are saved here.
+ * @param length The number of bytes.
+ * @return true - The bytes were read.
+ * @return false - The range is outside the array.
+ */
+bool CSE_ModbusRTU_MemoryJournalStorage:: read (uint32_t offset, uint8_t* data, uint32_t length) {
+  if (((uint64_t) offset + length) > ((uint64_t) pageSize * pageCount)) {
+    return false;
+  }
+
+  memcpy (data, memory + offset, length);
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes bytes to the array. Like in a NOR flash, the bits can only be cleared.
+ *
+ * @param offset The offset of the first byte.
+ * @param data The bytes to write.
+ * @param length The number of bytes.
+ * @return true - The bytes were written.
+ * @return false - The range is outside the array.
+ */
+bool CSE_ModbusRTU_MemoryJournalStorage:: write (uint32_t offset, const uint8_t* data, uint32_t length) {
+  if (((uint64_t) offset + length) > ((uint64_t) pageSize * pageCount)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < length; i++) {
+    memory [offset + i] &= data [i];
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets all the bytes of a page to 0xFF.
+ *
+ * @param page The page.
+ * @return true - The page was erased.
+ * @return false - The page does not exist.
+ */
+bool CSE_ModbusRTU_MemoryJournalStorage:: erase (uint16_t page) {
+  if (page >= pageCount) {
+    return false;
+  }
+
+  memset (memory + ((uint32_t) page * pageSize), 0xFF, pageSize);
+  return true;
+}
+
+#if !defined(ARDUINO)
+
+//======================================================================================//
+/**
+ * @brief Constructor. The file is opened by begin().
+ *
+ * @param path The path of the file.
+ * @param pageSize The number of bytes in a page.
+ * @param pageCount The number of pages.
+ */
+CSE_ModbusRTU_FileJournalStorage:: CSE_ModbusRTU_FileJournalStorage (const char* path, uint32_t pageSize, uint16_t pageCount) {
+  this->path = String (path);
+  this->pageSize = pageSize;
+  this->pageCount = pageCount;
+  fd = -1;
+}
+
+//======================================================================================//
+/**
+ * @brief Closes the file.
+ *
+ */
+CSE_ModbusRTU_FileJournalStorage:: ~CSE_ModbusRTU_FileJournalStorage() {
+  end();
+}
+
+//======================================================================================//
+/**
+ * @brief Opens the file. If it does not exist or has a different size, it is created
+ * with all the pages erased.
+ *
+ * @return true - The file is open.
+ * @return false - The file could not be opened. errno has the reason.
+ */
+bool CSE_ModbusRTU_FileJournalStorage:: begin() {
+  end();
+
+  fd = ::open (path.c_str(), O_RDWR | O_CREAT, 0666);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat status;
+  uint64_t length = (uint64_t) pageSize * pageCount;
+
+  if (fstat (fd, &status) != 0) {
+    end();
+    return false;
+  }
+
+  if ((uint64_t) status.st_size == length) {
+    return true;
+  }
+
+  if (ftruncate (fd, (off_t) length) != 0) {
+    end();
+    return false;
+  }
+
+  for (uint16_t page = 0; page < pageCount; page++) {
+    if (!erase (page)) {
+      end();
+      return false;
+    }
+  }
+
+  return sync();
+}
+
+//======================================================================================//
+/**
+ * @brief Closes the file.
+ *
+ */
+void CSE_ModbusRTU_FileJournalStorage:: end() {
+  if (fd >= 0) {
+    close (fd);
+    fd = -1;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if the file is open.
+ *
+ * @return true - The file is open.
+ * @return false - The file is closed.
+ */
+bool CSE_ModbusRTU_FileJournalStorage:: isOpen() {
+  return (fd >= 0);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes in a page.
+ *
+ * @return uint32_t
+ */
+uint32_t CSE_ModbusRTU_FileJournalStorage:: getPageSize() {
+  return pageSize;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of pages.
+ *
+ * @return uint16_t
+ */
+uint16_t CSE_ModbusRTU_FileJournalStorage:: getPageCount() {
+  return pageCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads bytes from the file.
+ *
+ * @param offset The offset of the first byte.
+ * @param data The bytes are saved here.
+ * @param length The number of bytes.
+ * @return true - The bytes were read.
+ * @return false - The file is closed, or the bytes could not be read.
+ */
+bool CSE_ModbusRTU_FileJournalStorage:: read (uint32_t offset, uint8_t* data, uint32_t length) {
+  return (fd >= 0) && (pread (fd, data, length, (off_t) offset) == (ssize_t) length);
+}
+
+//======================================================================================//
+/**
+ * @brief Writes bytes to the file.
+ *
+ * @param offset The offset of the first byte.
+ * @param data The bytes to write.
+ * @param length The number of bytes.
+ * @return true - The bytes were written.
+ * @return false - The file is closed, or the bytes could not be written.
+ */
+bool CSE_ModbusRTU_FileJournalStorage:: write (uint32_t offset, const uint8_t* data, uint32_t length) {
+  return (fd >= 0) && (pwrite (fd, data, length, (off_t) offset) == (ssize_t) length);
+}
+
+//======================================================================================//
+/**
+ * @brief Sets all the bytes of a page to 0xFF.
+ *
+ * @param page The page.
+ * @return true - The page was erased.
+ * @return false - The page does not exist, or could not be written.
+ */
+bool CSE_ModbusRTU_FileJournalStorage:: erase (uint16_t page) {
+  uint8_t erased [256];
+  memset (erased, 0xFF, sizeof (erased));
+
+  if (page >= pageCount) {
+    return false;
+  }
+
+  for (uint32_t offset = 0; offset < pageSize; offset += sizeof (erased)) {
+    uint32_t length = ((pageSize - offset) < sizeof (erased)) ? (pageSize - offset) : sizeof (erased);
+
+    if (!write (((uint32_t) page * pageSize) + offset, erased, length)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes the data of the file to the disk.
+ *
+ * @return true - The data is on the disk.
+ * @return false - The file is closed, or the data could not be written.
+ */
+bool CSE_ModbusRTU_FileJournalStorage:: sync() {
+  return (fd >= 0) && (fsync (fd) == 0);
+}
+
+#endif
+
+//======================================================================================//
+/**
+ * @brief Constructor. The registers are restored by begin().
+ *
+ * @param server The server whose holding registers are saved.
+ * @param storage The storage of the journal.
+ */
+CSE_ModbusRTU_Journal:: CSE_ModbusRTU_Journal (CSE_ModbusRTU_Server& server, CSE_ModbusRTU_JournalStorage& storage) {
+  this->server = &server;
+  this->storage = &storage;
+  hasPending = false;
+  pendingTime = 0;
+  flushDelay = MODBUS_RTU_JOURNAL_FLUSH_DELAY;
+  started = false;
+
+  pageSize = 0;
+  pageCount = 0;
+  tail = 0;
+  head = 0;
+  usedPages = 0;
+  headOffset = 0;
+  sequence = 0;
+  snapshotPages = 0;
+
+  compacting = false;
+  snapshotStart = MODBUS_RTU_JOURNAL_PAGE_NONE;
+  snapshotBlock = 0;
+  snapshotAddress = 0;
+  reclaimEnd = MODBUS_RTU_JOURNAL_PAGE_NONE;
+
+  recordCount = 0;
+  restoreCount = 0;
+  compactionCount = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes in a record.
+ *
+ * @param count The number of registers in the record.
+ * @return uint32_t - The size, with the padding.
+ */
+uint32_t CSE_ModbusRTU_Journal:: getRecordSize (uint16_t count) {
+  return ((6UL + (2UL * count)) + 3) & ~3UL;
+}
+
+//======================================================================================//
+/**
+ * @brief Restores the holding registers of the server from the journal, and starts
+ * saving the writes of the client. The holding registers must be configured before
+ * this. The journal must have at least twice the pages of a snapshot of all the holding
+ * registers, and two more.
+ *
+ * @return true - The journal was started.
+ * @return false - The storage is too small or could not be read, or there are no holding
+ * registers.
+ */
+bool CSE_ModbusRTU_Journal:: begin() {
+  end();
+
+  pageSize = storage->getPageSize();
+  pageCount = storage->getPageCount();
+
+  if ((pageSize < (MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE + MODBUS_RTU_JOURNAL_RECORD_SIZE_MAX)) || (pageCount == 0) || (pageCount == MODBUS_RTU_JOURNAL_PAGE_NONE)) {
+    return false;
+  }
+
+  if (server->holdingRegisters.getBlockCount() == 0) {
+    return false;
+  }
+
+  // The marks have the same ranges as the holding registers. The size of a snapshot is
+  // found by packing its records into pages.
+  pending.clear();
+  snapshotPages = 1;
+  uint32_t offset = MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE;
+
+  for (size_t i = 0; i < server->holdingRegisters.getBlockCount(); i++) {
+    CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t* block = server->holdingRegisters.getBlock (i);
+
+    for (uint32_t done = 0; done < block->length;) {
+      uint16_t count = ((block->length - done) < MODBUS_RTU_JOURNAL_RUN_MAX) ? (uint16_t) (block->length - done) : MODBUS_RTU_JOURNAL_RUN_MAX;
+
+      if (!pending.add ((uint16_t) (block->address + done), count)) {
+        return false;
+      }
+
+      if ((offset + getRecordSize (count)) > pageSize) {
+        snapshotPages++;
+        offset = MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE;
+      }
+
+      offset += getRecordSize (count);
+      done += count;
+    }
+  }
+
+  if ((offset + getRecordSize (0)) > pageSize) {
+    snapshotPages++;
+  }
+
+  if (pageCount < ((2UL * snapshotPages) + 2)) {
+    return false;
+  }
+
+  // Find the pages in use, and sort them by their sequence numbers
+  std::vector <uint32_t> sequences;
+  std::vector <uint16_t> pages;
+  uint8_t header [MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE];
+
+  for (uint16_t page = 0; page < pageCount; page++) {
+    if (!storage->read ((uint32_t) page * pageSize, header, sizeof (header))) {
+      return false;
+    }
+
+    if ((header [4] != MODBUS_RTU_JOURNAL_MAGIC) || (getWord (header + 6) != CSE_ModbusRTU_CRC:: calculate (header, 6))) {
+      continue;
+    }
+
+    uint32_t number = (uint32_t) getWord (header) | ((uint32_t) getWord (header + 2) << 16);
+    size_t index = pages.size();
+
+    while ((index > 0) && (sequences [index - 1] > number)) {
+      index--;
+    }
+
+    sequences.insert (sequences.begin() + index, number);
+    pages.insert (pages.begin() + index, page);
+  }
+
+  // Replay the records from the oldest page to the newest
+  bool snapshotOpen = false;
+  uint32_t snapshotEnd = 0;
+
+  compacting = false;
+  snapshotStart = MODBUS_RTU_JOURNAL_PAGE_NONE;
+  reclaimEnd = MODBUS_RTU_JOURNAL_PAGE_NONE;
+  recordCount = 0;
+  restoreCount = 0;
+  compactionCount = 0;
+
+  for (size_t i = 0; i < pages.size(); i++) {
+    if (!restorePage (pages [i], snapshotOpen, snapshotEnd)) {
+      return false;
+    }
+  }
+
+  if (pages.size() == 0) {
+    tail = 0;
+    head = 0;
+    usedPages = 0;
+    headOffset = pageSize;
+    sequence = 0;
+  }
+  else {
+    tail = pages.front();
+    head = pages.back();
+    usedPages = ((head + pageCount - tail) % pageCount) + 1;
+    sequence = sequences.back();
+
+    // A record cut short by a reset leaves bytes that can not be written again
+    if (!isErased (head, headOffset)) {
+      headOffset = pageSize;
+    }
+  }
+
+  // A snapshot stopped by a reset is continued after its last record
+  if (snapshotOpen) {
+    compacting = true;
+    seekSnapshot (snapshotEnd);
+  }
+
+  hasPending = false;
+  started = true;
+  server->setWriteCallback (onWrite, this);
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Stops saving the writes of the client. The writes not saved yet are lost, so
+ * call flush() first.
+ *
+ */
+void CSE_ModbusRTU_Journal:: end() {
+  if (started) {
+    server->setWriteCallback (NULL);
+    started = false;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Replays the records of a page into the holding registers of the server. The
+ * replay stops at the first record that is erased or not valid.
+ *
+ * @param page The page.
+ * @param snapshotOpen Set if a snapshot was started and has not ended.
+ * @param snapshotEnd One past the last address saved by the open snapshot.
+ * @return true - The page was read.
+ * @return false - The storage could not be read.
+ */
+bool CSE_ModbusRTU_Journal:: restorePage (uint16_t page, bool& snapshotOpen, uint32_t& snapshotEnd) {
+  uint8_t record [MODBUS_RTU_JOURNAL_RECORD_SIZE_MAX];
+  uint16_t values [MODBUS_RTU_JOURNAL_RUN_MAX];
+  uint32_t base = (uint32_t) page * pageSize;
+
+  if (!storage->read (base, record, MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE)) {
+    return false;
+  }
+
+  if (record [5] & MODBUS_RTU_JOURNAL_PAGE_SNAPSHOT) {
+    snapshotStart = page;
+    snapshotOpen = true;
+    snapshotEnd = 0;
+  }
+
+  headOffset = MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE;
+
+  while ((headOffset + getRecordSize (0)) <= pageSize) {
+    if (!storage->read (base + headOffset, record, 4)) {
+      return false;
+    }
+
+    uint16_t address = getWord (record);
+    uint16_t count = getWord (record + 2);
+
+    // An erased record has a count of 0xFFFF
+    if ((count > MODBUS_RTU_JOURNAL_RUN_MAX) || ((headOffset + getRecordSize (count)) > pageSize)) {
+      break;
+    }
+
+    if (!storage->read (base + headOffset + 4, record + 4, getRecordSize (count) - 4)) {
+      return false;
+    }
+
+    if (getWord (record + 4 + (2 * count)) != CSE_ModbusRTU_CRC:: calculate (record, 4 + (2 * count))) {
+      break;
+    }
+
+    headOffset += getRecordSize (count);
+
+    // The end of a snapshot. The pages before it are not needed any more.
+    if (count == 0) {
+      if (snapshotOpen) {
+        reclaimEnd = snapshotStart;
+        snapshotOpen = false;
+      }
+
+      continue;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+      values [i] = getWord (record + 4 + (2 * i));
+    }
+
+    // If the holding registers were configured differently, restore the ones present
+    if (server->writeHoldingRegister (address, count, values) != 1) {
+      for (uint16_t i = 0; i < count; i++) {
+        server->writeHoldingRegister ((uint16_t) (address + i), values [i]);
+      }
+    }
+
+    restoreCount++;
+
+    if (snapshotOpen) {
+      snapshotEnd = (uint32_t) address + count;
+    }
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if the rest of a page is erased.
+ *
+ * @param page The page.
+ * @param offset The first byte to check.
+ * @return true - All the bytes from the offset are 0xFF.
+ * @return false - A byte was written, or the storage could not be read.
+ */
+bool CSE_ModbusRTU_Journal:: isErased (uint16_t page, uint32_t offset) {
+  uint8_t buffer [32];
+
+  while (offset < pageSize) {
+    uint32_t length = ((pageSize - offset) < sizeof (buffer)) ? (pageSize - offset) : sizeof (buffer);
+
+    if (!storage->read (((uint32_t) page * pageSize) + offset, buffer, length)) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+      if (buffer [i] != 0xFF) {
+        return false;
+      }
+    }
+
+    offset += length;
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Starts writing the page after the head. The page is erased first if needed.
+ *
+ * @param flags The flags of the page header.
+ * @return true - The page was started.
+ * @return false - There is no free page, or the storage failed.
+ */
+bool CSE_ModbusRTU_Journal:: openPage (uint8_t flags) {
+  if (usedPages >= pageCount) {
+    return false;
+  }
+
+  uint16_t next = (usedPages == 0) ? tail : ((head + 1) % pageCount);
+
+  if (!isErased (next, 0) && !storage->erase (next)) {
+    return false;
+  }
+
+  uint8_t header [MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE];
+
+  putWord (header, (uint16_t) ((sequence + 1) & 0xFFFF));
+  putWord (header + 2, (uint16_t) ((sequence + 1) >> 16));
+  header [4] = MODBUS_RTU_JOURNAL_MAGIC;
+  header [5] = flags;
+  putWord (header + 6, CSE_ModbusRTU_CRC:: calculate (header, 6));
+
+  if (!storage->write ((uint32_t) next * pageSize, header, sizeof (header))) {
+    return false;
+  }
+
+  if (usedPages == 0) {
+    tail = next;
+  }
+
+  sequence++;
+  head = next;
+  headOffset = MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE;
+  usedPages++;
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Makes room for a record in the head page. A new page is started if the head
+ * page is full. The changes are not allowed to take the pages kept for a snapshot, and
+ * one more page. A record of a snapshot that failed, or was cut short by a reset, leaves
+ * the rest of its page unused, and the snapshot goes on in that page.
+ *
+ * @param length The size of the record.
+ * @param snapshot The record is part of a snapshot.
+ * @return true - The record fits in the head page.
+ * @return false - There is no page to use.
+ */
+bool CSE_ModbusRTU_Journal:: reserve (uint32_t length, bool snapshot) {
+  if ((usedPages > 0) && ((headOffset + length) <= pageSize)) {
+    return true;
+  }
+
+  uint16_t freePages = pageCount - usedPages;
+
+  if ((freePages == 0) || (!snapshot && (freePages <= (snapshotPages + 1U)))) {
+    return false;
+  }
+
+  return openPage (0);
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a record at the end of the head page. reserve() must be called first.
+ *
+ * @param address The first address.
+ * @param count The number of registers. 0 for the end of a snapshot.
+ * @param values The values.
+ * @return true - The record was written.
+ * @return false - The storage failed. The rest of the page is not used.
+ */
+bool CSE_ModbusRTU_Journal:: appendRecord (uint16_t address, uint16_t count, const uint16_t* values) {
+  uint8_t record [MODBUS_RTU_JOURNAL_RECORD_SIZE_MAX];
+  uint32_t length = getRecordSize (count);
+
+  putWord (record, address);
+  putWord (record + 2, count);
+
+  for (uint16_t i = 0; i < count; i++) {
+    putWord (record + 4 + (2 * i), values [i]);
+  }
+
+  putWord (record + 4 + (2 * count), CSE_ModbusRTU_CRC:: calculate (record, 4 + (2 * count)));
+  memset (record + 6 + (2 * count), 0xFF, length - (6 + (2 * count)));
+
+  if (!storage->write (((uint32_t) head * pageSize) + headOffset, record, length)) {
+    headOffset = pageSize;
+    return false;
+  }
+
+  headOffset += length;
+  recordCount++;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the next address saved by the snapshot. If the address is not present,
+ * the next present address is used.
+ *
+ * @param address The address. Can be 0x10000 after the last address.
+ */
+void CSE_ModbusRTU_Journal:: seekSnapshot (uint32_t address) {
+  for (snapshotBlock = 0; snapshotBlock < server->holdingRegisters.getBlockCount(); snapshotBlock++) {
+    CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t* block = server->holdingRegisters.getBlock (snapshotBlock);
+
+    if (((uint32_t) block->address + block->length) > address) {
+      snapshotAddress = (block->address > address) ? block->address : address;
+      return;
+    }
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Starts a snapshot on a new page.
+ *
+ * @return int - 1 if started; -1 if there is no free page.
+ */
+int CSE_ModbusRTU_Journal:: startSnapshot() {
+  if (!openPage (MODBUS_RTU_JOURNAL_PAGE_SNAPSHOT)) {
+    return -1;
+  }
+
+  compacting = true;
+  snapshotStart = head;
+  seekSnapshot (0);
+
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Saves the next range of the snapshot. Ends the snapshot when all the holding
+ * registers are saved. If a record can not be written, the rest of the page is not used,
+ * and the next call writes the same range again on a new page.
+ *
+ * @return int - 1 if a record was written; -1 if failed.
+ */
+int CSE_ModbusRTU_Journal:: writeSnapshot() {
+  CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t* block = server->holdingRegisters.getBlock (snapshotBlock);
+
+  // All the registers are saved, so the pages before the snapshot are not needed
+  if (block == NULL) {
+    if (!reserve (getRecordSize (0), true) || !appendRecord (0, 0, NULL) || !storage->sync()) {
+      return -1;
+    }
+
+    compacting = false;
+    compactionCount++;
+    reclaimEnd = snapshotStart;
+
+    return 1;
+  }
+
+  uint32_t blockEnd = (uint32_t) block->address + block->length;
+  uint16_t count = ((blockEnd - snapshotAddress) < MODBUS_RTU_JOURNAL_RUN_MAX) ? (uint16_t) (blockEnd - snapshotAddress) : MODBUS_RTU_JOURNAL_RUN_MAX;
+  uint16_t values [MODBUS_RTU_JOURNAL_RUN_MAX];
+
+  if (!reserve (getRecordSize (count), true)) {
+    return -1;
+  }
+
+  // The marks are cleared before the values are read, so a later write is saved again
+  pending.setBit ((uint16_t) snapshotAddress, 0, count);
+  server->readHoldingRegister ((uint16_t) snapshotAddress, count, values);
+
+  if (!appendRecord ((uint16_t) snapshotAddress, count, values)) {
+    return -1;
+  }
+
+  seekSnapshot (snapshotAddress + count);
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Saves the first range of marked registers. Starts a snapshot instead if the
+ * journal is running out of pages.
+ *
+ * @return int - 1 if a record or a snapshot was started; 0 if nothing is marked; -1 if
+ * failed.
+ */
+int CSE_ModbusRTU_Journal:: writePending() {
+  uint16_t address, count;
+  uint16_t values [MODBUS_RTU_JOURNAL_RUN_MAX];
+
+  if (!pending.findSet (address, count)) {
+    hasPending = false;
+    return storage->sync() ? 0 : -1;
+  }
+
+  if (count > MODBUS_RTU_JOURNAL_RUN_MAX) {
+    count = MODBUS_RTU_JOURNAL_RUN_MAX;
+  }
+
+  if (!reserve (getRecordSize (count), false)) {
+    return startSnapshot();
+  }
+
+  // The marks are cleared before the values are read, so a later write is saved again
+  pending.setBit (address, 0, count);
+  server->readHoldingRegister (address, count, values);
+
+  return appendRecord (address, count, values) ? 1 : -1;
+}
+
+//======================================================================================//
+/**
+ * @brief Erases the oldest page before the last snapshot.
+ *
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_Journal:: reclaim() {
+  if (tail != reclaimEnd) {
+    if (!storage->erase (tail)) {
+      return -1;
+    }
+
+    tail = (tail + 1) % pageCount;
+    usedPages--;
+  }
+
+  if (tail == reclaimEnd) {
+    reclaimEnd = MODBUS_RTU_JOURNAL_PAGE_NONE;
+  }
+
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Does the next piece of work. Erasing the pages before a snapshot comes first,
+ * then the snapshot, and then the marked registers.
+ *
+ * @param force Save the marked registers without waiting for the flush delay.
+ * @return int - 1 if there is more work; 0 if idle; -1 if failed.
+ */
+int CSE_ModbusRTU_Journal:: step (bool force) {
+  if (!started) {
+    return -1;
+  }
+
+  if (reclaimEnd != MODBUS_RTU_JOURNAL_PAGE_NONE) {
+    return reclaim();
+  }
+
+  if (compacting) {
+    return writeSnapshot();
+  }
+
+  if (hasPending && (force || ((millis() - pendingTime) >= flushDelay))) {
+    return writePending();
+  }
+
+  return 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Saves the writes in the background. Call it from the loop that polls the
+ * server, and from the same thread. Each call writes at most one record, or erases one
+ * page.
+ *
+ * @return int - 1 if something was written or erased; 0 if idle; -1 if the storage
+ * failed or the journal is not started.
+ */
+int CSE_ModbusRTU_Journal:: poll() {
+  return step (false);
+}
+
+//======================================================================================//
+/**
+ * @brief Saves all the marked registers now, and finishes any snapshot. Use it before
+ * the power is turned off.
+ *
+ * @return true - All the writes are saved.
+ * @return false - The storage failed or the journal is not started.
+ */
+bool CSE_ModbusRTU_Journal:: flush() {
+  int result;
+
+  do {
+    result = step (true);
+  } while (result > 0);
+
+  return (result == 0);
+}
+
+//======================================================================================//
+/**
+ * @brief The write callback of the server. Marks the registers written by the client.
+ *
+ * @param address The first address.
+ * @param count The number of registers.
+ * @param context The journal.
+ */
+void CSE_ModbusRTU_Journal:: onWrite (uint16_t address, uint16_t count, void* context) {
+  ((CSE_ModbusRTU_Journal*) context)->mark (address, count);
+}
+
+//======================================================================================//
+/**
+ * @brief Marks a range of holding registers to be saved. The writes of the client are
+ * marked by the server. Call this after the application writes holding registers that
+ * must be kept.
+ *
+ * @param address The first address.
+ * @param count The number of registers.
+ */
+void CSE_ModbusRTU_Journal:: mark (uint16_t address, uint16_t count) {
+  if (!pending.setBit (address, 1, count)) {
+    return;
+  }
+
+  if (!hasPending) {
+    hasPending = true;
+    pendingTime = millis();
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if any marked register is not saved yet.
+ *
+ * @return true - Some writes are not saved.
+ * @return false - All the writes are saved.
+ */
+bool CSE_ModbusRTU_Journal:: isPending() {
+  return hasPending;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the time from the first unsaved write to saving it. The writes in this
+ * time are saved together, so a longer delay wears the flash less, and loses more
+ * writes when the power fails.
+ *
+ * @param delay The delay in milliseconds.
+ */
+void CSE_ModbusRTU_Journal:: setFlushDelay (uint32_t delay) {
+  flushDelay = delay;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of pages in use.
+ *
+ * @return uint16_t
+ */
+uint16_t CSE_ModbusRTU_Journal:: getUsedPageCount() {
+  return usedPages;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of records written since begin().
+ *
+ * @return uint32_t
+ */
+uint32_t CSE_ModbusRTU_Journal:: getRecordCount() {
+  return recordCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of records replayed by begin().
+ *
+ * @return uint32_t
+ */
+uint32_t CSE_ModbusRTU_Journal:: getRestoreCount() {
+  return restoreCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of snapshots completed since begin().
+ *
+ * @return uint32_t
+ */
+uint32_t CSE_ModbusRTU_Journal:: getCompactionCount() {
+  return compactionCount;
+}
+
+//======================================================================================//
@@ -0,0 +1,219 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Journal.h
+  Description: Saves the holding registers written by the client to a journal in flash,
+  EEPROM or a file, and restores them when the server starts.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_JOURNAL_H
+#define CSE_MODBUSRTU_JOURNAL_H
+
+#include "CSE_ModbusRTU.h"
+
+//======================================================================================//
+
+// The maximum number of registers in one record. A longer range is saved as several
+// records. A record takes 6 bytes and 2 bytes per register, rounded up to 4 bytes.
+#ifndef MODBUS_RTU_JOURNAL_RUN_MAX
+  #if defined(ARDUINO_ARCH_AVR)
+    #define MODBUS_RTU_JOURNAL_RUN_MAX                  8U
+  #else
+    #define MODBUS_RTU_JOURNAL_RUN_MAX                  32U
+  #endif
+#endif
+
+// The time in milliseconds from the first unsaved write to saving it. All the writes made
+// in this time are saved together, and each register only once.
+#ifndef MODBUS_RTU_JOURNAL_FLUSH_DELAY
+  #define MODBUS_RTU_JOURNAL_FLUSH_DELAY                1000UL
+#endif
+
+#define   MODBUS_RTU_JOURNAL_MAGIC                      0x4AU // The byte 'J'
+#define   MODBUS_RTU_JOURNAL_PAGE_HEADER_SIZE           8U
+#define   MODBUS_RTU_JOURNAL_PAGE_SNAPSHOT              0x01U // The page starts a snapshot
+#define   MODBUS_RTU_JOURNAL_RECORD_SIZE_MAX            (((6U + (2U * MODBUS_RTU_JOURNAL_RUN_MAX)) + 3U) & ~3U)
+#define   MODBUS_RTU_JOURNAL_PAGE_NONE                  0xFFFFU
+
+//======================================================================================//
+/**
+ * @brief The storage of a journal. It is a number of pages of the same size, such as the
+ * sectors of a flash memory. A page is erased as a whole, which sets all its bytes to
+ * 0xFF. The journal only writes bytes that are erased, and never writes the same byte
+ * twice, so the storage can be a NOR flash, an EEPROM or a file.
+ *
+ * Implement this class for the flash or EEPROM of your board.
+ *
+ */
+class CSE_ModbusRTU_JournalStorage {
+  public:
+    virtual ~CSE_ModbusRTU_JournalStorage() {}
+
+    virtual uint32_t getPageSize() = 0; // Bytes in a page
+    virtual uint16_t getPageCount() = 0;  // Number of pages
+    virtual bool read (uint32_t offset, uint8_t* data, uint32_t length) = 0;  // Read bytes
+    virtual bool write (uint32_t offset, const uint8_t* data, uint32_t length) = 0; // Write erased bytes
+    virtual bool erase (uint16_t page) = 0; // Set all the bytes of a page to 0xFF
+    virtual bool sync() { return true; }  // Make the writes durable
+};
+
+//======================================================================================//
+/**
+ * @brief Journal storage in an array in RAM. A write can only clear bits, like in a NOR
+ * flash. Use it for testing, or with memory that keeps its contents while the processor
+ * is reset, such as the RTC memory of an ESP32.
+ *
+ */
+class CSE_ModbusRTU_MemoryJournalStorage final : public CSE_ModbusRTU_JournalStorage {
+  private:
+    uint8_t* memory;  // pageSize * pageCount bytes
+    uint32_t pageSize;
+    uint16_t pageCount;
+
+  public:
+    CSE_ModbusRTU_MemoryJournalStorage (uint8_t* memory, uint32_t pageSize, uint16_t pageCount);
+
+    uint32_t getPageSize();
+    uint16_t getPageCount();
+    bool read (uint32_t offset, uint8_t* data, uint32_t length);
+    bool write (uint32_t offset, const uint8_t* data, uint32_t length);
+    bool erase (uint16_t page);
+};
+
+#if !defined(ARDUINO)
+
+//======================================================================================//
+/**
+ * @brief Journal storage in a file, for Linux and macOS hosts. The file is created with
+ * all its pages erased if it does not exist or has a different size.
+ *
+ */
+class CSE_ModbusRTU_FileJournalStorage final : public CSE_ModbusRTU_JournalStorage {
+  private:
+    String path;  // The path of the file
+    uint32_t pageSize;
+    uint16_t pageCount;
+    int fd; // The file descriptor, or -1 if the file is closed
+
+  public:
+    CSE_ModbusRTU_FileJournalStorage (const char* path, uint32_t pageSize = 4096, uint16_t pageCount = 8);
+    ~CSE_ModbusRTU_FileJournalStorage();
+
+    bool begin(); // Open or create the file
+    void end(); // Close the file
+    bool isOpen();  // Check if the file is open
+
+    uint32_t getPageSize();
+    uint16_t getPageCount();
+    bool read (uint32_t offset, uint8_t* data, uint32_t length);
+    bool write (uint32_t offset, const uint8_t* data, uint32_t length);
+    bool erase (uint16_t page);
+    bool sync();
+};
+
+#endif
+
+//======================================================================================//
+/**
+ * @brief Saves the holding registers written by the client, and restores them when the
+ * server starts. The journal is a ring of pages. Each write of the client only marks its
+ * registers in a bit map, in the response path. poll() later appends the marked
+ * registers to the journal as records, so repeated writes to a register are saved once.
+ * The records are never changed, so a flash page is only written once between erases.
+ *
+ * When the free pages are about to run out, poll() writes a snapshot of all the holding
+ * registers, a record at a time, and then erases the pages before it, a page at a time.
+ * So no call of poll() does more than one record write or one page erase.
+ *
+ * begin() replays the records of all the pages in order, and a crash during a write only
+ * loses the record being written, which is found by its CRC. A snapshot stopped by a
+ * crash is continued after the restart, on a new page if its last record was cut short.
+ * The changes leave a spare page for this.
+ *
+ * Page header (8 bytes, little-endian):
+ *
+ *   0  4  Sequence number of the page. Increases by 1 for every page used.
+ *   4  1  MODBUS_RTU_JOURNAL_MAGIC
+ *   5  1  Flags. MODBUS_RTU_JOURNAL_PAGE_SNAPSHOT if the page starts a snapshot.
+ *   6  2  CRC-16/MODBUS of the previous 6 bytes
+ *
+ * Record (little-endian, padded with 0xFF to a multiple of 4 bytes):
+ *
+ *   0  2  The first address
+ *   2  2  The number of registers, 1 to MODBUS_RTU_JOURNAL_RUN_MAX. 0 marks the end of
+ *         a snapshot.
+ *   4  2n The values
+ *   -  2  CRC-16/MODBUS of the previous bytes
+ *
+ */
+class CSE_ModbusRTU_Journal {
+  private:
+    CSE_ModbusRTU_Server* server; // The server whose holding registers are saved
+    CSE_ModbusRTU_JournalStorage* storage;
+    CSE_ModbusRTU_BitMap pending; // The registers written since they were last saved
+    bool hasPending;  // At least one register is marked
+    uint32_t pendingTime; // The time of the first unsaved write
+    uint32_t flushDelay;
+    bool started; // Set by begin()
+
+    uint32_t pageSize;
+    uint16_t pageCount;
+    uint16_t tail;  // The oldest page in use
+    uint16_t head;  // The page being written
+    uint16_t usedPages; // The pages from the tail to the head
+    uint32_t headOffset;  // The next free byte of the head page
+    uint32_t sequence;  // The sequence number of the head page
+    uint16_t snapshotPages; // The pages a snapshot can take
+
+    bool compacting;  // A snapshot is being written
+    uint16_t snapshotStart; // The first page of the last snapshot
+    size_t snapshotBlock; // The block of the holding registers being saved
+    uint32_t snapshotAddress; // The next address to save
+    uint16_t reclaimEnd;  // The pages before this one can be erased
+
+    uint32_t recordCount; // Records written
+    uint32_t restoreCount;  // Records replayed by begin()
+    uint32_t compactionCount; // Snapshots completed
+
+    static void onWrite (uint16_t address, uint16_t count, void* context); // The write callback of the server
+    static uint32_t getRecordSize (uint16_t count); // The bytes in a record
+
+    bool isErased (uint16_t page, uint32_t offset); // Check if the rest of a page is erased
+    bool openPage (uint8_t flags);  // Start the next page
+    bool reserve (uint32_t length, bool snapshot);  // Make room for a record in the head page
+    bool appendRecord (uint16_t address, uint16_t count, const uint16_t* values); // Write a record
+    bool restorePage (uint16_t page, bool& snapshotOpen, uint32_t& snapshotEnd); // Replay the records of a page
+    void seekSnapshot (uint32_t address); // Set the next address of the snapshot
+    int step (bool force);  // Do the next piece of work
+    int startSnapshot();
+    int writeSnapshot();
+    int writePending();
+    int reclaim();
+
+  public:
+    CSE_ModbusRTU_Journal (CSE_ModbusRTU_Server& server, CSE_ModbusRTU_JournalStorage& storage);
+
+    bool begin(); // Restore the holding registers and start saving the writes of the client
+    void end(); // Stop saving the writes of the client
+    int poll(); // Save the writes in the background
+    bool flush(); // Save all the writes now
+    void mark (uint16_t address, uint16_t count = 1); // Mark registers written by the application to be saved
+    bool isPending(); // Check if any write is not saved yet
+    void setFlushDelay (uint32_t delay); // Set the time from a write to saving it
+
+    uint16_t getUsedPageCount(); // Number of pages in use
+    uint32_t getRecordCount(); // Number of records written
+    uint32_t getRestoreCount(); // Number of records replayed by begin()
+    uint32_t getCompactionCount(); // Number of snapshots completed
+};
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,354 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Loopback.cpp
+  Description: In-memory serial port pair for connecting a CSE_ModbusRTU client and
+  server in one process, for host tests and benchmarks.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Loopback.h"
+
+#define   MODBUS_RTU_LOOPBACK_BUFFER_MASK       (MODBUS_RTU_LOOPBACK_BUFFER_SIZE - 1U)
+
+//======================================================================================//
+/**
+ * @brief Checks if a time has been reached. Works across the wrap around of micros().
+ *
+ * @param time The time to check in microseconds.
+ * @param now The current time in microseconds.
+ * @return true - The time has been reached.
+ * @return false - The time is in the future.
+ */
+static inline bool timeReached (uint32_t time, uint32_t now) {
+  return ((int32_t) (now - time) >= 0);
+}
+
+//======================================================================================//
+/**
+ * @brief Constructor. The port has to be connected to another port with connect().
+ *
+ * @param baudRate The baud rate for pacing the written bytes. 0 disables the pacing.
+ * @param characterBits The number of bits per character, including the start, parity
+ * and stop bits.
+ */
+CSE_ModbusRTU_LoopbackPort:: CSE_ModbusRTU_LoopbackPort (uint32_t baudRate, uint8_t characterBits) : head (0), tail (0), overflowCount (0) {
+  peer = NULL;
+  this->baudRate = baudRate;
+  this->characterBits = (characterBits > 0) ? characterBits : 10;
+  latency = 0;
+  injectedDelay = 0;
+  injectedIndex = 0;
+  delayPending = false;
+  txEndTime = 0;
+  lastReadyTime = 0;
+  txActive = false;
+  lastReadTime = 0;
+  readActive = false;
+  lastGap = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Connects two ports to each other. The bytes written to one port can be read
+ * from the other.
+ *
+ * @param other The other port.
+ */
+void CSE_ModbusRTU_LoopbackPort:: connect (CSE_ModbusRTU_LoopbackPort& other) {
+  peer = &other;
+  other.peer = this;
+}
+
+//======================================================================================//
+/**
+ * @brief Discards all the received bytes. Must only be called from the thread that
+ * reads the port.
+ *
+ */
+void CSE_ModbusRTU_LoopbackPort:: clear() {
+  tail.store (head.load (std::memory_order_acquire), std::memory_order_release);
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the baud rate for pacing the written bytes. A written byte is readable at
+ * the other end only after its transmission time has passed, and flush() waits until
+ * the last byte is sent.
+ *
+ * @param baudRate The baud rate. 0 disables the pacing.
+ * @param characterBits The number of bits per character, including the start, parity
+ * and stop bits.
+ * @return true - Operation successful.
+ * @return false - Invalid character length.
+ */
+bool CSE_ModbusRTU_LoopbackPort:: setBaudRate (uint32_t baudRate, uint8_t characterBits) {
+  if (characterBits == 0) {
+    return false;
+  }
+
+  this->baudRate = baudRate;
+  this->characterBits = characterBits;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the baud rate used for pacing.
+ *
+ * @return uint32_t - The baud rate. 0 if the pacing is disabled.
+ */
+uint32_t CSE_ModbusRTU_LoopbackPort:: getBaudRate() {
+  return baudRate;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets a fixed delay between sending a byte and it becoming readable at the other
+ * end. This can be used to model the latency of USB-serial adapters.
+ *
+ * @param latency The latency in microseconds.
+ */
+void CSE_ModbusRTU_LoopbackPort:: setLatency (uint32_t latency) {
+  this->latency = latency;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the latency set with setLatency().
+ *
+ * @return uint32_t - The latency in microseconds.
+ */
+uint32_t CSE_ModbusRTU_LoopbackPort:: getLatency() {
+  return latency;
+}
+
+//======================================================================================//
+/**
+ * @brief Injects a one-time delay into the next write. The byte at `byteIndex` of the
+ * next write, and all the bytes after it, become readable `delay` microseconds later.
+ * This creates a gap in the middle of a frame, to test the inter-character and
+ * inter-frame timing of the receiver.
+ *
+ * @param delay The delay in microseconds.
+ * @param byteIndex The index of the first delayed byte in the next write.
+ */
+void CSE_ModbusRTU_LoopbackPort:: injectDelay (uint32_t delay, size_t byteIndex) {
+  injectedDelay = delay;
+  injectedIndex = byteIndex;
+  delayPending = true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of received bytes dropped because the buffer of this port
+ * was full.
+ *
+ * @return uint32_t - The overflow count.
+ */
+uint32_t CSE_ModbusRTU_LoopbackPort:: getOverflowCount() {
+  return overflowCount.load (std::memory_order_relaxed);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the silence on the line from the last byte read to the start of the
+ * first byte of the next write. A node must wait for t3.5 after a frame it received
+ * before it sends.
+ *
+ * @return uint32_t - The silence in microseconds. 0 if no byte was read before a write.
+ */
+uint32_t CSE_ModbusRTU_LoopbackPort:: getLastGap() {
+  return lastGap;
+}
+
+//======================================================================================//
+/**
+ * @brief Adds a byte to the receive buffer of this port. Called by the peer when it
+ * writes. If the buffer is full, the byte is dropped, like on a UART that is not read.
+ *
+ * @param byte The byte.
+ * @param readyTime The time the byte becomes readable in microseconds.
+ * @return true - The byte was added.
+ * @return false - The buffer is full.
+ */
+bool CSE_ModbusRTU_LoopbackPort:: push (uint8_t byte, uint32_t readyTime) {
+  size_t currentHead = head.load (std::memory_order_relaxed);
+
+  if ((currentHead - tail.load (std::memory_order_acquire)) >= MODBUS_RTU_LOOPBACK_BUFFER_SIZE) {
+    overflowCount.fetch_add (1, std::memory_order_relaxed);
+    return false;
+  }
+
+  data [currentHead & MODBUS_RTU_LOOPBACK_BUFFER_MASK] = byte;
+  readyTimes [currentHead & MODBUS_RTU_LOOPBACK_BUFFER_MASK] = readyTime;
+  head.store (currentHead + 1, std::memory_order_release);  // Publish the byte
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Counts the bytes whose ready time has passed. The ready times are in order, so
+ * the count stops at the first byte that is not ready.
+ *
+ * @return size_t - Number of readable bytes.
+ */
+size_t CSE_ModbusRTU_LoopbackPort:: countReady() {
+  size_t currentTail = tail.load (std::memory_order_relaxed);
+  size_t currentHead = head.load (std::memory_order_acquire);
+  uint32_t now = micros();
+  size_t count = 0;
+
+  while ((currentTail != currentHead) && timeReached (readyTimes [currentTail & MODBUS_RTU_LOOPBACK_BUFFER_MASK], now)) {
+    currentTail++;
+    count++;
+  }
+
+  return count;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes that can be read. If there are none, the CPU is
+ * given to other threads before returning.
+ *
+ * @return int - Number of bytes available.
+ */
+int CSE_ModbusRTU_LoopbackPort:: available() {
+  size_t count = countReady();
+
+  if (count == 0) {
+    yield();
+  }
+
+  return (int) count;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a byte.
+ *
+ * @return int - The byte, or -1 if no byte is readable.
+ */
+int CSE_ModbusRTU_LoopbackPort:: read() {
+  int byte = peek();
+
+  if (byte >= 0) {
+    size_t currentTail = tail.load (std::memory_order_relaxed);
+
+    lastReadTime = readyTimes [currentTail & MODBUS_RTU_LOOPBACK_BUFFER_MASK];
+    readActive = true;
+    tail.store (currentTail + 1, std::memory_order_release); // Free the entry
+  }
+
+  return byte;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a byte without removing it.
+ *
+ * @return int - The byte, or -1 if no byte is readable.
+ */
+int CSE_ModbusRTU_LoopbackPort:: peek() {
+  size_t currentTail = tail.load (std::memory_order_relaxed);
+
+  if (currentTail == head.load (std::memory_order_acquire)) {
+    return -1;
+  }
+
+  if (!timeReached (readyTimes [currentTail & MODBUS_RTU_LOOPBACK_BUFFER_MASK], micros())) {
+    return -1;
+  }
+
+  return data [currentTail & MODBUS_RTU_LOOPBACK_BUFFER_MASK];
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a byte.
+ *
+ * @param byte The byte to write.
+ * @return size_t - The number of bytes written.
+ */
+size_t CSE_ModbusRTU_LoopbackPort:: write (uint8_t byte) {
+  return write (&byte, 1);
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a buffer to the other end. The function does not wait for the pacing.
+ * The bytes are queued with the times they become readable. If the port is not
+ * connected, the bytes are discarded.
+ *
+ * @param buffer The bytes to write.
+ * @param size The number of bytes.
+ * @return size_t - The number of bytes written.
+ */
+size_t CSE_ModbusRTU_LoopbackPort:: write (const uint8_t* buffer, size_t size) {
+  uint32_t now = micros();
+
+  // The bytes are sent after the previous write has left the line.
+  uint32_t startTime = (txActive && !timeReached (txEndTime, now)) ? txEndTime : now;
+  uint32_t sentTime = startTime;
+
+  if ((size > 0) && readActive) {
+    lastGap = startTime - lastReadTime;
+    readActive = false;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    if (baudRate > 0) {
+      sentTime = startTime + (uint32_t) (((uint64_t) (i + 1) * characterBits * 1000000ULL) / baudRate);
+    }
+
+    uint32_t readyTime = sentTime + latency;
+
+    if (delayPending && (i >= injectedIndex)) {
+      readyTime += injectedDelay;
+    }
+
+    // A byte can not overtake the bytes sent before it.
+    if (txActive && !timeReached (lastReadyTime, readyTime)) {
+      readyTime = lastReadyTime;
+    }
+
+    if (peer != NULL) {
+      peer->push (buffer [i], readyTime);
+    }
+
+    lastReadyTime = readyTime;
+    txActive = true;
+  }
+
+  if (size > 0) {
+    txEndTime = sentTime;
+    delayPending = false;
+  }
+
+  return size;
+}
+
+//======================================================================================//
+/**
+ * @brief Waits until all the written bytes are sent at the pacing baud rate. Returns
+ * immediately if the pacing is disabled.
+ *
+ */
+void CSE_ModbusRTU_LoopbackPort:: flush() {
+  while (txActive && !timeReached (txEndTime, micros())) {
+    yield();
+  }
+}
+
+#endif
+
+//======================================================================================//
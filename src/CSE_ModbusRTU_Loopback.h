@@ -0,0 +1,105 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Loopback.h
+  Description: In-memory serial port pair for connecting a CSE_ModbusRTU client and
+  server in one process, for host tests and benchmarks.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_LOOPBACK_H
+#define CSE_MODBUSRTU_LOOPBACK_H
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Host.h"
+#include <atomic>
+
+//======================================================================================//
+
+// The number of bytes a loopback port can hold before the received bytes are dropped.
+// Must be a power of two.
+#ifndef MODBUS_RTU_LOOPBACK_BUFFER_SIZE
+  #define MODBUS_RTU_LOOPBACK_BUFFER_SIZE       1024U
+#endif
+
+#if (MODBUS_RTU_LOOPBACK_BUFFER_SIZE & (MODBUS_RTU_LOOPBACK_BUFFER_SIZE - 1)) != 0
+  #error "MODBUS_RTU_LOOPBACK_BUFFER_SIZE must be a power of two."
+#endif
+
+//======================================================================================//
+/**
+ * @brief One end of an in-memory serial link. Two ports are connected with connect().
+ * The bytes written to one port can be read from the other port. The ports can be used
+ * from two different threads, one thread for each port.
+ *
+ * Every byte is stored with the time it becomes readable at the other end. By default
+ * the bytes are readable immediately. With a baud rate set, the bytes are paced like on
+ * a real line, and flush() waits until the last byte is sent. A fixed latency can be
+ * added to every byte, and a one-time delay can be injected before any byte of the next
+ * write, to test the frame timing of the receiver. The silence between the last byte read
+ * and the next write is measured, to test the frame timing of the sender.
+ *
+ * When no byte is readable, available() calls yield(). So a client and a server polling
+ * the two ends from two threads also make progress on a single CPU.
+ *
+ */
+class CSE_ModbusRTU_LoopbackPort final : public CSE_ModbusRTU_HostSerial {
+  private:
+    CSE_ModbusRTU_LoopbackPort* peer; // The other end of the link
+
+    uint8_t data [MODBUS_RTU_LOOPBACK_BUFFER_SIZE]; // Received bytes
+    uint32_t readyTimes [MODBUS_RTU_LOOPBACK_BUFFER_SIZE];  // Time each byte becomes readable in microseconds
+    std::atomic <size_t> head; // Next entry to write. Written only by the peer.
+    std::atomic <size_t> tail; // Next entry to read. Written only by this port.
+    std::atomic <uint32_t> overflowCount; // Number of received bytes dropped
+
+    uint32_t baudRate;  // 0 = no pacing
+    uint8_t characterBits;  // Bits per character for pacing
+    uint32_t latency; // Added to the ready time of every byte in microseconds
+    uint32_t injectedDelay; // One-time delay for the next write in microseconds
+    size_t injectedIndex; // Index of the byte in the next write the delay is applied to
+    bool delayPending;  // An injected delay is waiting for the next write
+    uint32_t txEndTime; // Time the last written byte leaves the line
+    uint32_t lastReadyTime; // Ready time of the last written byte
+    bool txActive;  // A byte has been written and txEndTime is valid
+    uint32_t lastReadTime;  // Ready time of the last byte read
+    bool readActive;  // A byte has been read since the last write
+    uint32_t lastGap; // The silence between the last byte read and the next write in microseconds
+
+    bool push (uint8_t byte, uint32_t readyTime); // Called by the peer
+    size_t countReady(); // Number of readable bytes
+
+  public:
+    CSE_ModbusRTU_LoopbackPort (uint32_t baudRate = 0, uint8_t characterBits = 10);
+
+    void connect (CSE_ModbusRTU_LoopbackPort& other); // Connect two ports to each other
+    void clear(); // Discard all received bytes
+
+    bool setBaudRate (uint32_t baudRate, uint8_t characterBits = 10); // Set the pacing. 0 disables it.
+    uint32_t getBaudRate(); // Get the pacing baud rate
+    void setLatency (uint32_t latency); // Set the latency of every byte in microseconds
+    uint32_t getLatency(); // Get the latency in microseconds
+    void injectDelay (uint32_t delay, size_t byteIndex = 0); // Delay a byte of the next write
+    uint32_t getOverflowCount(); // Get the number of received bytes dropped
+    uint32_t getLastGap(); // Get the silence before the last write in microseconds
+
+    int available();
+    int read();
+    int peek();
+    size_t write (uint8_t byte);
+    size_t write (const uint8_t* buffer, size_t size);
+    void flush();
+};
+
+#endif
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,711 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Master.cpp
+  Description: Multi-bus Modbus RTU client runtime for Linux and macOS hosts. Runs the
+  requests of each serial bus on its own worker thread.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Master.h"
+
+//======================================================================================//
+/**
+ * @brief Constructor for the state of a bus.
+ *
+ * @param rtu The node of the bus.
+ */
+CSE_ModbusRTU_Master:: bus_t:: bus_t (CSE_ModbusRTU& rtu) : client (rtu, "masterClient"), requestCount (0), errorCount (0) {
+  this->rtu = &rtu;
+  head = NULL;
+  tail = NULL;
+  stop = false;
+  current = NULL;
+  receiving = false;
+  startTime = 0;
+  turnaroundDelay = MODBUS_RTU_MASTER_TURNAROUND_DELAY;
+  broadcastTime = 0;
+  broadcastPending = false;
+}
+
+//======================================================================================//
+/**
+ * @brief Constructor. Add the buses with addBus() and start them with begin().
+ *
+ * @param name The name of the master.
+ */
+CSE_ModbusRTU_Master:: CSE_ModbusRTU_Master (String name) {
+  this->name = name;
+  busCount = 0;
+  running = false;
+  threaded = false;
+
+  for (uint8_t i = 0; i < MODBUS_RTU_MASTER_BUS_COUNT_MAX; i++) {
+    buses [i] = NULL;
+  }
+
+  for (uint16_t i = 0; i < 256; i++) {
+    routes [i] = MODBUS_RTU_MASTER_BUS_NONE;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Destructor. Stops the buses.
+ *
+ */
+CSE_ModbusRTU_Master:: ~CSE_ModbusRTU_Master() {
+  end();
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    delete buses [i];
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Adds a bus. The CSE_ModbusRTU object must have its own port, and the port must
+ * be ready to use. The buses can only be added before begin().
+ *
+ * @param rtu The node of the bus.
+ * @return int - The index of the bus; -1 if failed.
+ */
+int CSE_ModbusRTU_Master:: addBus (CSE_ModbusRTU& rtu) {
+  if (running || (busCount >= MODBUS_RTU_MASTER_BUS_COUNT_MAX)) {
+    return -1;
+  }
+
+  buses [busCount] = new bus_t (rtu);
+  return busCount++;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of buses.
+ *
+ * @return uint8_t - The number of buses.
+ */
+uint8_t CSE_ModbusRTU_Master:: getBusCount() {
+  return busCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Routes a device address to a bus. Jobs with the bus set to
+ * MODBUS_RTU_MASTER_BUS_AUTO are queued to the bus of the device address of their
+ * request. The routes can only be changed before begin().
+ *
+ * @param deviceAddress The device address (unit ID) of the server.
+ * @param bus The index of the bus, or MODBUS_RTU_MASTER_BUS_NONE to remove the route.
+ * @return true - Operation successful.
+ * @return false - The bus doesn't exist, or the master is running.
+ */
+bool CSE_ModbusRTU_Master:: setRoute (uint8_t deviceAddress, uint8_t bus) {
+  if (running || ((bus >= busCount) && (bus != MODBUS_RTU_MASTER_BUS_NONE))) {
+    return false;
+  }
+
+  routes [deviceAddress] = bus;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the bus a device address is routed to.
+ *
+ * @param deviceAddress The device address (unit ID) of the server.
+ * @return uint8_t - The index of the bus, or MODBUS_RTU_MASTER_BUS_NONE.
+ */
+uint8_t CSE_ModbusRTU_Master:: getRoute (uint8_t deviceAddress) {
+  return routes [deviceAddress];
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the time a request waits for its response on a bus. The default is the
+ * receiveTimeout of CSE_ModbusRTU_Client. Set it before begin().
+ *
+ * @param bus The index of the bus.
+ * @param timeout The timeout in milliseconds.
+ * @return true - Operation successful.
+ * @return false - The bus doesn't exist, or the master is running.
+ */
+bool CSE_ModbusRTU_Master:: setTimeout (uint8_t bus, uint32_t timeout) {
+  if (running || (bus >= busCount)) {
+    return false;
+  }
+
+  buses [bus]->client.receiveTimeout = timeout;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the time the servers of a bus get to process a broadcast request. The
+ * next request on the bus is only sent after this time, counted from the end of the
+ * broadcast. The default is MODBUS_RTU_MASTER_TURNAROUND_DELAY. Set it before begin().
+ *
+ * @param bus The index of the bus.
+ * @param delay The delay in milliseconds. 0 to send the next request at once.
+ * @return true - Operation successful.
+ * @return false - The bus doesn't exist, or the master is running.
+ */
+bool CSE_ModbusRTU_Master:: setTurnaroundDelay (uint8_t bus, uint32_t delay) {
+  if (running || (bus >= busCount)) {
+    return false;
+  }
+
+  buses [bus]->turnaroundDelay = delay;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Starts the buses. With threads, a worker thread is started for every bus.
+ * Without threads, the buses are run by poll().
+ *
+ * @param useThreads true to run every bus on its own thread, false to use poll().
+ * @return true - Operation successful.
+ * @return false - No buses were added, or the master is already running.
+ */
+bool CSE_ModbusRTU_Master:: begin (bool useThreads) {
+  if (running || (busCount == 0)) {
+    return false;
+  }
+
+  threaded = useThreads;
+  running = true;
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    buses [i]->stop = false;
+    buses [i]->broadcastPending = false;
+
+    if (threaded) {
+      buses [i]->worker = std::thread (&CSE_ModbusRTU_Master:: workerLoop, this, buses [i]);
+    }
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Stops the buses. The job running on each bus is completed. The jobs still in
+ * the queues fail with -1.
+ *
+ */
+void CSE_ModbusRTU_Master:: end() {
+  if (!running) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    bus_t* bus = buses [i];
+
+    {
+      std::lock_guard <std::mutex> guard (bus->lock);
+      bus->stop = true;
+    }
+
+    bus->signal.notify_one();
+
+    if (bus->worker.joinable()) {
+      bus->worker.join();
+    }
+
+    if (bus->current != NULL) {
+      while (bus->rtu->isSending()) {
+        // Release DE at the end of the request
+      }
+
+      bus->rtu->disableReceive();
+      finishJob (bus, bus->current, -1);
+      bus->current = NULL;
+    }
+
+    job_t* job;
+
+    while ((job = popJob (bus)) != NULL) {
+      finishJob (bus, job, -1);
+    }
+  }
+
+  running = false;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns true if the buses are running.
+ *
+ * @return true - begin() was called.
+ * @return false - The master is stopped.
+ */
+bool CSE_ModbusRTU_Master:: isRunning() {
+  return running;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the name of the master.
+ *
+ * @return String - The name of the master.
+ */
+String CSE_ModbusRTU_Master:: getName() {
+  return name;
+}
+
+//======================================================================================//
+/**
+ * @brief Queues a job to its bus and returns immediately. If the bus of the job is
+ * MODBUS_RTU_MASTER_BUS_AUTO, the route of the device address of the request is used.
+ * Use wait() to get the result, or set a callback in the job.
+ *
+ * @param job The job to run. Must stay valid until it is complete.
+ * @return true - The job was queued.
+ * @return false - The master is not running, or the job has no valid bus.
+ */
+bool CSE_ModbusRTU_Master:: submit (job_t& job) {
+  uint8_t index = job.bus;
+
+  if (index == MODBUS_RTU_MASTER_BUS_AUTO) {
+    index = routes [job.request.getDeviceAddress()];
+  }
+
+  if ((!running) || (index >= busCount)) {
+    return false;
+  }
+
+  bus_t* bus = buses [index];
+
+  job.result = -1;
+  job.next = NULL;
+  job.submitTime = micros();
+  job.startTime = job.submitTime;
+  job.endTime = job.submitTime;
+
+  {
+    std::lock_guard <std::mutex> guard (doneLock);
+    job.done = false;
+  }
+
+  {
+    std::lock_guard <std::mutex> guard (bus->lock);
+
+    if (bus->stop) {
+      return false;
+    }
+
+    if (bus->tail == NULL) {
+      bus->head = &job;
+    }
+    else {
+      bus->tail->next = &job;
+    }
+
+    bus->tail = &job;
+  }
+
+  bus->signal.notify_one();
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Waits until a job is complete. In the polled mode, the buses are polled while
+ * waiting. Don't use this for jobs with a callback.
+ *
+ * @param job A job queued with submit().
+ * @return int - Function code if successful; Exception code if exception; -1 if failed.
+ */
+int CSE_ModbusRTU_Master:: wait (job_t& job) {
+  if (threaded) {
+    std::unique_lock <std::mutex> guard (doneLock);
+    doneSignal.wait (guard, [&job] { return job.done; });
+  }
+  else {
+    while (running && !isDone (job)) {
+      poll();
+    }
+
+    if (!isDone (job)) {
+      return -1;
+    }
+  }
+
+  return job.result;
+}
+
+//======================================================================================//
+/**
+ * @brief Queues a job and waits until it is complete.
+ *
+ * @param job The job to run.
+ * @return int - Function code if successful; Exception code if exception; -1 if failed.
+ */
+int CSE_ModbusRTU_Master:: transfer (job_t& job) {
+  job.callback = NULL;
+
+  if (!submit (job)) {
+    job.result = -1;
+    return -1;
+  }
+
+  return wait (job);
+}
+
+//======================================================================================//
+/**
+ * @brief Runs the buses in the polled mode. An idle bus starts sending the request of
+ * its next job. A bus waiting for a response reads the available bytes, and completes
+ * the job when the response is received or the timeout is reached. The function never
+ * waits for a request to be sent or for a response, so the frames of all the buses are
+ * on the lines at the same time. Call it repeatedly from your loop.
+ *
+ * @return int - The number of jobs completed in this call; -1 if not in the polled mode.
+ */
+int CSE_ModbusRTU_Master:: poll() {
+  if ((!running) || threaded) {
+    return -1;
+  }
+
+  int completed = 0;
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    bus_t* bus = buses [i];
+
+    if (bus->current == NULL) {
+      // The servers are still processing the last broadcast
+      if (bus->broadcastPending) {
+        if ((millis() - bus->broadcastTime) < bus->turnaroundDelay) {
+          continue;
+        }
+
+        bus->broadcastPending = false;
+      }
+
+      // The next request can only start after t3.5 of silence on the line
+      if (!bus->rtu->isReadyToSend()) {
+        continue;
+      }
+
+      job_t* job = popJob (bus);
+
+      if ((job != NULL) && !startJob (bus, job)) {
+        completed++;  // The job failed
+      }
+
+      continue;
+    }
+
+    job_t* job = bus->current;
+
+    // Wait until the request has left the port, then start the response timeout
+    if (!bus->receiving) {
+      if (bus->rtu->isSending()) {
+        continue;
+      }
+
+      // A broadcast request has no response. The next request waits for the turnaround
+      // delay.
+      if (job->request.getDeviceAddress() == 0x00) {
+        bus->broadcastPending = true;
+        bus->broadcastTime = millis();
+        bus->current = NULL;
+        finishJob (bus, job, job->request.getFunctionCode());
+        completed++;
+        continue;
+      }
+
+      bus->rtu->enableReceive();
+      bus->receiving = true;
+      bus->startTime = millis();
+    }
+
+    int result = bus->rtu->receiveFrame (job->response, true);
+
+    if (result == 0) {
+      if (((millis() - bus->startTime) < bus->client.receiveTimeout) || bus->rtu->isReceiving()) {
+        continue;
+      }
+    }
+
+    bus->rtu->disableReceive();
+    bus->current = NULL;
+    finishJob (bus, job, (result > 0) ? checkResponse (job) : -1);
+    completed++;
+  }
+
+  return completed;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads holding registers from a server through a bus, and waits for the result.
+ *
+ * @param bus The index of the bus, or MODBUS_RTU_MASTER_BUS_AUTO to use the route.
+ * @param deviceAddress The device address of the server.
+ * @param address The address of the first holding register.
+ * @param count The number of holding registers to read.
+ * @param holdingRegisters The array to save the values.
+ * @return int - Function code if successful; Exception code if exception; -1 if failed.
+ */
+int CSE_ModbusRTU_Master:: readHoldingRegister (uint8_t bus, uint8_t deviceAddress, uint16_t address, uint8_t count, uint16_t* holdingRegisters) {
+  job_t job;
+
+  job.bus = bus;
+  job.request.setDeviceAddress (deviceAddress);
+  job.request.setFunctionCode (MODBUS_FC_READ_HOLDING_REGISTERS);
+  job.request.add ((uint16_t) address);
+  job.request.add ((uint16_t) count);
+  job.request.setCRC();
+
+  int result = transfer (job);
+
+  // The exception code 0x03 is the same as the function code, so the response is checked
+  if ((result == MODBUS_FC_READ_HOLDING_REGISTERS) && (job.response.getFunctionCode() == MODBUS_FC_READ_HOLDING_REGISTERS)) {
+    // The byte count must match the requested number of registers
+    if (job.response.getByte (MODBUS_RTU_ADU_DATA_INDEX) != (count * 2)) {
+      return -1;
+    }
+
+    // Unpack the registers in one pass. If the response is too short, they are not changed.
+    if (!job.response.getWords (MODBUS_RTU_ADU_DATA_INDEX + 1, holdingRegisters, count)) {
+      return -1;
+    }
+  }
+
+  return result;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a single holding register of a server through a bus, and waits for the
+ * result.
+ *
+ * @param bus The index of the bus, or MODBUS_RTU_MASTER_BUS_AUTO to use the route.
+ * @param deviceAddress The device address of the server.
+ * @param address The address of the holding register.
+ * @param value The value to write.
+ * @return int - Function code if successful; Exception code if exception; -1 if failed.
+ */
+int CSE_ModbusRTU_Master:: writeHoldingRegister (uint8_t bus, uint8_t deviceAddress, uint16_t address, uint16_t value) {
+  job_t job;
+
+  job.bus = bus;
+  job.request.setDeviceAddress (deviceAddress);
+  job.request.setFunctionCode (MODBUS_FC_WRITE_SINGLE_REGISTER);
+  job.request.add ((uint16_t) address);
+  job.request.add ((uint16_t) value);
+  job.request.setCRC();
+
+  return transfer (job);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of jobs run on a bus.
+ *
+ * @param bus The index of the bus.
+ * @return uint32_t - The number of jobs.
+ */
+uint32_t CSE_ModbusRTU_Master:: getRequestCount (uint8_t bus) {
+  return (bus < busCount) ? buses [bus]->requestCount.load() : 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of jobs that failed on a bus, without a valid response.
+ * Exception responses are not counted.
+ *
+ * @param bus The index of the bus.
+ * @return uint32_t - The number of failed jobs.
+ */
+uint32_t CSE_ModbusRTU_Master:: getErrorCount (uint8_t bus) {
+  return (bus < busCount) ? buses [bus]->errorCount.load() : 0;
+}
+
+//======================================================================================//
+/**
+ * @brief The worker thread of a bus. Runs the jobs in the queue until the bus is
+ * stopped.
+ *
+ * @param bus The bus to run.
+ */
+void CSE_ModbusRTU_Master:: workerLoop (bus_t* bus) {
+  while (true) {
+    job_t* job;
+
+    {
+      std::unique_lock <std::mutex> guard (bus->lock);
+      bus->signal.wait (guard, [bus] { return bus->stop || (bus->head != NULL); });
+
+      if (bus->stop) {
+        return; // The queued jobs are failed by end()
+      }
+
+      job = bus->head;
+      bus->head = job->next;
+
+      if (bus->head == NULL) {
+        bus->tail = NULL;
+      }
+    }
+
+    runJob (bus, job);
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Takes the first job from the queue of a bus.
+ *
+ * @param bus The bus.
+ * @return job_t* - The job, or NULL if the queue is empty.
+ */
+CSE_ModbusRTU_Master:: job_t* CSE_ModbusRTU_Master:: popJob (bus_t* bus) {
+  std::lock_guard <std::mutex> guard (bus->lock);
+  job_t* job = bus->head;
+
+  if (job != NULL) {
+    bus->head = job->next;
+
+    if (bus->head == NULL) {
+      bus->tail = NULL;
+    }
+  }
+
+  return job;
+}
+
+//======================================================================================//
+/**
+ * @brief Runs a job with the client of the bus. Used by the worker threads. After a
+ * broadcast request, the thread waits for the turnaround delay of the bus before it
+ * takes the next job.
+ *
+ * @param bus The bus.
+ * @param job The job to run.
+ */
+void CSE_ModbusRTU_Master:: runJob (bus_t* bus, job_t* job) {
+  job->startTime = micros();
+  bus->client.request = job->request;
+
+  int result = bus->client.transfer();
+  bool broadcast = (job->request.getDeviceAddress() == 0x00) && (result >= 0);
+
+  job->response = bus->client.response;
+  finishJob (bus, job, result); // The job is not accessed after this
+
+  if (broadcast) {
+    delay (bus->turnaroundDelay);
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Starts sending the request of a job in the polled mode. poll() waits for the
+ * request to leave the port, and then for the response. A job that can not be sent is
+ * completed at once.
+ *
+ * @param bus The bus.
+ * @param job The job to start.
+ * @return true - The request is being sent.
+ * @return false - The job failed.
+ */
+bool CSE_ModbusRTU_Master:: startJob (bus_t* bus, job_t* job) {
+  job->startTime = micros();
+  job->response.resetLength();
+  job->response.setType (CSE_ModbusRTU_ADU::aduType_t:: RESPONSE);
+
+  if (bus->rtu->sendFrame (job->request) < 0) {
+    finishJob (bus, job, -1);
+    return false;
+  }
+
+  bus->current = job;
+  bus->receiving = false;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks the device address and the function code of a received response. This
+ * is the same check as in CSE_ModbusRTU_Client::transfer().
+ *
+ * @param job The job with the received response.
+ * @return int - Function code if successful; Exception code if exception; -1 if failed.
+ */
+int CSE_ModbusRTU_Master:: checkResponse (job_t* job) {
+  uint8_t functionCode = job->request.getFunctionCode();
+
+  if (job->response.getDeviceAddress() != job->request.getDeviceAddress()) {
+    return -1;
+  }
+
+  if (job->response.getFunctionCode() == functionCode) {
+    return functionCode;
+  }
+  else if (job->response.getFunctionCode() == (functionCode | 0x80)) {
+    job->response.setType (CSE_ModbusRTU_ADU::aduType_t:: EXCEPTION);
+    return job->response.getExceptionCode();
+  }
+
+  return -1;
+}
+
+//======================================================================================//
+/**
+ * @brief Completes a job. Calls the callback of the job, or wakes up the threads waiting
+ * for it. The job is not accessed after that, because it may be reused or destroyed.
+ *
+ * @param bus The bus that ran the job.
+ * @param job The job.
+ * @param result The result of the job.
+ */
+void CSE_ModbusRTU_Master:: finishJob (bus_t* bus, job_t* job, int result) {
+  bus->requestCount++;
+
+  if (result < 0) {
+    bus->errorCount++;
+  }
+
+  job->result = result;
+  job->endTime = micros();
+
+  if (job->callback != NULL) {
+    job->callback (*job, job->context);
+    return;
+  }
+
+  {
+    std::lock_guard <std::mutex> guard (doneLock);
+    job->done = true;
+  }
+
+  doneSignal.notify_all();
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if a job is complete.
+ *
+ * @param job The job.
+ * @return true - The job is complete.
+ * @return false - The job is queued or running.
+ */
+bool CSE_ModbusRTU_Master:: isDone (job_t& job) {
+  std::lock_guard <std::mutex> guard (doneLock);
+  return job.done;
+}
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,166 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_Master.h
+  Description: Multi-bus Modbus RTU client runtime for Linux and macOS hosts. Runs the
+  requests of each serial bus on its own worker thread.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_MASTER_H
+#define CSE_MODBUSRTU_MASTER_H
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//======================================================================================//
+
+// The maximum number of buses a master can run
+#ifndef MODBUS_RTU_MASTER_BUS_COUNT_MAX
+  #define MODBUS_RTU_MASTER_BUS_COUNT_MAX       16U
+#endif
+
+// The time the servers get to process a broadcast request, before the next request on
+// the same bus, in milliseconds. The Modbus specification suggests 100 to 200 ms.
+#ifndef MODBUS_RTU_MASTER_TURNAROUND_DELAY
+  #define MODBUS_RTU_MASTER_TURNAROUND_DELAY    100U
+#endif
+
+#define   MODBUS_RTU_MASTER_BUS_AUTO            0xFFU // Route the job by the device address of the request
+#define   MODBUS_RTU_MASTER_BUS_NONE            0xFFU // No route is set for the device address
+
+//======================================================================================//
+/**
+ * @brief Runs Modbus RTU client requests on several serial buses at the same time. Each
+ * bus is a CSE_ModbusRTU object with its own port. A request is wrapped in a job, and
+ * the job is queued to a bus, either by the bus index, or by a route set for the device
+ * address (unit ID) of the request. The jobs of one bus are run one after another, in
+ * the order they were submitted. The jobs of different buses run in parallel, so the
+ * total throughput grows with the number of buses.
+ *
+ * There are two ways of running the buses.
+ *
+ *   - begin (true) : Every bus gets a worker thread. submit(), transfer() and wait() can
+ *     be called from any number of threads.
+ *   - begin (false) : No threads are created. The buses are run by calling poll() from
+ *     your own loop. poll() never waits. It starts the next request of an idle bus with
+ *     CSE_ModbusRTU::sendFrame(), and checks the buses sending or waiting for a
+ *     response, so the frames of all the buses overlap in one thread. All the functions
+ *     must be called from that thread.
+ *
+ * The CSE_ModbusRTU objects must not be used by anything else while the master runs.
+ *
+ */
+class CSE_ModbusRTU_Master {
+  public:
+    struct job_t;
+    typedef void (*jobCallback_t) (job_t& job, void* context);  // Called when a job is complete
+
+    /**
+     * @brief A request and its response. The request must be complete, including the
+     * device address and the CRC. The job must stay valid until it is complete.
+     *
+     */
+    struct job_t {
+      uint8_t bus = MODBUS_RTU_MASTER_BUS_AUTO; // The bus index, or MODBUS_RTU_MASTER_BUS_AUTO
+      CSE_ModbusRTU_ADU request;  // The request to send
+      CSE_ModbusRTU_ADU response; // The response received
+      int result = -1;  // Function code if successful; Exception code if exception; -1 if failed.
+      jobCallback_t callback = NULL; // Optional. Called on the bus thread when the job is complete.
+      void* context = NULL; // Passed to the callback
+
+      uint32_t submitTime = 0;  // The time the job was queued in microseconds
+      uint32_t startTime = 0; // The time the bus started sending the request in microseconds
+      uint32_t endTime = 0; // The time the job was completed in microseconds
+
+      job_t* next = NULL; // The next job in the queue. Used by the master.
+      bool done = false;  // Set when the job is complete. Used by the master.
+    };
+
+  private:
+    // The state of one bus
+    struct bus_t {
+      CSE_ModbusRTU* rtu; // The node of the bus
+      CSE_ModbusRTU_Client client; // Runs the transactions in the threaded mode
+      std::thread worker; // The worker thread
+      std::mutex lock;  // Protects the queue and stop
+      std::condition_variable signal; // Signals a new job or stop to the worker
+      job_t* head;  // The first job in the queue
+      job_t* tail;  // The last job in the queue
+      bool stop;  // The worker must exit
+
+      job_t* current; // The job being run in the polled mode
+      bool receiving; // The request of the current job is sent, and the response is awaited
+      uint32_t startTime; // The time the current request was sent in milliseconds
+      uint32_t turnaroundDelay; // Time after a broadcast before the next request in milliseconds
+      uint32_t broadcastTime; // The time the last broadcast was sent in milliseconds
+      bool broadcastPending; // The turnaround delay of the last broadcast has not passed
+
+      std::atomic <uint32_t> requestCount;  // Number of jobs run
+      std::atomic <uint32_t> errorCount;  // Number of jobs that failed
+
+      bus_t (CSE_ModbusRTU& rtu);
+    };
+
+    String name; // The name of the master
+    bus_t* buses [MODBUS_RTU_MASTER_BUS_COUNT_MAX]; // The buses
+    uint8_t busCount; // The number of buses added
+    uint8_t routes [256]; // The bus index for each device address
+    std::atomic <bool> running; // begin() was called
+    bool threaded; // The buses run on worker threads
+
+    std::mutex doneLock;  // Protects the done flag of the jobs
+    std::condition_variable doneSignal; // Signals a completed job
+
+    void workerLoop (bus_t* bus); // The worker thread of a bus
+    job_t* popJob (bus_t* bus); // Take the first job from the queue of a bus
+    void runJob (bus_t* bus, job_t* job); // Run a job on a worker thread
+    bool startJob (bus_t* bus, job_t* job); // Start sending the request of a job in the polled mode
+    int checkResponse (job_t* job); // Validate the response of a job
+    void finishJob (bus_t* bus, job_t* job, int result); // Complete a job
+    bool isDone (job_t& job); // Check if a job is complete
+
+  public:
+    CSE_ModbusRTU_Master (String name);
+    ~CSE_ModbusRTU_Master();
+
+    int addBus (CSE_ModbusRTU& rtu); // Add a bus and return its index
+    uint8_t getBusCount(); // Get the number of buses
+    bool setRoute (uint8_t deviceAddress, uint8_t bus); // Route a device address to a bus
+    uint8_t getRoute (uint8_t deviceAddress); // Get the bus of a device address
+    bool setTimeout (uint8_t bus, uint32_t timeout); // Set the response timeout of a bus in milliseconds
+    bool setTurnaroundDelay (uint8_t bus, uint32_t delay); // Set the delay after a broadcast on a bus in milliseconds
+
+    bool begin (bool useThreads = true); // Start the buses
+    void end(); // Stop the buses
+    bool isRunning(); // Check if the buses are running
+    String getName(); // Returns the name of the master
+
+    bool submit (job_t& job); // Queue a job and return immediately
+    int wait (job_t& job); // Wait until a job is complete
+    int transfer (job_t& job); // Queue a job and wait until it is complete
+    int poll(); // Run the buses in the polled mode
+
+    int readHoldingRegister (uint8_t bus, uint8_t deviceAddress, uint16_t address, uint8_t count, uint16_t* holdingRegisters); // Read holding registers through a bus
+    int writeHoldingRegister (uint8_t bus, uint8_t deviceAddress, uint16_t address, uint16_t value); // Write a single holding register through a bus
+
+    uint32_t getRequestCount (uint8_t bus); // Number of jobs run on a bus
+    uint32_t getErrorCount (uint8_t bus); // Number of jobs that failed on a bus
+};
+
+#endif
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,475 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_PosixSerial.cpp
+  Description: POSIX termios serial port backend for running the CSE_ModbusRTU library
+  on Linux and macOS hosts.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_PosixSerial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#if defined(__linux__)
+  #include <linux/serial.h>
+#endif
+
+//======================================================================================//
+/**
+ * @brief Converts a baud rate to the termios speed constant.
+ *
+ * @param baudRate The baud rate.
+ * @param speed The speed constant is saved here.
+ * @return true - The baud rate is supported.
+ * @return false - The baud rate is not supported.
+ */
+static bool getSpeed (uint32_t baudRate, speed_t& speed) {
+  switch (baudRate) {
+    case 1200: speed = B1200; return true;
+    case 2400: speed = B2400; return true;
+    case 4800: speed = B4800; return true;
+    case 9600: speed = B9600; return true;
+    case 19200: speed = B19200; return true;
+    case 38400: speed = B38400; return true;
+    case 57600: speed = B57600; return true;
+    case 115200: speed = B115200; return true;
+    case 230400: speed = B230400; return true;
+    #ifdef B460800
+      case 460800: speed = B460800; return true;
+    #endif
+    #ifdef B921600
+      case 921600: speed = B921600; return true;
+    #endif
+    #ifdef B1000000
+      case 1000000: speed = B1000000; return true;
+    #endif
+    default: return false;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Constructor. The port is not opened until begin() is called.
+ *
+ * @param device The path of the serial device, like /dev/ttyUSB0.
+ * @param baudRate The baud rate.
+ * @param config Data bits, parity (N, E or O) and stop bits, like "8N1" or "8E1".
+ * @param deMode How the DE line is controlled. One of MODBUS_RTU_POSIX_DE_*.
+ */
+CSE_ModbusRTU_PosixSerial:: CSE_ModbusRTU_PosixSerial (const char* device, uint32_t baudRate, const char* config, uint8_t deMode) {
+  this->device = device;
+  this->baudRate = baudRate;
+  this->config = config;
+  this->deMode = deMode;
+
+  fd = -1;
+  rxStart = 0;
+  rxEnd = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Destructor. Closes the port.
+ *
+ */
+CSE_ModbusRTU_PosixSerial:: ~CSE_ModbusRTU_PosixSerial() {
+  end();
+}
+
+//======================================================================================//
+/**
+ * @brief Opens the port and configures it for raw, non-blocking I/O.
+ *
+ * @return true - Operation successful.
+ * @return false - Operation failed. Check errno for the reason.
+ */
+bool CSE_ModbusRTU_PosixSerial:: begin() {
+  end();
+
+  speed_t speed;
+
+  if (!getSpeed (baudRate, speed) || (config.length() != 3)) {
+    errno = EINVAL;
+    return false;
+  }
+
+  fd = open (device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct termios options;
+
+  if (tcgetattr (fd, &options) != 0) {
+    end();
+    return false;
+  }
+
+  cfmakeraw (&options);
+  cfsetispeed (&options, speed);
+  cfsetospeed (&options, speed);
+
+  options.c_cflag |= (CLOCAL | CREAD);
+  options.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+
+  #ifdef CRTSCTS
+    options.c_cflag &= ~CRTSCTS;  // RTS is used for DE, not for flow control
+  #endif
+
+  switch (config [0]) {
+    case '5': options.c_cflag |= CS5; break;
+    case '6': options.c_cflag |= CS6; break;
+    case '7': options.c_cflag |= CS7; break;
+    default: options.c_cflag |= CS8; break;
+  }
+
+  if ((config [1] == 'E') || (config [1] == 'e')) {
+    options.c_cflag |= PARENB;
+  }
+  else if ((config [1] == 'O') || (config [1] == 'o')) {
+    options.c_cflag |= (PARENB | PARODD);
+  }
+
+  if (config [2] == '2') {
+    options.c_cflag |= CSTOPB;
+  }
+
+  // Return immediately from read(), even if no bytes are available.
+  options.c_cc [VMIN] = 0;
+  options.c_cc [VTIME] = 0;
+
+  if (tcsetattr (fd, TCSANOW, &options) != 0) {
+    end();
+    return false;
+  }
+
+  #if defined(__linux__)
+    // Ask the driver to deliver the received bytes as soon as possible. This sets the
+    // latency timer of FTDI adapters to 1 ms. Not all drivers support it.
+    struct serial_struct serial;
+
+    if (ioctl (fd, TIOCGSERIAL, &serial) == 0) {
+      serial.flags |= ASYNC_LOW_LATENCY;
+      ioctl (fd, TIOCSSERIAL, &serial);
+    }
+
+    if (deMode == MODBUS_RTU_POSIX_DE_KERNEL) {
+      setDelays (preDelay, postDelay);  // Enables the RS-485 mode of the driver
+    }
+  #endif
+
+  if (deMode == MODBUS_RTU_POSIX_DE_RTS) {
+    setRTS (false); // Start in receive mode
+  }
+
+  tcflush (fd, TCIOFLUSH);  // Discard anything received before the port was opened
+  rxStart = 0;
+  rxEnd = 0;
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Opens the port with the specified baud rate.
+ *
+ * @param baudRate The baud rate.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU_PosixSerial:: begin (uint32_t baudRate) {
+  this->baudRate = baudRate;
+  return begin();
+}
+
+//======================================================================================//
+/**
+ * @brief Closes the port.
+ *
+ */
+void CSE_ModbusRTU_PosixSerial:: end() {
+  if (fd >= 0) {
+    close (fd);
+    fd = -1;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if the port is open.
+ *
+ * @return true - The port is open.
+ * @return false - The port is closed.
+ */
+bool CSE_ModbusRTU_PosixSerial:: isOpen() {
+  return (fd >= 0);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the file descriptor of the port. You can use it with poll() or
+ * select() to wait for data without polling the library.
+ *
+ * @return int - The file descriptor, or -1 if the port is closed.
+ */
+int CSE_ModbusRTU_PosixSerial:: getFileDescriptor() {
+  return fd;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the baud rate of the port.
+ *
+ * @return uint32_t - The baud rate.
+ */
+uint32_t CSE_ModbusRTU_PosixSerial:: getBaudRate() {
+  return baudRate;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads all the bytes the OS has received into the local buffer. The buffer is
+ * only refilled when it is empty.
+ *
+ * @return size_t - The number of bytes in the local buffer.
+ */
+size_t CSE_ModbusRTU_PosixSerial:: fillBuffer() {
+  if (rxStart < rxEnd) {
+    return rxEnd - rxStart;
+  }
+
+  rxStart = 0;
+  rxEnd = 0;
+
+  if (fd < 0) {
+    return 0;
+  }
+
+  ssize_t count = ::read (fd, rxBuffer, sizeof (rxBuffer));
+
+  if (count > 0) {
+    rxEnd = (size_t) count;
+  }
+
+  return rxEnd;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes that can be read without waiting.
+ *
+ * @return int - Number of bytes available.
+ */
+int CSE_ModbusRTU_PosixSerial:: available() {
+  return (int) fillBuffer();
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a byte.
+ *
+ * @return int - The byte, or -1 if no byte is available.
+ */
+int CSE_ModbusRTU_PosixSerial:: read() {
+  if (fillBuffer() == 0) {
+    return -1;
+  }
+
+  return rxBuffer [rxStart++];
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a byte without removing it.
+ *
+ * @return int - The byte, or -1 if no byte is available.
+ */
+int CSE_ModbusRTU_PosixSerial:: peek() {
+  if (fillBuffer() == 0) {
+    return -1;
+  }
+
+  return rxBuffer [rxStart];
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a byte.
+ *
+ * @param byte The byte to write.
+ * @return size_t - The number of bytes written.
+ */
+size_t CSE_ModbusRTU_PosixSerial:: write (uint8_t byte) {
+  return write (&byte, 1);
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a buffer. The function waits if the output buffer of the OS is full,
+ * until all the bytes are written or the port stops accepting data for 1 second.
+ *
+ * @param buffer The bytes to write.
+ * @param size The number of bytes.
+ * @return size_t - The number of bytes written.
+ */
+size_t CSE_ModbusRTU_PosixSerial:: write (const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+
+  while ((fd >= 0) && (written < size)) {
+    ssize_t count = ::write (fd, buffer + written, size - written);
+
+    if (count > 0) {
+      written += (size_t) count;
+    }
+    else if ((count < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+      break;  // Write error
+    }
+    else {
+      struct pollfd descriptor = { fd, POLLOUT, 0 };
+
+      if (poll (&descriptor, 1, 1000) <= 0) {
+        break;  // Timeout
+      }
+    }
+  }
+
+  return written;
+}
+
+//======================================================================================//
+/**
+ * @brief Waits until all the written bytes are sent. For USB-serial adapters, this only
+ * waits until the bytes are handed to the adapter. CSE_ModbusRTU::send() holds DE for
+ * the transmission time of the frame in addition.
+ *
+ */
+void CSE_ModbusRTU_PosixSerial:: flush() {
+  if (fd >= 0) {
+    tcdrain (fd);
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Prepares the port for transmitting. In the RTS mode, RTS is set to enable the
+ * driver, and the function waits for the pre-delay.
+ *
+ */
+void CSE_ModbusRTU_PosixSerial:: beginTransmission() {
+  if (deMode == MODBUS_RTU_POSIX_DE_RTS) {
+    setRTS (true);
+
+    if (preDelay > 0) {
+      delayMicroseconds ((uint32_t) preDelay);
+    }
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Ends the transmission. In the RTS mode, the function waits until the bytes are
+ * sent and for the post-delay, and then clears RTS to disable the driver.
+ *
+ */
+void CSE_ModbusRTU_PosixSerial:: endTransmission() {
+  if (deMode == MODBUS_RTU_POSIX_DE_RTS) {
+    flush();
+
+    if (postDelay > 0) {
+      delayMicroseconds ((uint32_t) postDelay);
+    }
+
+    setRTS (false);
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Enables the driver in the RTS mode.
+ *
+ * @return true - RTS was set.
+ * @return false - DE is not controlled by the library.
+ */
+bool CSE_ModbusRTU_PosixSerial:: assertDE() {
+  if (deMode != MODBUS_RTU_POSIX_DE_RTS) {
+    return false;
+  }
+
+  return setRTS (true);
+}
+
+//======================================================================================//
+/**
+ * @brief Disables the driver in the RTS mode.
+ *
+ * @return true - RTS was cleared.
+ * @return false - DE is not controlled by the library.
+ */
+bool CSE_ModbusRTU_PosixSerial:: deassertDE() {
+  if (deMode != MODBUS_RTU_POSIX_DE_RTS) {
+    return false;
+  }
+
+  return setRTS (false);
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the delays around a transmission. In the kernel RS-485 mode, the delays
+ * are passed to the driver, which only supports whole milliseconds.
+ *
+ * @param preDelay Time from enabling the driver to the first byte in microseconds.
+ * @param postDelay Time from the last byte to disabling the driver in microseconds.
+ */
+void CSE_ModbusRTU_PosixSerial:: setDelays (int preDelay, int postDelay) {
+  CSE_ModbusRTU_HostSerial:: setDelays (preDelay, postDelay);
+
+  #if defined(__linux__) && defined(TIOCSRS485)
+    if ((deMode == MODBUS_RTU_POSIX_DE_KERNEL) && (fd >= 0)) {
+      struct serial_rs485 rs485;
+      memset (&rs485, 0, sizeof (rs485));
+
+      rs485.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+      rs485.delay_rts_before_send = (uint32_t) (preDelay + 999) / 1000;
+      rs485.delay_rts_after_send = (uint32_t) (postDelay + 999) / 1000;
+
+      ioctl (fd, TIOCSRS485, &rs485);
+    }
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Sets or clears the RTS line.
+ *
+ * @param state true to set RTS.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool CSE_ModbusRTU_PosixSerial:: setRTS (bool state) {
+  if (fd < 0) {
+    return false;
+  }
+
+  int flag = TIOCM_RTS;
+  return (ioctl (fd, state ? TIOCMBIS : TIOCMBIC, &flag) == 0);
+}
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,88 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_PosixSerial.h
+  Description: POSIX termios serial port backend for running the CSE_ModbusRTU library
+  on Linux and macOS hosts.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_POSIXSERIAL_H
+#define CSE_MODBUSRTU_POSIXSERIAL_H
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_Host.h"
+
+//======================================================================================//
+
+// Ways of controlling the driver enable (DE) line of the transceiver
+#define   MODBUS_RTU_POSIX_DE_NONE                      0U  // The adapter switches direction automatically
+#define   MODBUS_RTU_POSIX_DE_RTS                       1U  // The RTS line is set by the library around each transmission
+#define   MODBUS_RTU_POSIX_DE_KERNEL                    2U  // The RS-485 mode of the Linux kernel driver (TIOCSRS485)
+
+#define   MODBUS_RTU_POSIX_RX_BUFFER_SIZE               512U  // Bytes read from the OS in one call
+
+//======================================================================================//
+/**
+ * @brief A serial port backend for Linux and macOS, based on termios. The port is
+ * opened in non-blocking mode with VMIN and VTIME set to 0, so that available() and
+ * read() never wait. On Linux, the low latency mode of the driver is requested, which
+ * sets the latency timer of USB-serial adapters like the FTDI to 1 ms.
+ *
+ * The received bytes are read from the OS in blocks into a local buffer. This avoids a
+ * system call for every byte.
+ *
+ */
+class CSE_ModbusRTU_PosixSerial final : public CSE_ModbusRTU_HostSerial {
+  private:
+    String device;  // The path of the serial device, like /dev/ttyUSB0
+    uint32_t baudRate;
+    String config;  // Data bits, parity and stop bits, like "8N1"
+    uint8_t deMode; // One of MODBUS_RTU_POSIX_DE_*
+    int fd; // The file descriptor, or -1 if the port is closed
+
+    uint8_t rxBuffer [MODBUS_RTU_POSIX_RX_BUFFER_SIZE]; // Bytes read from the OS
+    size_t rxStart; // The next byte to read from rxBuffer
+    size_t rxEnd; // One past the last valid byte in rxBuffer
+
+    size_t fillBuffer();  // Read the available bytes from the OS
+    bool setRTS (bool state); // Set or clear the RTS line
+
+  public:
+    CSE_ModbusRTU_PosixSerial (const char* device, uint32_t baudRate = 9600, const char* config = "8N1", uint8_t deMode = MODBUS_RTU_POSIX_DE_NONE);
+    ~CSE_ModbusRTU_PosixSerial();
+
+    bool begin(); // Open and configure the port
+    bool begin (uint32_t baudRate); // Open the port with the specified baud rate
+    void end(); // Close the port
+    bool isOpen(); // Check if the port is open
+    int getFileDescriptor(); // Get the file descriptor of the port
+    uint32_t getBaudRate(); // Get the baud rate of the port
+
+    int available();
+    int read();
+    int peek();
+    size_t write (uint8_t byte);
+    size_t write (const uint8_t* buffer, size_t size);
+    void flush();
+
+    void beginTransmission();
+    void endTransmission();
+
+    bool assertDE();
+    bool deassertDE();
+    void setDelays (int preDelay, int postDelay);
+};
+
+#endif
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,922 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_RegisterMap.cpp
+  Description: Sorted range-block storage for the data tables of the CSE_ModbusRTU
+  server. Registers are stored as 16-bit values and bits are packed.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#include "CSE_ModbusRTU_RegisterMap.h"
+#include <stdlib.h>
+
+//======================================================================================//
+/**
+ * @brief Creates a storage that uses the heap.
+ *
+ */
+CSE_ModbusRTU_MapStorage:: CSE_ModbusRTU_MapStorage() {
+  arena = NULL;
+  arenaSize = 0;
+  arenaUsed = 0;
+  used = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets an arena to allocate the arrays from, instead of the heap. No arrays must
+ * be allocated. The start of the arena is aligned to MODBUS_RTU_MAP_ALIGNMENT, so a few
+ * bytes can be lost at the start.
+ *
+ * @param arena The arena. NULL to use the heap again.
+ * @param size The size of the arena in bytes.
+ * @return true - The arena was set.
+ * @return false - Arrays are allocated.
+ */
+bool CSE_ModbusRTU_MapStorage:: setArena (void* arena, size_t size) {
+  if (used > 0) {
+    return false;
+  }
+
+  if (arena == NULL) {
+    this->arena = NULL;
+    arenaSize = 0;
+    arenaUsed = 0;
+    return true;
+  }
+
+  // Align the start of the arena
+  size_t skip = (MODBUS_RTU_MAP_ALIGNMENT - ((uintptr_t) arena % MODBUS_RTU_MAP_ALIGNMENT)) % MODBUS_RTU_MAP_ALIGNMENT;
+
+  if (skip > size) {
+    skip = size;
+  }
+
+  this->arena = (uint8_t*) arena + skip;
+  arenaSize = size - skip;
+  arenaUsed = 0;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if an array is the last one taken from the arena.
+ *
+ * @param array The array.
+ * @param size The size of the array in bytes.
+ * @return true - The array is the last one.
+ * @return false - The array is not the last one, or there is no arena.
+ */
+bool CSE_ModbusRTU_MapStorage:: isLast (void* array, size_t size) {
+  if (arena == NULL) {
+    return false;
+  }
+
+  size_t start = (uint8_t*) array - arena;
+  size_t alignedSize = (size + MODBUS_RTU_MAP_ALIGNMENT - 1) & ~((size_t) MODBUS_RTU_MAP_ALIGNMENT - 1);
+  return (start + alignedSize) == arenaUsed;
+}
+
+//======================================================================================//
+/**
+ * @brief Allocates an array from the arena, or from the heap if there is no arena.
+ *
+ * @param size The size of the array in bytes.
+ * @return void* - The array; NULL if there is not enough memory.
+ */
+void* CSE_ModbusRTU_MapStorage:: allocate (size_t size) {
+  if (size == 0) {
+    return NULL;
+  }
+
+  void* array;
+
+  if (arena != NULL) {
+    size_t alignedSize = (size + MODBUS_RTU_MAP_ALIGNMENT - 1) & ~((size_t) MODBUS_RTU_MAP_ALIGNMENT - 1);
+
+    if (alignedSize > (arenaSize - arenaUsed)) {
+      return NULL;
+    }
+
+    array = arena + arenaUsed;
+    arenaUsed += alignedSize;
+  }
+  else {
+    array = malloc (size);
+
+    if (array == NULL) {
+      return NULL;
+    }
+  }
+
+  used += size;
+  return array;
+}
+
+//======================================================================================//
+/**
+ * @brief Changes the size of an array. The contents are kept up to the smaller of the
+ * two sizes. The last array of the arena and the arrays on the heap can change their size
+ * in place. Other arrays in the arena are moved to a new array when they grow, and keep
+ * their place when they shrink. So making an array smaller never fails.
+ *
+ * @param array The array.
+ * @param oldSize The current size of the array in bytes.
+ * @param newSize The new size of the array in bytes.
+ * @return void* - The array, which can have moved; NULL if there is not enough memory. The old array is still valid then.
+ */
+void* CSE_ModbusRTU_MapStorage:: resize (void* array, size_t oldSize, size_t newSize) {
+  if (arena == NULL) {
+    void* newArray = realloc (array, newSize);
+
+    // A smaller array can always stay where it is
+    if ((newArray == NULL) && (newSize <= oldSize)) {
+      newArray = array;
+    }
+
+    if (newArray != NULL) {
+      used = used - oldSize + newSize;
+    }
+
+    return newArray;
+  }
+
+  if (isLast (array, oldSize)) {
+    size_t start = (uint8_t*) array - arena;
+    size_t alignedSize = (newSize + MODBUS_RTU_MAP_ALIGNMENT - 1) & ~((size_t) MODBUS_RTU_MAP_ALIGNMENT - 1);
+
+    if (alignedSize > (arenaSize - start)) {
+      return NULL;
+    }
+
+    arenaUsed = start + alignedSize;
+    used = used - oldSize + newSize;
+    return array;
+  }
+
+  // The space after a smaller array is lost, like the space of a released array
+  if (newSize <= oldSize) {
+    used = used - oldSize + newSize;
+    return array;
+  }
+
+  void* newArray = allocate (newSize);
+
+  if (newArray == NULL) {
+    return NULL;
+  }
+
+  memcpy (newArray, array, (oldSize < newSize) ? oldSize : newSize);
+  release (array, oldSize);
+  return newArray;
+}
+
+//======================================================================================//
+/**
+ * @brief Frees an array. In the arena, the space is given back only if the array is the
+ * last one.
+ *
+ * @param array The array.
+ * @param size The size of the array in bytes.
+ */
+void CSE_ModbusRTU_MapStorage:: release (void* array, size_t size) {
+  if (array == NULL) {
+    return;
+  }
+
+  if (arena == NULL) {
+    free (array);
+  }
+  else if (isLast (array, size)) {
+    arenaUsed = (uint8_t*) array - arena;
+  }
+
+  used -= size;
+
+  // Once all the arrays are freed, the whole arena can be used again
+  if (used == 0) {
+    arenaUsed = 0;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes in the allocated arrays.
+ *
+ * @return size_t
+ */
+size_t CSE_ModbusRTU_MapStorage:: getUsage() {
+  return used;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes left at the end of the arena. The space of freed
+ * arrays that were not the last one is not included.
+ *
+ * @return size_t - Number of bytes; 0 if there is no arena.
+ */
+size_t CSE_ModbusRTU_MapStorage:: getArenaFree() {
+  if (arena == NULL) {
+    return 0;
+  }
+
+  return arenaSize - arenaUsed;
+}
+
+//======================================================================================//
+/**
+ * @brief Creates an empty map.
+ *
+ */
+CSE_ModbusRTU_BitMap:: CSE_ModbusRTU_BitMap() {
+  layout = NULL;
+  layoutCount = 0;
+  count = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Frees the values of all the blocks.
+ *
+ */
+CSE_ModbusRTU_BitMap:: ~CSE_ModbusRTU_BitMap() {
+  clear();
+}
+
+//======================================================================================//
+/**
+ * @brief Sets an arena to store the values in, instead of the heap. The map must be
+ * empty. The arena must stay valid as long as the map is used.
+ *
+ * @param arena The arena. NULL to use the heap again.
+ * @param size The size of the arena in bytes.
+ * @return true - The arena was set.
+ * @return false - The map is not empty.
+ */
+bool CSE_ModbusRTU_BitMap:: setArena (void* arena, size_t size) {
+  if (getBlockCount() > 0) {
+    return false;
+  }
+
+  return storage.setArena (arena, size);
+}
+
+//======================================================================================//
+/**
+ * @brief Makes the map use a fixed array of blocks, instead of adding them one by one.
+ * Works the same way as CSE_ModbusRTU_RegisterMap::setLayout(). The unused bits of the
+ * last byte of each block must be 0.
+ *
+ * @param layoutBlocks The blocks.
+ * @param blockCount The number of blocks.
+ * @return true - The layout was set.
+ * @return false - The map is not empty, or the blocks are not valid.
+ */
+bool CSE_ModbusRTU_BitMap:: setLayout (block_t* layoutBlocks, size_t blockCount) {
+  if ((getBlockCount() > 0) || (layoutBlocks == NULL) || (blockCount == 0)) {
+    return false;
+  }
+
+  uint32_t end = 0; // One past the last address of the previous block
+  size_t total = 0;
+
+  for (size_t i = 0; i < blockCount; i++) {
+    if ((layoutBlocks [i].length == 0) || (layoutBlocks [i].bits == NULL) || ((i > 0) && (layoutBlocks [i].address <= end))) {
+      return false;
+    }
+
+    end = (uint32_t) layoutBlocks [i].address + layoutBlocks [i].length;
+
+    if (end > 0x10000UL) {
+      return false;
+    }
+
+    total += layoutBlocks [i].length;
+  }
+
+  layout = layoutBlocks;
+  layoutCount = blockCount;
+  count = total;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the first block. The blocks are in the layout if one is set.
+ *
+ * @return block_t* - The first block; NULL if there are no blocks.
+ */
+CSE_ModbusRTU_BitMap:: block_t* CSE_ModbusRTU_BitMap:: getBlocks() {
+  if (layout != NULL) {
+    return layout;
+  }
+
+  return blocks.empty() ? NULL : &blocks [0];
+}
+
+//======================================================================================//
+/**
+ * @brief Finds the first block whose last address is greater than or equal to the
+ * address. The block contains the address only if its starting address is not greater
+ * than the address.
+ *
+ * @param address The address to search.
+ * @return int - Index of the block; the number of blocks if there is none.
+ */
+int CSE_ModbusRTU_BitMap:: search (uint16_t address) {
+  block_t* list = getBlocks();
+  int low = 0;
+  int high = getBlockCount();
+
+  while (low < high) {
+    int middle = (low + high) / 2;
+    uint32_t end = (uint32_t) list [middle].address + list [middle].length; // One past the last address
+
+    if (end <= address) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+//======================================================================================//
+/**
+ * @brief Finds the block that contains all the addresses of a range.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @param offset The bit offset of the first address in the block is saved here.
+ * @return block_t* - The block; NULL if any address is not present.
+ */
+CSE_ModbusRTU_BitMap:: block_t* CSE_ModbusRTU_BitMap:: findBlock (uint16_t address, uint16_t count, uint32_t& offset) {
+  if (count == 0) {
+    return NULL;
+  }
+
+  int index = search (address);
+  block_t* block = getBlocks() + index;
+
+  if ((index == (int) getBlockCount()) || (block->address > address)) {
+    return NULL;
+  }
+
+  offset = address - block->address;
+
+  if ((offset + count) > block->length) {
+    return NULL;
+  }
+
+  return block;
+}
+
+//======================================================================================//
+/**
+ * @brief Adds a range of addresses to the map. The values are set to 0. The range must
+ * not overlap any address already present, and must not go past the address 0xFFFF. If
+ * the range touches a block before or after it, the blocks are merged.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - The range was added.
+ * @return false - The range is empty, too long, overlaps the existing addresses, a layout is set, or there is no memory.
+ */
+bool CSE_ModbusRTU_BitMap:: add (uint16_t address, uint16_t count) {
+  uint32_t end = (uint32_t) address + count; // One past the last address
+
+  if ((count == 0) || (end > 0x10000UL) || (layout != NULL)) {
+    return false;
+  }
+
+  int index = search (address);
+
+  // The block found is the first one that ends after the address. If it starts before
+  // the end of the new range, the two overlap.
+  if ((index < (int) blocks.size()) && (blocks [index].address < end)) {
+    return false;
+  }
+
+  bool joinsPrevious = (index > 0) && (((uint32_t) blocks [index - 1].address + blocks [index - 1].length) == address);
+  bool joinsNext = (index < (int) blocks.size()) && (blocks [index].address == end);
+
+  if (joinsPrevious) {
+    // The new bits are appended as zeros. The unused bits of the last byte are already 0.
+    block_t& previous = blocks [index - 1];
+    uint32_t length = previous.length + count + (joinsNext ? blocks [index].length : 0);
+    size_t oldSize = (previous.length + 7) / 8;
+    size_t newSize = (length + 7) / 8;
+    uint8_t* bits = (uint8_t*) storage.resize (previous.bits, oldSize, newSize);
+
+    if (bits == NULL) {
+      return false;
+    }
+
+    memset (bits + oldSize, 0, newSize - oldSize);
+
+    if (joinsNext) {
+      block_t& next = blocks [index];
+      copyBits (bits, previous.length + count, next.bits, 0, next.length);
+      storage.release (next.bits, (next.length + 7) / 8);
+      blocks.erase (blocks.begin() + index);
+    }
+
+    blocks [index - 1].bits = bits;
+    blocks [index - 1].length = length;
+  }
+  else if (joinsNext) {
+    // The bits of the next block must be moved up by the count
+    block_t& next = blocks [index];
+    uint32_t length = next.length + count;
+    uint8_t* bits = (uint8_t*) storage.allocate ((length + 7) / 8);
+
+    if (bits == NULL) {
+      return false;
+    }
+
+    memset (bits, 0, (length + 7) / 8);
+    copyBits (bits, count, next.bits, 0, next.length);
+    storage.release (next.bits, (next.length + 7) / 8);
+
+    next.address = address;
+    next.length = length;
+    next.bits = bits;
+  }
+  else {
+    block_t block;
+    block.address = address;
+    block.length = count;
+    block.bits = (uint8_t*) storage.allocate ((count + 7) / 8);
+    block.flags = 0;
+
+    if (block.bits == NULL) {
+      return false;
+    }
+
+    memset (block.bits, 0, (count + 7) / 8);
+    blocks.insert (blocks.begin() + index, block);
+  }
+
+  this->count += count;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Removes a range of addresses from the map. The range must be inside one block.
+ * A block is split in two if the range is in the middle of it. This can undo an add().
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - The range was removed.
+ * @return false - An address is not present, a layout is set, or there is no memory to split the block.
+ */
+bool CSE_ModbusRTU_BitMap:: remove (uint16_t address, uint16_t count) {
+  uint32_t offset;
+
+  if ((layout != NULL) || (findBlock (address, count, offset) == NULL)) {
+    return false;
+  }
+
+  int index = search (address);
+  block_t& block = blocks [index];
+  uint32_t tailLength = block.length - offset - count; // The addresses after the range
+
+  if ((offset == 0) && (tailLength == 0)) {
+    storage.release (block.bits, (block.length + 7) / 8);
+    blocks.erase (blocks.begin() + index);
+  }
+  else if (tailLength == 0) {
+    // Only the end of the block is removed, so the bits stay where they are
+    block.bits = (uint8_t*) storage.resize (block.bits, (block.length + 7) / 8, (offset + 7) / 8);
+    block.length = offset;
+  }
+  else {
+    // The bits after the range are moved to a new array, which is a new block if the
+    // range is in the middle of the block
+    uint8_t* bits = (uint8_t*) storage.allocate ((tailLength + 7) / 8);
+
+    if (bits == NULL) {
+      return false;
+    }
+
+    memset (bits, 0, (tailLength + 7) / 8);
+    copyBits (bits, 0, block.bits, offset + count, tailLength);
+
+    if (offset == 0) {
+      storage.release (block.bits, (block.length + 7) / 8);
+      block.address += count;
+      block.bits = bits;
+      block.length = tailLength;
+    }
+    else {
+      block_t tail;
+      tail.address = address + count;
+      tail.length = tailLength;
+      tail.bits = bits;
+      tail.flags = block.flags;
+
+      block.bits = (uint8_t*) storage.resize (block.bits, (block.length + 7) / 8, (offset + 7) / 8);
+      block.length = offset;
+      blocks.insert (blocks.begin() + index + 1, tail);
+    }
+  }
+
+  // The unused bits of the last byte must be 0
+  if ((index < (int) blocks.size()) && (blocks [index].address < address) && ((blocks [index].length % 8) != 0)) {
+    blocks [index].bits [blocks [index].length / 8] &= (1U << (blocks [index].length % 8)) - 1;
+  }
+
+  this->count -= count;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Removes all the blocks. A layout is only detached, since its values are not
+ * owned by the map.
+ *
+ */
+void CSE_ModbusRTU_BitMap:: clear() {
+  layout = NULL;
+  layoutCount = 0;
+
+  // Free the values in the reverse order, so that an arena is given back completely
+  for (size_t i = blocks.size(); i > 0; i--) {
+    storage.release (blocks [i - 1].bits, (blocks [i - 1].length + 7) / 8);
+  }
+
+  blocks.clear();
+  count = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Reserves memory for a number of blocks. This is not necessary but it prevents
+ * memory fragmentation when the blocks are added.
+ *
+ * @param blockCount The number of blocks.
+ */
+void CSE_ModbusRTU_BitMap:: reserve (size_t blockCount) {
+  blocks.reserve (blockCount);
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if all the addresses of a range are present.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - All the addresses are present.
+ * @return false - One or more addresses are not present.
+ */
+bool CSE_ModbusRTU_BitMap:: isPresent (uint16_t address, uint16_t count) {
+  uint32_t offset;
+  return findBlock (address, count, offset) != NULL;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if all the addresses of a range are present, and can be written by the
+ * client. The blocks flagged with MODBUS_RTU_BLOCK_READ_ONLY can only be written by the
+ * server itself.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - All the addresses are present and writable.
+ * @return false - One or more addresses are not present, or are read-only.
+ */
+bool CSE_ModbusRTU_BitMap:: isWritable (uint16_t address, uint16_t count) {
+  uint32_t offset;
+  block_t* block = findBlock (address, count, offset);
+
+  return (block != NULL) && ((block->flags & MODBUS_RTU_BLOCK_READ_ONLY) == 0);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the value of an address.
+ *
+ * @param address The address.
+ * @return int - 0x00 or 0x01; -1 if the address is not present.
+ */
+int CSE_ModbusRTU_BitMap:: getBit (uint16_t address) {
+  uint32_t offset;
+  block_t* block = findBlock (address, 1, offset);
+
+  if (block == NULL) {
+    return -1;
+  }
+
+  return (block->bits [offset / 8] >> (offset % 8)) & 0x01;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets a range of addresses to the same value. The whole bytes inside the range
+ * are set with memset(). If any address is not present, nothing is changed.
+ *
+ * @param address The first address of the range.
+ * @param value 0x00 for OFF, and any other value for ON.
+ * @param count The number of addresses.
+ * @return true - The values were set.
+ * @return false - One or more addresses are not present.
+ */
+bool CSE_ModbusRTU_BitMap:: setBit (uint16_t address, uint8_t value, uint16_t count) {
+  uint32_t offset;
+  block_t* block = findBlock (address, count, offset);
+
+  if (block == NULL) {
+    return false;
+  }
+
+  uint8_t* bits = block->bits;
+  uint32_t end = offset + count;
+
+  // Set single bits until the offset is on a byte boundary
+  while ((offset < end) && ((offset % 8) != 0)) {
+    if (value) {
+      bits [offset / 8] |= (1U << (offset % 8));
+    }
+    else {
+      bits [offset / 8] &= ~(1U << (offset % 8));
+    }
+    offset++;
+  }
+
+  // Then the whole bytes
+  uint32_t byteCount = (end - offset) / 8;
+  memset (bits + (offset / 8), value ? 0xFF : 0x00, byteCount);
+  offset += byteCount * 8;
+
+  // And the bits left in the last byte
+  if (offset < end) {
+    uint8_t mask = (1U << (end - offset)) - 1;
+
+    if (value) {
+      bits [offset / 8] |= mask;
+    }
+    else {
+      bits [offset / 8] &= ~mask;
+    }
+  }
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets all the addresses of all the blocks to the same value. The unused bits of
+ * the last byte of a block are left at 0.
+ *
+ * @param value 0x00 for OFF, and any other value for ON.
+ */
+void CSE_ModbusRTU_BitMap:: setAll (uint8_t value) {
+  block_t* block = getBlocks();
+
+  for (size_t i = 0; i < getBlockCount(); i++, block++) {
+    uint32_t byteCount = (block->length + 7) / 8;
+
+    if (byteCount == 0) {
+      continue;
+    }
+
+    memset (block->bits, value ? 0xFF : 0x00, byteCount);
+
+    // Clear the bits after the end of the block
+    if (value && ((block->length % 8) != 0)) {
+      block->bits [byteCount - 1] = (1U << (block->length % 8)) - 1;
+    }
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief Copies the values of a range of addresses to a packed array, in the format of
+ * the data field of a Modbus read coils or read discrete inputs response. The first
+ * address goes to the least significant bit of the first byte. The unused bits of the
+ * last byte are set to 0.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @param data The array to save the values. Must have space for (count + 7) / 8 bytes.
+ * @return true - The values were copied.
+ * @return false - One or more addresses are not present.
+ */
+bool CSE_ModbusRTU_BitMap:: read (uint16_t address, uint16_t count, uint8_t* data) {
+  uint32_t offset;
+  block_t* block = findBlock (address, count, offset);
+
+  if (block == NULL) {
+    return false;
+  }
+
+  data [(count - 1) / 8] = 0; // Clear the unused bits of the last byte
+  copyBits (data, 0, block->bits, offset, count);
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Copies the values of a range of addresses from a packed array, in the format of
+ * the data field of a Modbus write multiple coils request. If any address is not
+ * present, nothing is changed.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @param data The packed values. (count + 7) / 8 bytes are read.
+ * @return true - The values were copied.
+ * @return false - One or more addresses are not present.
+ */
+bool CSE_ModbusRTU_BitMap:: write (uint16_t address, uint16_t count, const uint8_t* data) {
+  uint32_t offset;
+  block_t* block = findBlock (address, count, offset);
+
+  if (block == NULL) {
+    return false;
+  }
+
+  copyBits (block->bits, offset, data, 0, count);
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Finds the first range of contiguous addresses that are ON. The bytes that are
+ * all OFF or all ON are skipped a byte at a time. A range does not continue into the
+ * next block, even if the blocks are separated only by missing addresses.
+ *
+ * @param address The first address of the range is saved here.
+ * @param count The number of addresses in the range is saved here. Limited to 0xFFFF.
+ * @return true - A range was found.
+ * @return false - All the addresses are OFF.
+ */
+bool CSE_ModbusRTU_BitMap:: findSet (uint16_t& address, uint16_t& count) {
+  block_t* list = getBlocks();
+
+  for (size_t i = 0; i < getBlockCount(); i++) {
+    const uint8_t* bits = list [i].bits;
+    uint32_t byteCount = (list [i].length + 7) / 8;
+    uint32_t index = 0;
+
+    // Skip the bytes that are all OFF. The unused bits of the last byte are always 0.
+    while ((index < byteCount) && (bits [index] == 0)) {
+      index++;
+    }
+
+    if (index == byteCount) {
+      continue;
+    }
+
+    uint32_t first = index * 8;
+
+    while (((bits [index] >> (first % 8)) & 0x01) == 0) {
+      first++;
+    }
+
+    // Then count the bits that are ON, skipping the whole bytes that are all ON
+    uint32_t last = first + 1; // One past the last bit that is ON
+
+    while (last < list [i].length) {
+      if (((last % 8) == 0) && (bits [last / 8] == 0xFF) && ((last + 8) <= list [i].length)) {
+        last += 8;
+      }
+      else if ((bits [last / 8] >> (last % 8)) & 0x01) {
+        last++;
+      }
+      else {
+        break;
+      }
+    }
+
+    if ((last - first) > 0xFFFF) {
+      last = first + 0xFFFF;
+    }
+
+    address = list [i].address + first;
+    count = last - first;
+    return true;
+  }
+
+  return false;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the total number of values in the map.
+ *
+ * @return size_t
+ */
+size_t CSE_ModbusRTU_BitMap:: size() {
+  return count;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of blocks in the map.
+ *
+ * @return size_t
+ */
+size_t CSE_ModbusRTU_BitMap:: getBlockCount() {
+  return (layout != NULL) ? layoutCount : blocks.size();
+}
+
+//======================================================================================//
+/**
+ * @brief Returns a block by its index. The blocks are sorted by their starting address.
+ *
+ * @param index The index of the block.
+ * @return block_t* - The block; NULL if the index is invalid.
+ */
+CSE_ModbusRTU_BitMap:: block_t* CSE_ModbusRTU_BitMap:: getBlock (size_t index) {
+  if (index >= getBlockCount()) {
+    return NULL;
+  }
+
+  return getBlocks() + index;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the memory used by the map. This is the size of the packed values and
+ * of the block descriptors. It does not depend on the addresses of the blocks. The
+ * memory of a layout is not counted, since it is not allocated by the map.
+ *
+ * @return size_t - Number of bytes.
+ */
+size_t CSE_ModbusRTU_BitMap:: getMemoryUsage() {
+  return storage.getUsage() + (blocks.capacity() * sizeof (block_t));
+}
+
+//======================================================================================//
+/**
+ * @brief Copies a number of packed bits. Bit n of an array is bit (n % 8) of byte
+ * (n / 8). The bits of the target outside the range are not changed. The arrays must
+ * not overlap.
+ *
+ * Single bits are copied until the target is on a byte boundary. After that, a whole
+ * target byte is written in each step. If the source is also on a byte boundary, the
+ * bytes are copied with memcpy(). Otherwise each target byte is made from two source
+ * bytes with shifts.
+ *
+ * @param target The target array.
+ * @param targetOffset The first bit of the target.
+ * @param source The source array.
+ * @param sourceOffset The first bit of the source.
+ * @param count The number of bits to copy.
+ */
+void CSE_ModbusRTU_BitMap:: copyBits (uint8_t* target, uint32_t targetOffset, const uint8_t* source, uint32_t sourceOffset, uint32_t count) {
+  // Copy single bits until the target is on a byte boundary
+  while ((count > 0) && ((targetOffset % 8) != 0)) {
+    if ((source [sourceOffset / 8] >> (sourceOffset % 8)) & 0x01) {
+      target [targetOffset / 8] |= (1U << (targetOffset % 8));
+    }
+    else {
+      target [targetOffset / 8] &= ~(1U << (targetOffset % 8));
+    }
+
+    targetOffset++;
+    sourceOffset++;
+    count--;
+  }
+
+  uint8_t* output = target + (targetOffset / 8);
+  const uint8_t* input = source + (sourceOffset / 8);
+  uint8_t shift = sourceOffset % 8;
+  uint32_t byteCount = count / 8;
+  uint8_t remaining = count % 8;
+
+  if (shift == 0) {
+    memcpy (output, input, byteCount);
+  }
+  else {
+    // The bits of each target byte are the upper bits of one source byte and the lower
+    // bits of the next one.
+    for (uint32_t i = 0; i < byteCount; i++) {
+      output [i] = (input [i] >> shift) | (input [i + 1] << (8 - shift));
+    }
+  }
+
+  // The bits left in the last target byte
+  if (remaining > 0) {
+    uint8_t value = input [byteCount] >> shift;
+
+    if ((shift + remaining) > 8) {
+      value |= input [byteCount + 1] << (8 - shift);
+    }
+
+    uint8_t mask = (1U << remaining) - 1;
+    output [byteCount] = (output [byteCount] & ~mask) | (value & mask);
+  }
+}
+
+//======================================================================================//
@@ -0,0 +1,637 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_RegisterMap.h
+  Description: Sorted range-block storage for the data tables of the CSE_ModbusRTU
+  server. Registers are stored as 16-bit values and bits are packed.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_REGISTERMAP_H
+#define CSE_MODBUSRTU_REGISTERMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_AVR)
+  #include <ArduinoSTL.h>
+#else
+  #include <vector>
+#endif
+
+//======================================================================================//
+
+// The value arrays taken from an arena start at multiples of this many bytes
+#define   MODBUS_RTU_MAP_ALIGNMENT              4U
+
+// Block flags
+#define   MODBUS_RTU_BLOCK_READ_ONLY            0x01U // The client can not write the block
+
+//======================================================================================//
+/**
+ * @brief Allocates the value arrays of the blocks of a map. By default the arrays are
+ * allocated on the heap. If an arena is set with setArena(), they are taken from it
+ * instead, and the heap is not used for the values. The arena can be a static array or
+ * a buffer allocated once by the application, so the memory of a map can be sized and
+ * placed at compile time.
+ *
+ * The arena is used like a stack. An array can grow in place only if it is the last one
+ * taken from the arena, and the space of an array is only given back if it is the last
+ * one. Adding the ranges of a map in increasing order of address keeps all the space in
+ * use.
+ *
+ */
+class CSE_ModbusRTU_MapStorage {
+  private:
+    uint8_t* arena; // The arena, or NULL to use the heap
+    size_t arenaSize; // The size of the arena in bytes
+    size_t arenaUsed; // The bytes taken from the arena, including the unused ones
+    size_t used;  // The bytes in the arrays that are allocated
+
+    bool isLast (void* array, size_t size); // Check if an array is the last one in the arena
+
+  public:
+    CSE_ModbusRTU_MapStorage();
+
+    bool setArena (void* arena, size_t size); // Use an arena instead of the heap
+    void* allocate (size_t size); // Allocate an array
+    void* resize (void* array, size_t oldSize, size_t newSize); // Grow or shrink an array
+    void release (void* array, size_t size); // Free an array
+    size_t getUsage(); // Number of bytes in the allocated arrays
+    size_t getArenaFree(); // Number of bytes left in the arena
+};
+
+//======================================================================================//
+/**
+ * @brief Stores one Modbus data table (input registers or holding registers) as a list
+ * of blocks. Each block is a contiguous range of addresses with a dense array of values,
+ * so the address of a value is implied by its position in the block. The blocks are
+ * kept sorted by their starting address, and never overlap or touch. A range added next
+ * to an existing block is merged into it. So every contiguous range of present addresses
+ * is inside one block.
+ *
+ * Finding an address is a binary search over the blocks, and a whole request range
+ * resolves to a single pointer into the values of one block. Reading or writing a range
+ * then costs only the number of values transferred.
+ *
+ * The values are stored on the heap, or in an arena set with setArena() (see
+ * CSE_ModbusRTU_MapStorage). Only the values and a small descriptor per block take
+ * memory, so a map can cover the whole address space. The map can also use a fixed
+ * array of blocks set with setLayout(), such as the one built at compile time by
+ * CSE_ModbusRTU_StaticRegisterMap. Then no memory is allocated at all.
+ *
+ * The server uses it with uint16_t values for the input and holding registers. The
+ * coils and discrete inputs are stored with CSE_ModbusRTU_BitMap, which works the same
+ * way but packs the values.
+ *
+ * @tparam value_t The type of the values.
+ */
+template <typename value_t> class CSE_ModbusRTU_RegisterMap {
+  public:
+    // A contiguous range of addresses
+    struct block_t {
+      uint16_t address; // The first address of the block
+      uint32_t length;  // The number of addresses in the block
+      value_t* values;  // One value for each address
+      uint8_t flags;  // MODBUS_RTU_BLOCK_READ_ONLY, or 0
+    };
+
+  private:
+    std::vector <block_t> blocks; // Sorted by the starting address
+    block_t* layout;  // The fixed blocks set with setLayout(), or NULL
+    size_t layoutCount; // The number of fixed blocks
+    size_t count; // Total number of values in all the blocks
+    CSE_ModbusRTU_MapStorage storage; // Allocates the values
+
+    block_t* getBlocks(); // The first block, from the layout or the list
+    int search (uint16_t address); // Index of the first block that ends after the address
+    block_t* findBlock (uint16_t address, uint16_t count, uint32_t& offset); // Find the block of a range
+
+    // The blocks own their values, so a map can not be copied
+    CSE_ModbusRTU_RegisterMap (const CSE_ModbusRTU_RegisterMap&);
+    CSE_ModbusRTU_RegisterMap& operator= (const CSE_ModbusRTU_RegisterMap&);
+
+  public:
+    CSE_ModbusRTU_RegisterMap();
+    ~CSE_ModbusRTU_RegisterMap();
+
+    bool setArena (void* arena, size_t size); // Store the values in an arena instead of the heap
+    bool setLayout (block_t* layoutBlocks, size_t blockCount); // Use a fixed array of blocks, such as a static map
+    bool add (uint16_t address, uint16_t count); // Add a range of addresses with the values set to 0
+    bool remove (uint16_t address, uint16_t count); // Remove a range of addresses
+    void clear(); // Remove all the blocks
+    void reserve (size_t blockCount); // Reserve memory for a number of blocks
+
+    value_t* find (uint16_t address, uint16_t count = 1); // Get the values of a range of addresses
+    bool isPresent (uint16_t address, uint16_t count = 1); // Check if a range of addresses is present
+    bool isWritable (uint16_t address, uint16_t count = 1); // Check if a range is present and not read-only
+
+    size_t size(); // Total number of values
+    size_t getBlockCount(); // Number of blocks
+    block_t* getBlock (size_t index); // Get a block by its index
+    size_t getMemoryUsage(); // Number of bytes used by the values and the blocks
+};
+
+//======================================================================================//
+/**
+ * @brief Creates an empty map.
+ *
+ */
+template <typename value_t> CSE_ModbusRTU_RegisterMap <value_t>:: CSE_ModbusRTU_RegisterMap() {
+  layout = NULL;
+  layoutCount = 0;
+  count = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Frees the values of all the blocks.
+ *
+ */
+template <typename value_t> CSE_ModbusRTU_RegisterMap <value_t>:: ~CSE_ModbusRTU_RegisterMap() {
+  clear();
+}
+
+//======================================================================================//
+/**
+ * @brief Sets an arena to store the values in, instead of the heap. The map must be
+ * empty. The arena must stay valid as long as the map is used.
+ *
+ * @param arena The arena. NULL to use the heap again.
+ * @param size The size of the arena in bytes.
+ * @return true - The arena was set.
+ * @return false - The map is not empty.
+ */
+template <typename value_t> bool CSE_ModbusRTU_RegisterMap <value_t>:: setArena (void* arena, size_t size) {
+  if (getBlockCount() > 0) {
+    return false;
+  }
+
+  return storage.setArena (arena, size);
+}
+
+//======================================================================================//
+/**
+ * @brief Makes the map use a fixed array of blocks, instead of adding them one by one.
+ * The blocks and their values are owned by the caller and must stay valid as long as
+ * the map is used. Nothing is allocated or copied. The map must be empty, and ranges
+ * can not be added to it until clear() is called. The blocks must be sorted by their
+ * starting address, and must not overlap or touch, as the blocks added with add().
+ *
+ * @param layoutBlocks The blocks.
+ * @param blockCount The number of blocks.
+ * @return true - The layout was set.
+ * @return false - The map is not empty, or the blocks are not valid.
+ */
+template <typename value_t> bool CSE_ModbusRTU_RegisterMap <value_t>:: setLayout (block_t* layoutBlocks, size_t blockCount) {
+  if ((getBlockCount() > 0) || (layoutBlocks == NULL) || (blockCount == 0)) {
+    return false;
+  }
+
+  uint32_t end = 0; // One past the last address of the previous block
+  size_t total = 0;
+
+  for (size_t i = 0; i < blockCount; i++) {
+    if ((layoutBlocks [i].length == 0) || (layoutBlocks [i].values == NULL) || ((i > 0) && (layoutBlocks [i].address <= end))) {
+      return false;
+    }
+
+    end = (uint32_t) layoutBlocks [i].address + layoutBlocks [i].length;
+
+    if (end > 0x10000UL) {
+      return false;
+    }
+
+    total += layoutBlocks [i].length;
+  }
+
+  layout = layoutBlocks;
+  layoutCount = blockCount;
+  count = total;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the first block. The blocks are in the layout if one is set.
+ *
+ * @return block_t* - The first block; NULL if there are no blocks.
+ */
+template <typename value_t> typename CSE_ModbusRTU_RegisterMap <value_t>:: block_t* CSE_ModbusRTU_RegisterMap <value_t>:: getBlocks() {
+  if (layout != NULL) {
+    return layout;
+  }
+
+  return blocks.empty() ? NULL : &blocks [0];
+}
+
+//======================================================================================//
+/**
+ * @brief Finds the first block whose last address is greater than or equal to the
+ * address. The block contains the address only if its starting address is not greater
+ * than the address.
+ *
+ * @param address The address to search.
+ * @return int - Index of the block; the number of blocks if there is none.
+ */
+template <typename value_t> int CSE_ModbusRTU_RegisterMap <value_t>:: search (uint16_t address) {
+  block_t* list = getBlocks();
+  int low = 0;
+  int high = getBlockCount();
+
+  while (low < high) {
+    int middle = (low + high) / 2;
+    uint32_t end = (uint32_t) list [middle].address + list [middle].length; // One past the last address
+
+    if (end <= address) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+//======================================================================================//
+/**
+ * @brief Adds a range of addresses to the map. The values are set to 0. The range must
+ * not overlap any address already present, and must not go past the address 0xFFFF. If
+ * the range touches a block before or after it, the blocks are merged.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - The range was added.
+ * @return false - The range is empty, too long, overlaps the existing addresses, a layout is set, or there is no memory.
+ */
+template <typename value_t> bool CSE_ModbusRTU_RegisterMap <value_t>:: add (uint16_t address, uint16_t count) {
+  uint32_t end = (uint32_t) address + count; // One past the last address
+
+  if ((count == 0) || (end > 0x10000UL) || (layout != NULL)) {
+    return false;
+  }
+
+  int index = search (address);
+
+  // The block found is the first one that ends after the address. If it starts before
+  // the end of the new range, the two overlap.
+  if ((index < (int) blocks.size()) && (blocks [index].address < end)) {
+    return false;
+  }
+
+  bool joinsPrevious = (index > 0) && (((uint32_t) blocks [index - 1].address + blocks [index - 1].length) == address);
+  bool joinsNext = (index < (int) blocks.size()) && (blocks [index].address == end);
+
+  if (joinsPrevious) {
+    // The values of the previous block are extended, in place if possible
+    block_t& previous = blocks [index - 1];
+    uint32_t length = previous.length + count + (joinsNext ? blocks [index].length : 0);
+    value_t* values = (value_t*) storage.resize (previous.values, previous.length * sizeof (value_t), length * sizeof (value_t));
+
+    if (values == NULL) {
+      return false;
+    }
+
+    memset (values + previous.length, 0, count * sizeof (value_t));
+
+    if (joinsNext) {
+      block_t& next = blocks [index];
+      memcpy (values + previous.length + count, next.values, next.length * sizeof (value_t));
+      storage.release (next.values, next.length * sizeof (value_t));
+      blocks.erase (blocks.begin() + index);
+    }
+
+    blocks [index - 1].values = values;
+    blocks [index - 1].length = length;
+  }
+  else if (joinsNext) {
+    // The values of the next block must be moved up by the count
+    block_t& next = blocks [index];
+    uint32_t length = next.length + count;
+    value_t* values = (value_t*) storage.allocate (length * sizeof (value_t));
+
+    if (values == NULL) {
+      return false;
+    }
+
+    memset (values, 0, count * sizeof (value_t));
+    memcpy (values + count, next.values, next.length * sizeof (value_t));
+    storage.release (next.values, next.length * sizeof (value_t));
+
+    next.address = address;
+    next.length = length;
+    next.values = values;
+  }
+  else {
+    block_t block;
+    block.address = address;
+    block.length = count;
+    block.values = (value_t*) storage.allocate (count * sizeof (value_t));
+    block.flags = 0;
+
+    if (block.values == NULL) {
+      return false;
+    }
+
+    memset (block.values, 0, count * sizeof (value_t));
+    blocks.insert (blocks.begin() + index, block);
+  }
+
+  this->count += count;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Removes a range of addresses from the map. The range must be inside one block.
+ * A block is split in two if the range is in the middle of it. This can undo an add().
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - The range was removed.
+ * @return false - An address is not present, a layout is set, or there is no memory to split the block.
+ */
+template <typename value_t> bool CSE_ModbusRTU_RegisterMap <value_t>:: remove (uint16_t address, uint16_t count) {
+  uint32_t offset;
+
+  if ((layout != NULL) || (findBlock (address, count, offset) == NULL)) {
+    return false;
+  }
+
+  int index = search (address);
+  block_t& block = blocks [index];
+  uint32_t tailLength = block.length - offset - count; // The addresses after the range
+
+  if ((offset == 0) && (tailLength == 0)) {
+    storage.release (block.values, block.length * sizeof (value_t));
+    blocks.erase (blocks.begin() + index);
+  }
+  else if (offset == 0) {
+    // The values after the range are moved down, and the array is made smaller
+    memmove (block.values, block.values + count, tailLength * sizeof (value_t));
+    block.values = (value_t*) storage.resize (block.values, block.length * sizeof (value_t), tailLength * sizeof (value_t));
+    block.address += count;
+    block.length = tailLength;
+  }
+  else if (tailLength == 0) {
+    block.values = (value_t*) storage.resize (block.values, block.length * sizeof (value_t), offset * sizeof (value_t));
+    block.length = offset;
+  }
+  else {
+    // The values after the range are moved to a new block
+    block_t tail;
+    tail.address = address + count;
+    tail.length = tailLength;
+    tail.values = (value_t*) storage.allocate (tailLength * sizeof (value_t));
+    tail.flags = block.flags;
+
+    if (tail.values == NULL) {
+      return false;
+    }
+
+    memcpy (tail.values, block.values + offset + count, tailLength * sizeof (value_t));
+    block.values = (value_t*) storage.resize (block.values, block.length * sizeof (value_t), offset * sizeof (value_t));
+    block.length = offset;
+    blocks.insert (blocks.begin() + index + 1, tail);
+  }
+
+  this->count -= count;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Removes all the blocks. A layout is only detached, since its values are not
+ * owned by the map.
+ *
+ */
+template <typename value_t> void CSE_ModbusRTU_RegisterMap <value_t>:: clear() {
+  layout = NULL;
+  layoutCount = 0;
+
+  // Free the values in the reverse order, so that an arena is given back completely
+  for (size_t i = blocks.size(); i > 0; i--) {
+    storage.release (blocks [i - 1].values, blocks [i - 1].length * sizeof (value_t));
+  }
+
+  blocks.clear();
+  count = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Reserves memory for a number of blocks. This is not necessary but it prevents
+ * memory fragmentation when the blocks are added.
+ *
+ * @param blockCount The number of blocks.
+ */
+template <typename value_t> void CSE_ModbusRTU_RegisterMap <value_t>:: reserve (size_t blockCount) {
+  blocks.reserve (blockCount);
+}
+
+//======================================================================================//
+/**
+ * @brief Finds the values of a range of addresses. All the addresses must be present.
+ * Since touching blocks are always merged, the range is inside a single block, and the
+ * values are contiguous in memory. The pointer stays valid until the next add() or
+ * clear().
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return value_t* - Pointer to the value of the first address; NULL if any address is not present.
+ */
+template <typename value_t> value_t* CSE_ModbusRTU_RegisterMap <value_t>:: find (uint16_t address, uint16_t count) {
+  uint32_t offset;
+  block_t* block = findBlock (address, count, offset);
+
+  if (block == NULL) {
+    return NULL;
+  }
+
+  return block->values + offset;
+}
+
+//======================================================================================//
+/**
+ * @brief Finds the block that contains all the addresses of a range.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @param offset The offset of the first address in the block is saved here.
+ * @return block_t* - The block; NULL if any address is not present.
+ */
+template <typename value_t> typename CSE_ModbusRTU_RegisterMap <value_t>:: block_t* CSE_ModbusRTU_RegisterMap <value_t>:: findBlock (uint16_t address, uint16_t count, uint32_t& offset) {
+  if (count == 0) {
+    return NULL;
+  }
+
+  int index = search (address);
+  block_t* block = getBlocks() + index;
+
+  if ((index == (int) getBlockCount()) || (block->address > address)) {
+    return NULL;
+  }
+
+  offset = address - block->address;
+
+  if ((offset + count) > block->length) {
+    return NULL;
+  }
+
+  return block;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if all the addresses of a range are present.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - All the addresses are present.
+ * @return false - One or more addresses are not present.
+ */
+template <typename value_t> bool CSE_ModbusRTU_RegisterMap <value_t>:: isPresent (uint16_t address, uint16_t count) {
+  return find (address, count) != NULL;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if all the addresses of a range are present, and can be written by the
+ * client. The blocks flagged with MODBUS_RTU_BLOCK_READ_ONLY can only be written by the
+ * server itself.
+ *
+ * @param address The first address of the range.
+ * @param count The number of addresses.
+ * @return true - All the addresses are present and writable.
+ * @return false - One or more addresses are not present, or are read-only.
+ */
+template <typename value_t> bool CSE_ModbusRTU_RegisterMap <value_t>:: isWritable (uint16_t address, uint16_t count) {
+  uint32_t offset;
+  block_t* block = findBlock (address, count, offset);
+
+  return (block != NULL) && ((block->flags & MODBUS_RTU_BLOCK_READ_ONLY) == 0);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the total number of values in the map.
+ *
+ * @return size_t
+ */
+template <typename value_t> size_t CSE_ModbusRTU_RegisterMap <value_t>:: size() {
+  return count;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of blocks in the map.
+ *
+ * @return size_t
+ */
+template <typename value_t> size_t CSE_ModbusRTU_RegisterMap <value_t>:: getBlockCount() {
+  return (layout != NULL) ? layoutCount : blocks.size();
+}
+
+//======================================================================================//
+/**
+ * @brief Returns a block by its index. The blocks are sorted by their starting address.
+ *
+ * @param index The index of the block.
+ * @return block_t* - The block; NULL if the index is invalid.
+ */
+template <typename value_t> typename CSE_ModbusRTU_RegisterMap <value_t>:: block_t* CSE_ModbusRTU_RegisterMap <value_t>:: getBlock (size_t index) {
+  if (index >= getBlockCount()) {
+    return NULL;
+  }
+
+  return getBlocks() + index;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the memory used by the map. This is the size of the values and of the
+ * block descriptors. It does not depend on the addresses of the blocks. The memory of a
+ * layout is not counted, since it is not allocated by the map.
+ *
+ * @return size_t - Number of bytes.
+ */
+template <typename value_t> size_t CSE_ModbusRTU_RegisterMap <value_t>:: getMemoryUsage() {
+  return storage.getUsage() + (blocks.capacity() * sizeof (block_t));
+}
+
+//======================================================================================//
+/**
+ * @brief Stores a table of Modbus bits (coils or discrete inputs). The blocks work the
+ * same way as in CSE_ModbusRTU_RegisterMap, but the values are packed 8 to a byte, in
+ * the same order as in the data field of a Modbus ADU. The first address of a block is
+ * the least significant bit of its first byte.
+ *
+ * A range is read into or written from the packed format of the ADU with read() and
+ * write(). When the range starts on a byte boundary of the block, the bytes are copied
+ * with memcpy(). Otherwise the bits are shifted into place a byte at a time.
+ *
+ */
+class CSE_ModbusRTU_BitMap {
+  public:
+    // A contiguous range of addresses
+    struct block_t {
+      uint16_t address; // The first address of the block
+      uint32_t length;  // The number of addresses in the block
+      uint8_t* bits;  // The packed values. The unused bits of the last byte are 0.
+      uint8_t flags;  // MODBUS_RTU_BLOCK_READ_ONLY, or 0
+    };
+
+  private:
+    std::vector <block_t> blocks; // Sorted by the starting address
+    block_t* layout;  // The fixed blocks set with setLayout(), or NULL
+    size_t layoutCount; // The number of fixed blocks
+    size_t count; // Total number of bits in all the blocks
+    CSE_ModbusRTU_MapStorage storage; // Allocates the packed values
+
+    block_t* getBlocks(); // The first block, from the layout or the list
+    int search (uint16_t address); // Index of the first block that ends after the address
+    block_t* findBlock (uint16_t address, uint16_t count, uint32_t& offset); // Find the block of a range
+
+    // The blocks own their values, so a map can not be copied
+    CSE_ModbusRTU_BitMap (const CSE_ModbusRTU_BitMap&);
+    CSE_ModbusRTU_BitMap& operator= (const CSE_ModbusRTU_BitMap&);
+
+  public:
+    CSE_ModbusRTU_BitMap();
+    ~CSE_ModbusRTU_BitMap();
+
+    bool setArena (void* arena, size_t size); // Store the values in an arena instead of the heap
+    bool setLayout (block_t* layoutBlocks, size_t blockCount); // Use a fixed array of blocks, such as a static map
+    bool add (uint16_t address, uint16_t count); // Add a range of addresses with the values set to 0
+    bool remove (uint16_t address, uint16_t count); // Remove a range of addresses
+    void clear(); // Remove all the blocks
+    void reserve (size_t blockCount); // Reserve memory for a number of blocks
+
+    bool isPresent (uint16_t address, uint16_t count = 1); // Check if a range of addresses is present
+    bool isWritable (uint16_t address, uint16_t count = 1); // Check if a range is present and not read-only
+    int getBit (uint16_t address); // Get the value of an address
+    bool setBit (uint16_t address, uint8_t value, uint16_t count = 1); // Set a range of addresses to the same value
+    void setAll (uint8_t value); // Set all the addresses to the same value
+    bool read (uint16_t address, uint16_t count, uint8_t* data); // Copy a range of values to a packed array
+    bool write (uint16_t address, uint16_t count, const uint8_t* data); // Copy a range of values from a packed array
+    bool findSet (uint16_t& address, uint16_t& count); // Find the first range of addresses that are ON
+
+    size_t size(); // Total number of values
+    size_t getBlockCount(); // Number of blocks
+    block_t* getBlock (size_t index); // Get a block by its index
+    size_t getMemoryUsage(); // Number of bytes used by the values and the blocks
+
+    static void copyBits (uint8_t* target, uint32_t targetOffset, const uint8_t* source, uint32_t sourceOffset, uint32_t count); // Copy packed bits
+};
+
+#endif
+
+//======================================================================================//
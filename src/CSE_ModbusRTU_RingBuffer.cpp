@@ -0,0 +1,82 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_RingBuffer.cpp
+  Description: Lock-free receive ring buffer for the CSE_ModbusRTU library.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#include "CSE_ModbusRTU_RingBuffer.h"
+
+//======================================================================================//
+/**
+ * @brief Constructor. Creates an empty buffer.
+ *
+ */
+CSE_ModbusRTU_RingBuffer:: CSE_ModbusRTU_RingBuffer() {
+  MODBUS_RTU_RING_STORE (head, 0, relaxed);
+  MODBUS_RTU_RING_STORE (tail, 0, relaxed);
+  overflowCount = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Discards all bytes in the buffer. This moves the read position to the write
+ * position, so it must only be called from the consumer.
+ *
+ */
+void CSE_ModbusRTU_RingBuffer:: clear() {
+  MODBUS_RTU_RING_STORE (tail, MODBUS_RTU_RING_LOAD (head, acquire), release);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes in the buffer. The value can increase at any time
+ * if the producer is running.
+ *
+ * @return int - Number of bytes available to read.
+ */
+int CSE_ModbusRTU_RingBuffer:: available() {
+  uint16_t currentHead = MODBUS_RTU_RING_LOAD (head, acquire);
+  uint16_t currentTail = MODBUS_RTU_RING_LOAD (tail, relaxed);
+
+  return (int) ((currentHead - currentTail) & MODBUS_RTU_RING_BUFFER_MASK);
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the maximum number of bytes the buffer can hold. This is one less than
+ * MODBUS_RTU_RING_BUFFER_SIZE.
+ *
+ * @return size_t - The capacity of the buffer.
+ */
+size_t CSE_ModbusRTU_RingBuffer:: getCapacity() {
+  return MODBUS_RTU_RING_BUFFER_SIZE - 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the number of bytes dropped because the buffer was full.
+ *
+ * @return uint32_t - The overflow count.
+ */
+uint32_t CSE_ModbusRTU_RingBuffer:: getOverflowCount() {
+  return overflowCount;
+}
+
+//======================================================================================//
+/**
+ * @brief Resets the overflow counter to 0.
+ *
+ */
+void CSE_ModbusRTU_RingBuffer:: resetOverflowCount() {
+  overflowCount = 0;
+}
+
+//======================================================================================//
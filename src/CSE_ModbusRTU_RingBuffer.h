@@ -0,0 +1,170 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_RingBuffer.h
+  Description: Lock-free receive ring buffer for the CSE_ModbusRTU library.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_RINGBUFFER_H
+#define CSE_MODBUSRTU_RINGBUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// AVR has no <atomic>, and there is only one core. A 16-bit load or store takes two
+// instructions there, so the indices are accessed with the interrupts disabled.
+#if defined(ARDUINO_ARCH_AVR)
+  #include <util/atomic.h>
+  #define MODBUS_RTU_RING_INDEX_T               volatile uint16_t
+  #define MODBUS_RTU_RING_LOAD(index, order)    modbusRTURingLoad (index)
+  #define MODBUS_RTU_RING_STORE(index, value, order)   modbusRTURingStore ((index), (value))
+
+  static inline uint16_t modbusRTURingLoad (volatile uint16_t& index) {
+    uint16_t value;
+
+    ATOMIC_BLOCK (ATOMIC_RESTORESTATE) {
+      value = index;
+    }
+
+    return value;
+  }
+
+  static inline void modbusRTURingStore (volatile uint16_t& index, uint16_t value) {
+    ATOMIC_BLOCK (ATOMIC_RESTORESTATE) {
+      index = value;
+    }
+  }
+#else
+  #include <atomic>
+  #define MODBUS_RTU_RING_INDEX_T               std::atomic <uint16_t>
+  #define MODBUS_RTU_RING_LOAD(index, order)    (index).load (std::memory_order_##order)
+  #define MODBUS_RTU_RING_STORE(index, value, order)   (index).store ((value), std::memory_order_##order)
+#endif
+
+//======================================================================================//
+
+// The number of entries in the receive ring buffer. Must be a power of two, and not
+// larger than 32768. One entry is always kept free, so the buffer can hold one byte less.
+// Each entry takes 5 bytes of RAM (data byte + timestamp). The default of 512 holds a
+// whole 256 byte ADU and the start of the next one. AVR has little RAM, so it has 64.
+#ifndef MODBUS_RTU_RING_BUFFER_SIZE
+  #if defined(ARDUINO_ARCH_AVR)
+    #define MODBUS_RTU_RING_BUFFER_SIZE         64U
+  #else
+    #define MODBUS_RTU_RING_BUFFER_SIZE         512U
+  #endif
+#endif
+
+#if ((MODBUS_RTU_RING_BUFFER_SIZE & (MODBUS_RTU_RING_BUFFER_SIZE - 1)) != 0) || (MODBUS_RTU_RING_BUFFER_SIZE > 32768)
+  #error "MODBUS_RTU_RING_BUFFER_SIZE must be a power of two and not larger than 32768."
+#endif
+
+#define   MODBUS_RTU_RING_BUFFER_MASK           (MODBUS_RTU_RING_BUFFER_SIZE - 1U)
+
+//======================================================================================//
+/**
+ * @brief A single-producer/single-consumer ring buffer for received bytes. Every byte is
+ * stored with its arrival timestamp in microseconds. The producer is a UART RX interrupt
+ * or a receive callback, and calls push(). The consumer is the CSE_ModbusRTU object,
+ * which calls pop(). No locks or disabling of interrupts are needed as long as there is
+ * only one producer and one consumer.
+ *
+ * push() and pop() are defined in the header so that they can be inlined into the
+ * interrupt handler.
+ *
+ */
+class CSE_ModbusRTU_RingBuffer {
+  private:
+    uint8_t data [MODBUS_RTU_RING_BUFFER_SIZE]; // Received bytes
+    uint32_t timestamps [MODBUS_RTU_RING_BUFFER_SIZE];  // Arrival time of each byte in microseconds
+    MODBUS_RTU_RING_INDEX_T head; // Next entry to write. Written only by the producer.
+    MODBUS_RTU_RING_INDEX_T tail; // Next entry to read. Written only by the consumer.
+    volatile uint32_t overflowCount;  // Number of bytes dropped because the buffer was full
+
+  public:
+    CSE_ModbusRTU_RingBuffer();
+    void clear(); // Discard all bytes. Consumer side only.
+    int available();  // Number of bytes in the buffer
+    size_t getCapacity(); // Maximum number of bytes the buffer can hold
+    uint32_t getOverflowCount();  // Number of bytes dropped
+    void resetOverflowCount();  // Reset the overflow counter
+
+    /**
+     * @brief Adds a received byte to the buffer. Must only be called from the producer
+     * (the interrupt handler or the receive callback). If the buffer is full, the byte
+     * is dropped and the overflow counter is incremented.
+     *
+     * @param byte The received byte.
+     * @param timestamp The arrival time of the byte in microseconds, usually micros().
+     * @return true - The byte was added.
+     * @return false - The buffer is full.
+     */
+    inline bool push (uint8_t byte, uint32_t timestamp) {
+      uint16_t currentHead = MODBUS_RTU_RING_LOAD (head, relaxed);
+      uint16_t nextHead = (currentHead + 1) & MODBUS_RTU_RING_BUFFER_MASK;
+
+      if (nextHead == MODBUS_RTU_RING_LOAD (tail, acquire)) {
+        overflowCount = overflowCount + 1;
+        return false;
+      }
+
+      data [currentHead] = byte;
+      timestamps [currentHead] = timestamp;
+      MODBUS_RTU_RING_STORE (head, nextHead, release); // Publish the entry
+      return true;
+    }
+
+    /**
+     * @brief Removes the oldest byte from the buffer. Must only be called from the
+     * consumer.
+     *
+     * @param byte The byte is saved here.
+     * @param timestamp The arrival time of the byte is saved here.
+     * @return true - A byte was read.
+     * @return false - The buffer is empty.
+     */
+    inline bool pop (uint8_t& byte, uint32_t& timestamp) {
+      uint16_t currentTail = MODBUS_RTU_RING_LOAD (tail, relaxed);
+
+      if (currentTail == MODBUS_RTU_RING_LOAD (head, acquire)) {
+        return false;
+      }
+
+      byte = data [currentTail];
+      timestamp = timestamps [currentTail];
+      MODBUS_RTU_RING_STORE (tail, (uint16_t) ((currentTail + 1) & MODBUS_RTU_RING_BUFFER_MASK), release); // Free the entry
+      return true;
+    }
+
+    /**
+     * @brief Reads the oldest byte without removing it from the buffer. Must only be
+     * called from the consumer.
+     *
+     * @param byte The byte is saved here.
+     * @param timestamp The arrival time of the byte is saved here.
+     * @return true - A byte was read.
+     * @return false - The buffer is empty.
+     */
+    inline bool peek (uint8_t& byte, uint32_t& timestamp) {
+      uint16_t currentTail = MODBUS_RTU_RING_LOAD (tail, relaxed);
+
+      if (currentTail == MODBUS_RTU_RING_LOAD (head, acquire)) {
+        return false;
+      }
+
+      byte = data [currentTail];
+      timestamp = timestamps [currentTail];
+      return true;
+    }
+};
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,259 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_SeqLock.h
+  Description: Sequence lock for consistent reads of the register tables of the server
+  while another thread or core writes them.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_SEQLOCK_H
+#define CSE_MODBUSRTU_SEQLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//======================================================================================//
+
+// Available register locks
+#define   MODBUS_RTU_REGISTER_LOCK_NONE                 0U  // No protection. All access from one thread.
+#define   MODBUS_RTU_REGISTER_LOCK_SEQLOCK              1U  // Sequence lock. Readers retry if a write overlaps.
+
+// You can select the register lock used by the server here, or by defining
+// MODBUS_RTU_REGISTER_LOCK in your build flags. AVR has no <atomic> and only one core,
+// so it has no lock by default.
+#ifndef MODBUS_RTU_REGISTER_LOCK
+  #if defined(ARDUINO_ARCH_AVR)
+    #define MODBUS_RTU_REGISTER_LOCK    MODBUS_RTU_REGISTER_LOCK_NONE
+  #else
+    #define MODBUS_RTU_REGISTER_LOCK    MODBUS_RTU_REGISTER_LOCK_SEQLOCK
+  #endif
+#endif
+
+#if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+  #include <atomic>
+#endif
+
+// The number of times a lock with an owner set by setCounter() checks an odd sequence
+// number that does not change, before it checks if the writer is still alive. This is
+// only for counters shared with other processes, where a process can crash while it
+// holds the lock. 0 to never check, and wait forever.
+#ifndef MODBUS_RTU_SEQLOCK_SPIN_LIMIT
+  #define MODBUS_RTU_SEQLOCK_SPIN_LIMIT   1000000UL
+#endif
+
+//======================================================================================//
+/**
+ * @brief A sequence lock. The sequence number is odd while a write is in progress, and
+ * is incremented at the start and the end of every write. A reader copies the values
+ * between beginRead() and endRead(), and copies them again if endRead() returns false.
+ * So the readers never block the writers, and a reader only waits for the write that is
+ * in progress. Writers are serialized with each other by the sequence number itself.
+ *
+ * The sequence number is kept in the lock, or in a counter given with setCounter(),
+ * such as one in a memory segment shared with other processes. A process can stop in
+ * the middle of a write and leave the number odd. So setCounter() can also be given an
+ * owner, where every writer stores its id while it holds the lock, and a function that
+ * checks if the writer with an id is alive. After MODBUS_RTU_SEQLOCK_SPIN_LIMIT checks
+ * of the same odd number, a reader or a writer checks the owner. If the writer is dead,
+ * a reader copies the values as they are, and a writer takes over the write. A writer
+ * that is only slow or suspended is always waited for.
+ *
+ * The functions are defined in the header so that they can be inlined into the request
+ * handlers of the server.
+ *
+ */
+class CSE_ModbusRTU_SeqLock {
+  private:
+    #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+      std::atomic <uint32_t> localSequence; // Used if no counter is set
+      std::atomic <uint32_t>* sequence; // Odd while a write is in progress
+      std::atomic <uint32_t>* owner;  // The id of the writer, or NULL if not used
+      uint32_t id;  // The id stored in the owner by this lock
+      bool (*isAlive) (uint32_t id);  // Checks if the writer with an id is alive
+
+      //================================================================================//
+      /**
+       * @brief Checks if the writer that made the sequence number odd has died. The
+       * owner is checked every MODBUS_RTU_SEQLOCK_SPIN_LIMIT times the same number is
+       * seen in a row, because the check can be a system call. Without an owner, or if
+       * the writer has not stored its id yet, the writer is always waited for.
+       *
+       * @param current The odd sequence number just loaded.
+       * @param last The number seen by the previous check.
+       * @param spins The number of times the same number was seen. Set to 0 by the caller.
+       * @return true - The writer has stopped.
+       * @return false - Keep waiting.
+       */
+      bool isStalled (uint32_t current, uint32_t& last, uint32_t& spins) {
+        if ((MODBUS_RTU_SEQLOCK_SPIN_LIMIT == 0) || (owner == NULL) || (isAlive == NULL)) {
+          return false;
+        }
+
+        if (current != last) {
+          last = current;
+          spins = 0;
+        }
+
+        if (++spins < MODBUS_RTU_SEQLOCK_SPIN_LIMIT) {
+          return false;
+        }
+
+        spins = 0;
+
+        uint32_t writer = owner->load (std::memory_order_acquire);
+        return (writer != 0) && !isAlive (writer);
+      }
+    #endif
+
+  public:
+    CSE_ModbusRTU_SeqLock() {
+      #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+        localSequence.store (0, std::memory_order_relaxed);
+        sequence = &localSequence;
+        owner = NULL;
+        id = 0;
+        isAlive = NULL;
+      #endif
+    }
+
+    #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+      //================================================================================//
+      /**
+       * @brief Makes the lock use a sequence number kept somewhere else. All the locks
+       * that use the same counter are the same lock. A counter in shared memory must be
+       * lock-free, so that it works across processes. No read or write may be in
+       * progress when the counter is changed.
+       *
+       * The lock stores its id in the owner while it writes, and clears it at the end.
+       * The id must be unique among the writers of the counter, and not 0, such as the
+       * ID of the process. The threads of one process can share an id, because a process
+       * is alive as long as any of its threads is.
+       *
+       * @param counter The counter. NULL to use the counter of the lock again.
+       * @param owner The id of the writer that holds the lock. NULL to never take over.
+       * @param id The id of this lock.
+       * @param isAlive Returns false only if the writer with an id is surely dead.
+       */
+      void setCounter (std::atomic <uint32_t>* counter, std::atomic <uint32_t>* owner = NULL, uint32_t id = 0, bool (*isAlive) (uint32_t id) = NULL) {
+        sequence = (counter != NULL) ? counter : &localSequence;
+        this->owner = (counter != NULL) ? owner : NULL;
+        this->id = id;
+        this->isAlive = isAlive;
+      }
+    #endif
+
+    //==================================================================================//
+    /**
+     * @brief Waits until no write is in progress, and returns the sequence number to be
+     * checked with endRead(). If the writer of a counter set by setCounter() has died,
+     * the odd number is returned, so that the values can still be read.
+     *
+     * @return uint32_t - The sequence number.
+     */
+    uint32_t beginRead() {
+      #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+        uint32_t start = sequence->load (std::memory_order_acquire);
+        uint32_t last = start, spins = 0;
+
+        while ((start & 0x01) && !isStalled (start, last, spins)) {
+          start = sequence->load (std::memory_order_acquire);
+        }
+
+        return start;
+      #else
+        return 0;
+      #endif
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Checks if the values read since beginRead() are consistent.
+     *
+     * @param start The sequence number returned by beginRead().
+     * @return true - No write overlapped the read.
+     * @return false - A write overlapped the read. Read the values again.
+     */
+    bool endRead (uint32_t start) {
+      #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+        std::atomic_thread_fence (std::memory_order_acquire); // The values are read before the sequence
+        return sequence->load (std::memory_order_relaxed) == start;
+      #else
+        (void) start;
+        return true;
+      #endif
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Starts a write. Waits if another writer is in progress. If the writer of a
+     * counter set by setCounter() has died, its write is taken over. The number is
+     * incremented by 2, so it stays odd and the readers see the change.
+     *
+     */
+    void beginWrite() {
+      #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+        uint32_t current = sequence->load (std::memory_order_relaxed);
+        uint32_t last = current, spins = 0;
+
+        // Make the sequence odd, only if it is even
+        while (true) {
+          if ((current & 0x01) == 0) {
+            if (sequence->compare_exchange_weak (current, current + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+              break;
+            }
+          }
+          else if (isStalled (current, last, spins) && sequence->compare_exchange_strong (current, current + 2, std::memory_order_acquire, std::memory_order_relaxed)) {
+            break;
+          }
+
+          current = sequence->load (std::memory_order_relaxed);
+        }
+
+        if (owner != NULL) {
+          owner->store (id, std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence (std::memory_order_release); // The values are written after the sequence
+      #endif
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Ends a write started with beginWrite().
+     *
+     */
+    void endWrite() {
+      #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+        if (owner != NULL) {
+          owner->store (0, std::memory_order_relaxed);
+        }
+
+        sequence->fetch_add (1, std::memory_order_release);
+      #endif
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Returns the sequence number. It is incremented twice for every write.
+     *
+     * @return uint32_t - The sequence number; 0 if there is no lock.
+     */
+    uint32_t getSequence() {
+      #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+        return sequence->load (std::memory_order_acquire);
+      #else
+        return 0;
+      #endif
+    }
+};
+
+#endif
+
+//======================================================================================//
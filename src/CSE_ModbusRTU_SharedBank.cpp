@@ -0,0 +1,651 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_SharedBank.cpp
+  Description: Register bank in shared memory or a memory-mapped file, for sharing the
+  registers of the server with other processes on Linux and macOS hosts.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU_SharedBank.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//======================================================================================//
+/**
+ * @brief Rounds an offset up to the alignment of the tables.
+ *
+ * @param offset The offset in bytes.
+ * @return uint32_t - The aligned offset.
+ */
+static uint32_t alignOffset (uint32_t offset) {
+  return (offset + (MODBUS_RTU_SHARED_BANK_ALIGNMENT - 1)) & ~(MODBUS_RTU_SHARED_BANK_ALIGNMENT - 1);
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if the process that holds the lock of a table is alive. A process that
+ * is suspended, owned by another user, or not reaped yet, still exists.
+ *
+ * @param pid The process ID stored by the writer.
+ * @return true - The process exists, or it could not be checked.
+ * @return false - There is no such process.
+ */
+static bool isProcessAlive (uint32_t pid) {
+  return (kill ((pid_t) pid, 0) == 0) || (errno != ESRCH);
+}
+
+//======================================================================================//
+/**
+ * @brief Constructor. Nothing is opened until create() or open() is called.
+ *
+ * @param name The name of the shared memory object, like "/modbus", or the path of the
+ * file.
+ * @param storage MODBUS_RTU_SHARED_BANK_SHM or MODBUS_RTU_SHARED_BANK_FILE.
+ */
+CSE_ModbusRTU_SharedBank:: CSE_ModbusRTU_SharedBank (const char* name, uint8_t storage) {
+  this->name = String (name);
+  this->storage = storage;
+  header = NULL;
+  fd = -1;
+  size = 0;
+  inputAddress = 0;
+  inputCount = 0;
+  holdingAddress = 0;
+  holdingCount = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Unmaps the bank. The bank itself is kept until remove() is called.
+ *
+ */
+CSE_ModbusRTU_SharedBank:: ~CSE_ModbusRTU_SharedBank() {
+  end();
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the name of the bank.
+ *
+ * @return String - The name of the shared memory object, or the path of the file.
+ */
+String CSE_ModbusRTU_SharedBank:: getName() {
+  return name;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the range of input registers of the bank. Only used by create().
+ *
+ * @param address The first address.
+ * @param count The number of registers. 0 for no input registers.
+ * @return true - The range was set.
+ * @return false - The range goes past the address 0xFFFF.
+ */
+bool CSE_ModbusRTU_SharedBank:: configureInputRegisters (uint16_t address, uint16_t count) {
+  if (((uint32_t) address + count) > 0x10000UL) {
+    return false;
+  }
+
+  inputAddress = address;
+  inputCount = count;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Sets the range of holding registers of the bank. Only used by create().
+ *
+ * @param address The first address.
+ * @param count The number of registers. 0 for no holding registers.
+ * @return true - The range was set.
+ * @return false - The range goes past the address 0xFFFF.
+ */
+bool CSE_ModbusRTU_SharedBank:: configureHoldingRegisters (uint16_t address, uint16_t count) {
+  if (((uint32_t) address + count) > 0x10000UL) {
+    return false;
+  }
+
+  holdingAddress = address;
+  holdingCount = count;
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Opens the shared memory object or the file of the bank.
+ *
+ * @param flags The flags of open().
+ * @return int - The file descriptor; -1 if failed.
+ */
+int CSE_ModbusRTU_SharedBank:: openObject (int flags) {
+  if (storage == MODBUS_RTU_SHARED_BANK_SHM) {
+    return shm_open (name.c_str(), flags, 0666);
+  }
+
+  return ::open (name.c_str(), flags, 0666);
+}
+
+//======================================================================================//
+/**
+ * @brief Maps the bank opened with openObject(), and makes the locks of the bank use its
+ * sequence numbers. The file descriptor is kept open until end(), because it holds the
+ * lock of the bank. It is closed if the bank can not be mapped.
+ *
+ * @param length The size of the bank.
+ * @return true - The bank was mapped.
+ * @return false - The bank could not be mapped, or the register lock is not a seqlock.
+ */
+bool CSE_ModbusRTU_SharedBank:: map (size_t length) {
+  #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+    void* memory = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (memory == MAP_FAILED) {
+      ::close (fd);
+      fd = -1;
+      return false;
+    }
+
+    header = (header_t*) memory;
+    size = length;
+
+    inputRegisterLock.setCounter (&header->inputRegisters.sequence, &header->inputWriter, (uint32_t) getpid(), isProcessAlive);
+    holdingRegisterLock.setCounter (&header->holdingRegisters.sequence, &header->holdingWriter, (uint32_t) getpid(), isProcessAlive);
+    return true;
+  #else
+    ::close (fd);
+    fd = -1;
+    errno = ENOTSUP;
+    return false;
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Checks that a table of a mapped bank is inside the bank.
+ *
+ * @param table The table.
+ * @return true - The table is valid.
+ * @return false - The table is not valid.
+ */
+bool CSE_ModbusRTU_SharedBank:: isValid (table_t& table) {
+  if (table.count == 0) {
+    return true;
+  }
+
+  if ((table.count > 0xFFFFUL) || (((uint32_t) table.address + table.count) > 0x10000UL)) {
+    return false;
+  }
+
+  return (table.offset >= sizeof (header_t)) && ((table.offset % 2) == 0) && (((uint64_t) table.offset + (table.count * 2)) <= size);
+}
+
+//======================================================================================//
+/**
+ * @brief Creates the bank with the layout set by configureInputRegisters() and
+ * configureHoldingRegisters(), and maps it. This is done by the process that runs the
+ * server, before the other processes open the bank.
+ *
+ * If the bank already exists with the same layout, its values are kept. So a bank in
+ * a file starts with the values it had when the last process stopped. Otherwise all the
+ * values are set to 0.
+ *
+ * An existing bank is only changed if no other process has it mapped. That is checked
+ * with an exclusive flock() on the bank. If another process is using it, the bank is
+ * reused only if the layout is the same, and the sequence numbers are left as they are,
+ * because an odd number may be a write in progress. If no process is using it, an odd
+ * sequence number was left by a process that stopped during a write, and is made even.
+ *
+ * @return true - The bank was created and mapped.
+ * @return false - The bank could not be created. errno has the reason. EBUSY if the
+ * layout is different and another process is using the bank.
+ */
+bool CSE_ModbusRTU_SharedBank:: create() {
+  end();
+
+  uint32_t inputOffset = sizeof (header_t);
+  uint32_t holdingOffset = alignOffset (inputOffset + (inputCount * 2));
+  uint32_t length = alignOffset (holdingOffset + (holdingCount * 2));
+
+  fd = openObject (O_RDWR | O_CREAT);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  // If the object does not support flock(), the bank is changed as if no other process
+  // is using it, but the sequence numbers are never repaired.
+  bool locked = (flock (fd, LOCK_EX | LOCK_NB) == 0);
+  bool busy = !locked && (errno == EWOULDBLOCK);
+  struct stat status;
+
+  if (fstat (fd, &status) != 0) {
+    ::close (fd);
+    fd = -1;
+    return false;
+  }
+
+  bool reuse = ((uint64_t) status.st_size == length);
+
+  if (!reuse && busy) {
+    ::close (fd);
+    fd = -1;
+    errno = EBUSY;
+    return false;
+  }
+
+  if (!reuse && (ftruncate (fd, length) != 0)) {
+    ::close (fd);
+    fd = -1;
+    return false;
+  }
+
+  if (!map (length)) {
+    return false;
+  }
+
+  // An existing bank is only kept if every field of the layout is the same
+  reuse = reuse && (header->magic.load (std::memory_order_acquire) == MODBUS_RTU_SHARED_BANK_MAGIC);
+  reuse = reuse && (header->version == MODBUS_RTU_SHARED_BANK_VERSION) && (header->headerSize == sizeof (header_t)) && (header->size == length);
+  reuse = reuse && (header->inputRegisters.address == inputAddress) && (header->inputRegisters.count == inputCount) && (header->inputRegisters.offset == inputOffset);
+  reuse = reuse && (header->holdingRegisters.address == holdingAddress) && (header->holdingRegisters.count == holdingCount) && (header->holdingRegisters.offset == holdingOffset);
+
+  if (reuse) {
+    table_t* tables[] = { &header->inputRegisters, &header->holdingRegisters };
+
+    // No other process has the bank mapped, so an odd sequence number was left by a
+    // process that stopped during a write
+    for (table_t* table : tables) {
+      if (locked && (table->sequence.load (std::memory_order_relaxed) & 0x01)) {
+        table->sequence.fetch_add (1, std::memory_order_release);
+      }
+    }
+
+    if (locked) {
+      header->inputWriter.store (0, std::memory_order_relaxed);
+      header->holdingWriter.store (0, std::memory_order_relaxed);
+    }
+
+    // Keep a shared lock like the other processes. flock() can not convert the lock
+    // atomically, but nothing else is changed after this.
+    flock (fd, LOCK_SH);
+    return true;
+  }
+
+  if (busy) {
+    end();
+    errno = EBUSY;
+    return false;
+  }
+
+  // The magic number is set last, so that open() fails until the layout is complete
+  memset ((void*) header, 0, length);
+
+  header->version = MODBUS_RTU_SHARED_BANK_VERSION;
+  header->headerSize = sizeof (header_t);
+  header->size = length;
+  header->inputRegisters.address = inputAddress;
+  header->inputRegisters.count = inputCount;
+  header->inputRegisters.offset = inputOffset;
+  header->holdingRegisters.address = holdingAddress;
+  header->holdingRegisters.count = holdingCount;
+  header->holdingRegisters.offset = holdingOffset;
+  header->magic.store (MODBUS_RTU_SHARED_BANK_MAGIC, std::memory_order_release);
+
+  flock (fd, LOCK_SH);
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Opens and maps a bank created by another process with create(). The layout is
+ * read from the header of the bank.
+ *
+ * @return true - The bank was opened.
+ * @return false - The bank does not exist, is not initialized yet, or its layout is not
+ * valid. errno has the reason.
+ */
+bool CSE_ModbusRTU_SharedBank:: open() {
+  end();
+
+  fd = openObject (O_RDWR);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  // Waits while create() has the exclusive lock. The bank is used without the lock if
+  // the object does not support flock().
+  flock (fd, LOCK_SH);
+  struct stat status;
+
+  if (fstat (fd, &status) != 0) {
+    ::close (fd);
+    fd = -1;
+    return false;
+  }
+
+  if ((status.st_size < (off_t) sizeof (header_t)) || (status.st_size > (off_t) 0xFFFFFFFFUL)) {
+    ::close (fd);
+    fd = -1;
+    errno = EINVAL;
+    return false;
+  }
+
+  if (!map ((size_t) status.st_size)) {
+    return false;
+  }
+
+  bool valid = (header->magic.load (std::memory_order_acquire) == MODBUS_RTU_SHARED_BANK_MAGIC);
+  valid = valid && (header->version == MODBUS_RTU_SHARED_BANK_VERSION) && (header->headerSize == sizeof (header_t)) && (header->size == size);
+  valid = valid && isValid (header->inputRegisters) && isValid (header->holdingRegisters);
+
+  if (!valid) {
+    end();
+    errno = EINVAL;
+    return false;
+  }
+
+  inputAddress = header->inputRegisters.address;
+  inputCount = (uint16_t) header->inputRegisters.count;
+  holdingAddress = header->holdingRegisters.address;
+  holdingCount = (uint16_t) header->holdingRegisters.count;
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Unmaps the bank and releases its lock. A server must be detached before this.
+ *
+ */
+void CSE_ModbusRTU_SharedBank:: end() {
+  if (header == NULL) {
+    return;
+  }
+
+  #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+    inputRegisterLock.setCounter (NULL);
+    holdingRegisterLock.setCounter (NULL);
+  #endif
+
+  munmap ((void*) header, size);
+  ::close (fd); // Releases the lock
+  header = NULL;
+  fd = -1;
+  size = 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Checks if the bank is mapped.
+ *
+ * @return true - The bank is mapped.
+ * @return false - The bank is not mapped.
+ */
+bool CSE_ModbusRTU_SharedBank:: isOpen() {
+  return (header != NULL);
+}
+
+//======================================================================================//
+/**
+ * @brief Removes the name of the bank. The processes that have it mapped can still use
+ * it, and the memory is freed when the last one unmaps it. A bank in a file is deleted.
+ *
+ * @return true - The name was removed.
+ * @return false - The name could not be removed. errno has the reason.
+ */
+bool CSE_ModbusRTU_SharedBank:: remove() {
+  if (storage == MODBUS_RTU_SHARED_BANK_SHM) {
+    return shm_unlink (name.c_str()) == 0;
+  }
+
+  return unlink (name.c_str()) == 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Makes a server answer the register requests from the bank. The input and
+ * holding registers of the server use the tables of the bank as their layout, and the
+ * register locks of the server use the sequence numbers of the bank. Nothing is copied.
+ * The change flags of the holding registers are added, so that readChangedHoldingRegisters()
+ * still reports the writes of the client.
+ *
+ * The register tables and the changed holding registers of the server must be empty.
+ * The server must not be polled while it is attached or detached.
+ *
+ * @param server The server.
+ * @return true - The server was attached.
+ * @return false - The bank is not open, or the tables of the server are not empty.
+ */
+bool CSE_ModbusRTU_SharedBank:: attach (CSE_ModbusRTU_Server& server) {
+  if ((header == NULL) || (server.inputRegisters.getBlockCount() > 0) || (server.holdingRegisters.getBlockCount() > 0) || (server.changedHoldingRegisters.getBlockCount() > 0)) {
+    return false;
+  }
+
+  if (inputCount > 0) {
+    inputBlock.address = inputAddress;
+    inputBlock.length = inputCount;
+    inputBlock.values = find (header->inputRegisters, inputAddress, inputCount);
+    inputBlock.flags = 0;
+
+    if (!server.inputRegisters.setLayout (&inputBlock, 1)) {
+      return false;
+    }
+  }
+
+  if (holdingCount > 0) {
+    holdingBlock.address = holdingAddress;
+    holdingBlock.length = holdingCount;
+    holdingBlock.values = find (header->holdingRegisters, holdingAddress, holdingCount);
+    holdingBlock.flags = 0;
+
+    if (!server.holdingRegisters.setLayout (&holdingBlock, 1) || !server.changedHoldingRegisters.add (holdingAddress, holdingCount)) {
+      detach (server);
+      return false;
+    }
+  }
+
+  #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+    server.inputRegisterLock.setCounter (&header->inputRegisters.sequence, &header->inputWriter, (uint32_t) getpid(), isProcessAlive);
+    server.holdingRegisterLock.setCounter (&header->holdingRegisters.sequence, &header->holdingWriter, (uint32_t) getpid(), isProcessAlive);
+  #endif
+
+  return true;
+}
+
+//======================================================================================//
+/**
+ * @brief Stops a server from using the bank. The register tables of the server are
+ * cleared, and its register locks use their own sequence numbers again.
+ *
+ * @param server The server.
+ */
+void CSE_ModbusRTU_SharedBank:: detach (CSE_ModbusRTU_Server& server) {
+  server.inputRegisters.clear();
+  server.holdingRegisters.clear();
+  server.changedHoldingRegisters.clear();
+
+  #if (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK)
+    server.inputRegisterLock.setCounter (NULL);
+    server.holdingRegisterLock.setCounter (NULL);
+  #endif
+}
+
+//======================================================================================//
+/**
+ * @brief Finds a range of registers in a table of the bank.
+ *
+ * @param table The table.
+ * @param address The first address of the range.
+ * @param count The number of registers.
+ * @return uint16_t* - The value of the first register; NULL if the range is not in the
+ * table.
+ */
+uint16_t* CSE_ModbusRTU_SharedBank:: find (table_t& table, uint16_t address, uint16_t count) {
+  if ((header == NULL) || (count == 0) || (address < table.address) || (((uint32_t) address + count) > ((uint32_t) table.address + table.count))) {
+    return NULL;
+  }
+
+  return (uint16_t*) ((uint8_t*) header + table.offset) + (address - table.address);
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a consistent snapshot of a range of input registers of the bank.
+ *
+ * @param address The 16-bit starting address of the input registers.
+ * @param count The number of input registers to read.
+ * @param registerValues The values are saved here.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_SharedBank:: readInputRegister (uint16_t address, uint16_t count, uint16_t* registerValues) {
+  uint16_t* values = (header != NULL) ? find (header->inputRegisters, address, count) : NULL;
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  uint32_t sequence;
+
+  do {
+    sequence = inputRegisterLock.beginRead();
+    memcpy (registerValues, values, count * 2);
+  } while (!inputRegisterLock.endRead (sequence));
+
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a range of input registers of the bank as one update. The server and
+ * the other processes never read only some of the values.
+ *
+ * @param address The 16-bit starting address of the input registers.
+ * @param count The number of input registers to write.
+ * @param registerValues The values to write.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_SharedBank:: writeInputRegister (uint16_t address, uint16_t count, const uint16_t* registerValues) {
+  uint16_t* values = (header != NULL) ? find (header->inputRegisters, address, count) : NULL;
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  inputRegisterLock.beginWrite();
+  memcpy (values, registerValues, count * 2);
+  inputRegisterLock.endWrite();
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Reads a consistent snapshot of a range of holding registers of the bank.
+ *
+ * @param address The 16-bit starting address of the holding registers.
+ * @param count The number of holding registers to read.
+ * @param registerValues The values are saved here.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_SharedBank:: readHoldingRegister (uint16_t address, uint16_t count, uint16_t* registerValues) {
+  uint16_t* values = (header != NULL) ? find (header->holdingRegisters, address, count) : NULL;
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  uint32_t sequence;
+
+  do {
+    sequence = holdingRegisterLock.beginRead();
+    memcpy (registerValues, values, count * 2);
+  } while (!holdingRegisterLock.endRead (sequence));
+
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Writes a range of holding registers of the bank as one update. The server and
+ * the other processes never read only some of the values. The write is not reported by
+ * readChangedHoldingRegisters() of the server, which only reports the client.
+ *
+ * @param address The 16-bit starting address of the holding registers.
+ * @param count The number of holding registers to write.
+ * @param registerValues The values to write.
+ * @return int - 1 if successful; -1 if failed.
+ */
+int CSE_ModbusRTU_SharedBank:: writeHoldingRegister (uint16_t address, uint16_t count, const uint16_t* registerValues) {
+  uint16_t* values = (header != NULL) ? find (header->holdingRegisters, address, count) : NULL;
+
+  if ((values == NULL) || (registerValues == NULL)) {
+    return -1;
+  }
+
+  holdingRegisterLock.beginWrite();
+  memcpy (values, registerValues, count * 2);
+  holdingRegisterLock.endWrite();
+  return 1;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the sequence number of the input registers. It changes every time any
+ * process writes them, so it can be polled to find out if they have changed.
+ *
+ * @return uint32_t - The sequence number; 0 if the bank is not open.
+ */
+uint32_t CSE_ModbusRTU_SharedBank:: getInputRegisterSequence() {
+  return (header != NULL) ? inputRegisterLock.getSequence() : 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the sequence number of the holding registers. It changes every time
+ * any process or the client writes them.
+ *
+ * @return uint32_t - The sequence number; 0 if the bank is not open.
+ */
+uint32_t CSE_ModbusRTU_SharedBank:: getHoldingRegisterSequence() {
+  return (header != NULL) ? holdingRegisterLock.getSequence() : 0;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the header of the mapped bank.
+ *
+ * @return header_t* - The header; NULL if the bank is not open.
+ */
+CSE_ModbusRTU_SharedBank:: header_t* CSE_ModbusRTU_SharedBank:: getHeader() {
+  return header;
+}
+
+//======================================================================================//
+/**
+ * @brief Returns the size of the mapped bank.
+ *
+ * @return size_t - The size in bytes; 0 if the bank is not open.
+ */
+size_t CSE_ModbusRTU_SharedBank:: getSize() {
+  return size;
+}
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,170 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_SharedBank.h
+  Description: Register bank in shared memory or a memory-mapped file, for sharing the
+  registers of the server with other processes on Linux and macOS hosts.
+  Framework: Linux, macOS
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_SHAREDBANK_H
+#define CSE_MODBUSRTU_SHAREDBANK_H
+
+#if !defined(ARDUINO)
+
+#include "CSE_ModbusRTU.h"
+#include <atomic>
+
+//======================================================================================//
+
+// Where the bank is kept
+#define   MODBUS_RTU_SHARED_BANK_SHM                    0U  // POSIX shared memory object, named like "/modbus"
+#define   MODBUS_RTU_SHARED_BANK_FILE                   1U  // Memory-mapped file. The values are kept across restarts.
+
+#define   MODBUS_RTU_SHARED_BANK_MAGIC                  0x42455343UL  // The bytes "CSEB"
+#define   MODBUS_RTU_SHARED_BANK_VERSION                1U  // The version of the layout
+#define   MODBUS_RTU_SHARED_BANK_ALIGNMENT              64U // The tables start on a cache line
+
+//======================================================================================//
+/**
+ * @brief A bank of input and holding registers in a POSIX shared memory object or a
+ * memory-mapped file. The server answers requests from the bank directly, and other
+ * processes on the same host, such as a historian or an HMI, read and write the same
+ * memory without going through Modbus.
+ *
+ * The layout of the bank is fixed, so that processes that do not use this library can
+ * map it too. All the fields are in the byte order of the host.
+ *
+ *   Offset  Size  Field
+ *   0       4     Magic number, the bytes "CSEB". Set after the bank is initialized.
+ *   4       2     Layout version, 1
+ *   6       2     Size of the header, 64
+ *   8       4     Size of the bank in bytes
+ *   12      4     Reserved, 0
+ *   16      16    Input register table
+ *   32      16    Holding register table
+ *   48      4     Process ID of the writer of the input registers, 0 if none
+ *   52      4     Process ID of the writer of the holding registers, 0 if none
+ *   56      8     Reserved, 0
+ *
+ * Each table has a sequence lock counter, which is odd while a write is in progress,
+ * the first address and the number of registers, and the offset of the values from the
+ * start of the bank. The values are 16-bit words, and each table starts on a 64 byte
+ * boundary.
+ *
+ *   Offset  Size  Field
+ *   0       4     Sequence number (CSE_ModbusRTU_SeqLock)
+ *   4       2     First address
+ *   6       2     Reserved, 0
+ *   8       4     Number of registers. 0 if the table is not used.
+ *   12      4     Offset of the values in bytes
+ *
+ * A writer increments the sequence number of the table before and after it changes the
+ * values. A reader copies the values, and copies them again if the sequence number was
+ * odd or has changed. The locks of the server use the same counters, so a response
+ * never has only some of the values of one write from another process.
+ *
+ * A writer also stores its process ID in the header after it makes the number odd, and
+ * clears it before it makes the number even. If the number stays odd and that process
+ * no longer exists, the other processes take over the write. A process that is only
+ * suspended is waited for. So all the processes that use the bank must be in the same
+ * PID namespace. A writer that does not store its ID is always waited for.
+ *
+ * Every process that has the bank mapped holds a shared flock() on it. create() only
+ * changes the layout of an existing bank, or repairs the sequence numbers left odd by a
+ * process that stopped during a write, if it can get an exclusive lock, so that no
+ * other process is using the bank. Other programs that map the bank should hold a
+ * shared lock too.
+ *
+ */
+class CSE_ModbusRTU_SharedBank {
+  public:
+    // A table of the bank. 16 bytes.
+    struct table_t {
+      std::atomic <uint32_t> sequence; // Odd while a write is in progress
+      uint16_t address; // The first address
+      uint16_t reserved;
+      uint32_t count; // The number of registers
+      uint32_t offset;  // The offset of the values from the start of the bank
+    };
+
+    // The header at the start of the bank. 64 bytes.
+    struct header_t {
+      std::atomic <uint32_t> magic; // MODBUS_RTU_SHARED_BANK_MAGIC
+      uint16_t version; // MODBUS_RTU_SHARED_BANK_VERSION
+      uint16_t headerSize;  // sizeof (header_t)
+      uint32_t size;  // The size of the bank in bytes
+      uint32_t reserved;
+      table_t inputRegisters;
+      table_t holdingRegisters;
+      std::atomic <uint32_t> inputWriter; // The process ID of the writer, or 0
+      std::atomic <uint32_t> holdingWriter;
+      uint8_t padding [8];
+    };
+
+    static_assert (sizeof (table_t) == 16, "The table layout must be 16 bytes.");
+    static_assert (sizeof (header_t) == 64, "The header layout must be 64 bytes.");
+    static_assert (ATOMIC_INT_LOCK_FREE == 2, "The sequence numbers must be lock-free to be shared by processes.");
+
+  private:
+    String name;  // The name of the shared memory object, or the path of the file
+    uint8_t storage;  // MODBUS_RTU_SHARED_BANK_SHM or MODBUS_RTU_SHARED_BANK_FILE
+    header_t* header; // The mapped bank, or NULL if it is not open
+    int fd; // Kept open while the bank is mapped, to hold the lock of the bank
+    size_t size;  // The size of the mapping
+    uint16_t inputAddress;  // The layout used by create()
+    uint16_t inputCount;
+    uint16_t holdingAddress;
+    uint16_t holdingCount;
+
+    CSE_ModbusRTU_SeqLock inputRegisterLock;  // Use the counters in the bank
+    CSE_ModbusRTU_SeqLock holdingRegisterLock;
+    CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t inputBlock;  // The layouts given to a server
+    CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t holdingBlock;
+
+    int openObject (int flags);  // Open the shared memory object or the file
+    bool map (size_t length); // Map the bank and share its locks
+    bool isValid (table_t& table);  // Check a table of a mapped bank
+    uint16_t* find (table_t& table, uint16_t address, uint16_t count); // Find a range of registers
+
+  public:
+    CSE_ModbusRTU_SharedBank (const char* name, uint8_t storage = MODBUS_RTU_SHARED_BANK_SHM);
+    ~CSE_ModbusRTU_SharedBank();
+
+    String getName(); // Get the name of the bank
+
+    bool configureInputRegisters (uint16_t address, uint16_t count); // Set the input register range for create()
+    bool configureHoldingRegisters (uint16_t address, uint16_t count); // Set the holding register range for create()
+
+    bool create();  // Create or reuse the bank with the configured layout
+    bool open();  // Open a bank created by another process
+    void end(); // Unmap the bank
+    bool isOpen();  // Check if the bank is mapped
+    bool remove();  // Remove the name of the bank
+
+    bool attach (CSE_ModbusRTU_Server& server); // Serve the registers of the bank
+    void detach (CSE_ModbusRTU_Server& server); // Stop serving the registers of the bank
+
+    int readInputRegister (uint16_t address, uint16_t count, uint16_t* registerValues); // Read a snapshot of input registers
+    int writeInputRegister (uint16_t address, uint16_t count, const uint16_t* registerValues); // Write input registers as one update
+    int readHoldingRegister (uint16_t address, uint16_t count, uint16_t* registerValues); // Read a snapshot of holding registers
+    int writeHoldingRegister (uint16_t address, uint16_t count, const uint16_t* registerValues); // Write holding registers as one update
+
+    uint32_t getInputRegisterSequence(); // Changes every time the input registers are written
+    uint32_t getHoldingRegisterSequence(); // Changes every time the holding registers are written
+
+    header_t* getHeader();  // Get the mapped header
+    size_t getSize(); // Get the size of the bank in bytes
+};
+
+#endif
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,353 @@
+
+//======================================================================================//
+/*
+  Filename: CSE_ModbusRTU_StaticMap.h
+  Description: Compile-time register and bit maps for the data tables of the
+  CSE_ModbusRTU server. The layout is checked by the compiler and stored statically.
+  Framework: Arduino, PlatformIO
+  Author: Vishnu Mohanan (@vishnumaiea, @vizmohanan)
+  Maintainer: CIRCUITSTATE Electronics (@circuitstate)
+  Version: 0.0.9
+  License: MIT
+  Source: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+ */
+//======================================================================================//
+
+#ifndef CSE_MODBUSRTU_STATICMAP_H
+#define CSE_MODBUSRTU_STATICMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "CSE_ModbusRTU_RegisterMap.h"
+
+//======================================================================================//
+
+// Returned by the offset functions of CSE_ModbusRTU_RangeList for a missing address
+#define   MODBUS_RTU_RANGE_NOT_FOUND            0x80000000UL
+
+//======================================================================================//
+/**
+ * @brief Describes one range of a static map at compile time. The values of the range
+ * are set to the initial value when the map is attached. The flags are copied to the
+ * block, so MODBUS_RTU_BLOCK_READ_ONLY makes the range read-only for the client. For a
+ * bit map, any initial value other than 0 sets the bits ON.
+ *
+ * @tparam firstAddress The first address of the range.
+ * @tparam addressCount The number of addresses.
+ * @tparam initialValue The value of all the addresses after the map is attached.
+ * @tparam rangeFlags MODBUS_RTU_BLOCK_READ_ONLY, or 0.
+ */
+template <uint16_t firstAddress, uint16_t addressCount, uint16_t initialValue = 0, uint8_t rangeFlags = 0> struct CSE_ModbusRTU_Range {
+  static_assert (addressCount > 0, "A range must have at least one address.");
+  static_assert (((uint32_t) firstAddress + addressCount) <= 0x10000UL, "A range must not go past the address 0xFFFF.");
+
+  static constexpr uint16_t address = firstAddress;
+  static constexpr uint16_t count = addressCount;
+  static constexpr uint16_t value = initialValue;
+  static constexpr uint8_t flags = rangeFlags;
+};
+
+//======================================================================================//
+/**
+ * @brief Computes the layout of a list of ranges at compile time. Used by the static
+ * maps. The values of the ranges are stored one after the other, in the order of the
+ * list. For bit maps, each range starts on a byte boundary.
+ *
+ */
+template <typename... ranges_t> struct CSE_ModbusRTU_RangeList;
+
+// The end of the list
+template <> struct CSE_ModbusRTU_RangeList <> {
+  static constexpr uint32_t count = 0;
+  static constexpr uint32_t byteCount = 0;
+
+  static constexpr bool isSeparate (uint32_t) {
+    return true;
+  }
+
+  static constexpr bool contains (uint32_t, uint32_t) {
+    return false;
+  }
+
+  static constexpr uint32_t offsetOf (uint32_t) {
+    return MODBUS_RTU_RANGE_NOT_FOUND;
+  }
+
+  static constexpr uint32_t bitOffsetOf (uint32_t) {
+    return MODBUS_RTU_RANGE_NOT_FOUND;
+  }
+};
+
+template <typename range_t, typename... rest_t> struct CSE_ModbusRTU_RangeList <range_t, rest_t...> {
+  typedef CSE_ModbusRTU_RangeList <rest_t...> rest;
+
+  static constexpr uint32_t end = (uint32_t) range_t::address + range_t::count; // One past the last address
+  static constexpr uint32_t count = range_t::count + rest::count; // Number of addresses
+  static constexpr uint32_t byteCount = ((range_t::count + 7) / 8) + rest::byteCount; // Bytes of packed bits
+
+  // Checks that each range starts after the end of the one before it, with a gap. The
+  // first range can start anywhere. previousEnd is 0 only for the first range.
+  static constexpr bool isSeparate (uint32_t previousEnd) {
+    return ((previousEnd == 0) || (range_t::address > previousEnd)) && rest::isSeparate (end);
+  }
+
+  // Checks if a range of addresses is inside one range of the list
+  static constexpr bool contains (uint32_t address, uint32_t length) {
+    return ((address >= range_t::address) && ((address + length) <= end)) || rest::contains (address, length);
+  }
+
+  // The index of the value of an address, from the first value of the map
+  static constexpr uint32_t offsetOf (uint32_t address) {
+    return ((address >= range_t::address) && (address < end)) ? (address - range_t::address) : (range_t::count + rest::offsetOf (address));
+  }
+
+  // The index of the bit of an address, from the first bit of the map
+  static constexpr uint32_t bitOffsetOf (uint32_t address) {
+    return ((address >= range_t::address) && (address < end)) ? (address - range_t::address) : ((((range_t::count + 7) / 8) * 8) + rest::bitOffsetOf (address));
+  }
+};
+
+//======================================================================================//
+/**
+ * @brief A register map whose layout is declared at compile time. The ranges are given
+ * as CSE_ModbusRTU_Range types, sorted by address. The compiler checks that they don't
+ * overlap or touch, and builds the values and the blocks in the object itself, with
+ * no code run at startup. Declare the map as a global or static object, and attach it
+ * to a table of the server. Nothing is allocated.
+ *
+ *   CSE_ModbusRTU_StaticRegisterMap <
+ *     CSE_ModbusRTU_Range <0x0000, 16>,
+ *     CSE_ModbusRTU_Range <0x0100, 4, 0x1234, MODBUS_RTU_BLOCK_READ_ONLY>
+ *   > holdingMap;
+ *
+ *   holdingMap.attach (server.holdingRegisters);
+ *
+ * The server then finds the request ranges in the blocks as usual. The application can
+ * access a register with a constant address with at(), which compiles to a fixed offset
+ * in the array of values.
+ *
+ * @tparam ranges_t The ranges.
+ */
+template <typename... ranges_t> class CSE_ModbusRTU_StaticRegisterMap {
+  public:
+    typedef CSE_ModbusRTU_RangeList <ranges_t...> list_t;
+    typedef CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t block_t;
+
+    static constexpr size_t blockCount = sizeof... (ranges_t);
+    static constexpr uint32_t valueCount = list_t::count;
+
+    static_assert (sizeof... (ranges_t) > 0, "A static map must have at least one range.");
+    static_assert (list_t::isSeparate (0), "The ranges must be sorted by address, and must not overlap or touch.");
+
+  private:
+    uint16_t values [valueCount]; // The values of all the ranges
+    block_t blocks [blockCount];  // One block per range, pointing to its values
+
+    void fill (uint32_t offset, uint16_t count, uint16_t value); // Set the values of a range
+
+  public:
+    //==================================================================================//
+    /**
+     * @brief Builds the blocks. For a global or static object, this is done by the
+     * compiler. The values are 0 until the map is attached.
+     *
+     */
+    constexpr CSE_ModbusRTU_StaticRegisterMap() :
+      values(),
+      blocks { { ranges_t::address, ranges_t::count, values + list_t::offsetOf (ranges_t::address), ranges_t::flags }... } {
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Makes a register table of the server use this map, and sets the initial
+     * values. The table must be empty.
+     *
+     * @param map The table, such as server.holdingRegisters.
+     * @return true - The map was attached.
+     * @return false - The table is not empty.
+     */
+    bool attach (CSE_ModbusRTU_RegisterMap <uint16_t>& map) {
+      if (!map.setLayout (blocks, blockCount)) {
+        return false;
+      }
+
+      reset();
+      return true;
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Sets all the values to the initial values of their ranges.
+     *
+     */
+    void reset() {
+      int expand[] = { 0, (fill (list_t::offsetOf (ranges_t::address), ranges_t::count, ranges_t::value), 0)... };
+      (void) expand;
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Returns the value of a constant address. The address is checked by the
+     * compiler, and the value is at a fixed offset.
+     *
+     * @tparam address The address.
+     * @return uint16_t& - The value.
+     */
+    template <uint16_t address> uint16_t& at() {
+      static_assert (list_t::offsetOf (address) < valueCount, "The address is not in the map.");
+      return values [list_t::offsetOf (address)];
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Returns the values of a constant range of addresses, such as the two
+     * registers of a 32-bit value. The range must be inside one range of the map.
+     *
+     * @tparam address The first address.
+     * @tparam count The number of addresses.
+     * @return uint16_t* - The value of the first address.
+     */
+    template <uint16_t address, uint16_t count> uint16_t* find() {
+      static_assert (list_t::contains (address, count), "The addresses are not in one range of the map.");
+      return values + list_t::offsetOf (address);
+    }
+};
+
+template <typename... ranges_t> constexpr size_t CSE_ModbusRTU_StaticRegisterMap <ranges_t...>:: blockCount;
+template <typename... ranges_t> constexpr uint32_t CSE_ModbusRTU_StaticRegisterMap <ranges_t...>:: valueCount;
+
+//======================================================================================//
+/**
+ * @brief Sets the values of a range.
+ *
+ * @param offset The index of the first value.
+ * @param count The number of values.
+ * @param value The value.
+ */
+template <typename... ranges_t> void CSE_ModbusRTU_StaticRegisterMap <ranges_t...>:: fill (uint32_t offset, uint16_t count, uint16_t value) {
+  for (uint32_t i = 0; i < count; i++) {
+    values [offset + i] = value;
+  }
+}
+
+//======================================================================================//
+/**
+ * @brief A bit map whose layout is declared at compile time. Works the same way as
+ * CSE_ModbusRTU_StaticRegisterMap, for the coils and discrete inputs. Each range starts
+ * on a byte boundary of the packed values.
+ *
+ * @tparam ranges_t The ranges.
+ */
+template <typename... ranges_t> class CSE_ModbusRTU_StaticBitMap {
+  public:
+    typedef CSE_ModbusRTU_RangeList <ranges_t...> list_t;
+    typedef CSE_ModbusRTU_BitMap:: block_t block_t;
+
+    static constexpr size_t blockCount = sizeof... (ranges_t);
+    static constexpr uint32_t byteCount = list_t::byteCount;
+
+    static_assert (sizeof... (ranges_t) > 0, "A static map must have at least one range.");
+    static_assert (list_t::isSeparate (0), "The ranges must be sorted by address, and must not overlap or touch.");
+
+  private:
+    uint8_t bits [byteCount]; // The packed values of all the ranges
+    block_t blocks [blockCount];  // One block per range, pointing to its bits
+
+    void fill (uint32_t offset, uint16_t count, uint16_t value); // Set the bits of a range
+
+  public:
+    //==================================================================================//
+    /**
+     * @brief Builds the blocks. For a global or static object, this is done by the
+     * compiler. The bits are 0 until the map is attached.
+     *
+     */
+    constexpr CSE_ModbusRTU_StaticBitMap() :
+      bits(),
+      blocks { { ranges_t::address, ranges_t::count, bits + (list_t::bitOffsetOf (ranges_t::address) / 8), ranges_t::flags }... } {
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Makes a bit table of the server use this map, and sets the initial values.
+     * The table must be empty.
+     *
+     * @param map The table, such as server.coils.
+     * @return true - The map was attached.
+     * @return false - The table is not empty.
+     */
+    bool attach (CSE_ModbusRTU_BitMap& map) {
+      if (!map.setLayout (blocks, blockCount)) {
+        return false;
+      }
+
+      reset();
+      return true;
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Sets all the bits to the initial values of their ranges.
+     *
+     */
+    void reset() {
+      int expand[] = { 0, (fill (list_t::bitOffsetOf (ranges_t::address) / 8, ranges_t::count, ranges_t::value), 0)... };
+      (void) expand;
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Returns the value of a constant address. The address is checked by the
+     * compiler, and the bit is at a fixed offset.
+     *
+     * @tparam address The address.
+     * @return true - The bit is ON.
+     * @return false - The bit is OFF.
+     */
+    template <uint16_t address> bool getBit() {
+      static_assert (list_t::contains (address, 1), "The address is not in the map.");
+      return (bits [list_t::bitOffsetOf (address) / 8] >> (list_t::bitOffsetOf (address) % 8)) & 0x01;
+    }
+
+    //==================================================================================//
+    /**
+     * @brief Sets the value of a constant address.
+     *
+     * @tparam address The address.
+     * @param value The value.
+     */
+    template <uint16_t address> void setBit (bool value) {
+      static_assert (list_t::contains (address, 1), "The address is not in the map.");
+
+      if (value) {
+        bits [list_t::bitOffsetOf (address) / 8] |= (uint8_t) (1U << (list_t::bitOffsetOf (address) % 8));
+      }
+      else {
+        bits [list_t::bitOffsetOf (address) / 8] &= (uint8_t) ~(1U << (list_t::bitOffsetOf (address) % 8));
+      }
+    }
+};
+
+template <typename... ranges_t> constexpr size_t CSE_ModbusRTU_StaticBitMap <ranges_t...>:: blockCount;
+template <typename... ranges_t> constexpr uint32_t CSE_ModbusRTU_StaticBitMap <ranges_t...>:: byteCount;
+
+//======================================================================================//
+/**
+ * @brief Sets the bits of a range. The unused bits of the last byte are always 0.
+ *
+ * @param offset The index of the first byte.
+ * @param count The number of bits.
+ * @param value 0 for OFF, any other value for ON.
+ */
+template <typename... ranges_t> void CSE_ModbusRTU_StaticBitMap <ranges_t...>:: fill (uint32_t offset, uint16_t count, uint16_t value) {
+  memset (bits + offset, (value != 0) ? 0xFF : 0x00, (count + 7) / 8);
+
+  if ((value != 0) && ((count % 8) != 0)) {
+    bits [offset + (count / 8)] = (uint8_t) ((1U << (count % 8)) - 1);
+  }
+}
+
+#endif
+
+//======================================================================================//
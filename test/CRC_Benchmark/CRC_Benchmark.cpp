@@ -0,0 +1,134 @@
+
+//===================================================================================//
+/**
+  * @file CRC_Benchmark.cpp
+  * @brief Host-side benchmark for the CRC-16/MODBUS engines of the CSE_ModbusRTU
+  * library. Checks that all engines agree, and then reports the throughput of each
+  * engine in bytes per second for 8, 64 and 256 byte frames.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -O2 -I../../src CRC_Benchmark.cpp ../../src/CSE_ModbusRTU_CRC.cpp -o CRC_Benchmark
+  *   ./CRC_Benchmark
+  *
+  * @date +05:30 10:12:40 AM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "CSE_ModbusRTU_CRC.h"
+
+//===================================================================================//
+
+typedef uint16_t (*crcEngine_t) (const uint8_t* buffer, size_t length, uint16_t crc);
+
+struct engine_t {
+  const char* name;
+  crcEngine_t function;
+};
+
+const engine_t engines[] = {
+  { "bitwise", CSE_ModbusRTU_CRC:: calculateBitwise },
+  { "table", CSE_ModbusRTU_CRC:: calculateTable },
+  { "slicing-by-4", CSE_ModbusRTU_CRC:: calculateSlicing4 },
+  { "slicing-by-8", CSE_ModbusRTU_CRC:: calculateSlicing8 }
+};
+
+const size_t engineCount = sizeof (engines) / sizeof (engines [0]);
+const size_t frameSizes[] = { 8, 64, 256 };
+const size_t bytesPerRun = 64UL * 1024UL * 1024UL; // Bytes processed per measurement
+
+volatile uint16_t sink; // Keeps the compiler from removing the CRC calls
+
+//===================================================================================//
+/**
+ * @brief Checks all engines against the CRC-16/MODBUS check value and against each
+ * other for every length from 0 to 256 bytes.
+ *
+ * @return true - All engines agree.
+ * @return false - Mismatch found.
+ */
+bool verifyEngines() {
+  const uint8_t checkString[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+  uint8_t buffer [256];
+
+  for (size_t e = 0; e < engineCount; e++) {
+    uint16_t crc = engines [e].function (checkString, sizeof (checkString), MODBUS_RTU_CRC_INIT);
+
+    if (crc != 0x4B37) {
+      printf ("%s: Check value mismatch. Found 0x%04X, expected 0x4B37.\n", engines [e].name, crc);
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < sizeof (buffer); i++) {
+    buffer [i] = (uint8_t) rand();
+  }
+
+  for (size_t length = 0; length <= sizeof (buffer); length++) {
+    uint16_t expected = CSE_ModbusRTU_CRC:: calculateBitwise (buffer, length);
+
+    for (size_t e = 0; e < engineCount; e++) {
+      if (engines [e].function (buffer, length, MODBUS_RTU_CRC_INIT) != expected) {
+        printf ("%s: Mismatch at length %zu.\n", engines [e].name, length);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - CRC Benchmark\n");
+  printf ("Selected engine: %s\n\n", CSE_ModbusRTU_CRC:: getEngineName());
+
+  if (!verifyEngines()) {
+    printf ("Engine verification failed!\n");
+    return 1;
+  }
+
+  printf ("All engines verified.\n\n");
+  printf ("%-14s %10s %16s\n", "Engine", "Frame", "Throughput");
+
+  uint8_t frame [256];
+
+  for (size_t i = 0; i < sizeof (frame); i++) {
+    frame [i] = (uint8_t) rand();
+  }
+
+  for (size_t e = 0; e < engineCount; e++) {
+    for (size_t s = 0; s < (sizeof (frameSizes) / sizeof (frameSizes [0])); s++) {
+      size_t frameSize = frameSizes [s];
+      size_t iterations = bytesPerRun / frameSize;
+      uint16_t accumulator = 0;
+
+      auto startTime = std::chrono::steady_clock::now();
+
+      for (size_t i = 0; i < iterations; i++) {
+        frame [0] = (uint8_t) i; // Change the input on every iteration
+        accumulator ^= engines [e].function (frame, frameSize, MODBUS_RTU_CRC_INIT);
+      }
+
+      auto endTime = std::chrono::steady_clock::now();
+      sink = accumulator;
+
+      double seconds = std::chrono::duration <double> (endTime - startTime).count();
+      double bytesPerSecond = (double) (iterations * frameSize) / seconds;
+
+      printf ("%-14s %8zu B %12.1f MB/s\n", engines [e].name, frameSize, bytesPerSecond / 1e6);
+    }
+  }
+
+  return 0;
+}
+
+//===================================================================================//
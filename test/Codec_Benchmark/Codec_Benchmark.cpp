@@ -0,0 +1,202 @@
+
+//===================================================================================//
+/**
+  * @file Codec_Benchmark.cpp
+  * @brief Host-side benchmark for the register codec engines of the CSE_ModbusRTU
+  * library. Checks that all engines agree for every count up to 125 registers and every
+  * alignment of the byte array, and then reports the time to encode and decode the
+  * payload of a 125-register frame with each engine. The two ways the library used to
+  * do it are measured too.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -O2 -I../../src Codec_Benchmark.cpp ../../src/CSE_ModbusRTU_Codec.cpp -o Codec_Benchmark
+  *   ./Codec_Benchmark
+  *
+  * @date +05:30 11:46:20 PM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "CSE_ModbusRTU_Codec.h"
+
+//===================================================================================//
+
+#define   REGISTER_COUNT        125U  // Registers in a read holding registers response
+#define   FRAME_COUNT           2000000UL // Frames processed per measurement
+
+typedef void (*encoder_t) (uint8_t* target, const uint16_t* source, size_t count);
+typedef void (*decoder_t) (uint16_t* target, const uint8_t* source, size_t count);
+
+struct engine_t {
+  const char* name;
+  encoder_t encode;
+  decoder_t decode;
+};
+
+//===================================================================================//
+/**
+ * @brief Encodes the way the server did before. The bytes are split into an array on
+ * the stack, and then copied to the frame one by one.
+ *
+ */
+void encodeTwoPass (uint8_t* target, const uint16_t* source, size_t count) {
+  uint8_t data [REGISTER_COUNT * 2];
+
+  for (size_t i = 0, j = 0; i < count; i++, j += 2) {
+    data [j] = source [i] >> 8;
+    data [j + 1] = source [i] & 0xFF;
+  }
+
+  for (size_t i = 0; i < (count * 2); i++) {
+    target [i] = data [i];
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Decodes the way the client did before. Each word is read with a bounds check,
+ * as in CSE_ModbusRTU_ADU::getWord().
+ *
+ */
+void decodePerWord (uint16_t* target, const uint8_t* source, size_t count) {
+  volatile size_t length = count * 2; // The frame length, as the ADU sees it
+
+  for (size_t i = 0; i < count; i++) {
+    size_t index = i * 2;
+
+    if ((index + 1) < length) {
+      target [i] = (uint16_t) (source [index] << 8) + source [index + 1];
+    }
+    else {
+      target [i] = 0x0000;
+    }
+  }
+}
+
+const engine_t engines[] = {
+  { "bytewise", CSE_ModbusRTU_Codec:: encodeBytewise, CSE_ModbusRTU_Codec:: decodeBytewise },
+  { "wordwise", CSE_ModbusRTU_Codec:: encodeWordwise, CSE_ModbusRTU_Codec:: decodeWordwise },
+  { "SIMD", CSE_ModbusRTU_Codec:: encodeSIMD, CSE_ModbusRTU_Codec:: decodeSIMD },
+  { "before", encodeTwoPass, decodePerWord }
+};
+
+const size_t engineCount = sizeof (engines) / sizeof (engines [0]);
+
+volatile uint16_t sink; // Keeps the compiler from removing the calls
+
+//===================================================================================//
+/**
+ * @brief Checks all engines against the byte-wise engine for every count from 0 to 125
+ * registers, at every offset of the byte array inside a 32-bit word. The bytes around
+ * the range must not be changed.
+ *
+ * @return true - All engines agree.
+ * @return false - Mismatch found.
+ */
+bool verifyEngines() {
+  uint16_t registers [REGISTER_COUNT];
+  uint16_t decoded [REGISTER_COUNT + 1];
+  uint8_t expected [(REGISTER_COUNT * 2) + 8];
+  uint8_t encoded [(REGISTER_COUNT * 2) + 8];
+
+  for (size_t i = 0; i < REGISTER_COUNT; i++) {
+    registers [i] = (uint16_t) rand();
+  }
+
+  // The first register is known, to check the byte order itself
+  registers [0] = 0x1234;
+  CSE_ModbusRTU_Codec:: encodeBytewise (expected, registers, 1);
+
+  if ((expected [0] != 0x12) || (expected [1] != 0x34)) {
+    printf ("bytewise: The high byte is not first.\n");
+    return false;
+  }
+
+  for (size_t e = 0; e < engineCount; e++) {
+    for (size_t offset = 0; offset < 4; offset++) {
+      for (size_t count = 0; count <= REGISTER_COUNT; count++) {
+        memset (expected, 0xA5, sizeof (expected));
+        memset (encoded, 0xA5, sizeof (encoded));
+        CSE_ModbusRTU_Codec:: encodeBytewise (expected + offset, registers, count);
+        engines [e].encode (encoded + offset, registers, count);
+
+        if (memcmp (expected, encoded, sizeof (expected)) != 0) {
+          printf ("%s: Encode mismatch at offset %zu, count %zu.\n", engines [e].name, offset, count);
+          return false;
+        }
+
+        decoded [count] = 0x5A5A;
+        engines [e].decode (decoded, encoded + offset, count);
+
+        if ((memcmp (decoded, registers, count * 2) != 0) || (decoded [count] != 0x5A5A)) {
+          printf ("%s: Decode mismatch at offset %zu, count %zu.\n", engines [e].name, offset, count);
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - Codec Benchmark\n");
+  printf ("Selected engine: %s\n\n", CSE_ModbusRTU_Codec:: getEngineName());
+
+  if (!verifyEngines()) {
+    printf ("Engine verification failed!\n");
+    return 1;
+  }
+
+  printf ("All engines verified.\n\n");
+  printf ("%-14s %20s %20s\n", "Engine", "Encode 125 regs", "Decode 125 regs");
+
+  uint16_t registers [REGISTER_COUNT];
+  uint8_t frame [(REGISTER_COUNT * 2) + 3]; // The data starts at byte 3 of a response
+
+  for (size_t i = 0; i < REGISTER_COUNT; i++) {
+    registers [i] = (uint16_t) rand();
+  }
+
+  for (size_t e = 0; e < engineCount; e++) {
+    uint16_t accumulator = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+      registers [0] = (uint16_t) i; // Change the input on every iteration
+      engines [e].encode (frame + 3, registers, REGISTER_COUNT);
+      accumulator ^= frame [3 + (i % (REGISTER_COUNT * 2))];
+    }
+
+    auto middleTime = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+      frame [3] = (uint8_t) i;
+      engines [e].decode (registers, frame + 3, REGISTER_COUNT);
+      accumulator ^= registers [i % REGISTER_COUNT];
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    sink = accumulator;
+
+    double encodeTime = std::chrono::duration <double, std::nano> (middleTime - startTime).count() / FRAME_COUNT;
+    double decodeTime = std::chrono::duration <double, std::nano> (endTime - middleTime).count() / FRAME_COUNT;
+
+    printf ("%-14s %14.1f ns %17.1f ns\n", engines [e].name, encodeTime, decodeTime);
+  }
+
+  return 0;
+}
+
+//===================================================================================//
@@ -0,0 +1,514 @@
+
+//===================================================================================//
+/**
+  * @file Gateway_Test.cpp
+  * @brief Host-side test for CSE_ModbusRTU_Gateway. Two loopback buses paced at 115200
+  * baud each have a server polled from its own thread. The servers are at the unit IDs
+  * 0x01 and 0x02. A CSE_ModbusRTU_Master runs the buses, and the gateway listens on a
+  * free TCP port of the local host. The test connects to the gateway as Modbus TCP
+  * clients.
+  *
+  * Four checks are made.
+  *
+  *   - Multiplex : Several TCP clients each keep a number of requests in progress, to
+  *     both units. Each client writes a counting value to its own holding register and
+  *     reads it back. The responses are matched to the requests by the transaction ID,
+  *     and the values are checked. The queueing delay measured by the gateway is printed.
+  *   - Exceptions : A unit ID with no route must be answered with Gateway Path
+  *     Unavailable (0x0A), and a unit ID with no server on its bus with Gateway Target
+  *     Device Failed to Respond (0x0B). A broadcast with the unit ID 0x00, which has no
+  *     route, must not be answered at all.
+  *   - Depth : With a queue depth of 2, a burst of 6 requests to one unit must have
+  *     exactly 4 of them answered with Server Device Busy (0x06).
+  *   - Header : A request with an invalid protocol ID must close the connection.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host. The
+  * optional argument is the number of transactions of each TCP client.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src Gateway_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o Gateway_Test
+  *   ./Gateway_Test 500
+  *
+  * @date +05:30 09:35:15 PM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "CSE_ModbusRTU_Gateway.h"
+
+//===================================================================================//
+
+#define   BUS_COUNT             2U
+#define   BAUD_RATE             115200UL
+#define   CLIENT_COUNT          6U  // TCP clients in the multiplex test
+#define   CLIENT_WINDOW         4U  // Requests in progress for each client
+
+CSE_ModbusRTU_LoopbackPort clientPorts [BUS_COUNT];
+CSE_ModbusRTU_LoopbackPort serverPorts [BUS_COUNT];
+
+CSE_ModbusRTU clientRTU0 (&clientPorts [0], 0x00, "clientRTU0");
+CSE_ModbusRTU clientRTU1 (&clientPorts [1], 0x00, "clientRTU1");
+CSE_ModbusRTU serverRTU0 (&serverPorts [0], 0x01, "serverRTU0");
+CSE_ModbusRTU serverRTU1 (&serverPorts [1], 0x02, "serverRTU1");
+
+CSE_ModbusRTU_Server server0 (serverRTU0, "server0");
+CSE_ModbusRTU_Server server1 (serverRTU1, "server1");
+
+CSE_ModbusRTU_Master master ("master");
+CSE_ModbusRTU_Gateway gateway (master, "gateway");
+
+std::atomic <bool> serversRunning (false);
+std::atomic <bool> gatewayRunning (false);
+std::thread gatewayThread;
+
+//===================================================================================//
+/**
+ * @brief The server thread of a bus.
+ *
+ * @param server The server to poll.
+ */
+void serverLoop (CSE_ModbusRTU_Server* server) {
+  while (serversRunning.load()) {
+    server->poll();
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief The gateway thread.
+ *
+ */
+void gatewayLoop() {
+  while (gatewayRunning.load()) {
+    gateway.poll (10);
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Connects a TCP client to the gateway.
+ *
+ * @return int - The socket; -1 if failed.
+ */
+int connectGateway() {
+  int fd = socket (AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address;
+
+  memset (&address, 0, sizeof (address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons (gateway.getPort());
+  inet_pton (AF_INET, "127.0.0.1", &address.sin_addr);
+
+  if (connect (fd, (struct sockaddr*) &address, sizeof (address)) != 0) {
+    close (fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+//===================================================================================//
+/**
+ * @brief Sends a read or write request for one holding register.
+ *
+ * @param fd The socket.
+ * @param transactionId The transaction ID.
+ * @param unitId The unit ID.
+ * @param functionCode MODBUS_FC_READ_HOLDING_REGISTERS or MODBUS_FC_WRITE_SINGLE_REGISTER.
+ * @param address The address of the register.
+ * @param value The count for a read, or the value for a write.
+ * @param protocolId The protocol ID. Must be 0 for Modbus.
+ * @return true - Operation successful.
+ * @return false - Operation failed.
+ */
+bool sendRequest (int fd, uint16_t transactionId, uint8_t unitId, uint8_t functionCode, uint16_t address, uint16_t value, uint16_t protocolId = 0) {
+  uint8_t frame [] = {
+    (uint8_t) (transactionId >> 8), (uint8_t) transactionId,
+    (uint8_t) (protocolId >> 8), (uint8_t) protocolId,
+    0x00, 0x06,
+    unitId, functionCode,
+    (uint8_t) (address >> 8), (uint8_t) address,
+    (uint8_t) (value >> 8), (uint8_t) value
+  };
+
+  return write (fd, frame, sizeof (frame)) == (ssize_t) sizeof (frame);
+}
+
+//===================================================================================//
+/**
+ * @brief Reads exactly the specified number of bytes.
+ *
+ * @return true - Operation successful.
+ * @return false - The connection was closed.
+ */
+bool readExact (int fd, uint8_t* buffer, size_t length) {
+  size_t received = 0;
+
+  while (received < length) {
+    ssize_t count = recv (fd, buffer + received, length - received, 0);
+
+    if (count <= 0) {
+      return false;
+    }
+
+    received += (size_t) count;
+  }
+
+  return true;
+}
+
+//===================================================================================//
+/**
+ * @brief Reads a response.
+ *
+ * @param fd The socket.
+ * @param frame The MBAP header and the PDU are saved here.
+ * @return int - The length of the frame; -1 if the connection was closed.
+ */
+int readResponse (int fd, uint8_t* frame) {
+  if (!readExact (fd, frame, MODBUS_TCP_MBAP_LENGTH)) {
+    return -1;
+  }
+
+  uint16_t length = (frame [4] << 8) | frame [5];
+
+  if ((length < 2) || !readExact (fd, frame + MODBUS_TCP_MBAP_LENGTH, length - 1)) {
+    return -1;
+  }
+
+  return 6 + length;
+}
+
+//===================================================================================//
+/**
+ * @brief A TCP client of the multiplex test. Keeps CLIENT_WINDOW requests in progress.
+ * The requests are pairs of a write and a read-back of the holding register with the
+ * index of the client, to unit 0x01 and 0x02 in turns.
+ *
+ * @param client The index of the client.
+ * @param count The number of transactions.
+ * @param failed The number of failed transactions is saved here.
+ */
+void clientLoop (uint8_t client, uint32_t count, uint32_t* failed) {
+  struct pending_t {
+    uint8_t functionCode;
+    uint16_t value;
+  };
+
+  std::vector <pending_t> pending (count);
+  int fd = connectGateway();
+
+  if (fd < 0) {
+    *failed = count;
+    return;
+  }
+
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  uint16_t value = (uint16_t) (client << 12);
+
+  while (received < count) {
+    while ((sent < count) && ((sent - received) < CLIENT_WINDOW)) {
+      uint8_t unitId = ((sent >> 1) & 1) + 1;
+
+      if ((sent & 1) == 0) {
+        value++;
+        pending [sent] = { MODBUS_FC_WRITE_SINGLE_REGISTER, value };
+        sendRequest (fd, (uint16_t) sent, unitId, MODBUS_FC_WRITE_SINGLE_REGISTER, client, value);
+      }
+      else {
+        pending [sent] = { MODBUS_FC_READ_HOLDING_REGISTERS, value };
+        sendRequest (fd, (uint16_t) sent, unitId, MODBUS_FC_READ_HOLDING_REGISTERS, client, 1);
+      }
+
+      sent++;
+    }
+
+    uint8_t frame [MODBUS_TCP_FRAME_LENGTH_MAX];
+
+    if (readResponse (fd, frame) < 0) {
+      break;
+    }
+
+    // Match the response to its request by the transaction ID
+    uint16_t transactionId = (frame [0] << 8) | frame [1];
+    received++;
+
+    if (transactionId >= sent) {
+      (*failed)++;
+      continue;
+    }
+
+    pending_t& request = pending [transactionId];
+
+    if (frame [7] != request.functionCode) {
+      (*failed)++;
+    }
+    else if ((request.functionCode == MODBUS_FC_READ_HOLDING_REGISTERS) && (((frame [9] << 8) | frame [10]) != request.value)) {
+      (*failed)++;
+    }
+  }
+
+  *failed += count - received;
+  close (fd);
+}
+
+//===================================================================================//
+/**
+ * @brief Runs the multiplex test.
+ *
+ * @param count The number of transactions of each client.
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runMultiplexTest (uint32_t count) {
+  std::vector <std::thread> clients;
+  uint32_t failures [CLIENT_COUNT] = {0};
+  uint32_t startTime = micros();
+
+  for (uint8_t i = 0; i < CLIENT_COUNT; i++) {
+    clients.push_back (std::thread (clientLoop, i, count, &failures [i]));
+  }
+
+  uint32_t failed = 0;
+
+  for (uint8_t i = 0; i < CLIENT_COUNT; i++) {
+    clients [i].join();
+    failed += failures [i];
+  }
+
+  double seconds = (micros() - startTime) / 1000000.0;
+  bool passed = (failed == 0) && (gateway.getRejectedCount() == 0);
+
+  printf ("%-10s %u clients x %u, %.0f trans/s, queue delay avg %u us max %u us, failed %u  %s\n", "Multiplex",
+    CLIENT_COUNT, count, (CLIENT_COUNT * count) / seconds, gateway.getQueueDelayAverage(), gateway.getQueueDelayMax(),
+    failed, passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Sends a request and returns the exception code of the response.
+ *
+ * @return int - The exception code; 0 for a normal response; -1 if failed.
+ */
+int requestException (int fd, uint16_t transactionId, uint8_t unitId) {
+  uint8_t frame [MODBUS_TCP_FRAME_LENGTH_MAX];
+
+  if (!sendRequest (fd, transactionId, unitId, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1) || (readResponse (fd, frame) < 0)) {
+    return -1;
+  }
+
+  if ((((frame [0] << 8) | frame [1]) != transactionId) || (frame [6] != unitId)) {
+    return -1;
+  }
+
+  return (frame [7] & 0x80) ? frame [8] : 0;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks the exception responses of the gateway.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runExceptionTest() {
+  int fd = connectGateway();
+
+  int unrouted = requestException (fd, 100, 0x09);
+  int noResponse = requestException (fd, 101, 0x03);
+  int normal = requestException (fd, 102, 0x01);
+
+  // A broadcast has no route, but must not be answered. The next response must be the
+  // one of the next request.
+  bool broadcastSent = sendRequest (fd, 103, 0x00, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1);
+  int afterBroadcast = requestException (fd, 104, 0x01);
+
+  close (fd);
+
+  bool passed = (unrouted == MODBUS_EX_GATEWAY_PATH_UNAVAILABLE) && (noResponse == MODBUS_EX_GATEWAY_TARGET_NO_RESPONSE) && (normal == 0);
+  passed &= broadcastSent && (afterBroadcast == 0);
+
+  printf ("%-10s no route 0x%02X, no response 0x%02X, normal %d, broadcast %s  %s\n", "Exceptions", unrouted, noResponse, normal,
+    (afterBroadcast == 0) ? "unanswered" : "answered", passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Sends a burst of requests to one unit with a queue depth of 2.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runDepthTest() {
+  int fd = connectGateway();
+  uint8_t frame [MODBUS_TCP_FRAME_LENGTH_MAX];
+  uint32_t rejected = gateway.getRejectedCount();
+  uint8_t busyCount = 0;
+  uint8_t normalCount = 0;
+
+  // One write, so that the burst arrives at the gateway in one segment
+  uint8_t burst [6 * 12];
+
+  for (uint8_t i = 0; i < 6; i++) {
+    uint8_t request [] = { 0x00, (uint8_t) (200 + i), 0x00, 0x00, 0x00, 0x06, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 0x00, 0x00, 0x00, 0x01 };
+    memcpy (burst + (i * 12), request, 12);
+  }
+
+  bool passed = (write (fd, burst, sizeof (burst)) == (ssize_t) sizeof (burst));
+
+  for (uint8_t i = 0; passed && (i < 6); i++) {
+    if (readResponse (fd, frame) < 0) {
+      passed = false;
+    }
+    else if ((frame [7] & 0x80) && (frame [8] == MODBUS_EX_SERVER_DEVICE_BUSY)) {
+      busyCount++;
+    }
+    else if (frame [7] == MODBUS_FC_READ_HOLDING_REGISTERS) {
+      normalCount++;
+    }
+  }
+
+  close (fd);
+
+  passed &= (busyCount == 4) && (normalCount == 2) && ((gateway.getRejectedCount() - rejected) == 4);
+
+  printf ("%-10s depth 2, burst of 6: %u busy, %u answered  %s\n", "Depth", busyCount, normalCount, passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Sends a request with an invalid protocol ID.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runHeaderTest() {
+  int fd = connectGateway();
+  uint8_t frame [MODBUS_TCP_FRAME_LENGTH_MAX];
+
+  sendRequest (fd, 300, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1, 0x0001);
+  bool passed = (readResponse (fd, frame) < 0);  // Closed without a response
+
+  close (fd);
+
+  printf ("%-10s invalid protocol ID, connection %s  %s\n", "Header", passed ? "closed" : "open", passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Starts or stops the gateway thread. The settings of the gateway are changed
+ * only while the thread is stopped.
+ *
+ */
+void runGateway (bool run) {
+  if (run) {
+    gatewayRunning.store (true);
+    gatewayThread = std::thread (gatewayLoop);
+  }
+  else {
+    gatewayRunning.store (false);
+    gatewayThread.join();
+  }
+}
+
+//===================================================================================//
+
+int main (int argc, char* argv[]) {
+  uint32_t count = (argc > 1) ? (uint32_t) strtoul (argv [1], NULL, 10) : 500UL;
+
+  printf ("CSE_ModbusRTU - Gateway Test\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  CSE_ModbusRTU* nodes[] = { &clientRTU0, &clientRTU1, &serverRTU0, &serverRTU1 };
+
+  for (uint8_t i = 0; i < BUS_COUNT; i++) {
+    clientPorts [i].connect (serverPorts [i]);
+    clientPorts [i].setBaudRate (BAUD_RATE);
+    serverPorts [i].setBaudRate (BAUD_RATE);
+  }
+
+  for (CSE_ModbusRTU* node : nodes) {
+    node->setCharacterBits (10);
+    node->setBaudRate (BAUD_RATE);
+    node->setInterCharTimeout (0);  // The threads can be late on a loaded host. See Loopback_Benchmark.
+  }
+
+  CSE_ModbusRTU_Server* servers[] = { &server0, &server1 };
+
+  for (CSE_ModbusRTU_Server* server : servers) {
+    server->begin();
+    server->configureHoldingRegisters (0x00, 9);
+    server->setNonBlocking (true);
+  }
+
+  serversRunning.store (true);
+  std::thread serverThread0 (serverLoop, &server0);
+  std::thread serverThread1 (serverLoop, &server1);
+
+  // The unit 0x03 is routed to the first bus, but there is no server for it
+  master.addBus (clientRTU0);
+  master.addBus (clientRTU1);
+  master.setRoute (0x01, 0);
+  master.setRoute (0x02, 1);
+  master.setRoute (0x03, 0);
+  master.setTimeout (0, 50);
+  master.setTimeout (1, 50);
+  master.begin();
+
+  bool passed = gateway.begin (0, "127.0.0.1");
+
+  if (!passed) {
+    printf ("Failed to start the gateway.\n");
+    return 1;
+  }
+
+  printf ("Listening on port %u\n\n", gateway.getPort());
+
+  gateway.setQueueDepth (MODBUS_RTU_GATEWAY_REQUEST_MAX);
+  runGateway (true);
+  passed &= runMultiplexTest (count);
+  passed &= runExceptionTest();
+  runGateway (false);
+
+  gateway.setQueueDepth (2);
+  runGateway (true);
+  passed &= runDepthTest();
+  passed &= runHeaderTest();
+  runGateway (false);
+
+  gateway.end();
+  master.end();
+
+  serversRunning.store (false);
+  serverThread0.join();
+  serverThread1.join();
+
+  printf ("\nRequests %u, rejected %u\n", gateway.getRequestCount(), gateway.getRejectedCount());
+  printf ("%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
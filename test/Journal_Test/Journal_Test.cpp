@@ -0,0 +1,652 @@
+
+//===================================================================================//
+/**
+  * @file Journal_Test.cpp
+  * @brief Host-side test for the holding register journal of the CSE_ModbusRTU server.
+  *
+  *   - Restore : Saves some holding registers to a journal in memory, and restores them
+  *     into a new server, like after a restart. A storage too small for a snapshot must
+  *     be refused.
+  *   - Coalescing : Writes the same register many times and a range one register at a
+  *     time. Each must be saved with the fewest records, and only after the flush delay.
+  *   - Crashes : Writes registers through the journal until it has made several
+  *     snapshots, and takes a copy of the storage after every step of poll(), like a
+  *     power failure at that point, and another copy with the bytes of that step only
+  *     half written. Every copy must restore the registers as they were before or
+  *     after the last write, and must finish any snapshot in progress, also when a
+  *     record of the snapshot is torn.
+  *   - Failed writes : Makes each write to the storage fail in turn, after writing half
+  *     of its bytes. The journal must go on after the failed write, also when it is a
+  *     write of a snapshot, and keep all the other writes.
+  *   - Torn record : Leaves a record half written. The restart must ignore it, and the
+  *     journal must keep working after it.
+  *   - Loopback : A client writes the holding registers over a loopback pair. The
+  *     response path must only mark the registers, and the journal must save them when
+  *     it is flushed.
+  *   - File : Saves the registers in a file, and restores them from a new storage object.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src Journal_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o Journal_Test
+  *   ./Journal_Test
+  *
+  * @date +05:30 02:53:07 AM 17-10-2026, Saturday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "CSE_ModbusRTU.h"
+#include "CSE_ModbusRTU_Journal.h"
+
+//===================================================================================//
+
+#define   HOLDING_ADDRESS       0x0100U // Holding registers of the servers
+#define   HOLDING_COUNT         64U
+#define   PAGE_SIZE             256U  // A snapshot of 64 registers takes one page
+#define   PAGE_COUNT            6U
+#define   CRASH_ROUNDS          600U  // Writes made by the crash test
+
+CSE_ModbusRTU_LoopbackPort clientPort;
+CSE_ModbusRTU_LoopbackPort serverPort;
+
+CSE_ModbusRTU clientRTU (&clientPort, 0x00, "clientRTU");
+CSE_ModbusRTU serverRTU (&serverPort, 0x01, "serverRTU");
+
+CSE_ModbusRTU_Client modbusRTUClient (clientRTU, "modbusRTUClient");
+CSE_ModbusRTU_Server modbusRTUServer (serverRTU, "modbusRTUServer");
+
+std::atomic <bool> running (false);
+
+CSE_ModbusRTU_LoopbackPort restorePort; // Used by the servers that are never polled
+CSE_ModbusRTU restoreRTU (&restorePort, 0x01, "restoreRTU");
+
+uint8_t memory [PAGE_SIZE * PAGE_COUNT];
+uint8_t image [PAGE_SIZE * PAGE_COUNT];
+uint8_t previous [PAGE_SIZE * PAGE_COUNT];  // The storage before a step of the crash test
+
+//===================================================================================//
+/**
+ * @brief Journal storage in memory that fails one of its writes, after writing half of
+ * the bytes.
+ *
+ */
+class FailingJournalStorage final : public CSE_ModbusRTU_JournalStorage {
+  private:
+    CSE_ModbusRTU_MemoryJournalStorage memoryStorage;
+
+  public:
+    uint32_t writeCount;  // Writes made
+    uint32_t failWrite; // The write that fails, counting from 1
+    bool snapshotFailed;  // The failed write was a record of a snapshot
+
+    FailingJournalStorage (uint8_t* memory) : memoryStorage (memory, PAGE_SIZE, PAGE_COUNT) {
+      writeCount = 0;
+      failWrite = 0;
+      snapshotFailed = false;
+    }
+
+    uint32_t getPageSize() { return PAGE_SIZE; }
+    uint16_t getPageCount() { return PAGE_COUNT; }
+    bool read (uint32_t offset, uint8_t* data, uint32_t length) { return memoryStorage.read (offset, data, length); }
+    bool erase (uint16_t page) { return memoryStorage.erase (page); }
+
+    bool write (uint32_t offset, const uint8_t* data, uint32_t length) {
+      if (++writeCount != failWrite) {
+        return memoryStorage.write (offset, data, length);
+      }
+
+      // The test writes one register at a time, so only a snapshot writes full runs and
+      // the record that ends it
+      uint16_t count = (uint16_t) (data [2] | (data [3] << 8));
+      snapshotFailed = ((offset % PAGE_SIZE) != 0) && ((count == 0) || (count == MODBUS_RTU_JOURNAL_RUN_MAX));
+
+      memoryStorage.write (offset, data, length / 2);
+      return false;
+    }
+};
+
+//===================================================================================//
+/**
+ * @brief Prints the result of a check.
+ *
+ * @param name The name of the check.
+ * @param passed The result.
+ * @return bool - The result.
+ */
+bool check (const char* name, bool passed) {
+  printf ("  %-52s %s\n", name, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Restores the holding registers from a storage into a new server, like after a
+ * restart.
+ *
+ * @param storage The storage of the journal.
+ * @param values The restored values are saved here.
+ * @param finish Flush the journal after the restore, and restore again.
+ * @param compactions The number of snapshots the flush has completed.
+ * @return true - The journal was started, and the values were read.
+ */
+bool restore (CSE_ModbusRTU_JournalStorage& storage, uint16_t* values, bool finish = false, uint32_t* compactions = NULL) {
+  CSE_ModbusRTU_Server server (restoreRTU, "restoreServer");
+  CSE_ModbusRTU_Journal journal (server, storage);
+
+  if (!server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT) || !journal.begin()) {
+    return false;
+  }
+
+  if (finish) {
+    if (!journal.flush()) {
+      return false;
+    }
+
+    if (compactions != NULL) {
+      *compactions = journal.getCompactionCount();
+    }
+  }
+
+  journal.end();
+
+  if (server.readHoldingRegister (HOLDING_ADDRESS, HOLDING_COUNT, values) != 1) {
+    return false;
+  }
+
+  if (finish) {
+    uint16_t again [HOLDING_COUNT];
+
+    return restore (storage, again) && (memcmp (values, again, sizeof (again)) == 0);
+  }
+
+  return true;
+}
+
+//===================================================================================//
+/**
+ * @brief Saves and restores some holding registers.
+ *
+ * @return true - All the checks passed.
+ */
+bool runRestoreTest() {
+  bool passed = true;
+
+  printf ("Restore\n");
+
+  memset (memory, 0xFF, sizeof (memory));
+  CSE_ModbusRTU_MemoryJournalStorage storage (memory, PAGE_SIZE, PAGE_COUNT);
+  CSE_ModbusRTU_MemoryJournalStorage smallStorage (memory, PAGE_SIZE, 3);
+
+  CSE_ModbusRTU_Server server (restoreRTU, "server");
+  CSE_ModbusRTU_Journal journal (server, storage);
+  CSE_ModbusRTU_Journal smallJournal (server, smallStorage);
+
+  server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+
+  passed &= check ("refuse a storage without room for snapshots", !smallJournal.begin());
+  passed &= check ("start on an erased storage", journal.begin() && (journal.getUsedPageCount() == 0) && (journal.getRestoreCount() == 0));
+
+  uint16_t values [HOLDING_COUNT];
+
+  for (size_t i = 0; i < HOLDING_COUNT; i++) {
+    values [i] = (uint16_t) (0xA000 + i);
+  }
+
+  server.writeHoldingRegister (HOLDING_ADDRESS, HOLDING_COUNT, values);
+  journal.mark (HOLDING_ADDRESS, HOLDING_COUNT);
+  server.writeHoldingRegister (HOLDING_ADDRESS + 3, 0x1234);
+  journal.mark (HOLDING_ADDRESS + 3);
+  journal.mark (0x0000); // Not a holding register
+
+  passed &= check ("flush the marked registers", journal.flush() && !journal.isPending() && (journal.getRecordCount() == 2));
+  journal.end();
+
+  uint16_t restored [HOLDING_COUNT];
+  values [3] = 0x1234;
+
+  bool restoreOk = restore (storage, restored) && (memcmp (values, restored, sizeof (values)) == 0);
+  passed &= check ("restore into a new server", restoreOk);
+
+  // The journal of a server with other registers restores the ones present
+  CSE_ModbusRTU_Server otherServer (restoreRTU, "otherServer");
+  CSE_ModbusRTU_Journal otherJournal (otherServer, storage);
+  otherServer.configureHoldingRegisters (HOLDING_ADDRESS + 60, 8);
+
+  bool otherOk = otherJournal.begin() && (otherServer.readHoldingRegister (HOLDING_ADDRESS + 63) == 0xA03F) && (otherServer.readHoldingRegister (HOLDING_ADDRESS + 64) == 0);
+  passed &= check ("restore a different layout", otherOk);
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks that repeated writes are saved with few records.
+ *
+ * @return true - All the checks passed.
+ */
+bool runCoalescingTest() {
+  bool passed = true;
+
+  printf ("\nCoalescing\n");
+
+  memset (memory, 0xFF, sizeof (memory));
+  CSE_ModbusRTU_MemoryJournalStorage storage (memory, PAGE_SIZE, PAGE_COUNT);
+  CSE_ModbusRTU_Server server (restoreRTU, "server");
+  CSE_ModbusRTU_Journal journal (server, storage);
+
+  server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+  journal.setFlushDelay (60000UL);
+  journal.begin();
+
+  for (uint32_t i = 0; i < 1000; i++) {
+    server.writeHoldingRegister (HOLDING_ADDRESS + 5, (uint16_t) i);
+    journal.mark (HOLDING_ADDRESS + 5);
+  }
+
+  passed &= check ("nothing saved before the flush delay", (journal.poll() == 0) && journal.isPending() && (journal.getRecordCount() == 0));
+  passed &= check ("1000 writes of a register saved as 1 record", journal.flush() && (journal.getRecordCount() == 1));
+
+  for (uint32_t i = 0; i < HOLDING_COUNT; i++) {
+    server.writeHoldingRegister (HOLDING_ADDRESS + i, (uint16_t) (i * 3));
+    journal.mark (HOLDING_ADDRESS + i);
+  }
+
+  bool rangeOk = journal.flush() && (journal.getRecordCount() == (1 + ((HOLDING_COUNT + MODBUS_RTU_JOURNAL_RUN_MAX - 1) / MODBUS_RTU_JOURNAL_RUN_MAX)));
+  passed &= check ("64 single writes saved as runs", rangeOk);
+
+  journal.setFlushDelay (0);
+  server.writeHoldingRegister (HOLDING_ADDRESS + 9, 0x5555);
+  journal.mark (HOLDING_ADDRESS + 9);
+
+  int first = journal.poll();
+  int second = journal.poll();
+  passed &= check ("poll saves one record per call", (first == 1) && (second == 0) && !journal.isPending());
+
+  uint16_t restored [HOLDING_COUNT];
+  passed &= check ("restore the last values", restore (storage, restored) && (restored [5] == 15) && (restored [9] == 0x5555) && (restored [63] == 189));
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Writes through the journal, and restores a copy of the storage after every
+ * step of poll().
+ *
+ * @return true - All the checks passed.
+ */
+bool runCrashTest() {
+  bool passed = true;
+
+  printf ("\nCrashes\n");
+
+  memset (memory, 0xFF, sizeof (memory));
+  CSE_ModbusRTU_MemoryJournalStorage storage (memory, PAGE_SIZE, PAGE_COUNT);
+  CSE_ModbusRTU_MemoryJournalStorage imageStorage (image, PAGE_SIZE, PAGE_COUNT);
+  CSE_ModbusRTU_Server server (restoreRTU, "server");
+  CSE_ModbusRTU_Journal journal (server, storage);
+
+  server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+  journal.setFlushDelay (0);
+  journal.begin();
+
+  uint16_t before [HOLDING_COUNT];
+  uint16_t restored [HOLDING_COUNT];
+  uint32_t steps = 0, badImages = 0, unfinished = 0, resumedSnapshots = 0, fullPages = 0;
+  uint32_t tornImages = 0, tornSnapshots = 0;
+
+  memset (before, 0, sizeof (before));
+
+  for (uint32_t round = 1; round <= CRASH_ROUNDS; round++) {
+    uint16_t index = (uint16_t) ((round * 7) % HOLDING_COUNT);
+
+    server.writeHoldingRegister (HOLDING_ADDRESS + index, (uint16_t) round);
+    journal.mark (HOLDING_ADDRESS + index);
+
+    int result;
+
+    do {
+      memcpy (previous, memory, sizeof (previous));
+      result = journal.poll();
+      steps++;
+
+      // Find the bytes written by this step. An erase sets bits, and is not torn.
+      size_t first = 0, last = 0;
+      bool erased = false;
+
+      for (size_t i = 0; i < sizeof (memory); i++) {
+        if (memory [i] != previous [i]) {
+          first = (last == 0) ? i : first;
+          last = i + 1;
+          erased = erased || ((memory [i] & ~previous [i]) != 0);
+        }
+      }
+
+      // A power failure after this step, and one in the middle of its write
+      for (int torn = 0; torn < (((last > first) && !erased) ? 2 : 1); torn++) {
+        memcpy (image, memory, sizeof (image));
+
+        if (torn) {
+          size_t middle = first + ((last - first) / 2);
+          memcpy (image + middle, previous + middle, last - middle);
+          tornImages++;
+        }
+
+        uint32_t compactions = 0;
+
+        if (!restore (imageStorage, restored, true, &compactions)) {
+          unfinished++;
+          continue;
+        }
+
+        resumedSnapshots += (compactions > 0) ? 1 : 0;
+        tornSnapshots += (torn && (compactions > 0)) ? 1 : 0;
+
+        for (size_t i = 0; i < HOLDING_COUNT; i++) {
+          bool isOld = (restored [i] == before [i]);
+          bool isNew = (i == index) && (restored [i] == round);
+
+          if (!isOld && !isNew) {
+            badImages++;
+            break;
+          }
+        }
+      }
+    } while (result > 0);
+
+    before [index] = (uint16_t) round;
+    fullPages += (journal.getUsedPageCount() == PAGE_COUNT) ? 1 : 0;
+
+    if (result < 0) {
+      break;
+    }
+  }
+
+  passed &= check ("all writes saved", !journal.isPending() && (restore (storage, restored)) && (memcmp (before, restored, sizeof (before)) == 0));
+  passed &= check ("snapshots made and old pages erased", (journal.getCompactionCount() >= 3) && (fullPages == 0));
+  passed &= check ("every crash restores the old or the new values", (badImages == 0) && (unfinished == 0) && (steps > CRASH_ROUNDS));
+  passed &= check ("snapshots stopped by a crash are finished", resumedSnapshots > 0);
+  passed &= check ("snapshots with a torn record are finished", (tornImages > CRASH_ROUNDS) && (tornSnapshots > 0));
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Makes each write to the storage fail in turn, and checks that the journal goes
+ * on after it.
+ *
+ * @return true - All the checks passed.
+ */
+bool runFailedWriteTest() {
+  bool passed = true;
+
+  printf ("\nFailed writes\n");
+
+  uint32_t runs = 0, snapshotFailures = 0, stuck = 0, badRestores = 0;
+
+  // Stops after the first run in which the write to fail is never made
+  for (uint32_t failWrite = 1; ; failWrite++) {
+    memset (memory, 0xFF, sizeof (memory));
+    FailingJournalStorage storage (memory);
+    CSE_ModbusRTU_Server server (restoreRTU, "server");
+    CSE_ModbusRTU_Journal journal (server, storage);
+    uint16_t expected [HOLDING_COUNT];
+    uint16_t restored [HOLDING_COUNT];
+
+    server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+    journal.setFlushDelay (0);
+    journal.begin();
+    storage.failWrite = failWrite;
+    memset (expected, 0, sizeof (expected));
+
+    for (uint32_t round = 1; round <= 200; round++) {
+      uint16_t index = (uint16_t) ((round * 7) % HOLDING_COUNT);
+
+      server.writeHoldingRegister (HOLDING_ADDRESS + index, (uint16_t) round);
+      journal.mark (HOLDING_ADDRESS + index);
+
+      // The write of a failed record is lost, so it is marked again
+      if (!journal.flush()) {
+        journal.mark (HOLDING_ADDRESS + index);
+        stuck += journal.flush() ? 0 : 1;
+      }
+
+      expected [index] = (uint16_t) round;
+    }
+
+    if (storage.writeCount < failWrite) {
+      break;
+    }
+
+    runs++;
+    snapshotFailures += storage.snapshotFailed ? 1 : 0;
+    journal.end();
+
+    if (!restore (storage, restored) || (memcmp (expected, restored, sizeof (expected)) != 0)) {
+      badRestores++;
+    }
+  }
+
+  passed &= check ("fail every write, and the writes of snapshots", (runs > 200) && (snapshotFailures > 0));
+  passed &= check ("journal goes on after a failed write", stuck == 0);
+  passed &= check ("restore all the writes", badRestores == 0);
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Leaves the last record half written, like a power failure during the write.
+ *
+ * @return true - All the checks passed.
+ */
+bool runTornTest() {
+  bool passed = true;
+
+  printf ("\nTorn record\n");
+
+  memset (memory, 0xFF, sizeof (memory));
+  CSE_ModbusRTU_MemoryJournalStorage storage (memory, PAGE_SIZE, PAGE_COUNT);
+  CSE_ModbusRTU_Server server (restoreRTU, "server");
+  CSE_ModbusRTU_Journal journal (server, storage);
+
+  server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+  journal.begin();
+
+  server.writeHoldingRegister (HOLDING_ADDRESS + 7, 0x1111);
+  journal.mark (HOLDING_ADDRESS + 7);
+  journal.flush();
+
+  memcpy (image, memory, sizeof (image));
+
+  uint16_t values [4] = { 0x2222, 0x2222, 0x2222, 0x2222 };
+  server.writeHoldingRegister (HOLDING_ADDRESS + 7, 4, values);
+  journal.mark (HOLDING_ADDRESS + 7, 4);
+  journal.flush();
+  journal.end();
+
+  // Only the first half of the new bytes reached the storage
+  size_t first = 0, last = 0;
+
+  for (size_t i = 0; i < sizeof (memory); i++) {
+    if (memory [i] != image [i]) {
+      first = (last == 0) ? i : first;
+      last = i + 1;
+    }
+  }
+
+  for (size_t i = first + ((last - first) / 2); i < last; i++) {
+    memory [i] = image [i];
+  }
+
+  uint16_t restored [HOLDING_COUNT];
+  passed &= check ("torn record ignored", (last > first) && restore (storage, restored) && (restored [7] == 0x1111) && (restored [8] == 0));
+
+  CSE_ModbusRTU_Server nextServer (restoreRTU, "nextServer");
+  CSE_ModbusRTU_Journal nextJournal (nextServer, storage);
+  nextServer.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+
+  bool continued = nextJournal.begin() && (nextJournal.getUsedPageCount() == 1);
+  nextServer.writeHoldingRegister (HOLDING_ADDRESS + 8, 0x3333);
+  nextJournal.mark (HOLDING_ADDRESS + 8);
+  continued = continued && nextJournal.flush() && (nextJournal.getUsedPageCount() == 2);
+  nextJournal.end();
+
+  continued = continued && restore (storage, restored) && (restored [7] == 0x1111) && (restored [8] == 0x3333);
+  passed &= check ("journal continues on the next page", continued);
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief The server thread. Polls the server and the journal until the run ends.
+ *
+ * @param journal The journal of the server.
+ */
+void serverLoop (CSE_ModbusRTU_Journal* journal) {
+  while (running.load()) {
+    modbusRTUServer.poll();
+    journal->poll();
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Writes the holding registers over a loopback pair.
+ *
+ * @return true - All the checks passed.
+ */
+bool runLoopbackTest() {
+  bool passed = true;
+
+  printf ("\nLoopback\n");
+
+  memset (memory, 0xFF, sizeof (memory));
+  CSE_ModbusRTU_MemoryJournalStorage storage (memory, PAGE_SIZE, PAGE_COUNT);
+  CSE_ModbusRTU_Journal journal (modbusRTUServer, storage);
+
+  modbusRTUServer.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+  journal.setFlushDelay (60000UL);
+  passed &= check ("start the journal", journal.begin());
+
+  clientPort.connect (serverPort);
+
+  CSE_ModbusRTU* nodes[] = { &clientRTU, &serverRTU };
+
+  for (CSE_ModbusRTU* node : nodes) {
+    node->setBaudRate (100000000UL);
+    node->setInterCharTimeout (0);
+    node->setInterFrameDelay (20);
+  }
+
+  modbusRTUClient.begin();
+  modbusRTUClient.setServerAddress (0x01);
+  modbusRTUServer.begin();
+  modbusRTUServer.setNonBlocking (true);
+
+  running.store (true);
+  std::thread serverThread (serverLoop, &journal);
+
+  uint16_t values [HOLDING_COUNT];
+  uint32_t failedRequests = 0;
+
+  for (uint32_t i = 0; i < 100; i++) {
+    for (size_t j = 0; j < 16; j++) {
+      values [j] = (uint16_t) (i + j);
+    }
+
+    if (modbusRTUClient.writeHoldingRegister (HOLDING_ADDRESS, 16, values) != MODBUS_FC_WRITE_MULTIPLE_REGISTERS) {
+      failedRequests++;
+    }
+
+    if (modbusRTUClient.writeHoldingRegister (HOLDING_ADDRESS + 40, (uint16_t) i) != MODBUS_FC_WRITE_SINGLE_REGISTER) {
+      failedRequests++;
+    }
+  }
+
+  running.store (false);
+  serverThread.join();
+
+  passed &= check ("all requests answered", failedRequests == 0);
+  passed &= check ("responses only mark the registers", journal.isPending() && (journal.getRecordCount() == 0));
+  passed &= check ("flush saves each range once", journal.flush() && (journal.getRecordCount() == 2));
+
+  uint16_t restored [HOLDING_COUNT];
+  bool restoreOk = restore (storage, restored) && (restored [0] == 99) && (restored [15] == 114) && (restored [40] == 99) && (restored [16] == 0);
+  passed &= check ("restore the writes of the client", restoreOk);
+
+  journal.end();
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Saves the registers in a file, and restores them from a new storage object.
+ *
+ * @return true - All the checks passed.
+ */
+bool runFileTest() {
+  bool passed = true;
+
+  printf ("\nFile\n");
+
+  char path [64];
+  snprintf (path, sizeof (path), "/tmp/cse_modbusrtu_test_%d.journal", (int) getpid());
+  unlink (path);
+
+  CSE_ModbusRTU_FileJournalStorage storage (path, 512, 4);
+  CSE_ModbusRTU_Server server (restoreRTU, "server");
+  CSE_ModbusRTU_Journal journal (server, storage);
+
+  server.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+  bool started = storage.begin() && journal.begin();
+  passed &= check ("create the file", started);
+
+  server.writeHoldingRegister (HOLDING_ADDRESS + 20, 0xCAFE);
+  journal.mark (HOLDING_ADDRESS + 20);
+  passed &= check ("flush to the file", journal.flush());
+  journal.end();
+  storage.end();
+
+  CSE_ModbusRTU_FileJournalStorage otherStorage (path, 512, 4);
+  uint16_t restored [HOLDING_COUNT];
+  passed &= check ("restore from the file", otherStorage.begin() && restore (otherStorage, restored) && (restored [20] == 0xCAFE));
+
+  otherStorage.end();
+  unlink (path);
+
+  return passed;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - Journal Test\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  bool passed = true;
+
+  passed &= runRestoreTest();
+  passed &= runCoalescingTest();
+  passed &= runCrashTest();
+  passed &= runFailedWriteTest();
+  passed &= runTornTest();
+  passed &= runLoopbackTest();
+  passed &= runFileTest();
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
@@ -0,0 +1,397 @@
+
+//===================================================================================//
+/**
+  * @file Loopback_Benchmark.cpp
+  * @brief Host-side test and benchmark for the CSE_ModbusRTU client and server. The two
+  * nodes are connected with a pair of CSE_ModbusRTU_LoopbackPort objects in one process.
+  * The server is polled in non-blocking mode from a second thread. The client writes a
+  * counting value to a holding register and reads it back, and the value is checked.
+  *
+  * Five runs are made.
+  *
+  *   - Unpaced : The bytes are readable immediately. Measures the transaction rate and
+  *     latency of the library itself. The inter-frame delay is set to 20 us.
+  *   - 9600 : The bytes are paced at 9600 baud. The latency must not be shorter than the
+  *     time the request and response take on the line, plus t3.5.
+  *   - USB : 115200 baud with 1 ms latency on every byte, like a USB-serial adapter.
+  *   - Gap : A 2 ms gap, longer than t3.5, is injected in the middle of a request at
+  *     115200 baud. The server must reject both halves of the request, and the next
+  *     request must succeed.
+  *   - Slow loop : 115200 baud with the t1.5 check enabled, while the server thread
+  *     sleeps 1 ms between two polls, longer than t1.5. The client writes and reads 100
+  *     registers, so the sleeps fall inside the frames. The bytes are not timestamped
+  *     when they arrive, so the requests must not be rejected as framing errors.
+  *   - Silence : At 9600 baud, the client makes requests back to back. The client
+  *     completes a response as soon as its length is reached, but its next request
+  *     must still start t3.5 after the end of the response.
+  *   - Polls : The server is polled from the main thread at 9600 baud, with a response
+  *     delay of 5 ms. No call of poll() may wait for the response delay or for the
+  *     response to be sent, and the server must be in the TRANSMITTING state meanwhile.
+  *
+  * At the end, the turnaround time must only be measured by the server, which replies
+  * to the requests, and not by the client.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host. The
+  * optional argument is the number of unpaced transactions.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src Loopback_Benchmark.cpp ../../src/CSE_ModbusRTU*.cpp -o Loopback_Benchmark
+  *   ./Loopback_Benchmark 1000000
+  *
+  * @date +05:30 07:25:10 PM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "CSE_ModbusRTU.h"
+
+//===================================================================================//
+
+#define   REGISTER_ADDRESS      0x03  // The holding register used for the test
+#define   SLOW_ADDRESS          0x10  // The holding registers used by the slow loop test
+#define   SLOW_COUNT            100U
+
+CSE_ModbusRTU_LoopbackPort clientPort;
+CSE_ModbusRTU_LoopbackPort serverPort;
+
+CSE_ModbusRTU clientRTU (&clientPort, 0x00, "clientRTU");
+CSE_ModbusRTU serverRTU (&serverPort, 0x01, "serverRTU");
+
+CSE_ModbusRTU_Client modbusRTUClient (clientRTU, "modbusRTUClient");
+CSE_ModbusRTU_Server modbusRTUServer (serverRTU, "modbusRTUServer");
+
+std::atomic <bool> serverRunning (false);
+std::atomic <uint32_t> pollInterval (0); // Sleep of the server thread between polls in microseconds
+
+//===================================================================================//
+/**
+ * @brief The server thread. Polls the server until serverRunning is cleared, and sleeps
+ * for pollInterval between two polls.
+ *
+ */
+void serverLoop() {
+  while (serverRunning.load()) {
+    modbusRTUServer.poll();
+
+    if (pollInterval.load() > 0) {
+      std::this_thread::sleep_for (std::chrono::microseconds (pollInterval.load()));
+    }
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Sets the pacing of both ports and the frame timing of both nodes.
+ *
+ * @param baudRate The baud rate of the line. 0 for no pacing.
+ * @param latency The latency of every byte in microseconds.
+ */
+void setLine (uint32_t baudRate, uint32_t latency) {
+  clientPort.setBaudRate (baudRate, 10);
+  serverPort.setBaudRate (baudRate, 10);
+  clientPort.setLatency (latency);
+  serverPort.setLatency (latency);
+
+  CSE_ModbusRTU* nodes[] = { &clientRTU, &serverRTU };
+
+  for (CSE_ModbusRTU* node : nodes) {
+    node->setCharacterBits (10);
+
+    if (baudRate == 0) {
+      // Only the frame timing is set by the baud rate here. A high rate keeps the
+      // transmission time of send() close to 0.
+      node->setBaudRate (100000000UL);
+      node->setInterCharTimeout (0);
+      node->setInterFrameDelay (20);
+    }
+    else {
+      // The bytes are timestamped when the other thread reads them. On a loaded host
+      // that thread can be late, which looks like a t1.5 gap, so only t3.5 is checked.
+      node->setBaudRate (baudRate);
+      node->setInterCharTimeout (0);
+    }
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Runs a number of write and read-back transactions and prints the statistics.
+ *
+ * @param name The name of the run.
+ * @param count The number of transactions. Each write and each read is one.
+ * @param minLatency The shortest allowed latency of a transaction in microseconds.
+ * @return true - All the transactions succeeded.
+ * @return false - A transaction failed or was faster than minLatency.
+ */
+bool runTest (const char* name, uint32_t count, uint32_t minLatency) {
+  std::vector <uint32_t> latencies;
+  latencies.reserve (count);
+
+  uint32_t failed = 0;
+  auto startTime = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t value = (uint16_t) (i >> 1);
+    uint16_t readValue = 0;
+    uint32_t transactionStart = micros();
+    bool success;
+
+    if ((i & 1) == 0) {
+      success = (modbusRTUClient.writeHoldingRegister (REGISTER_ADDRESS, value) != -1);
+    }
+    else {
+      success = (modbusRTUClient.readHoldingRegister (REGISTER_ADDRESS, 1, &readValue) != -1) && (readValue == value);
+    }
+
+    latencies.push_back (micros() - transactionStart);
+
+    if (!success) {
+      failed++;
+    }
+  }
+
+  double seconds = std::chrono::duration <double> (std::chrono::steady_clock::now() - startTime).count();
+
+  std::sort (latencies.begin(), latencies.end());
+
+  uint64_t total = 0;
+
+  for (uint32_t latency : latencies) {
+    total += latency;
+  }
+
+  bool passed = (failed == 0) && (latencies.front() >= minLatency);
+
+  printf ("%-8s %8u %10.0f %9.1f %9u %9u %9u %9u %6u  %s\n", name, count, count / seconds,
+    (double) total / count, latencies.front(), latencies [count / 2], latencies [(count * 99ULL) / 100],
+    latencies.back(), failed, passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Injects a gap longer than t3.5 into a request. The server sees two frames with
+ * invalid CRCs and drops them, so the client times out. The next request must succeed.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runGapTest() {
+  uint16_t readValue = 0;
+
+  clientPort.injectDelay (2000, 4);  // 2 ms before the fifth byte of the request
+  bool rejected = (modbusRTUClient.readHoldingRegister (REGISTER_ADDRESS, 1, &readValue) == -1);
+
+  bool recovered = (modbusRTUClient.writeHoldingRegister (REGISTER_ADDRESS, 0x5A5A) != -1) &&
+    (modbusRTUClient.readHoldingRegister (REGISTER_ADDRESS, 1, &readValue) != -1) && (readValue == 0x5A5A);
+
+  bool passed = rejected && recovered;
+
+  printf ("%-8s request with gap %s, next requests %s  %s\n", "Gap", rejected ? "rejected" : "accepted",
+    recovered ? "succeeded" : "failed", passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Polls the server slower than t1.5, while the client writes and reads long
+ * frames. A slow loop must not turn a correctly timed request into a framing error.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runSlowLoopTest() {
+  uint16_t values [SLOW_COUNT];
+  uint16_t readValues [SLOW_COUNT];
+  uint32_t failed = 0;
+
+  setLine (115200, 0);
+  serverRTU.setBaudRate (115200); // Enable the t1.5 check of the server again
+  pollInterval.store (1000);
+
+  for (uint32_t i = 0; i < 10; i++) {
+    for (size_t j = 0; j < SLOW_COUNT; j++) {
+      values [j] = (uint16_t) (i + j);
+    }
+
+    if ((modbusRTUClient.writeHoldingRegister (SLOW_ADDRESS, SLOW_COUNT, values) == -1) ||
+      (modbusRTUClient.readHoldingRegister (SLOW_ADDRESS, SLOW_COUNT, readValues) == -1) ||
+      (memcmp (values, readValues, sizeof (values)) != 0)) {
+      failed++;
+    }
+  }
+
+  pollInterval.store (0);
+
+  bool passed = (failed == 0);
+
+  printf ("%-8s 1 ms between polls, t1.5 %u us, failed %u  %s\n", "Slow", serverRTU.getInterCharTimeout(), failed, passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Makes requests back to back, and measures the silence between each response
+ * and the next request at the port of the client.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runSilenceTest() {
+  uint16_t readValue = 0;
+  uint32_t failed = 0, shortestGap = 0xFFFFFFFFUL;
+
+  setLine (9600, 0);
+
+  for (uint32_t i = 0; i < 10; i++) {
+    if (modbusRTUClient.readHoldingRegister (REGISTER_ADDRESS, 1, &readValue) == -1) {
+      failed++;
+    }
+
+    // The first request follows the requests of the last test
+    if (i > 0) {
+      shortestGap = std::min (shortestGap, clientPort.getLastGap());
+    }
+  }
+
+  bool passed = (failed == 0) && (shortestGap >= clientRTU.getInterFrameDelay());
+
+  printf ("%-8s shortest silence before a request %u us, t3.5 %u us  %s\n", "Silence", shortestGap, clientRTU.getInterFrameDelay(), passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Reads the test register with the client. Runs in a thread while the main thread
+ * polls the server.
+ *
+ * @param success Set if the read succeeded.
+ * @param done Set when the read has returned.
+ */
+void clientRead (bool* success, std::atomic <bool>* done) {
+  uint16_t readValue = 0;
+
+  *success = (modbusRTUClient.readHoldingRegister (REGISTER_ADDRESS, 1, &readValue) != -1) && (readValue == 0x5A5A);
+  done->store (true);
+}
+
+//===================================================================================//
+/**
+ * @brief Polls the server from this thread while the client reads a register. The
+ * response has to wait for the response delay of 5 ms, and takes about 7 ms on the line.
+ * No call of poll() may take as long as the response delay. The threads share the CPU,
+ * so a call can still take some time.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runPollTest() {
+  std::atomic <bool> done (false);
+  bool success = false;
+  uint32_t longestPoll = 0, transmittingPolls = 0;
+
+  setLine (9600, 0);
+  serverRTU.setResponseDelay (5000);
+
+  std::thread clientThread (clientRead, &success, &done);
+
+  while (!done.load()) {
+    uint32_t pollStart = micros();
+    modbusRTUServer.poll();
+    longestPoll = std::max (longestPoll, micros() - pollStart);
+    transmittingPolls += (modbusRTUServer.getState() == CSE_ModbusRTU_Server::serverState_t:: TRANSMITTING) ? 1 : 0;
+  }
+
+  clientThread.join();
+
+  // The last poll finds that the response has left the port
+  for (uint32_t i = 0; (i < 1000) && (modbusRTUServer.getState() != CSE_ModbusRTU_Server::serverState_t:: IDLE); i++) {
+    modbusRTUServer.poll();
+  }
+
+  serverRTU.setResponseDelay (0);
+
+  bool passed = success && (longestPoll < 5000) && (transmittingPolls > 0) && (modbusRTUServer.getState() == CSE_ModbusRTU_Server::serverState_t:: IDLE);
+
+  printf ("%-8s longest poll %u us, %u polls while transmitting  %s\n", "Polls", longestPoll, transmittingPolls, passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+
+int main (int argc, char* argv[]) {
+  uint32_t unpacedCount = (argc > 1) ? (uint32_t) strtoul (argv [1], NULL, 10) : 1000000UL;
+
+  if (unpacedCount < 2) {
+    unpacedCount = 2;
+  }
+
+  printf ("CSE_ModbusRTU - Loopback Benchmark\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  clientPort.connect (serverPort);
+
+  modbusRTUClient.begin();
+  modbusRTUClient.setServerAddress (0x01);
+  modbusRTUServer.begin();
+  modbusRTUServer.configureHoldingRegisters (0x00, 9);
+  modbusRTUServer.configureHoldingRegisters (SLOW_ADDRESS, SLOW_COUNT);
+  modbusRTUServer.setNonBlocking (true);
+
+  serverRunning.store (true);
+  std::thread serverThread (serverLoop);
+
+  printf ("%-8s %8s %10s %9s %9s %9s %9s %9s %6s\n", "Run", "Count", "Trans/s", "Avg (us)", "Min", "p50", "p99", "Max", "Failed");
+
+  bool passed = true;
+
+  setLine (0, 0);
+  passed &= runTest ("Unpaced", unpacedCount, 0);
+
+  // Request 8 bytes, response 7 bytes (read) or 8 bytes (write), and t3.5 at the server
+  setLine (9600, 0);
+  passed &= runTest ("9600", 20, ((8 + 7) * 10 * 1000000UL) / 9600 + serverRTU.getInterFrameDelay());
+
+  setLine (115200, 1000);
+  passed &= runTest ("USB", 200, 2000);
+
+  passed &= runGapTest();
+
+  passed &= runSlowLoopTest();
+
+  passed &= runSilenceTest();
+
+  serverRunning.store (false);
+  serverThread.join();
+
+  passed &= runPollTest();
+
+  // Only the replies of the server are turnarounds. The client never replies.
+  bool turnaroundOk = (clientRTU.getLastTurnaroundTime() == 0) && (serverRTU.getLastTurnaroundTime() > 0);
+  passed &= turnaroundOk;
+
+  printf ("%-8s client %u us, server %u us  %s\n", "Turn", clientRTU.getLastTurnaroundTime(), serverRTU.getLastTurnaroundTime(), turnaroundOk ? "PASS" : "FAIL");
+
+  printf ("\nOverflows: client %u, server %u\n", clientPort.getOverflowCount(), serverPort.getOverflowCount());
+  printf ("%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
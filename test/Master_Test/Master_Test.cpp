@@ -0,0 +1,463 @@
+
+//===================================================================================//
+/**
+  * @file Master_Test.cpp
+  * @brief Host-side test and benchmark for CSE_ModbusRTU_Master. Each bus is a pair of
+  * CSE_ModbusRTU_LoopbackPort objects paced at 19200 baud, with a server polled from
+  * its own thread. Every server has a different device address, and the master routes
+  * the requests to the buses by the device address.
+  *
+  * For 1, 2, 4 and 8 buses, the requests are run for a fixed time and the aggregate
+  * transaction rate is printed. The transaction time on one bus is fixed by the baud
+  * rate, so the rate must grow with the number of buses. Every value written to a
+  * server is read back and checked. This is done in both the threaded mode, with one
+  * caller thread per bus, and the polled mode, where one thread keeps a job queued on
+  * every bus and calls poll().
+  *
+  * The routing, the exception responses and the failing of queued jobs by end() are
+  * also checked, and that a request after a broadcast waits for the turnaround delay.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host. The
+  * optional argument is the time of each run in milliseconds.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src Master_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o Master_Test
+  *   ./Master_Test 1000
+  *
+  * @date +05:30 08:50:40 PM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "CSE_ModbusRTU_Master.h"
+
+//===================================================================================//
+
+#define   BUS_COUNT             8U  // The maximum number of buses tested
+#define   BAUD_RATE             19200UL
+#define   REGISTER_ADDRESS      0x03  // The holding register used for the test
+#define   BROADCAST_DELAY       50U // The turnaround delay after a broadcast in milliseconds
+
+/**
+ * @brief A bus with a server at the other end.
+ *
+ */
+struct testBus_t {
+  CSE_ModbusRTU_LoopbackPort clientPort;
+  CSE_ModbusRTU_LoopbackPort serverPort;
+  CSE_ModbusRTU clientRTU;
+  CSE_ModbusRTU serverRTU;
+  CSE_ModbusRTU_Server server;
+  std::thread serverThread;
+
+  testBus_t (uint8_t serverAddress) :
+    clientPort (BAUD_RATE), serverPort (BAUD_RATE),
+    clientRTU (&clientPort, 0x00, "clientRTU"), serverRTU (&serverPort, serverAddress, "serverRTU"),
+    server (serverRTU, "server") {
+  }
+};
+
+testBus_t* testBuses [BUS_COUNT];
+std::atomic <bool> serversRunning (false);
+
+//===================================================================================//
+/**
+ * @brief The server thread of a bus.
+ *
+ * @param bus The bus.
+ */
+void serverLoop (testBus_t* bus) {
+  while (serversRunning.load()) {
+    bus->server.poll();
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Creates the buses and starts the servers. The server of bus i has the device
+ * address i + 1.
+ *
+ */
+void setupBuses() {
+  for (uint8_t i = 0; i < BUS_COUNT; i++) {
+    testBus_t* bus = new testBus_t (i + 1);
+
+    bus->clientPort.connect (bus->serverPort);
+
+    CSE_ModbusRTU* nodes[] = { &bus->clientRTU, &bus->serverRTU };
+
+    for (CSE_ModbusRTU* node : nodes) {
+      node->setCharacterBits (10);
+      node->setBaudRate (BAUD_RATE);
+      node->setInterCharTimeout (0);  // The threads can be late on a loaded host. See Loopback_Benchmark.
+    }
+
+    bus->server.begin();
+    bus->server.configureHoldingRegisters (0x00, 9);
+    bus->server.setNonBlocking (true);
+
+    testBuses [i] = bus;
+  }
+
+  serversRunning.store (true);
+
+  for (uint8_t i = 0; i < BUS_COUNT; i++) {
+    testBuses [i]->serverThread = std::thread (serverLoop, testBuses [i]);
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Creates a master with the first busCount buses, and routes the device address
+ * of each server to its bus.
+ *
+ * @param master The master.
+ * @param busCount The number of buses.
+ */
+void addBuses (CSE_ModbusRTU_Master& master, uint8_t busCount) {
+  for (uint8_t i = 0; i < busCount; i++) {
+    int index = master.addBus (testBuses [i]->clientRTU);
+    master.setRoute (i + 1, (uint8_t) index);
+    master.setTimeout ((uint8_t) index, 100);
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief A caller thread of the threaded run. Writes a counting value to the server of
+ * a bus and reads it back, until the time is over.
+ *
+ * @param master The master.
+ * @param serverAddress The device address of the server.
+ * @param duration The time to run in milliseconds.
+ * @param count The number of transactions made.
+ * @param failed The number of transactions that failed or read a wrong value.
+ */
+void callerLoop (CSE_ModbusRTU_Master* master, uint8_t serverAddress, uint32_t duration, uint32_t* count, uint32_t* failed) {
+  uint32_t startTime = millis();
+  uint16_t value = (uint16_t) (serverAddress << 8);
+
+  while ((millis() - startTime) < duration) {
+    uint16_t readValue = 0;
+
+    value++;
+
+    if (master->writeHoldingRegister (MODBUS_RTU_MASTER_BUS_AUTO, serverAddress, REGISTER_ADDRESS, value) != MODBUS_FC_WRITE_SINGLE_REGISTER) {
+      (*failed)++;
+    }
+
+    if ((master->readHoldingRegister (MODBUS_RTU_MASTER_BUS_AUTO, serverAddress, REGISTER_ADDRESS, 1, &readValue) != MODBUS_FC_READ_HOLDING_REGISTERS) || (readValue != value)) {
+      (*failed)++;
+    }
+
+    *count += 2;
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Runs the buses on worker threads, with one caller thread per bus.
+ *
+ * @param busCount The number of buses.
+ * @param duration The time to run in milliseconds.
+ * @param failed Incremented by the number of failed transactions.
+ * @return double - The aggregate transaction rate per second.
+ */
+double runThreaded (uint8_t busCount, uint32_t duration, uint32_t& failed) {
+  CSE_ModbusRTU_Master master ("master");
+  addBuses (master, busCount);
+  master.begin (true);
+
+  std::vector <std::thread> callers;
+  uint32_t counts [BUS_COUNT] = {0};
+  uint32_t failures [BUS_COUNT] = {0};
+  uint32_t startTime = micros();
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    callers.push_back (std::thread (callerLoop, &master, i + 1, duration, &counts [i], &failures [i]));
+  }
+
+  uint32_t total = 0;
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    callers [i].join();
+    total += counts [i];
+    failed += failures [i];
+  }
+
+  uint32_t elapsed = micros() - startTime;
+  master.end();
+
+  return (total * 1000000.0) / elapsed;
+}
+
+//===================================================================================//
+/**
+ * @brief Runs the buses from one thread with poll(). Each bus always has a write or a
+ * read-back job queued.
+ *
+ * @param busCount The number of buses.
+ * @param duration The time to run in milliseconds.
+ * @param failed Incremented by the number of failed transactions.
+ * @return double - The aggregate transaction rate per second.
+ */
+double runPolled (uint8_t busCount, uint32_t duration, uint32_t& failed) {
+  CSE_ModbusRTU_Master master ("master");
+  addBuses (master, busCount);
+  master.begin (false);
+
+  CSE_ModbusRTU_Master::job_t jobs [BUS_COUNT];
+  uint16_t values [BUS_COUNT];
+  bool reading [BUS_COUNT];
+  uint32_t total = 0;
+
+  // Queues the next job of a bus. The write and the read-back alternate.
+  auto queueJob = [&] (uint8_t i) {
+    CSE_ModbusRTU_Master::job_t& job = jobs [i];
+
+    job.bus = MODBUS_RTU_MASTER_BUS_AUTO;
+    job.request.resetLength();
+    job.request.setDeviceAddress (i + 1);
+
+    if (reading [i]) {
+      job.request.setFunctionCode (MODBUS_FC_READ_HOLDING_REGISTERS);
+      job.request.add ((uint16_t) REGISTER_ADDRESS);
+      job.request.add ((uint16_t) 1);
+    }
+    else {
+      values [i]++;
+      job.request.setFunctionCode (MODBUS_FC_WRITE_SINGLE_REGISTER);
+      job.request.add ((uint16_t) REGISTER_ADDRESS);
+      job.request.add ((uint16_t) values [i]);
+    }
+
+    job.request.setCRC();
+    master.submit (job);
+  };
+
+  for (uint8_t i = 0; i < busCount; i++) {
+    values [i] = (uint16_t) ((i + 1) << 12);
+    reading [i] = false;
+    queueJob (i);
+  }
+
+  uint32_t startTime = micros();
+  uint32_t startMillis = millis();
+
+  while ((millis() - startMillis) < duration) {
+    if (master.poll() == 0) {
+      continue;
+    }
+
+    for (uint8_t i = 0; i < busCount; i++) {
+      CSE_ModbusRTU_Master::job_t& job = jobs [i];
+
+      if (!job.done) {
+        continue;
+      }
+
+      if (reading [i]) {
+        if ((job.result != MODBUS_FC_READ_HOLDING_REGISTERS) || (job.response.getWord (MODBUS_RTU_ADU_DATA_INDEX + 1) != values [i])) {
+          failed++;
+        }
+      }
+      else if (job.result != MODBUS_FC_WRITE_SINGLE_REGISTER) {
+        failed++;
+      }
+
+      total++;
+      reading [i] = !reading [i];
+      queueJob (i);
+    }
+  }
+
+  uint32_t elapsed = micros() - startTime;
+
+  // Let the jobs still running complete, so that no response arrives in the next run
+  for (uint8_t i = 0; i < busCount; i++) {
+    master.wait (jobs [i]);
+  }
+
+  master.end();
+
+  return (total * 1000000.0) / elapsed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks the routing, the exception responses and end().
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runFunctionTest() {
+  CSE_ModbusRTU_Master master ("master");
+  addBuses (master, 2);
+
+  bool passed = true;
+  uint16_t readValue = 0;
+
+  // Jobs can not be queued before begin()
+  passed &= (master.writeHoldingRegister (0, 1, REGISTER_ADDRESS, 1) == -1);
+
+  master.begin (true);
+
+  // Explicit bus index, and the route of the device address
+  passed &= (master.writeHoldingRegister (1, 2, REGISTER_ADDRESS, 0x1234) == MODBUS_FC_WRITE_SINGLE_REGISTER);
+  passed &= (master.readHoldingRegister (MODBUS_RTU_MASTER_BUS_AUTO, 2, REGISTER_ADDRESS, 1, &readValue) == MODBUS_FC_READ_HOLDING_REGISTERS) && (readValue == 0x1234);
+
+  // A device address with no route, and a bus that doesn't exist
+  passed &= (master.readHoldingRegister (MODBUS_RTU_MASTER_BUS_AUTO, 9, REGISTER_ADDRESS, 1, &readValue) == -1);
+  passed &= (master.readHoldingRegister (5, 1, REGISTER_ADDRESS, 1, &readValue) == -1);
+
+  // A server on the wrong bus doesn't respond
+  passed &= (master.readHoldingRegister (0, 2, REGISTER_ADDRESS, 1, &readValue) == -1);
+  passed &= (master.getErrorCount (0) == 1);
+
+  // Illegal data value exception for registers that are not present
+  CSE_ModbusRTU_Master::job_t jobs [4];
+
+  jobs [0].bus = 0;
+  jobs [0].request.setDeviceAddress (1);
+  jobs [0].request.setFunctionCode (MODBUS_FC_READ_HOLDING_REGISTERS);
+  jobs [0].request.add ((uint16_t) 0x100);
+  jobs [0].request.add ((uint16_t) 1);
+  jobs [0].request.setCRC();
+
+  passed &= (master.transfer (jobs [0]) == MODBUS_EX_ILLEGAL_DATA_VALUE) && (jobs [0].response.getFunctionCode() == (MODBUS_FC_READ_HOLDING_REGISTERS | 0x80));
+
+  // Jobs still in the queue fail when the master is stopped
+
+  for (uint8_t i = 0; i < 4; i++) {
+    jobs [i].bus = MODBUS_RTU_MASTER_BUS_AUTO;
+    jobs [i].request.resetLength();
+    jobs [i].request.setDeviceAddress (1);
+    jobs [i].request.setFunctionCode (MODBUS_FC_READ_HOLDING_REGISTERS);
+    jobs [i].request.add ((uint16_t) REGISTER_ADDRESS);
+    jobs [i].request.add ((uint16_t) 1);
+    jobs [i].request.setCRC();
+    master.submit (jobs [i]);
+  }
+
+  master.end();
+
+  for (uint8_t i = 0; i < 4; i++) {
+    passed &= jobs [i].done;
+  }
+
+  passed &= (jobs [3].result == -1);
+
+  printf ("%-10s routing, exceptions and end()  %s\n", "Function", passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks that the request after a broadcast waits for the turnaround delay of
+ * the bus, in the threaded and the polled mode.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runBroadcastTest() {
+  bool passed = true;
+  uint32_t shortestGap = 0xFFFFFFFFUL;
+
+  for (uint8_t mode = 0; mode < 2; mode++) {
+    CSE_ModbusRTU_Master master ("master");
+    addBuses (master, 1);
+    passed &= master.setTurnaroundDelay (0, BROADCAST_DELAY);
+    master.begin (mode == 0);
+    passed &= !master.setTurnaroundDelay (0, BROADCAST_DELAY);
+
+    // A broadcast, and a read queued right behind it
+    CSE_ModbusRTU_Master::job_t jobs [2];
+
+    jobs [0].request.setDeviceAddress (0x00);
+    jobs [0].request.setFunctionCode (MODBUS_FC_WRITE_SINGLE_REGISTER);
+    jobs [0].request.add ((uint16_t) REGISTER_ADDRESS);
+    jobs [0].request.add ((uint16_t) 0x5A5A);
+    jobs [0].request.setCRC();
+    jobs [0].bus = 0;
+
+    jobs [1].request.setDeviceAddress (1);
+    jobs [1].request.setFunctionCode (MODBUS_FC_READ_HOLDING_REGISTERS);
+    jobs [1].request.add ((uint16_t) REGISTER_ADDRESS);
+    jobs [1].request.add ((uint16_t) 1);
+    jobs [1].request.setCRC();
+
+    passed &= master.submit (jobs [0]) && master.submit (jobs [1]);
+    passed &= (master.wait (jobs [0]) == MODBUS_FC_WRITE_SINGLE_REGISTER);
+    passed &= (master.wait (jobs [1]) == MODBUS_FC_READ_HOLDING_REGISTERS);
+
+    uint32_t gap = jobs [1].startTime - jobs [0].endTime;
+    shortestGap = (gap < shortestGap) ? gap : shortestGap;
+
+    master.end();
+  }
+
+  // millis() can tick just after the broadcast ends
+  passed &= (shortestGap >= ((BROADCAST_DELAY - 1) * 1000UL));
+
+  printf ("%-10s turnaround delay %3u ms        %s\n", "Broadcast", shortestGap / 1000, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+
+int main (int argc, char* argv[]) {
+  uint32_t duration = (argc > 1) ? (uint32_t) strtoul (argv [1], NULL, 10) : 1000UL;
+
+  printf ("CSE_ModbusRTU - Master Test\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  setupBuses();
+
+  bool passed = runFunctionTest();
+  passed &= runBroadcastTest();
+
+  printf ("\n%-10s %6s %10s %8s %7s\n", "Mode", "Buses", "Trans/s", "Scaling", "Failed");
+
+  const char* modes[] = { "Threaded", "Polled" };
+
+  for (uint8_t mode = 0; mode < 2; mode++) {
+    double singleRate = 0;
+
+    for (uint8_t busCount = 1; busCount <= BUS_COUNT; busCount *= 2) {
+      uint32_t failed = 0;
+      double rate = (mode == 0) ? runThreaded (busCount, duration, failed) : runPolled (busCount, duration, failed);
+
+      if (busCount == 1) {
+        singleRate = rate;
+      }
+
+      double scaling = rate / singleRate;
+
+      // Allow for the time lost to the scheduling of the threads on a loaded host
+      bool runPassed = (failed == 0) && (scaling >= (busCount * 0.7));
+      passed &= runPassed;
+
+      printf ("%-10s %6u %10.0f %7.2fx %7u  %s\n", modes [mode], busCount, rate, scaling, failed, runPassed ? "PASS" : "FAIL");
+    }
+  }
+
+  serversRunning.store (false);
+
+  for (uint8_t i = 0; i < BUS_COUNT; i++) {
+    testBuses [i]->serverThread.join();
+  }
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
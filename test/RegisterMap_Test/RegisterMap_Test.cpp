@@ -0,0 +1,834 @@
+
+//===================================================================================//
+/**
+  * @file RegisterMap_Test.cpp
+  * @brief Host-side test for the range-block data tables of the CSE_ModbusRTU server.
+  *
+  *   - Map : Checks how CSE_ModbusRTU_RegisterMap adds, merges and rejects ranges, and
+  *     that find() only succeeds for ranges with no gap.
+  *   - Lookup : Builds a map of 1000 scattered blocks and measures the time of find()
+  *     against a linear search over one entry per address, which is how the server
+  *     stored its data before. The block lookup must be faster.
+  *   - Bits : Runs random set, write and read operations on a CSE_ModbusRTU_BitMap
+  *     with blocks of odd lengths, and compares the results with a plain array. Every
+  *     bit offset is covered. Then measures the time of reading 2000 packed coils, and
+  *     compares it with packing them from one byte per coil.
+  *   - Arena : Stores the values of the maps in static arrays. Ranges added in order of
+  *     address must use the arena without any waste, a map must cover all the 65536
+  *     addresses, and the memory used must depend only on the number of addresses and
+  *     blocks, not on where they are.
+  *   - Server : Connects a client and a server with a loopback port pair. The holding
+  *     registers and coils are configured with two adjacent calls each. Requests that
+  *     cross the boundary must succeed, and requests that touch a missing address must
+  *     be answered with an exception. The input registers cover the whole address
+  *     space, and are stored in a static array. Register providers must be called
+  *     once per request, with only the part of their range that is read, and must be
+  *     able to write the registers themselves. The ranges written by the client must
+  *     be reported once, merged across the two configured ranges, and the writes of
+  *     the server must not be reported.
+  *   - Static : Replaces the holding registers and coils of the server with maps laid
+  *     out at compile time. The initial values must be set when they are attached, the
+  *     requests must work as on the other maps, and client writes to the read-only
+  *     ranges must be rejected.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src RegisterMap_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o RegisterMap_Test
+  *   ./RegisterMap_Test
+  *
+  * @date +05:30 11:19:52 PM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "CSE_ModbusRTU.h"
+
+//===================================================================================//
+
+#define   BLOCK_COUNT           1000U // Blocks in the lookup test
+#define   BLOCK_LENGTH          8U  // Addresses in each block
+#define   BLOCK_STRIDE          64U // Distance between the starting addresses of two blocks
+#define   LOOKUP_COUNT          1000000UL
+#define   BIT_OPERATION_COUNT   200000UL
+#define   BIT_READ_COUNT        100000UL
+#define   ARENA_SIZE            (0x10000UL * 2) // Bytes for one value of 16 bits for every address
+
+CSE_ModbusRTU_LoopbackPort clientPort;
+CSE_ModbusRTU_LoopbackPort serverPort;
+
+CSE_ModbusRTU clientRTU (&clientPort, 0x00, "clientRTU");
+CSE_ModbusRTU serverRTU (&serverPort, 0x01, "serverRTU");
+
+CSE_ModbusRTU_Client modbusRTUClient (clientRTU, "modbusRTUClient");
+CSE_ModbusRTU_Server modbusRTUServer (serverRTU, "modbusRTUServer");
+
+std::atomic <bool> serverRunning (false);
+
+// The arenas of the maps. The input registers of the server use the last one. They are
+// aligned so that no bytes are skipped at the start.
+alignas (MODBUS_RTU_MAP_ALIGNMENT) uint16_t registerArena [ARENA_SIZE / 2];
+alignas (MODBUS_RTU_MAP_ALIGNMENT) uint8_t bitArena [0x10000UL / 8];
+alignas (MODBUS_RTU_MAP_ALIGNMENT) uint16_t inputRegisterArena [ARENA_SIZE / 2];
+
+// The static maps of the last test. The holding registers have a read-only range with
+// an initial value, and the changes of the writable range are tracked.
+CSE_ModbusRTU_StaticRegisterMap <
+  CSE_ModbusRTU_Range <0x0000, 16>,
+  CSE_ModbusRTU_Range <0x0100, 4, 0x1234, MODBUS_RTU_BLOCK_READ_ONLY>
+> staticHoldingRegisters;
+
+CSE_ModbusRTU_StaticBitMap <
+  CSE_ModbusRTU_Range <0x0000, 16>
+> staticChangedHoldingRegisters;
+
+CSE_ModbusRTU_StaticBitMap <
+  CSE_ModbusRTU_Range <0x0003, 13, 1>,
+  CSE_ModbusRTU_Range <0x0040, 8, 0, MODBUS_RTU_BLOCK_READ_ONLY>
+> staticCoils;
+
+static_assert (decltype (staticHoldingRegisters)::valueCount == 20, "The static map must have 20 registers.");
+static_assert (decltype (staticCoils)::byteCount == 3, "Each range of a static bit map must start on a byte.");
+
+// One entry per address, as the server stored its data before the register map
+struct entry_t {
+  uint16_t address;
+  uint16_t value;
+};
+
+//===================================================================================//
+/**
+ * @brief Prints the result of a check.
+ *
+ * @param name The name of the check.
+ * @param passed The result.
+ * @return bool - The result.
+ */
+bool check (const char* name, bool passed) {
+  printf ("  %-52s %s\n", name, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks adding, merging and finding ranges.
+ *
+ * @return true - All the checks passed.
+ */
+bool runMapTest() {
+  CSE_ModbusRTU_RegisterMap <uint16_t> map;
+  bool passed = true;
+
+  printf ("Map\n");
+
+  passed &= check ("add separate ranges", map.add (100, 10) && map.add (0, 10) && map.add (200, 10) && (map.getBlockCount() == 3));
+  passed &= check ("reject overlapping ranges", !map.add (105, 10) && !map.add (95, 6) && !map.add (0, 1) && (map.size() == 30));
+  passed &= check ("reject empty and too long ranges", !map.add (300, 0) && !map.add (0xFFF0, 0x11));
+  passed &= check ("merge with the previous block", map.add (10, 5) && (map.getBlockCount() == 3));
+  passed &= check ("merge with the next block", map.add (190, 10) && (map.getBlockCount() == 3) && (map.getBlock (2)->address == 190));
+  passed &= check ("merge with both blocks", map.add (110, 80) && (map.getBlockCount() == 2) && (map.size() == 125));
+  passed &= check ("add the last address", map.add (0xFFFF, 1) && (map.find (0xFFFF) != NULL));
+
+  // Write the address to every value and read the values back through find()
+  for (uint16_t address = 0; address < 15; address++) {
+    *map.find (address) = address;
+  }
+
+  for (uint16_t address = 100; address < 210; address++) {
+    *map.find (address) = address;
+  }
+
+  uint16_t* values = map.find (100, 110);
+  bool valuesMatch = (values != NULL);
+
+  for (uint16_t i = 0; valuesMatch && (i < 110); i++) {
+    valuesMatch = (values [i] == (100 + i));
+  }
+
+  passed &= check ("find a range across merged blocks", valuesMatch);
+  passed &= check ("reject ranges with a gap", (map.find (10, 6) == NULL) && (map.find (99, 2) == NULL) && (map.find (205, 6) == NULL));
+  passed &= check ("reject missing addresses", (map.find (15) == NULL) && (map.find (50) == NULL) && (map.find (0xFFFE) == NULL));
+  passed &= check ("reject empty ranges", map.find (100, 0) == NULL);
+
+  // Remove ranges from the middle, the start and the end of a block, and a whole block
+  bool removeOk = map.remove (150, 10) && (map.getBlockCount() == 4) && (*map.find (160) == 160) && (map.find (150) == NULL);
+  removeOk = removeOk && map.remove (100, 5) && (map.getBlock (1)->address == 105) && (*map.find (105) == 105) && (*map.find (149) == 149);
+  removeOk = removeOk && map.remove (200, 10) && (map.getBlock (2)->length == 40) && (*map.find (199) == 199);
+  removeOk = removeOk && map.remove (0xFFFF, 1) && (map.getBlockCount() == 3) && (map.size() == 100);
+  passed &= check ("remove ranges and split blocks", removeOk);
+  passed &= check ("reject removing missing addresses", !map.remove (150, 1) && !map.remove (145, 10) && !map.remove (20, 0) && (map.size() == 100));
+
+  map.clear();
+  passed &= check ("clear", (map.size() == 0) && (map.getBlockCount() == 0) && (map.find (100) == NULL));
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Compares the lookup time of the register map with a linear search.
+ *
+ * @return true - The register map is faster and finds the same values.
+ */
+bool runLookupTest() {
+  CSE_ModbusRTU_RegisterMap <uint16_t> map;
+  std::vector <entry_t> entries;
+
+  printf ("\nLookup (%u blocks of %u registers)\n", BLOCK_COUNT, BLOCK_LENGTH);
+
+  for (uint32_t i = 0; i < BLOCK_COUNT; i++) {
+    uint16_t start = i * BLOCK_STRIDE;
+    map.add (start, BLOCK_LENGTH);
+
+    for (uint16_t j = 0; j < BLOCK_LENGTH; j++) {
+      *map.find (start + j) = start + j;
+      entries.push_back ({ (uint16_t) (start + j), (uint16_t) (start + j) });
+    }
+  }
+
+  // A simple pseudo-random sequence of present addresses
+  uint32_t seed = 1;
+  uint32_t mapSum = 0;
+  uint32_t linearSum = 0;
+
+  auto startTime = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < LOOKUP_COUNT; i++) {
+    seed = seed * 1103515245UL + 12345UL;
+    uint16_t address = ((seed >> 8) % BLOCK_COUNT) * BLOCK_STRIDE + (seed % BLOCK_LENGTH);
+    uint16_t* value = map.find (address);
+    mapSum += (value != NULL) ? *value : 0;
+  }
+
+  double mapTime = std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now() - startTime).count() / LOOKUP_COUNT;
+
+  // The linear search is much slower, so fewer lookups are made
+  uint32_t linearCount = LOOKUP_COUNT / 100;
+  seed = 1;
+  uint32_t mapCheckSum = 0;
+  startTime = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < linearCount; i++) {
+    seed = seed * 1103515245UL + 12345UL;
+    uint16_t address = ((seed >> 8) % BLOCK_COUNT) * BLOCK_STRIDE + (seed % BLOCK_LENGTH);
+    mapCheckSum += address;
+
+    for (size_t k = 0; k < entries.size(); k++) {
+      if (entries [k].address == address) {
+        linearSum += entries [k].value;
+        break;
+      }
+    }
+  }
+
+  double linearTime = std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now() - startTime).count() / linearCount;
+
+  printf ("  %-20s %10.1f ns per lookup\n", "Register map", mapTime);
+  printf ("  %-20s %10.1f ns per lookup\n", "Linear search", linearTime);
+
+  bool passed = (mapSum != 0) && (linearSum == mapCheckSum) && (mapTime < linearTime);
+  return check ("register map is faster than the linear search", passed);
+}
+
+//===================================================================================//
+/**
+ * @brief Returns a pseudo-random number.
+ *
+ * @return uint32_t
+ */
+uint32_t randomNumber() {
+  static uint32_t seed = 12345;
+  seed = seed * 1103515245UL + 12345UL;
+  return seed >> 8;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks the packed bit map against a plain array, and measures the time of
+ * reading a full request of coils.
+ *
+ * @return true - All the checks passed.
+ */
+bool runBitMapTest() {
+  CSE_ModbusRTU_BitMap map;
+  std::vector <int> reference (0x10000, -1); // -1 if the address is not present
+  bool passed = true;
+
+  printf ("\nBits\n");
+
+  // Blocks of odd lengths, added out of order so that they merge from both sides
+  const uint16_t ranges [][2] = { { 100, 13 }, { 150, 7 }, { 113, 37 }, { 157, 3000 }, { 61, 39 }, { 4000, 1 }, { 4002, 2500 }, { 4001, 1 } };
+  bool addOk = true;
+
+  for (auto& range : ranges) {
+    addOk = addOk && map.add (range [0], range [1]);
+
+    for (uint16_t i = 0; i < range [1]; i++) {
+      reference [range [0] + i] = 0;
+    }
+  }
+
+  passed &= check ("add and merge blocks of odd lengths", addOk && (map.getBlockCount() == 2) && (map.size() == 5598) && !map.add (3156, 2));
+
+  uint32_t mismatches = 0;
+  uint8_t data [256];
+  uint8_t expected [256];
+
+  for (uint32_t n = 0; n < BIT_OPERATION_COUNT; n++) {
+    uint16_t address = (randomNumber() % 7000);
+    uint16_t count = 1 + (randomNumber() % 2000);
+    bool present = ((uint32_t) address + count) <= 0x10000UL;
+
+    for (uint16_t i = 0; present && (i < count); i++) {
+      present = (reference [address + i] != -1);
+    }
+
+    memset (expected, 0, sizeof (expected));
+
+    switch (randomNumber() % 3) {
+      case 0: {
+        uint8_t value = randomNumber() & 0x01;
+
+        if (map.setBit (address, value, count) != present) {
+          mismatches++;
+        }
+
+        for (uint16_t i = 0; present && (i < count); i++) {
+          reference [address + i] = value;
+        }
+        break;
+      }
+
+      case 1: {
+        for (uint16_t i = 0; i < sizeof (data); i++) {
+          data [i] = randomNumber();
+        }
+
+        if (map.write (address, count, data) != present) {
+          mismatches++;
+        }
+
+        for (uint16_t i = 0; present && (i < count); i++) {
+          reference [address + i] = (data [i / 8] >> (i % 8)) & 0x01;
+        }
+        break;
+      }
+
+      case 2: {
+        memset (data, 0xAA, sizeof (data));
+
+        if (map.read (address, count, data) != present) {
+          mismatches++;
+        }
+
+        for (uint16_t i = 0; present && (i < count); i++) {
+          expected [i / 8] |= reference [address + i] << (i % 8);
+        }
+
+        // The unused bits of the last byte must be 0
+        if (present && (memcmp (data, expected, (count + 7) / 8) != 0)) {
+          mismatches++;
+        }
+        break;
+      }
+    }
+  }
+
+  for (uint32_t address = 0; address < 0x10000UL; address++) {
+    if (map.getBit (address) != reference [address]) {
+      mismatches++;
+    }
+  }
+
+  passed &= check ("random set, write and read match the array", mismatches == 0);
+
+  // Set all the bits, and check that the unused bits of the last bytes stay 0
+  uint16_t setAddress = 0, setCount = 0;
+  map.setAll (1);
+  bool setAllOk = map.findSet (setAddress, setCount) && (setAddress == 61) && (setCount == 3096);
+
+  for (size_t i = 0; i < map.getBlockCount(); i++) {
+    CSE_ModbusRTU_BitMap::block_t* block = map.getBlock (i);
+
+    if ((block->length % 8) != 0) {
+      setAllOk = setAllOk && ((block->bits [block->length / 8] >> (block->length % 8)) == 0);
+    }
+  }
+
+  map.setAll (0);
+  passed &= check ("set and clear all the bits", setAllOk && !map.findSet (setAddress, setCount));
+
+  // Remove ranges from the start, the middle and the end of a block
+  for (uint32_t address = 4000; address < 6502; address++) {
+    map.setBit (address, (address % 3) == 0);
+  }
+
+  bool removeOk = map.remove (4000, 3) && map.remove (5001, 10) && map.remove (6490, 12) && !map.remove (5005, 1) && !map.remove (3990, 20);
+  removeOk = removeOk && (map.getBlockCount() == 3) && (map.size() == (5598 - 25));
+
+  for (uint32_t address = 3990; removeOk && (address < 6510); address++) {
+    bool present = (address >= 4003) && (address < 6490) && ((address < 5001) || (address >= 5011));
+    removeOk = (map.getBit (address) == (present ? ((address % 3) == 0) : -1));
+  }
+
+  for (size_t i = 0; removeOk && (i < map.getBlockCount()); i++) {
+    CSE_ModbusRTU_BitMap::block_t* block = map.getBlock (i);
+    removeOk = ((block->length % 8) == 0) || ((block->bits [block->length / 8] >> (block->length % 8)) == 0);
+  }
+
+  passed &= check ("remove bits and split blocks", removeOk);
+
+  // Time the read of 2000 coils at every bit offset, against packing one byte per coil
+  std::vector <uint8_t> unpacked (4000);
+  uint32_t checkSum = 0;
+
+  for (uint16_t i = 0; i < unpacked.size(); i++) {
+    unpacked [i] = map.getBit (157 + i);
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
+
+  for (uint32_t n = 0; n < BIT_READ_COUNT; n++) {
+    map.read (157 + (n % 8), 2000, data);
+    checkSum += data [n % 250];
+  }
+
+  double packedTime = std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now() - startTime).count() / BIT_READ_COUNT;
+  startTime = std::chrono::steady_clock::now();
+
+  for (uint32_t n = 0; n < BIT_READ_COUNT; n++) {
+    memset (expected, 0, 250);
+
+    for (uint16_t j = 0; j < 2000; j++) {
+      if (unpacked [(n % 8) + j] != 0) {
+        expected [j / 8] |= (1U << (j % 8));
+      }
+    }
+
+    checkSum -= expected [n % 250];
+  }
+
+  double unpackedTime = std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now() - startTime).count() / BIT_READ_COUNT;
+
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < map.getBlockCount(); i++) {
+    bytes += (map.getBlock (i)->length + 7) / 8;
+  }
+
+  printf ("  %-20s %10.1f ns per 2000 coils, %u bytes for %u coils\n", "Packed", packedTime, (unsigned) bytes, (unsigned) map.size());
+  printf ("  %-20s %10.1f ns per 2000 coils, %u bytes for %u coils\n", "One byte per coil", unpackedTime, (unsigned) map.size(), (unsigned) map.size());
+
+  passed &= check ("packed read is faster and gives the same bits", (checkSum == 0) && (packedTime < unpackedTime));
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Stores the maps in arenas, and checks the memory used by them.
+ *
+ * @return true - All the checks passed.
+ */
+bool runArenaTest() {
+  bool passed = true;
+
+  printf ("\nArena\n");
+
+  // Scattered blocks added in order of address take exactly their size from the arena
+  CSE_ModbusRTU_RegisterMap <uint16_t> map;
+  passed &= check ("set an arena", map.setArena (registerArena, BLOCK_COUNT * BLOCK_LENGTH * 2));
+
+  bool added = true;
+
+  for (uint32_t i = 0; added && (i < BLOCK_COUNT); i++) {
+    added = map.add (i * BLOCK_STRIDE, BLOCK_LENGTH);
+  }
+
+  passed &= check ("add ranges in order without waste", added && (map.getBlockCount() == BLOCK_COUNT));
+  passed &= check ("reject a range when the arena is full", !map.add (0xFF00, 1) && (map.size() == (BLOCK_COUNT * BLOCK_LENGTH)) && !map.isPresent (0xFF00));
+  passed &= check ("reject an arena when not empty", !map.setArena (registerArena, ARENA_SIZE));
+
+  // The memory depends on the number of addresses and blocks, not on the addresses
+  size_t scatteredUsage = map.getMemoryUsage();
+
+  map.clear();
+  map.setArena (registerArena, ARENA_SIZE);
+
+  for (uint32_t i = 0; i < BLOCK_COUNT; i++) {
+    map.add (i * BLOCK_LENGTH * 2, BLOCK_LENGTH);
+  }
+
+  passed &= check ("memory does not depend on the addresses", map.getMemoryUsage() == scatteredUsage);
+
+  printf ("  %u bytes for %u registers in %u blocks\n", (unsigned) scatteredUsage, (unsigned) map.size(), (unsigned) map.getBlockCount());
+
+  // The whole address space. The quantity is 16-bit, so two ranges are needed.
+  map.clear();
+
+  CSE_ModbusRTU_RegisterMap <uint16_t> fullMap;
+  fullMap.reserve (1);
+  fullMap.setArena (registerArena, ARENA_SIZE);
+
+  passed &= check ("add all the 65536 registers", fullMap.add (0, 0x8000) && fullMap.add (0x8000, 0x8000) && (fullMap.size() == 0x10000UL) && (fullMap.getBlockCount() == 1));
+
+  uint16_t* values = fullMap.find (0x7FF0, 0x20);
+  bool valuesOk = (values != NULL) && (fullMap.find (0xFFFF) != NULL) && (fullMap.getMemoryUsage() == (ARENA_SIZE + sizeof (*fullMap.getBlock (0))));
+
+  if (valuesOk) {
+    values [0x0F] = 0x1234;
+    values [0x10] = 0x5678;
+    valuesOk = (registerArena [0x7FFF] == 0x1234) && (registerArena [0x8000] == 0x5678);
+  }
+
+  passed &= check ("registers are stored in the arena", valuesOk);
+
+  // The whole address space of bits, in an arena of exactly 8 KiB
+  CSE_ModbusRTU_BitMap bits;
+  bits.setArena (bitArena, sizeof (bitArena));
+
+  bool bitsOk = bits.add (0, 0x7FFF) && bits.add (0x7FFF, 1) && bits.add (0x8000, 0x8000) && (bits.getBlockCount() == 1) && (bits.size() == 0x10000UL);
+  bitsOk = bitsOk && bits.setBit (0x7FFE, 1, 3) && (bits.getBit (0x7FFD) == 0) && (bits.getBit (0x8000) == 1) && (bits.getBit (0xFFFF) == 0);
+
+  passed &= check ("add all the 65536 coils", bitsOk);
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief The server thread. Polls the server until serverRunning is cleared.
+ *
+ */
+void serverLoop() {
+  while (serverRunning.load()) {
+    modbusRTUServer.poll();
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief A register provider. Saves the range it was called with, and sets each value
+ * to its address plus the context.
+ *
+ */
+uint32_t providerCalls = 0;
+uint16_t providerAddress = 0;
+uint16_t providerCount = 0;
+
+void registerProvider (uint16_t address, uint16_t count, uint16_t* values, void* context) {
+  providerCalls++;
+  providerAddress = address;
+  providerCount = count;
+
+  for (uint16_t i = 0; i < count; i++) {
+    values [i] = address + i + *(uint16_t*) context;
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief A register provider that also writes an input register of the server, which
+ * takes the lock of the table.
+ *
+ * @param address The first address that is read.
+ * @param count The number of registers that are read.
+ * @param values The values to compute.
+ * @param context Not used.
+ */
+void writingProvider (uint16_t address, uint16_t count, uint16_t* values, void* context) {
+  modbusRTUServer.writeInputRegister (0x0300, address);
+
+  for (uint16_t i = 0; i < count; i++) {
+    values [i] = 0x4000 + i;
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Runs requests through a client and a server connected with a loopback pair.
+ *
+ * @return true - All the checks passed.
+ */
+bool runServerTest() {
+  bool passed = true;
+
+  printf ("\nServer\n");
+
+  clientPort.connect (serverPort);
+
+  CSE_ModbusRTU* nodes[] = { &clientRTU, &serverRTU };
+
+  for (CSE_ModbusRTU* node : nodes) {
+    node->setBaudRate (100000000UL);
+    node->setInterCharTimeout (0);
+    node->setInterFrameDelay (20);
+  }
+
+  modbusRTUClient.begin();
+  modbusRTUClient.setServerAddress (0x01);
+  modbusRTUServer.begin();
+  modbusRTUServer.setNonBlocking (true);
+
+  // Two adjacent ranges of each table, and a separate range after a gap
+  passed &= check ("configure holding registers", modbusRTUServer.configureHoldingRegisters (0x1000, 40) && modbusRTUServer.configureHoldingRegisters (0x1028, 45) && modbusRTUServer.configureHoldingRegisters (0x2000, 2));
+  passed &= check ("configure coils", modbusRTUServer.configureCoils (0x0010, 20) && modbusRTUServer.configureCoils (0x0024, 20));
+  passed &= check ("reject overlapping configuration", !modbusRTUServer.configureHoldingRegisters (0x1050, 2));
+
+  // All the input registers, stored in a static array
+  bool inputsOk = modbusRTUServer.inputRegisters.setArena (inputRegisterArena, sizeof (inputRegisterArena));
+  inputsOk = inputsOk && modbusRTUServer.configureInputRegisters (0, 0x8000) && modbusRTUServer.configureInputRegisters (0x8000, 0x8000);
+  passed &= check ("configure 65536 input registers", inputsOk && !modbusRTUServer.configureInputRegisters (0, 1));
+
+  serverRunning.store (true);
+  std::thread serverThread (serverLoop);
+
+  uint16_t registers [85];
+
+  for (uint16_t i = 0; i < 80; i++) {
+    registers [i] = 0xA000 + i;
+  }
+
+  // Write 80 registers across the boundary of the two ranges, and read all 85 back
+  bool writeOk = (modbusRTUClient.writeHoldingRegister (0x1002, 80, registers) == MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+  passed &= check ("write multiple registers across ranges", writeOk && (modbusRTUServer.readHoldingRegister (0x1002) == 0xA000) && (modbusRTUServer.readHoldingRegister (0x1051) == (0xA000 + 79)));
+
+  bool readOk = (modbusRTUClient.readHoldingRegister (0x1000, 85, registers) == MODBUS_FC_READ_HOLDING_REGISTERS);
+
+  for (uint16_t i = 0; readOk && (i < 85); i++) {
+    uint16_t expected = ((i >= 2) && (i < 82)) ? (0xA000 + i - 2) : 0;
+    readOk = (registers [i] == expected);
+  }
+
+  passed &= check ("read 85 registers across ranges", readOk);
+  passed &= check ("reject a read with a gap", (modbusRTUClient.readHoldingRegister (0x1052, 4, registers) != -1) && (modbusRTUClient.response.getExceptionCode() == MODBUS_EX_ILLEGAL_DATA_VALUE));
+  passed &= check ("reject a write to a missing register", modbusRTUClient.writeHoldingRegister (0x2002, 0x1234) == MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+  passed &= check ("write a single register", (modbusRTUClient.writeHoldingRegister (0x2001, 0x1234) != -1) && (modbusRTUServer.readHoldingRegister (0x2001) == 0x1234));
+
+  // The last input registers of the address space
+  modbusRTUServer.writeInputRegister (0xFFF0, 0x0000, 16);
+  modbusRTUServer.writeInputRegister (0xFFFF, 0xBEEF);
+  registers [15] = 0;
+
+  bool inputReadOk = (modbusRTUClient.readInputRegister (0xFFF0, 16, registers) == MODBUS_FC_READ_INPUT_REGISTERS);
+  passed &= check ("read the last input registers", inputReadOk && (registers [0] == 0) && (registers [15] == 0xBEEF) && (inputRegisterArena [0xFFFF] == 0xBEEF));
+
+  // Coils across the boundary of the two ranges
+  uint8_t coilValues [40];
+
+  for (uint8_t i = 0; i < 40; i++) {
+    coilValues [i] = (i % 3) == 0;
+  }
+
+  bool coilsOk = (modbusRTUClient.writeCoil (0x0010, 40, coilValues) != -1);
+
+  for (uint8_t i = 0; i < 40; i++) {
+    coilValues [i] = 0xFF;
+  }
+
+  coilsOk = coilsOk && (modbusRTUClient.readCoil (0x0010, 40, coilValues) != -1);
+
+  for (uint8_t i = 0; coilsOk && (i < 40); i++) {
+    coilsOk = (coilValues [i] == ((i % 3) == 0)) && (modbusRTUServer.readCoil (0x0010 + i) == coilValues [i]);
+  }
+
+  passed &= check ("write and read 40 coils across ranges", coilsOk);
+
+  // The write single requests are answered by sending the request back
+  bool echoOk = (modbusRTUClient.writeCoil (0x0011, (uint16_t) 0x0001) == MODBUS_FC_WRITE_SINGLE_COIL) && (modbusRTUServer.readCoil (0x0011) == 1);
+  echoOk = echoOk && (modbusRTUClient.response.getLength() == 8) && (memcmp (modbusRTUClient.response.getBuffer(), modbusRTUClient.request.getBuffer(), 8) == 0);
+  passed &= check ("write a single coil and get the request back", echoOk);
+
+  // A write multiple coils request whose byte count does not match the quantity, or
+  // whose data is shorter than the byte count, must not change the coils
+  uint8_t coilBytes [5] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  bool byteCountOk = true;
+
+  for (uint8_t byteCount = 4; byteCount <= 5; byteCount++) {
+    modbusRTUClient.request.resetLength();
+    modbusRTUClient.request.setDeviceAddress (0x01);
+    modbusRTUClient.request.setFunctionCode (MODBUS_FC_WRITE_MULTIPLE_COILS);
+    modbusRTUClient.request.add ((uint16_t) 0x0010);
+    modbusRTUClient.request.add ((uint16_t) 40);
+    modbusRTUClient.request.add (byteCount);
+    modbusRTUClient.request.add (coilBytes, 4);
+    modbusRTUClient.request.setCRC();
+
+    byteCountOk = byteCountOk && (modbusRTUClient.transfer() == MODBUS_EX_ILLEGAL_DATA_VALUE);
+  }
+
+  for (uint8_t i = 0; byteCountOk && (i < 40); i++) {
+    byteCountOk = (modbusRTUServer.readCoil (0x0010 + i) == (((i % 3) == 0) || (i == 1)));
+  }
+
+  passed &= check ("reject coil writes with a wrong byte count", byteCountOk);
+
+  // Only the writes of the client are marked as changed, and each range is read once
+  uint16_t changedAddress = 0, changedCount = 0;
+  modbusRTUServer.writeHoldingRegister (0x1000, 0x5555);
+  bool changesOk = modbusRTUServer.readChangedHoldingRegisters (changedAddress, changedCount) && (changedAddress == 0x1002) && (changedCount == 80);
+  changesOk = changesOk && modbusRTUServer.readChangedHoldingRegisters (changedAddress, changedCount) && (changedAddress == 0x2001) && (changedCount == 1);
+  changesOk = changesOk && !modbusRTUServer.readChangedHoldingRegisters (changedAddress, changedCount);
+  changesOk = changesOk && modbusRTUServer.readChangedCoils (changedAddress, changedCount) && (changedAddress == 0x0010) && (changedCount == 40);
+  changesOk = changesOk && !modbusRTUServer.readChangedCoils (changedAddress, changedCount);
+  passed &= check ("read the ranges changed by the client", changesOk);
+
+  changesOk = (modbusRTUClient.writeCoil (0x0024, (uint16_t) 0x0000) == MODBUS_FC_WRITE_SINGLE_COIL);
+  changesOk = changesOk && (modbusRTUClient.writeHoldingRegister (0x1030, 0x1234) == MODBUS_FC_WRITE_SINGLE_REGISTER);
+  changesOk = changesOk && modbusRTUServer.readChangedCoils (changedAddress, changedCount) && (changedAddress == 0x0024) && (changedCount == 1);
+  modbusRTUServer.clearChanges();
+  changesOk = changesOk && !modbusRTUServer.readChangedHoldingRegisters (changedAddress, changedCount);
+  passed &= check ("clear the changes", changesOk);
+  passed &= check ("reject a coil read with a missing address", modbusRTUClient.readCoil (0x0030, 10, coilValues) == MODBUS_EX_ILLEGAL_DATA_VALUE);
+
+  // Providers are called once per request, with the part of their range that is read
+  uint16_t offset = 0x8000;
+  bool providerOk = modbusRTUServer.addInputRegisterProvider (0x0100, 10, registerProvider, &offset);
+  providerOk = providerOk && !modbusRTUServer.addInputRegisterProvider (0x0109, 2, registerProvider, &offset);
+  providerOk = providerOk && !modbusRTUServer.addHoldingRegisterProvider (0x2001, 2, registerProvider, &offset);
+  passed &= check ("add and reject register providers", providerOk && modbusRTUServer.addHoldingRegisterProvider (0x2000, 2, registerProvider, &offset));
+
+  providerOk = (modbusRTUClient.readInputRegister (0x00FC, 10, registers) == MODBUS_FC_READ_INPUT_REGISTERS);
+  providerOk = providerOk && (providerCalls == 1) && (providerAddress == 0x0100) && (providerCount == 6);
+
+  for (uint16_t i = 0; providerOk && (i < 10); i++) {
+    providerOk = (registers [i] == ((i < 4) ? 0 : (0x8000 + 0x00FC + i)));
+  }
+
+  providerOk = providerOk && (modbusRTUClient.readInputRegister (0x0200, 4, registers) == MODBUS_FC_READ_INPUT_REGISTERS) && (providerCalls == 1);
+  offset = 0x1000;
+  providerOk = providerOk && (modbusRTUClient.readHoldingRegister (0x2000, 2, registers) == MODBUS_FC_READ_HOLDING_REGISTERS) && (providerCalls == 2) && (registers [1] == 0x3001);
+  passed &= check ("providers compute the values read", providerOk);
+
+  modbusRTUServer.clearProviders();
+
+  // A provider is called without the lock of the table, so it can write the registers
+  providerOk = modbusRTUServer.addInputRegisterProvider (0x0200, 4, writingProvider);
+  providerOk = providerOk && (modbusRTUClient.readInputRegister (0x0200, 4, registers) == MODBUS_FC_READ_INPUT_REGISTERS);
+  providerOk = providerOk && (registers [0] == 0x4000) && (registers [3] == 0x4003);
+  providerOk = providerOk && (modbusRTUClient.readInputRegister (0x0300, 1, registers) == MODBUS_FC_READ_INPUT_REGISTERS) && (registers [0] == 0x0200);
+  passed &= check ("providers can write the registers", providerOk);
+
+  modbusRTUServer.clearProviders();
+
+  serverRunning.store (false);
+  serverThread.join();
+
+  // The change flags of a second server only have room for 64 addresses. A range that
+  // does not fit must not stay configured.
+  CSE_ModbusRTU_Server smallServer (serverRTU, "smallServer");
+  alignas (MODBUS_RTU_MAP_ALIGNMENT) static uint8_t changedRegisterArena [8];
+  alignas (MODBUS_RTU_MAP_ALIGNMENT) static uint8_t changedCoilArena [8];
+
+  smallServer.changedHoldingRegisters.setArena (changedRegisterArena, sizeof (changedRegisterArena));
+  smallServer.changedCoils.setArena (changedCoilArena, sizeof (changedCoilArena));
+
+  bool rollbackOk = smallServer.configureHoldingRegisters (0, 32) && !smallServer.configureHoldingRegisters (32, 100);
+  rollbackOk = rollbackOk && (smallServer.holdingRegisters.size() == 32) && smallServer.configureHoldingRegisters (32, 32);
+  rollbackOk = rollbackOk && smallServer.configureCoils (0, 32) && !smallServer.configureCoils (32, 100);
+  rollbackOk = rollbackOk && (smallServer.coils.size() == 32) && smallServer.configureCoils (32, 32);
+  rollbackOk = rollbackOk && (smallServer.holdingRegisters.size() == 64) && (smallServer.coils.size() == 64);
+  passed &= check ("remove ranges without change flags", rollbackOk);
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Replaces the holding registers and coils of the server with static maps, and
+ * runs requests on them. Must run after the server test, which sets up the loopback
+ * pair.
+ *
+ * @return true - All the checks passed.
+ */
+bool runStaticTest() {
+  bool passed = true;
+
+  printf ("\nStatic\n");
+
+  // A layout can only be set on an empty map, and must be sorted and separate
+  passed &= check ("reject a layout on a map that is not empty", !staticHoldingRegisters.attach (modbusRTUServer.holdingRegisters));
+
+  CSE_ModbusRTU_RegisterMap <uint16_t>:: block_t touchingBlocks[] = {
+    { 0x0000, 4, registerArena, 0 },
+    { 0x0004, 4, registerArena + 4, 0 }
+  };
+
+  CSE_ModbusRTU_RegisterMap <uint16_t> map;
+  passed &= check ("reject touching blocks", !map.setLayout (touchingBlocks, 2) && (map.getBlockCount() == 0));
+
+  modbusRTUServer.holdingRegisters.clear();
+  modbusRTUServer.changedHoldingRegisters.clear();
+  modbusRTUServer.coils.clear();
+  modbusRTUServer.changedCoils.clear();
+
+  bool attached = staticHoldingRegisters.attach (modbusRTUServer.holdingRegisters) && staticCoils.attach (modbusRTUServer.coils);
+  attached = attached && staticChangedHoldingRegisters.attach (modbusRTUServer.changedHoldingRegisters);
+  attached = attached && (modbusRTUServer.holdingRegisters.size() == 20) && (modbusRTUServer.holdingRegisters.getBlockCount() == 2);
+  passed &= check ("attach static maps", attached && !modbusRTUServer.configureHoldingRegisters (0x0200, 1) && !modbusRTUServer.coils.add (0x0100, 1));
+  passed &= check ("initial values and constant addresses", (staticHoldingRegisters.at <0x0103>() == 0x1234) && staticCoils.getBit <0x000F>() && (modbusRTUServer.readCoil (0x0003) == 1));
+
+  serverRunning.store (true);
+  std::thread serverThread (serverLoop);
+
+  uint16_t registers [16];
+
+  for (uint16_t i = 0; i < 16; i++) {
+    registers [i] = 0xC000 + i;
+  }
+
+  bool requestsOk = (modbusRTUClient.writeHoldingRegister (0x0000, 16, registers) == MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+  requestsOk = requestsOk && (staticHoldingRegisters.at <0x000F>() == 0xC00F) && (staticHoldingRegisters.find <0x0002, 2>() [1] == 0xC003);
+  requestsOk = requestsOk && (modbusRTUClient.readHoldingRegister (0x0100, 4, registers) == MODBUS_FC_READ_HOLDING_REGISTERS) && (registers [3] == 0x1234);
+  passed &= check ("read and write the static registers", requestsOk);
+
+  uint16_t changedAddress = 0, changedCount = 0;
+  bool changesOk = modbusRTUServer.readChangedHoldingRegisters (changedAddress, changedCount) && (changedAddress == 0x0000) && (changedCount == 16);
+  passed &= check ("track the changes with a static bit map", changesOk && !modbusRTUServer.readChangedHoldingRegisters (changedAddress, changedCount));
+
+  bool readOnlyOk = (modbusRTUClient.writeHoldingRegister (0x0101, 0x0000) == MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+  readOnlyOk = readOnlyOk && (modbusRTUClient.writeHoldingRegister (0x0100, 2, registers) == MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+  readOnlyOk = readOnlyOk && (modbusRTUClient.writeCoil (0x0040, (uint16_t) 0x0001) == MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+  readOnlyOk = readOnlyOk && (modbusRTUClient.writeCoil (0x0003, (uint16_t) 0x0000) == MODBUS_FC_WRITE_SINGLE_COIL) && !staticCoils.getBit <0x0003>();
+  readOnlyOk = readOnlyOk && (modbusRTUServer.writeHoldingRegister (0x0101, 0x5678) == 1) && (staticHoldingRegisters.at <0x0101>() == 0x5678);
+  passed &= check ("reject client writes to read-only ranges", readOnlyOk);
+
+  serverRunning.store (false);
+  serverThread.join();
+
+  modbusRTUServer.holdingRegisters.clear();
+  passed &= check ("clear detaches the layout", (modbusRTUServer.holdingRegisters.size() == 0) && (staticHoldingRegisters.at <0x0000>() == 0xC000));
+
+  return passed;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - Register Map Test\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  bool passed = true;
+
+  passed &= runMapTest();
+  passed &= runLookupTest();
+  passed &= runBitMapTest();
+  passed &= runArenaTest();
+  passed &= runServerTest();
+  passed &= runStaticTest();
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
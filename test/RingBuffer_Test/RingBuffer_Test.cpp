@@ -0,0 +1,235 @@
+
+//===================================================================================//
+/**
+  * @file RingBuffer_Test.cpp
+  * @brief Host-side test for the receive ring buffer of the CSE_ModbusRTU library.
+  * A producer thread plays the role of the UART receive interrupt and pushes bytes with
+  * their arrival timestamps. The main thread plays the role of the Modbus layer and pops
+  * them. The test checks that no byte is lost, duplicated or reordered.
+  *
+  * Two runs are made. The first one paces the producer at the byte rate of a 1 Mbaud
+  * line (10 bits per byte, 10 us per byte), while the consumer sleeps for 100 us whenever
+  * the buffer is empty. The second one runs both sides as fast as possible to stress the
+  * index handling. The "full" column is the number of pushes that found the buffer full.
+  * On a real UART those bytes would have been lost. On a paced run it should be 0 unless
+  * the host is heavily loaded.
+  *
+  * A third run pushes a whole 256 byte ADU while the consumer is not running, like a
+  * loop that runs late for a whole frame, at every position of the buffer. No byte may
+  * be dropped.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -O2 -pthread -I../../src RingBuffer_Test.cpp ../../src/CSE_ModbusRTU_RingBuffer.cpp -o RingBuffer_Test
+  *   ./RingBuffer_Test
+  *
+  * @date +05:30 03:26:10 PM 16-10-2026, Friday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include "CSE_ModbusRTU_RingBuffer.h"
+
+//===================================================================================//
+
+const uint32_t pacedByteCount = 200000UL;  // 2 seconds at 1 Mbaud
+const uint32_t stressByteCount = 10000000UL;
+const uint32_t byteTimeNanos = 10000UL; // 10 bits at 1 Mbaud
+
+CSE_ModbusRTU_RingBuffer ringBuffer;
+
+//===================================================================================//
+/**
+ * @brief Returns the time since the first call in microseconds. Used as micros().
+ *
+ * @return uint32_t
+ */
+uint32_t hostMicros() {
+  static auto startTime = std::chrono::steady_clock::now();
+  return (uint32_t) std::chrono::duration_cast <std::chrono::microseconds> (std::chrono::steady_clock::now() - startTime).count();
+}
+
+//===================================================================================//
+/**
+ * @brief The producer. Pushes a counting sequence of bytes. When the buffer is full, the
+ * push is retried. A real UART would drop the byte instead, so every failed push is a
+ * byte that would have been lost, and is counted by the overflow counter of the buffer.
+ *
+ * @param count The number of bytes to push.
+ * @param paced If true, bytes are pushed at the rate they would arrive on the line, with
+ * their exact arrival times. Otherwise bytes are pushed as fast as possible.
+ */
+void producer (uint32_t count, bool paced) {
+  auto startTime = std::chrono::steady_clock::now();
+  uint32_t startMicros = hostMicros();
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint32_t arrived = count;
+
+    if (paced) {
+      // Number of bytes that have arrived on the line by now
+      uint64_t elapsed = (uint64_t) std::chrono::duration_cast <std::chrono::nanoseconds> (std::chrono::steady_clock::now() - startTime).count();
+      
+      if ((elapsed / byteTimeNanos) < count) {
+        arrived = (uint32_t) (elapsed / byteTimeNanos);
+      }
+    }
+
+    while (i < arrived) {
+      uint32_t timestamp = paced ? (startMicros + (uint32_t) (((uint64_t) (i + 1) * byteTimeNanos) / 1000)) : i;
+
+      if (!ringBuffer.push ((uint8_t) i, timestamp)) {
+        break;  // Full. Retry after the consumer has run.
+      }
+
+      i++;
+    }
+
+    if (paced) {
+      std::this_thread::sleep_for (std::chrono::microseconds (20)); // Like the gap between two interrupts
+    }
+    else {
+      std::this_thread::yield(); // Let the consumer run on single core hosts
+    }
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Runs one producer/consumer test.
+ *
+ * @param name The name of the run.
+ * @param count The number of bytes to push.
+ * @param paced See producer().
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runTest (const char* name, uint32_t count, bool paced) {
+  ringBuffer.clear();
+  ringBuffer.resetOverflowCount();
+
+  uint32_t received = 0;
+  uint32_t lastTimestamp = 0;
+  uint32_t maxFill = 0;
+  uint8_t expected = 0;
+  bool passed = true;
+
+  auto startTime = std::chrono::steady_clock::now();
+  std::thread producerThread (producer, count, paced);
+
+  while (received < count) {
+    uint8_t byte;
+    uint32_t timestamp;
+
+    uint32_t fill = (uint32_t) ringBuffer.available();
+
+    if (fill > maxFill) {
+      maxFill = fill;
+    }
+
+    if (!ringBuffer.pop (byte, timestamp)) {
+      if (paced) {
+        std::this_thread::sleep_for (std::chrono::microseconds (100)); // Like a busy application loop
+      }
+      else {
+        std::this_thread::yield();
+      }
+
+      continue;
+    }
+
+    if (byte != expected) {
+      printf ("%s: Byte %u is 0x%02X, expected 0x%02X.\n", name, received, byte, expected);
+      passed = false;
+      break;
+    }
+
+    if (timestamp < lastTimestamp) {
+      printf ("%s: Timestamp of byte %u went backwards.\n", name, received);
+      passed = false;
+      break;
+    }
+
+    lastTimestamp = timestamp;
+    expected++;
+    received++;
+  }
+
+  producerThread.join();
+
+  auto endTime = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration <double> (endTime - startTime).count();
+
+  printf ("%-8s %10u bytes %8.3f s %8.2f MB/s  max fill %3u/%u  full %6u  %s\n", name, received, seconds,
+    (double) received / seconds / 1e6, maxFill, (uint32_t) ringBuffer.getCapacity(),
+    ringBuffer.getOverflowCount(), passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Pushes a 256 byte frame with no consumer running, and then pops it. This is
+ * done starting at every position of the buffer, so that the frame also wraps around
+ * the end.
+ *
+ * @return true - Test passed.
+ * @return false - Test failed.
+ */
+bool runFrameTest() {
+  bool passed = true;
+
+  ringBuffer.clear();
+  ringBuffer.resetOverflowCount();
+
+  for (uint32_t start = 0; passed && (start < MODBUS_RTU_RING_BUFFER_SIZE); start++) {
+    for (uint32_t i = 0; i < 256; i++) {
+      ringBuffer.push ((uint8_t) (start + i), i);
+    }
+
+    for (uint32_t i = 0; passed && (i < 256); i++) {
+      uint8_t byte;
+      uint32_t timestamp;
+
+      passed = ringBuffer.pop (byte, timestamp) && (byte == (uint8_t) (start + i)) && (timestamp == i);
+    }
+
+    // Move the start of the next frame by one entry
+    uint8_t byte;
+    uint32_t timestamp;
+    ringBuffer.push (0, 0);
+    ringBuffer.pop (byte, timestamp);
+  }
+
+  passed = passed && (ringBuffer.getOverflowCount() == 0) && (ringBuffer.available() == 0);
+
+  printf ("%-8s %10u bytes %8s   %8s       max fill %3u/%u  full %6u  %s\n", "Frame", 256U, "", "", 256U, (uint32_t) ringBuffer.getCapacity(),
+    ringBuffer.getOverflowCount(), passed ? "PASS" : "FAIL");
+
+  return passed;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - Ring Buffer Test\n");
+  printf ("Buffer size: %u entries\n\n", (uint32_t) MODBUS_RTU_RING_BUFFER_SIZE);
+
+  bool passed = true;
+
+  passed &= runTest ("1 Mbaud", pacedByteCount, true);
+  passed &= runTest ("Stress", stressByteCount, false);
+  passed &= runFrameTest();
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
@@ -0,0 +1,401 @@
+
+//===================================================================================//
+/**
+  * @file SeqLock_Test.cpp
+  * @brief Host-side stress test for the register locks of the CSE_ModbusRTU server.
+  * Every writer fills a whole block of registers with the same value, so a reader that
+  * finds two different values in a block has seen a torn write.
+  *
+  *   - Lock : Two writer threads fill a block of 64 registers with their own counters,
+  *     while three reader threads copy it between beginRead() and endRead(). No copy
+  *     may be torn. The same run is then made without the lock, to show how many copies
+  *     would have been torn. That number is only printed, because it depends on how
+  *     the threads are scheduled by the host.
+  *   - Server : Connects a client and a server with a loopback port pair. A sampling
+  *     thread writes 64 input registers with writeInputRegister() while the client
+  *     reads them with read input registers requests. The client also writes 100
+  *     holding registers with write multiple registers requests, while a monitor
+  *     thread reads them with readHoldingRegister(). No response and no snapshot may
+  *     be torn.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src SeqLock_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o SeqLock_Test
+  *   ./SeqLock_Test
+  *
+  * @date +05:30 01:22:36 AM 17-10-2026, Saturday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "CSE_ModbusRTU.h"
+
+//===================================================================================//
+
+#define   BLOCK_LENGTH          64U // Registers in the block of the lock test
+#define   READER_COUNT          3U  // Reader threads in the lock test
+#define   LOCK_TEST_TIME        1000U // Duration of each lock test run in milliseconds
+#define   INPUT_COUNT           64U // Input registers read by the client
+#define   HOLDING_COUNT         100U  // Holding registers written by the client
+#define   REQUEST_COUNT         2000UL  // Read and write requests made by the client
+
+CSE_ModbusRTU_LoopbackPort clientPort;
+CSE_ModbusRTU_LoopbackPort serverPort;
+
+CSE_ModbusRTU clientRTU (&clientPort, 0x00, "clientRTU");
+CSE_ModbusRTU serverRTU (&serverPort, 0x01, "serverRTU");
+
+CSE_ModbusRTU_Client modbusRTUClient (clientRTU, "modbusRTUClient");
+CSE_ModbusRTU_Server modbusRTUServer (serverRTU, "modbusRTUServer");
+
+std::atomic <bool> running (false);
+
+CSE_ModbusRTU_SeqLock blockLock;
+uint16_t block [BLOCK_LENGTH];
+
+//===================================================================================//
+/**
+ * @brief Prints the result of a check.
+ *
+ * @param name The name of the check.
+ * @param passed The result.
+ * @return bool - The result.
+ */
+bool check (const char* name, bool passed) {
+  printf ("  %-52s %s\n", name, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks if all the values of an array are the same.
+ *
+ * @param values The values.
+ * @param count The number of values.
+ * @return true - All the values are the same.
+ * @return false - The array is torn.
+ */
+bool isUniform (const uint16_t* values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    if (values [i] != values [0]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//===================================================================================//
+/**
+ * @brief A writer of the lock test. Fills the block with its own counter until the run
+ * ends. The two writers use different halves of the value range.
+ *
+ * @param id The writer number, 0 or 1.
+ * @param locked Use the lock.
+ * @param writeCount The number of writes is saved here.
+ */
+void blockWriter (uint16_t id, bool locked, uint32_t* writeCount) {
+  uint32_t count = 0;
+
+  while (running.load (std::memory_order_relaxed)) {
+    uint16_t value = (uint16_t) ((id << 15) | (count & 0x7FFF));
+
+    if (locked) {
+      blockLock.beginWrite();
+    }
+
+    for (size_t i = 0; i < BLOCK_LENGTH; i++) {
+      ((volatile uint16_t*) block) [i] = value;
+    }
+
+    if (locked) {
+      blockLock.endWrite();
+    }
+
+    count++;
+  }
+
+  *writeCount = count;
+}
+
+//===================================================================================//
+/**
+ * @brief A reader of the lock test. Copies the block until the run ends, and counts the
+ * copies that are torn.
+ *
+ * @param locked Use the lock.
+ * @param readCount The number of copies is saved here.
+ * @param tornCount The number of torn copies is saved here.
+ * @param retryCount The number of copies made again because of a write is saved here.
+ */
+void blockReader (bool locked, uint32_t* readCount, uint32_t* tornCount, uint32_t* retryCount) {
+  uint16_t copy [BLOCK_LENGTH];
+  uint32_t reads = 0, torn = 0, retries = 0;
+
+  while (running.load (std::memory_order_relaxed)) {
+    if (locked) {
+      uint32_t sequence = blockLock.beginRead();
+
+      for (size_t i = 0; i < BLOCK_LENGTH; i++) {
+        copy [i] = ((volatile uint16_t*) block) [i];
+      }
+
+      if (!blockLock.endRead (sequence)) {
+        retries++;
+        continue;
+      }
+    }
+    else {
+      for (size_t i = 0; i < BLOCK_LENGTH; i++) {
+        copy [i] = ((volatile uint16_t*) block) [i];
+      }
+    }
+
+    reads++;
+
+    if (!isUniform (copy, BLOCK_LENGTH)) {
+      torn++;
+    }
+  }
+
+  *readCount = reads;
+  *tornCount = torn;
+  *retryCount = retries;
+}
+
+//===================================================================================//
+/**
+ * @brief Runs the writers and the readers of the lock test for LOCK_TEST_TIME.
+ *
+ * @param locked Use the lock.
+ * @param writeCount The number of writes of both writers is saved here.
+ * @param readCount The number of consistent copies of all readers is saved here.
+ * @param tornCount The number of torn copies is saved here.
+ * @return uint32_t - The number of copies made again.
+ */
+uint32_t runBlockTest (bool locked, uint32_t& writeCount, uint32_t& readCount, uint32_t& tornCount) {
+  uint32_t writes [2], reads [READER_COUNT], torn [READER_COUNT], retries [READER_COUNT];
+  std::thread writers [2];
+  std::thread readers [READER_COUNT];
+
+  running.store (true);
+
+  for (uint16_t i = 0; i < 2; i++) {
+    writers [i] = std::thread (blockWriter, i, locked, &writes [i]);
+  }
+
+  for (size_t i = 0; i < READER_COUNT; i++) {
+    readers [i] = std::thread (blockReader, locked, &reads [i], &torn [i], &retries [i]);
+  }
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (LOCK_TEST_TIME));
+  running.store (false);
+
+  uint32_t retryCount = 0;
+  writeCount = 0;
+  readCount = 0;
+  tornCount = 0;
+
+  for (size_t i = 0; i < 2; i++) {
+    writers [i].join();
+    writeCount += writes [i];
+  }
+
+  for (size_t i = 0; i < READER_COUNT; i++) {
+    readers [i].join();
+    readCount += reads [i];
+    tornCount += torn [i];
+    retryCount += retries [i];
+  }
+
+  return retryCount;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks the lock with two writers and three readers.
+ *
+ * @return true - All the checks passed.
+ */
+bool runLockTest() {
+  bool passed = true;
+  uint32_t writeCount, readCount, tornCount;
+
+  printf ("Lock\n");
+
+  uint32_t retryCount = runBlockTest (true, writeCount, readCount, tornCount);
+  printf ("  %lu writes, %lu reads, %lu retries\n", (unsigned long) writeCount, (unsigned long) readCount, (unsigned long) retryCount);
+  passed &= check ("writers and readers both make progress", (writeCount > 0) && (readCount > 0));
+  passed &= check ("no torn reads with the lock", tornCount == 0);
+  passed &= check ("sequence is even after the writes", (blockLock.getSequence() & 0x01) == 0);
+
+  runBlockTest (false, writeCount, readCount, tornCount);
+  printf ("  Without the lock: %lu of %lu reads torn\n", (unsigned long) tornCount, (unsigned long) readCount);
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief The server thread. Polls the server until the run ends.
+ *
+ */
+void serverLoop() {
+  while (running.load()) {
+    modbusRTUServer.poll();
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief The sampling thread. Writes the input registers as one update until the run
+ * ends, like a task on the second core of a microcontroller.
+ *
+ * @param writeCount The number of updates is saved here.
+ */
+void samplingLoop (uint32_t* writeCount) {
+  uint16_t values [INPUT_COUNT];
+  uint32_t count = 0;
+
+  while (running.load()) {
+    for (size_t i = 0; i < INPUT_COUNT; i++) {
+      values [i] = (uint16_t) count;
+    }
+
+    modbusRTUServer.writeInputRegister (0, INPUT_COUNT, values);
+    count++;
+
+    if ((count % 64) == 0) {
+      std::this_thread::yield(); // Let the server run on single core hosts
+    }
+  }
+
+  *writeCount = count;
+}
+
+//===================================================================================//
+/**
+ * @brief The monitor thread. Reads snapshots of the holding registers until the run
+ * ends, and counts the torn ones.
+ *
+ * @param readCount The number of snapshots is saved here.
+ * @param tornCount The number of torn snapshots is saved here.
+ */
+void monitorLoop (uint32_t* readCount, uint32_t* tornCount) {
+  uint16_t values [HOLDING_COUNT];
+  uint32_t reads = 0, torn = 0;
+
+  while (running.load()) {
+    if (modbusRTUServer.readHoldingRegister (0x1000, HOLDING_COUNT, values) == 1) {
+      reads++;
+      torn += isUniform (values, HOLDING_COUNT) ? 0 : 1;
+    }
+
+    if ((reads % 64) == 0) {
+      std::this_thread::yield(); // Let the server run on single core hosts
+    }
+  }
+
+  *readCount = reads;
+  *tornCount = torn;
+}
+
+//===================================================================================//
+/**
+ * @brief Runs requests through a client and a server connected with a loopback pair,
+ * while other threads access the same registers.
+ *
+ * @return true - All the checks passed.
+ */
+bool runServerTest() {
+  bool passed = true;
+
+  printf ("\nServer\n");
+
+  clientPort.connect (serverPort);
+
+  CSE_ModbusRTU* nodes[] = { &clientRTU, &serverRTU };
+
+  for (CSE_ModbusRTU* node : nodes) {
+    node->setBaudRate (100000000UL);
+    node->setInterCharTimeout (0);
+    node->setInterFrameDelay (20);
+  }
+
+  modbusRTUClient.begin();
+  modbusRTUClient.setServerAddress (0x01);
+  modbusRTUServer.begin();
+  modbusRTUServer.setNonBlocking (true);
+
+  // The tables are configured before the other threads start
+  bool configured = modbusRTUServer.configureInputRegisters (0, INPUT_COUNT) && modbusRTUServer.configureHoldingRegisters (0x1000, HOLDING_COUNT);
+  passed &= check ("configure the registers", configured);
+
+  uint32_t writeCount = 0, snapshotCount = 0, tornSnapshots = 0;
+
+  running.store (true);
+  std::thread serverThread (serverLoop);
+  std::thread samplingThread (samplingLoop, &writeCount);
+  std::thread monitorThread (monitorLoop, &snapshotCount, &tornSnapshots);
+
+  uint16_t registers [HOLDING_COUNT];
+  uint32_t responseCount = 0, tornResponses = 0, failedRequests = 0;
+
+  for (uint32_t i = 0; i < REQUEST_COUNT; i++) {
+    if (modbusRTUClient.readInputRegister (0, INPUT_COUNT, registers) == MODBUS_FC_READ_INPUT_REGISTERS) {
+      responseCount++;
+      tornResponses += isUniform (registers, INPUT_COUNT) ? 0 : 1;
+    }
+    else {
+      failedRequests++;
+    }
+
+    for (size_t j = 0; j < HOLDING_COUNT; j++) {
+      registers [j] = (uint16_t) i;
+    }
+
+    if (modbusRTUClient.writeHoldingRegister (0x1000, HOLDING_COUNT, registers) != MODBUS_FC_WRITE_MULTIPLE_REGISTERS) {
+      failedRequests++;
+    }
+  }
+
+  running.store (false);
+  serverThread.join();
+  samplingThread.join();
+  monitorThread.join();
+
+  printf ("  %lu input register updates, %lu holding register snapshots\n", (unsigned long) writeCount, (unsigned long) snapshotCount);
+  passed &= check ("all requests answered", (failedRequests == 0) && (responseCount == REQUEST_COUNT));
+  passed &= check ("no torn read input registers responses", tornResponses == 0);
+  passed &= check ("no torn holding register snapshots", (snapshotCount > 0) && (tornSnapshots == 0));
+  passed &= check ("last write is in the holding registers", modbusRTUServer.readHoldingRegister (0x1000 + HOLDING_COUNT - 1) == (int) (REQUEST_COUNT - 1));
+
+  return passed;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - SeqLock Test\n");
+  printf ("Register lock: %s\n\n", (MODBUS_RTU_REGISTER_LOCK == MODBUS_RTU_REGISTER_LOCK_SEQLOCK) ? "seqlock" : "none");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  bool passed = true;
+
+  passed &= runLockTest();
+  passed &= runServerTest();
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
@@ -0,0 +1,484 @@
+
+//===================================================================================//
+/**
+  * @file SharedBank_Test.cpp
+  * @brief Host-side test for the shared register bank of the CSE_ModbusRTU server.
+  *
+  *   - Layout : Creates a bank in POSIX shared memory, and checks the header and the
+  *     offsets of the tables against the documented layout. A second bank object must
+  *     open it and find the same layout.
+  *   - Processes : Attaches the bank to a server, and forks a second process that opens
+  *     the bank by its name. The second process fills the input registers with its own
+  *     counter, while the client reads them over a loopback pair. The client also fills
+  *     the holding registers, while the second process reads them from the bank. No
+  *     response and no read of the second process may be torn, and the second process
+  *     must see the last write of the client.
+  *   - File : Creates a bank in a file, closes it and creates it again. The values must
+  *     be kept if the layout is the same, and cleared if it has changed.
+  *   - Recovery : Forks a second process that starts a write and suspends itself, with
+  *     the sequence number of the table odd. A write must wait for it as long as it is
+  *     suspended, and take over the write once it is killed. create() must not change
+  *     the bank while another object has it open, and must repair the number when no
+  *     other object has it open.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host. Add
+  * -lrt if your C library does not have shm_open().
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src SharedBank_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o SharedBank_Test
+  *   ./SharedBank_Test
+  *
+  * @date +05:30 02:24:51 AM 17-10-2026, Saturday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "CSE_ModbusRTU.h"
+#include "CSE_ModbusRTU_SharedBank.h"
+
+//===================================================================================//
+
+#define   INPUT_ADDRESS         0x0000U // Input registers of the bank
+#define   INPUT_COUNT           64U
+#define   HOLDING_ADDRESS       0x1000U // Holding registers of the bank
+#define   HOLDING_COUNT         100U
+#define   REQUEST_COUNT         1000UL  // Read and write requests made by the client
+#define   CHILD_TIMEOUT         20000U  // Time the second process waits for the client in milliseconds
+
+CSE_ModbusRTU_LoopbackPort clientPort;
+CSE_ModbusRTU_LoopbackPort serverPort;
+
+CSE_ModbusRTU clientRTU (&clientPort, 0x00, "clientRTU");
+CSE_ModbusRTU serverRTU (&serverPort, 0x01, "serverRTU");
+
+CSE_ModbusRTU_Client modbusRTUClient (clientRTU, "modbusRTUClient");
+CSE_ModbusRTU_Server modbusRTUServer (serverRTU, "modbusRTUServer");
+
+std::atomic <bool> running (false);
+
+char bankName [64];
+char bankPath [64];
+
+//===================================================================================//
+/**
+ * @brief Prints the result of a check.
+ *
+ * @param name The name of the check.
+ * @param passed The result.
+ * @return bool - The result.
+ */
+bool check (const char* name, bool passed) {
+  printf ("  %-52s %s\n", name, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks if all the values of an array are the same.
+ *
+ * @param values The values.
+ * @param count The number of values.
+ * @return true - All the values are the same.
+ * @return false - The array is torn.
+ */
+bool isUniform (const uint16_t* values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    if (values [i] != values [0]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks the header of a new bank against the documented layout.
+ *
+ * @return true - All the checks passed.
+ */
+bool runLayoutTest() {
+  bool passed = true;
+
+  printf ("Layout\n");
+
+  CSE_ModbusRTU_SharedBank bank (bankName);
+  bank.configureInputRegisters (INPUT_ADDRESS, INPUT_COUNT);
+  bank.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+
+  passed &= check ("create the bank", bank.create());
+
+  if (!bank.isOpen()) {
+    return false;
+  }
+
+  const uint8_t* bytes = (const uint8_t*) bank.getHeader();
+  CSE_ModbusRTU_SharedBank:: header_t* header = bank.getHeader();
+
+  bool headerOk = (bytes [0] == 'C') && (bytes [1] == 'S') && (bytes [2] == 'E') && (bytes [3] == 'B');
+  headerOk = headerOk && (header->version == 1) && (header->headerSize == 64) && (header->size == bank.getSize());
+  passed &= check ("header fields", headerOk);
+
+  // 64 registers at 64, 100 registers at 192, and the size rounded up to 448
+  bool tablesOk = (header->inputRegisters.offset == 64) && (header->inputRegisters.count == INPUT_COUNT);
+  tablesOk = tablesOk && (header->holdingRegisters.address == HOLDING_ADDRESS) && (header->holdingRegisters.offset == 192) && (bank.getSize() == 448);
+  passed &= check ("table offsets", tablesOk);
+
+  CSE_ModbusRTU_SharedBank other (bankName);
+  uint16_t values [2] = { 0x1234, 0x5678 };
+  uint16_t copy [2] = { 0, 0 };
+
+  bool openOk = other.open() && (other.getSize() == bank.getSize()) && (other.writeHoldingRegister (HOLDING_ADDRESS + 98, 2, values) == 1);
+  openOk = openOk && (bank.readHoldingRegister (HOLDING_ADDRESS + 98, 2, copy) == 1) && (copy [1] == 0x5678);
+  openOk = openOk && (other.readHoldingRegister (HOLDING_ADDRESS + 99, 2, copy) == -1);
+  passed &= check ("open the bank from a second object", openOk);
+  passed &= check ("sequence counted once per write", (other.getHoldingRegisterSequence() == 2) && (bank.getHoldingRegisterSequence() == 2));
+
+  // The writers are at 48 and 52, and are cleared at the end of every write
+  bool writersOk = ((const uint8_t*) &header->inputWriter == (bytes + 48)) && ((const uint8_t*) &header->holdingWriter == (bytes + 52));
+  writersOk = writersOk && (header->inputWriter.load() == 0) && (header->holdingWriter.load() == 0);
+  passed &= check ("writer fields", writersOk);
+
+  other.end();
+  bank.end();
+  bank.remove();
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief The second process. Opens the bank by its name, fills the input registers
+ * until the client has written its last value to the holding registers, and checks the
+ * holding registers on the way.
+ *
+ * @return int - The exit status. 0 if no read was torn and the last write was seen.
+ */
+int runChild() {
+  CSE_ModbusRTU_SharedBank bank (bankName);
+
+  if (!bank.open()) {
+    return 2;
+  }
+
+  uint16_t values [HOLDING_COUNT];
+  uint32_t count = 0, torn = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds (CHILD_TIMEOUT)) {
+    for (size_t i = 0; i < INPUT_COUNT; i++) {
+      values [i] = (uint16_t) count;
+    }
+
+    bank.writeInputRegister (INPUT_ADDRESS, INPUT_COUNT, values);
+    count++;
+
+    bank.readHoldingRegister (HOLDING_ADDRESS, HOLDING_COUNT, values);
+    torn += isUniform (values, HOLDING_COUNT) ? 0 : 1;
+
+    if (values [0] == (REQUEST_COUNT - 1)) {
+      return (torn == 0) ? 0 : 1;
+    }
+
+    if ((count % 64) == 0) {
+      std::this_thread::yield(); // Let the server run on single core hosts
+    }
+  }
+
+  return 3;
+}
+
+//===================================================================================//
+/**
+ * @brief The server thread. Polls the server until the run ends.
+ *
+ */
+void serverLoop() {
+  while (running.load()) {
+    modbusRTUServer.poll();
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Runs requests on a server attached to the bank, while a second process uses
+ * the same bank.
+ *
+ * @return true - All the checks passed.
+ */
+bool runProcessTest() {
+  bool passed = true;
+
+  printf ("\nProcesses\n");
+
+  CSE_ModbusRTU_SharedBank bank (bankName);
+  bank.configureInputRegisters (INPUT_ADDRESS, INPUT_COUNT);
+  bank.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+
+  bool attached = bank.create() && modbusRTUServer.configureInputRegisters (0x2000, 1) && !bank.attach (modbusRTUServer);
+  modbusRTUServer.inputRegisters.clear();
+  attached = attached && bank.attach (modbusRTUServer) && (modbusRTUServer.holdingRegisters.size() == HOLDING_COUNT);
+  passed &= check ("attach the bank to the server", attached);
+
+  if (!attached) {
+    return false;
+  }
+
+  // The second process is started before any thread of this one
+  fflush (stdout);
+  pid_t child = fork();
+
+  if (child == 0) {
+    _exit (runChild());
+  }
+
+  clientPort.connect (serverPort);
+
+  CSE_ModbusRTU* nodes[] = { &clientRTU, &serverRTU };
+
+  for (CSE_ModbusRTU* node : nodes) {
+    node->setBaudRate (100000000UL);
+    node->setInterCharTimeout (0);
+    node->setInterFrameDelay (20);
+  }
+
+  modbusRTUClient.begin();
+  modbusRTUClient.setServerAddress (0x01);
+  modbusRTUServer.begin();
+  modbusRTUServer.setNonBlocking (true);
+
+  running.store (true);
+  std::thread serverThread (serverLoop);
+
+  uint16_t registers [HOLDING_COUNT];
+  uint32_t responseCount = 0, tornResponses = 0, failedRequests = 0;
+
+  for (uint32_t i = 0; i < REQUEST_COUNT; i++) {
+    if (modbusRTUClient.readInputRegister (INPUT_ADDRESS, INPUT_COUNT, registers) == MODBUS_FC_READ_INPUT_REGISTERS) {
+      responseCount++;
+      tornResponses += isUniform (registers, INPUT_COUNT) ? 0 : 1;
+    }
+    else {
+      failedRequests++;
+    }
+
+    for (size_t j = 0; j < HOLDING_COUNT; j++) {
+      registers [j] = (uint16_t) i;
+    }
+
+    if (modbusRTUClient.writeHoldingRegister (HOLDING_ADDRESS, HOLDING_COUNT, registers) != MODBUS_FC_WRITE_MULTIPLE_REGISTERS) {
+      failedRequests++;
+    }
+  }
+
+  int status = -1;
+  waitpid (child, &status, 0);
+
+  running.store (false);
+  serverThread.join();
+
+  uint16_t address = 0, count = 0;
+  bool changesOk = modbusRTUServer.readChangedHoldingRegisters (address, count) && (address == HOLDING_ADDRESS) && (count == HOLDING_COUNT);
+
+  passed &= check ("all requests answered", (failedRequests == 0) && (responseCount == REQUEST_COUNT));
+  passed &= check ("no torn read input registers responses", tornResponses == 0);
+  passed &= check ("second process wrote the input registers", modbusRTUServer.readInputRegister (INPUT_ADDRESS) > 0);
+  passed &= check ("second process saw every write untorn", WIFEXITED (status) && (WEXITSTATUS (status) == 0));
+  passed &= check ("client writes are still tracked", changesOk);
+
+  bank.detach (modbusRTUServer);
+  passed &= check ("detach the bank", (modbusRTUServer.holdingRegisters.size() == 0) && (modbusRTUServer.holdingRegisterLock.getSequence() == 0));
+
+  bank.end();
+  bank.remove();
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks that a bank in a file keeps its values when it is created again.
+ *
+ * @return true - All the checks passed.
+ */
+bool runFileTest() {
+  bool passed = true;
+
+  printf ("\nFile\n");
+
+  CSE_ModbusRTU_SharedBank bank (bankPath, MODBUS_RTU_SHARED_BANK_FILE);
+  bank.configureHoldingRegisters (0x0000, 16);
+
+  uint16_t value = 0xBEEF;
+  bool written = bank.create() && (bank.writeHoldingRegister (0x0005, 1, &value) == 1);
+  bank.end();
+  passed &= check ("create the bank in a file", written);
+
+  value = 0;
+  bool kept = bank.create() && (bank.readHoldingRegister (0x0005, 1, &value) == 1) && (value == 0xBEEF);
+  passed &= check ("values kept with the same layout", kept);
+
+  bank.configureHoldingRegisters (0x0000, 32);
+  bool cleared = bank.create() && (bank.readHoldingRegister (0x0005, 1, &value) == 1) && (value == 0) && (bank.getSize() == 128);
+  passed &= check ("values cleared when the layout changes", cleared);
+
+  bank.end();
+  passed &= check ("remove the file", bank.remove() && !bank.open());
+
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief The second process of the recovery test. Starts a write to the holding
+ * registers like a writer of the bank would, and suspends itself in the middle of it.
+ *
+ * @return int - The exit status, if the bank could not be opened.
+ */
+int runStoppedWriter() {
+  CSE_ModbusRTU_SharedBank bank (bankName);
+
+  if (!bank.open()) {
+    return 2;
+  }
+
+  bank.getHeader()->holdingRegisters.sequence.fetch_add (1);
+  bank.getHeader()->holdingWriter.store ((uint32_t) getpid());
+  raise (SIGSTOP);
+
+  return 0;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks that a writer that is suspended in the middle of a write is waited for,
+ * and that a writer that died in the middle of a write does not hang the other users of
+ * the bank.
+ *
+ * @return true - All the checks passed.
+ */
+bool runRecoveryTest() {
+  bool passed = true;
+
+  printf ("\nRecovery\n");
+
+  CSE_ModbusRTU_SharedBank bank (bankName);
+  bank.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+
+  if (!bank.create()) {
+    check ("leave a write in progress", false);
+    return false;
+  }
+
+  // Start a write from another process, which stops without ending the write
+  fflush (stdout);
+  pid_t child = fork();
+
+  if (child == 0) {
+    _exit (runStoppedWriter());
+  }
+
+  int status = 0;
+  bool stalled = (waitpid (child, &status, WUNTRACED) == child) && WIFSTOPPED (status);
+  stalled = stalled && (bank.getHoldingRegisterSequence() & 0x01) && (bank.getHeader()->holdingWriter.load() == (uint32_t) child);
+  passed &= check ("leave a write in progress", stalled);
+
+  if (!stalled) {
+    kill (child, SIGKILL);
+    waitpid (child, &status, 0);
+    return false;
+  }
+
+  // Another server can reuse the bank, but not repair or change it while it is open
+  CSE_ModbusRTU_SharedBank second (bankName);
+  second.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT);
+  bool busyOk = second.create() && (second.getHoldingRegisterSequence() & 0x01);
+  second.end();
+  second.configureHoldingRegisters (HOLDING_ADDRESS, HOLDING_COUNT / 2);
+  busyOk = busyOk && !second.create() && (errno == EBUSY) && (bank.getHoldingRegisterSequence() & 0x01);
+  passed &= check ("create does not touch a bank in use", busyOk);
+
+  // The write must wait as long as the writer is suspended, however long that is
+  std::atomic <bool> written (false);
+  uint16_t values [2] = { 0xCAFE, 0xF00D };
+
+  std::thread writer ([&]() {
+    bank.writeHoldingRegister (HOLDING_ADDRESS, 2, values);
+    written.store (true);
+  });
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (1000));
+  bool waited = !written.load() && (bank.getHeader()->holdingWriter.load() == (uint32_t) child);
+  passed &= check ("wait for a suspended writer", waited);
+
+  // Once the writer is gone, the write is taken over
+  kill (child, SIGKILL);
+  waitpid (child, &status, 0);
+
+  for (int i = 0; (i < 5000) && !written.load(); i++) {
+    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  }
+
+  bool tookOver = written.load();
+  passed &= check ("take over the write of a dead writer", tookOver);
+
+  if (!tookOver) {
+    writer.detach();
+    return false;
+  }
+
+  writer.join();
+
+  uint16_t copy [2] = { 0, 0 };
+  bool recovered = (bank.readHoldingRegister (HOLDING_ADDRESS, 2, copy) == 1) && (copy [1] == 0xF00D) && ((bank.getHoldingRegisterSequence() & 0x01) == 0);
+  recovered = recovered && (bank.getHeader()->holdingWriter.load() == 0);
+  passed &= check ("read and write after the writer died", recovered);
+
+  // With no other object open, create() repairs the number
+  bank.getHeader()->holdingRegisters.sequence.fetch_add (1);
+  bank.getHeader()->holdingWriter.store ((uint32_t) child);
+  bank.end();
+  bool repaired = bank.create() && ((bank.getHoldingRegisterSequence() & 0x01) == 0) && (bank.getHeader()->holdingWriter.load() == 0);
+  passed &= check ("create repairs the sequence when alone", repaired);
+
+  bank.end();
+  bank.remove();
+
+  return passed;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - SharedBank Test\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  snprintf (bankName, sizeof (bankName), "/cse_modbusrtu_test_%d", (int) getpid());
+  snprintf (bankPath, sizeof (bankPath), "/tmp/cse_modbusrtu_test_%d.bank", (int) getpid());
+
+  bool passed = true;
+
+  passed &= runLayoutTest();
+  passed &= runProcessTest();
+  passed &= runFileTest();
+  passed &= runRecoveryTest();
+
+  CSE_ModbusRTU_SharedBank (bankName).remove();
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//
@@ -0,0 +1,424 @@
+//===================================================================================//
+/**
+  * @file Sniffer_Test.cpp
+  * @brief Host-side test for CSE_ModbusRTU_Sniffer. The traffic of a busy 115200 baud
+  * bus is generated with the exact arrival time of every byte, and pushed into the
+  * receive buffer of the sniffer like a UART receive interrupt would. The frames follow
+  * each other with only t3.5 of silence, and several frames are in the buffer at every
+  * poll(), as if the loop of the sketch runs late.
+  *
+  *   - Traffic : Read and write requests with their responses, exception responses,
+  *     back-to-back broadcasts, and requests that are never answered. Every frame must
+  *     be captured with its times, every response paired with its request with the
+  *     right round trip time, the exceptions classified, the broadcasts never paired,
+  *     and no frame or byte dropped.
+  *   - Overflow : Fills the receive buffer past its size, and the frame queue of the
+  *     sniffer past its size. The dropped bytes and frames must be counted, and the
+  *     frame that lost a byte reported as an error.
+  *
+  * This is not an Arduino sketch. Compile and run it on a Linux or macOS host.
+  *
+  *   g++ -std=gnu++11 -O2 -pthread -I../../src Sniffer_Test.cpp ../../src/CSE_ModbusRTU*.cpp -o Sniffer_Test
+  *   ./Sniffer_Test
+  *
+  * @date +05:30 06:31:12 AM 17-10-2026, Saturday
+  * @author Vishnu Mohanan (@vishnumaiea)
+  * @par GitHub Repository: https://github.com/CIRCUITSTATE/CSE_ModbusRTU
+  * @par MIT License
+  *
+  */
+//===================================================================================//
+
+#include <stdio.h>
+#include <vector>
+#include "CSE_ModbusRTU.h"
+
+//===================================================================================//
+
+#define   BAUD_RATE             115200UL
+#define   BYTE_TIME             96U   // 11 bits at 115200 baud in microseconds, rounded up
+#define   TRANSACTION_COUNT     1000U // Transactions in the traffic test
+#define   RESPONSE_TIMEOUT      5U    // Response timeout of the sniffer in milliseconds
+
+typedef CSE_ModbusRTU_ADU::aduType_t aduType_t;
+
+/**
+ * @brief A frame on the line, and what the sniffer must report for it.
+ *
+ */
+struct lineFrame_t {
+  uint8_t bytes [MODBUS_RTU_ADU_LENGTH_MAX];
+  uint16_t length;
+  uint32_t startTime; // Arrival time of the first byte, from the start of the traffic
+  int type; // The expected type
+  int32_t request;  // For responses, the index of the request. -1 otherwise.
+};
+
+/**
+ * @brief What the sniffer reported for a frame.
+ *
+ */
+struct capturedFrame_t {
+  int status;
+  int type;
+  uint32_t sequence;
+  uint32_t startTime;
+  uint32_t endTime;
+  uint32_t roundTripTime;
+  uint32_t requestSequence;
+};
+
+CSE_ModbusRTU_LoopbackPort snifferPort;
+CSE_ModbusRTU_RingBuffer ringBuffer;
+
+std::vector <lineFrame_t> line;
+std::vector <capturedFrame_t> captured;
+
+uint32_t lineTime = 0;  // The end of the last frame on the line
+
+//===================================================================================//
+/**
+ * @brief Prints the result of a check.
+ *
+ * @param name The name of the check.
+ * @param passed The result.
+ * @return bool - The result.
+ */
+bool check (const char* name, bool passed) {
+  printf ("  %-52s %s\n", name, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Adds a frame to the line. The frame starts after the silence given, which
+ * includes the time of its first byte.
+ *
+ * @param address The device address.
+ * @param functionCode The function code.
+ * @param data The data of the PDU.
+ * @param dataLength The length of the data.
+ * @param silence The time from the last byte of the previous frame to the first byte of
+ * this one in microseconds.
+ * @param type The type the sniffer must report.
+ * @param request For responses, the index of the request. -1 otherwise.
+ * @return int32_t - The index of the frame.
+ */
+int32_t addFrame (uint8_t address, uint8_t functionCode, const uint8_t* data, uint8_t dataLength, uint32_t silence, int type, int32_t request = -1) {
+  CSE_ModbusRTU_ADU adu;
+
+  adu.add (address);
+  adu.add (functionCode);
+
+  for (uint8_t i = 0; i < dataLength; i++) {
+    adu.add (data [i]);
+  }
+
+  adu.setCRC();
+
+  lineFrame_t frame;
+  frame.length = adu.getLength();
+  memcpy (frame.bytes, adu.getBuffer(), frame.length);
+  frame.startTime = lineTime + silence;
+  frame.type = type;
+  frame.request = request;
+
+  lineTime = frame.startTime + ((frame.length - 1) * BYTE_TIME);
+  line.push_back (frame);
+
+  return (int32_t) (line.size() - 1);
+}
+
+//===================================================================================//
+/**
+ * @brief Generates the traffic of a busy bus. The transactions repeat in this order.
+ *
+ *   - A read holding registers request and its response.
+ *   - A read holding registers request and an exception response.
+ *   - Two write single register broadcasts with the same function code.
+ *   - A write multiple registers request and its response.
+ *   - A request that is not answered, and the same request again after the response
+ *     timeout, which is answered.
+ *
+ * Every frame follows the previous one after t3.5, and a response after a turnaround
+ * time that changes with every transaction.
+ *
+ */
+void generateTraffic() {
+  const uint32_t gap = MODBUS_RTU_FIXED_INTER_FRAME_DELAY + BYTE_TIME;  // The shortest silence between frames
+  uint8_t data [MODBUS_RTU_ADU_LENGTH_MAX];
+
+  line.clear();
+  lineTime = 0;
+
+  for (uint32_t i = 0; i < TRANSACTION_COUNT; i++) {
+    uint8_t address = (uint8_t) ((i % 247) + 1);
+    uint8_t count = (uint8_t) ((i % 125) + 1);
+    uint32_t turnaround = gap + ((i * 37) % 500);
+    int32_t request;
+
+    data [0] = 0x00;
+    data [1] = (uint8_t) i;
+    data [2] = 0x00;
+    data [3] = count;
+
+    switch (i % 5) {
+      case 0:
+        request = addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS, data, 4, gap, aduType_t:: REQUEST);
+        data [0] = count * 2;
+        memset (data + 1, (uint8_t) i, count * 2);
+        addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS, data, (count * 2) + 1, turnaround, aduType_t:: RESPONSE, request);
+        break;
+
+      case 1:
+        request = addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS, data, 4, gap, aduType_t:: REQUEST);
+        data [0] = 0x02;
+        addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS | 0x80, data, 1, turnaround, aduType_t:: EXCEPTION, request);
+        break;
+
+      case 2:
+        addFrame (0x00, MODBUS_FC_WRITE_SINGLE_REGISTER, data, 4, gap, aduType_t:: REQUEST);
+        addFrame (0x00, MODBUS_FC_WRITE_SINGLE_REGISTER, data, 4, gap, aduType_t:: REQUEST);
+        break;
+
+      case 3:
+        count = (uint8_t) ((i % 123) + 1);
+        data [3] = count;
+        data [4] = count * 2;
+        memset (data + 5, (uint8_t) i, count * 2);
+        request = addFrame (address, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, data, (count * 2) + 5, gap, aduType_t:: REQUEST);
+        addFrame (address, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, data, 4, turnaround, aduType_t:: RESPONSE, request);
+        break;
+
+      case 4:
+        addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS, data, 4, gap, aduType_t:: REQUEST);
+        request = addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS, data, 4, (RESPONSE_TIMEOUT * 1000UL) + gap, aduType_t:: REQUEST);
+        data [0] = count * 2;
+        memset (data + 1, (uint8_t) i, count * 2);
+        addFrame (address, MODBUS_FC_READ_HOLDING_REGISTERS, data, (count * 2) + 1, turnaround, aduType_t:: RESPONSE, request);
+        break;
+    }
+  }
+}
+
+//===================================================================================//
+/**
+ * @brief Records the frames reported by the sniffer.
+ *
+ * @param frame The frame.
+ */
+void recordFrame (CSE_ModbusRTU_Sniffer::frame_t& frame) {
+  capturedFrame_t record;
+
+  record.status = frame.status;
+  record.type = frame.adu.getType();
+  record.sequence = frame.sequence;
+  record.startTime = frame.startTime;
+  record.endTime = frame.endTime;
+  record.roundTripTime = frame.roundTripTime;
+  record.requestSequence = frame.requestSequence;
+
+  captured.push_back (record);
+}
+
+//===================================================================================//
+/**
+ * @brief Pushes the frames of the line into the receive buffer, and polls the sniffer
+ * whenever the next frame does not fit. The line ends before now, so the times of all
+ * the bytes are in the past, like the bytes that waited in the buffer of a late loop.
+ *
+ * @param sniffer The sniffer.
+ * @param base The time the line starts at.
+ * @param first The first frame to push.
+ * @param count The number of frames to push.
+ * @param polled If false, the frames are pushed without polling, and the buffer can
+ * overflow.
+ */
+void pushFrames (CSE_ModbusRTU_Sniffer& sniffer, uint32_t base, size_t first, size_t count, bool polled) {
+  for (size_t i = first; i < (first + count); i++) {
+    lineFrame_t& frame = line [i];
+
+    if (polled && ((MODBUS_RTU_RING_BUFFER_SIZE - 1 - ringBuffer.available()) < frame.length)) {
+      sniffer.poll();
+    }
+
+    for (uint16_t j = 0; j < frame.length; j++) {
+      ringBuffer.push (frame.bytes [j], base + frame.startTime + (j * BYTE_TIME));
+    }
+  }
+
+  sniffer.poll();
+}
+
+//===================================================================================//
+/**
+ * @brief Captures the traffic of a busy bus and checks every frame.
+ *
+ * @return true - All the checks passed.
+ */
+bool runTrafficTest() {
+  bool passed = true;
+
+  printf ("Traffic\n");
+
+  CSE_ModbusRTU snifferRTU (&snifferPort, 0x00, "snifferRTU");
+  CSE_ModbusRTU_Sniffer sniffer (snifferRTU, "sniffer");
+
+  snifferRTU.setBaudRate (BAUD_RATE);
+  snifferRTU.setReceiveBuffer (&ringBuffer);
+  ringBuffer.resetOverflowCount();
+
+  sniffer.setCallback (recordFrame);
+  sniffer.setResponseTimeout (RESPONSE_TIMEOUT);
+  passed &= check ("begin", sniffer.begin());
+
+  generateTraffic();
+  captured.clear();
+
+  uint32_t base = micros() - lineTime - 100000UL;
+  pushFrames (sniffer, base, 0, line.size(), true);
+
+  bool allCaptured = (captured.size() == line.size()) && (sniffer.getFrameCount() == line.size());
+  allCaptured = allCaptured && (sniffer.getErrorCount() == 0) && (sniffer.getDroppedFrameCount() == 0) && (ringBuffer.getOverflowCount() == 0);
+  passed &= check ("every frame captured", allCaptured);
+  printf ("  %u frames in %u transactions, %.2f seconds of traffic\n", (uint32_t) line.size(), TRANSACTION_COUNT, lineTime / 1000000.0);
+
+  if (!allCaptured) {
+    printf ("  %u captured, %u errors\n", (uint32_t) captured.size(), sniffer.getErrorCount());
+    return false;
+  }
+
+  uint32_t timeErrors = 0, typeErrors = 0, pairErrors = 0, timeErrorsRTT = 0;
+  uint32_t exceptions = 0, broadcasts = 0, unanswered = 0;
+
+  for (size_t i = 0; i < line.size(); i++) {
+    lineFrame_t& frame = line [i];
+    capturedFrame_t& record = captured [i];
+    uint32_t endTime = base + frame.startTime + ((frame.length - 1) * BYTE_TIME);
+
+    if ((record.status != frame.length) || (record.sequence != i) || (record.startTime != (base + frame.startTime)) || (record.endTime != endTime)) {
+      timeErrors++;
+    }
+
+    if (record.type != frame.type) {
+      typeErrors++;
+    }
+
+    if (frame.request >= 0) {
+      if (record.requestSequence != (uint32_t) frame.request) {
+        pairErrors++;
+      }
+
+      if (record.roundTripTime != (endTime - (base + line [frame.request].startTime))) {
+        timeErrorsRTT++;
+      }
+
+      exceptions += (frame.type == aduType_t:: EXCEPTION) ? 1 : 0;
+    }
+    else if ((record.roundTripTime != 0) || (record.requestSequence != 0)) {
+      pairErrors++;
+    }
+
+    if (frame.bytes [0] == 0x00) {
+      broadcasts++;
+    }
+    else if ((frame.type == aduType_t:: REQUEST) && (i + 1 < line.size()) && (line [i + 1].type == aduType_t:: REQUEST)) {
+      unanswered++;
+    }
+  }
+
+  passed &= check ("frame lengths, sequences and times", timeErrors == 0);
+  passed &= check ("frame types", typeErrors == 0);
+  passed &= check ("responses paired with their requests", pairErrors == 0);
+  passed &= check ("round trip times", timeErrorsRTT == 0);
+  passed &= check ("exception responses", (exceptions == (TRANSACTION_COUNT / 5)) && (typeErrors == 0));
+  passed &= check ("broadcasts never paired", (broadcasts == ((TRANSACTION_COUNT / 5) * 2)) && (typeErrors == 0));
+  passed &= check ("unanswered requests time out", (unanswered > 0) && (typeErrors == 0) && (pairErrors == 0));
+
+  snifferRTU.setReceiveBuffer (NULL);
+  return passed;
+}
+
+//===================================================================================//
+/**
+ * @brief Checks that the bytes dropped by the receive buffer and the frames dropped by
+ * the queue of the sniffer are counted.
+ *
+ * @return true - All the checks passed.
+ */
+bool runOverflowTest() {
+  bool passed = true;
+
+  printf ("\nOverflow\n");
+
+  CSE_ModbusRTU snifferRTU (&snifferPort, 0x00, "snifferRTU");
+  CSE_ModbusRTU_Sniffer sniffer (snifferRTU, "sniffer");
+
+  snifferRTU.setBaudRate (BAUD_RATE);
+  snifferRTU.setReceiveBuffer (&ringBuffer);
+  ringBuffer.resetOverflowCount();
+  sniffer.begin();
+
+  // Frames of 8 bytes that fill the buffer exactly, so the last byte does not fit
+  const uint32_t gap = MODBUS_RTU_FIXED_INTER_FRAME_DELAY + BYTE_TIME;
+  const size_t frameCount = MODBUS_RTU_RING_BUFFER_SIZE / 8;
+  uint8_t data [4] = { 0x00, 0x10, 0x00, 0x01 };
+
+  line.clear();
+  lineTime = 0;
+
+  for (size_t i = 0; i < frameCount; i++) {
+    addFrame (0x01, MODBUS_FC_WRITE_SINGLE_REGISTER, data, 4, gap, aduType_t:: REQUEST);
+  }
+
+  captured.clear();
+  sniffer.setCallback (recordFrame);
+  pushFrames (sniffer, micros() - lineTime - 100000UL, 0, frameCount, false);
+
+  bool ringCounted = (ringBuffer.getOverflowCount() == 1) && (captured.size() == frameCount) && (sniffer.getErrorCount() == 1);
+  ringCounted = ringCounted && (captured.back().status == MODBUS_RTU_RECEIVE_ERROR) && (captured.back().type == aduType_t:: NONE);
+  passed &= check ("receive buffer overflow counted", ringCounted);
+
+  // More frames than the queue holds, without reading them
+  sniffer.setCallback (NULL);
+  line.clear();
+  lineTime = 0;
+
+  for (size_t i = 0; i < (MODBUS_RTU_SNIFFER_QUEUE_SIZE + 5); i++) {
+    addFrame (0x00, MODBUS_FC_WRITE_SINGLE_REGISTER, data, 4, gap, aduType_t:: REQUEST);
+  }
+
+  pushFrames (sniffer, micros() - lineTime - 100000UL, 0, line.size(), true);
+
+  bool queueCounted = (sniffer.available() == MODBUS_RTU_SNIFFER_QUEUE_SIZE) && (sniffer.getDroppedFrameCount() == 5);
+  CSE_ModbusRTU_Sniffer::frame_t frame;
+
+  for (uint32_t i = 0; i < MODBUS_RTU_SNIFFER_QUEUE_SIZE; i++) {
+    queueCounted = queueCounted && sniffer.readFrame (frame) && (frame.sequence == (frameCount + i)) && (frame.status == 8);
+  }
+
+  queueCounted = queueCounted && !sniffer.readFrame (frame) && (sniffer.getFrameCount() == (frameCount + line.size()));
+  passed &= check ("queue overflow counted", queueCounted);
+
+  snifferRTU.setReceiveBuffer (NULL);
+  return passed;
+}
+
+//===================================================================================//
+
+int main() {
+  printf ("CSE_ModbusRTU - Sniffer Test\n\n");
+
+  CSE_ModbusRTU_Debug:: disableDebugMessages();
+
+  bool passed = true;
+
+  passed &= runTrafficTest();
+  passed &= runOverflowTest();
+
+  printf ("\n%s\n", passed ? "All tests passed." : "Tests failed!");
+
+  return passed ? 0 : 1;
+}
+
+//===================================================================================//